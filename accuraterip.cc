@@ -0,0 +1,453 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class calculates the AccurateRip v1/v2 checksums and the CRC32 of
+ * each track while the sectors are read.
+ *
+ * Database file layout (all values little endian), repeated per pressing:
+ *   uint8_t  tracks
+ *   uint32_t disc id 1, disc id 2, cddb id
+ *   per track: uint8_t confidence, uint32_t crc, uint32_t crc of frame 450
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <vdr/tools.h>
+#include "accuraterip.h"
+#include "cdmenu.h"
+#include "cdplayer.h"
+
+static uint32_t crc_table[4][256];
+static const uint32_t zero_samples[AR_MAX_OFFSET] = { 0 };
+
+static void InitCrcTable(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+        }
+        crc_table[0][i] = c;
+    }
+    for (int t = 1; t < 4; t++) {
+        for (int i = 0; i < 256; i++) {
+            uint32_t c = crc_table[t - 1][i];
+            crc_table[t][i] = (c >> 8) ^ crc_table[0][c & 0xff];
+        }
+    }
+}
+
+static uint32_t GetLe32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+cAccurateRip::cAccurateRip(void)
+{
+    if (crc_table[0][1] == 0) {
+        InitCrcTable();
+    }
+    mQueue = new uint8_t[AR_QUEUE_BLOCKS * CDIO_CD_FRAMESIZE_RAW];
+    mHead = 0;
+    mCount = 0;
+    mActive = false;
+    mGeneration = 0;
+    mOffset = 0;
+    mParanoia = false;
+    mDiscId1 = 0;
+    mDiscId2 = 0;
+    mCddbId = 0;
+    mMarkParanoia = false;
+}
+
+cAccurateRip::~cAccurateRip()
+{
+    Cancel(-1);
+    mMutex.Lock();
+    mCond.Broadcast();
+    mMutex.Unlock();
+    Cancel(3);
+    delete[] mQueue;
+}
+
+// Sum of sample * multiplier (v1) and of the high and low word of the
+// 64 bit product (v2). Without branches so it can be vectorized.
+void cAccurateRip::ArSum(const uint32_t *samples, int count, uint32_t mul,
+                         uint32_t &v1, uint32_t &v2)
+{
+    uint32_t s1 = 0;
+    uint32_t s2 = 0;
+
+    for (int i = 0; i < count; i++) {
+        uint64_t p = (uint64_t)samples[i] * (uint32_t)(mul + i);
+        s1 += (uint32_t)p;
+        s2 += (uint32_t)p + (uint32_t)(p >> 32);
+    }
+    v1 += s1;
+    v2 += s2;
+}
+
+// CRC32 (as zlib) of the samples in little endian byte order, slicing by 4
+uint32_t cAccurateRip::Crc32(uint32_t crc, const uint32_t *samples, int count)
+{
+    for (int i = 0; i < count; i++) {
+        crc ^= samples[i];
+        crc = crc_table[3][crc & 0xff] ^ crc_table[2][(crc >> 8) & 0xff] ^
+              crc_table[1][(crc >> 16) & 0xff] ^ crc_table[0][crc >> 24];
+    }
+    return crc;
+}
+
+void cAccurateRip::CalcDiscIds(const std::vector<lsn_t> &start,
+                               const std::vector<lsn_t> &end,
+                               uint32_t &id1, uint32_t &id2)
+{
+    int n = start.size();
+
+    id1 = 0;
+    id2 = 0;
+    if (n == 0) {
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        id1 += start[i];
+        id2 += ((start[i] > 0) ? start[i] : 1) * (i + 1);
+    }
+    id1 += end[n - 1] + 1;
+    id2 += (end[n - 1] + 1) * (n + 1);
+}
+
+std::string cAccurateRip::GetDiscKey(int tracks, uint32_t id1, uint32_t id2,
+                                     uint32_t cddbid)
+{
+    char key[32];
+
+    snprintf(key, sizeof(key), "%03d-%08x-%08x-%08x", tracks, id1, id2,
+             cddbid);
+    return key;
+}
+
+bool cAccurateRip::NeedParanoia(const std::vector<lsn_t> &start,
+                                const std::vector<lsn_t> &end, uint32_t cddbid)
+{
+    std::string fname = cPluginCdplayer::GetConfigDir() + AR_PARANOIA_FILE;
+    uint32_t id1, id2;
+    char line[64];
+    bool found = false;
+
+    CalcDiscIds(start, end, id1, id2);
+    std::string key = GetDiscKey(start.size(), id1, id2, cddbid);
+    FILE *fp = fopen(fname.c_str(), "r");
+    if (fp == NULL) {
+        return false;
+    }
+    while (!found && (fgets(line, sizeof(line), fp) != NULL)) {
+        found = (strncmp(line, key.c_str(), key.size()) == 0);
+    }
+    fclose(fp);
+    return found;
+}
+
+// Must be called with locked mTrackMutex
+void cAccurateRip::LoadDatabase(void)
+{
+    std::string key = GetDiscKey(mTracks.size(), mDiscId1, mDiscId2, mCddbId);
+    std::string dir = cPluginCdplayer::GetConfigDir() + AR_DB_DIR;
+    std::string names[2];
+    uint8_t buf[4096];
+    char sub[16];
+    size_t len;
+
+    mDb.clear();
+    // Flat or in the layout of the AccurateRip server
+    snprintf(sub, sizeof(sub), "%x/%x/%x/", mDiscId1 & 0xf,
+             (mDiscId1 >> 4) & 0xf, (mDiscId1 >> 8) & 0xf);
+    names[0] = dir + "dBAR-" + key + ".bin";
+    names[1] = dir + sub + "dBAR-" + key + ".bin";
+    for (int i = 0; i < 2; i++) {
+        FILE *fp = fopen(names[i].c_str(), "rb");
+        if (fp == NULL) {
+            continue;
+        }
+        while ((len = fread(buf, 1, sizeof(buf), fp)) > 0) {
+            mDb.insert(mDb.end(), buf, buf + len);
+        }
+        fclose(fp);
+        dsyslog("%s %d AccurateRip data %s", __FILE__, __LINE__,
+                names[i].c_str());
+        return;
+    }
+    dsyslog("%s %d no AccurateRip data for %s", __FILE__, __LINE__,
+            key.c_str());
+}
+
+void cAccurateRip::Setup(const std::vector<lsn_t> &start,
+                         const std::vector<lsn_t> &end,
+                         uint32_t cddbid, bool paranoia)
+{
+    cMutexLock MutexLock(&mMutex);
+    cMutexLock TrackLock(&mTrackMutex);
+    AR_TRACK_T t;
+
+    memset(&t, 0, sizeof(t));
+    t.mResult = AR_UNVERIFIED;
+    mTracks.clear();
+    for (int i = 0; i < (int)start.size(); i++) {
+        t.mStartLsn = start[i];
+        t.mSamples = (end[i] - start[i] + 1) * AR_SAMPLES_PER_BLOCK;
+        t.mBroken = true;
+        mTracks.push_back(t);
+    }
+    mHead = 0;
+    mCount = 0;
+    mOffset = cMenuCDPlayer::GetReadOffset();
+    if (mOffset > AR_MAX_OFFSET) {
+        mOffset = AR_MAX_OFFSET;
+    }
+    if (mOffset < -AR_MAX_OFFSET) {
+        mOffset = -AR_MAX_OFFSET;
+    }
+    mParanoia = paranoia;
+    mMarkParanoia = false;
+    mCddbId = cddbid;
+    CalcDiscIds(start, end, mDiscId1, mDiscId2);
+    LoadDatabase();
+    mActive = !mTracks.empty();
+    mGeneration++;
+}
+
+void cAccurateRip::Reset(void)
+{
+    cMutexLock MutexLock(&mMutex);
+    cMutexLock TrackLock(&mTrackMutex);
+    mTracks.clear();
+    mDb.clear();
+    mCount = 0;
+    mActive = false;
+    mGeneration++;
+}
+
+void cAccurateRip::Feed(lsn_t lsn, const uint8_t *data)
+{
+    cMutexLock MutexLock(&mMutex);
+    // A full queue drops the sector, the tracks are then unverified
+    if (!mActive || (mCount == AR_QUEUE_BLOCKS)) {
+        return;
+    }
+    int idx = (mHead + mCount) % AR_QUEUE_BLOCKS;
+    memcpy(mQueue + idx * CDIO_CD_FRAMESIZE_RAW, data, CDIO_CD_FRAMESIZE_RAW);
+    mQueueLsn[idx] = lsn;
+    mCount++;
+    mCond.Broadcast();
+}
+
+AR_RESULT_T cAccurateRip::GetResult(TRACK_IDX_T track, int *confidence,
+                                    uint32_t *crc)
+{
+    cMutexLock MutexLock(&mTrackMutex);
+    if ((track < 0) || (track >= (TRACK_IDX_T)mTracks.size())) {
+        return AR_UNVERIFIED;
+    }
+    if (confidence != NULL) {
+        *confidence = mTracks[track].mConfidence;
+    }
+    if (crc != NULL) {
+        *crc = ~mTracks[track].mCrc32;
+    }
+    return mTracks[track].mResult;
+}
+
+// Must be called with locked mTrackMutex. pos is the sample number within the
+// track, samples which were already added are skipped.
+void cAccurateRip::AddSamples(int track, int64_t pos, const uint32_t *samples,
+                              int count)
+{
+    AR_TRACK_T &t = mTracks[track];
+    int64_t from = (track == 0) ? AR_SKIP_SAMPLES - 1 : 1;
+    int64_t to = t.mSamples;
+
+    if (t.mResult != AR_UNVERIFIED) {
+        return;
+    }
+    if (pos == 0) {
+        t.mNext = 0;
+        t.mBroken = false;
+        t.mCrc32 = 0xffffffff;
+        t.mArV1 = 0;
+        t.mArV2 = 0;
+    }
+    if (t.mBroken) {
+        return;
+    }
+    if (pos > t.mNext) {
+        dsyslog("%s %d track %d incomplete", __FILE__, __LINE__, track);
+        t.mBroken = true;
+        return;
+    }
+    if (pos + count <= t.mNext) {
+        return;
+    }
+    samples += t.mNext - pos;
+    count -= t.mNext - pos;
+    pos = t.mNext;
+
+    t.mCrc32 = Crc32(t.mCrc32, samples, count);
+    // The multiplier is the sample number starting with 1
+    if (track == (int)mTracks.size() - 1) {
+        to -= AR_SKIP_SAMPLES;
+    }
+    int64_t lo = (pos + 1 > from) ? pos + 1 : from;
+    int64_t hi = (pos + count < to) ? pos + count : to;
+    if (lo <= hi) {
+        ArSum(samples + (lo - pos - 1), hi - lo + 1, lo, t.mArV1, t.mArV2);
+    }
+    t.mNext += count;
+    if (t.mNext >= t.mSamples) {
+        Verify(track);
+    }
+}
+
+// Must be called with locked mTrackMutex
+void cAccurateRip::Process(lsn_t lsn, const uint8_t *data)
+{
+    uint32_t samples[AR_SAMPLES_PER_BLOCK];
+    int last = mTracks.size() - 1;
+
+    for (int i = 0; i < AR_SAMPLES_PER_BLOCK; i++) {
+        samples[i] = GetLe32(data + 4 * i);
+    }
+    // The correct sample n is read as sample n + offset
+    int64_t first = (int64_t)lsn * AR_SAMPLES_PER_BLOCK - mOffset;
+    int64_t end = first + AR_SAMPLES_PER_BLOCK;
+
+    // Samples before the start of the disc can not be read
+    if ((lsn == mTracks[0].mStartLsn) && (mOffset < 0)) {
+        AddSamples(0, 0, zero_samples, -mOffset);
+    }
+    for (int t = 0; t <= last; t++) {
+        int64_t ts = (int64_t)mTracks[t].mStartLsn * AR_SAMPLES_PER_BLOCK;
+        int64_t te = ts + mTracks[t].mSamples;
+        int64_t s = (first > ts) ? first : ts;
+        int64_t e = (end < te) ? end : te;
+        if (s < e) {
+            AddSamples(t, s - ts, samples + (s - first), e - s);
+        }
+    }
+    // Samples after the end of the disc can not be read
+    if ((mOffset > 0) &&
+        ((int64_t)(lsn + 1) * AR_SAMPLES_PER_BLOCK ==
+         (int64_t)mTracks[last].mStartLsn * AR_SAMPLES_PER_BLOCK +
+         mTracks[last].mSamples)) {
+        AddSamples(last, mTracks[last].mSamples - mOffset, zero_samples,
+                   mOffset);
+    }
+}
+
+// Must be called with locked mTrackMutex
+void cAccurateRip::Verify(int track)
+{
+    AR_TRACK_T &t = mTracks[track];
+    size_t pos = 0;
+    bool known = false;
+
+    t.mConfidence = 0;
+    while (pos + 13 <= mDb.size()) {
+        int n = mDb[pos];
+        bool match = (n == (int)mTracks.size()) &&
+                     (GetLe32(&mDb[pos + 1]) == mDiscId1) &&
+                     (GetLe32(&mDb[pos + 5]) == mDiscId2) &&
+                     (GetLe32(&mDb[pos + 9]) == mCddbId);
+        pos += 13;
+        if (pos + n * 9 > mDb.size()) {
+            break;
+        }
+        if (match) {
+            int conf = mDb[pos + track * 9];
+            uint32_t crc = GetLe32(&mDb[pos + track * 9 + 1]);
+            known = true;
+            if ((crc == t.mArV1) || (crc == t.mArV2)) {
+                t.mConfidence += conf;
+            }
+        }
+        pos += n * 9;
+    }
+    if (t.mConfidence > 0) {
+        t.mResult = AR_ACCURATE;
+    }
+    else if (known) {
+        t.mResult = AR_MISMATCH;
+        // Remember the disc only once
+        if (!mParanoia) {
+            mMarkParanoia = true;
+            mParanoia = true;
+        }
+    }
+    else {
+        t.mResult = AR_UNKNOWN;
+    }
+    dsyslog("%s %d track %d CRC %08x AR v1 %08x v2 %08x result %d (%d)",
+            __FILE__, __LINE__, track + 1, ~t.mCrc32, t.mArV1, t.mArV2,
+            t.mResult, t.mConfidence);
+    cPluginCdplayer::GetPlayState().SetVerified();
+}
+
+void cAccurateRip::Action(void)
+{
+    while (Running()) {
+        std::string key;
+        uint8_t data[CDIO_CD_FRAMESIZE_RAW];
+        lsn_t lsn = 0;
+        unsigned int generation = 0;
+        bool valid = false;
+
+        // Only the copy of the sector is done with the queue locked, the
+        // reader does not wait in Feed while the sums are calculated.
+        mMutex.Lock();
+        if (mCount == 0) {
+            mCond.TimedWait(mMutex, 500);
+        }
+        if ((mCount > 0) && mActive) {
+            memcpy(data, mQueue + mHead * CDIO_CD_FRAMESIZE_RAW,
+                   CDIO_CD_FRAMESIZE_RAW);
+            lsn = mQueueLsn[mHead];
+            generation = mGeneration;
+            valid = true;
+            mHead = (mHead + 1) % AR_QUEUE_BLOCKS;
+            mCount--;
+        }
+        mMutex.Unlock();
+
+        mTrackMutex.Lock();
+        // The sector is dropped if the disc changed since it was queued
+        if (valid && (generation == mGeneration)) {
+            Process(lsn, data);
+        }
+        if (mMarkParanoia) {
+            mMarkParanoia = false;
+            key = GetDiscKey(mTracks.size(), mDiscId1, mDiscId2, mCddbId);
+        }
+        mTrackMutex.Unlock();
+
+        // Remember the disc, it is read with paranoia next time
+        if (!key.empty()) {
+            std::string fname = cPluginCdplayer::GetConfigDir() +
+                                AR_PARANOIA_FILE;
+            isyslog("cdplayer: disc %s is not accurate, use paranoia",
+                    key.c_str());
+            FILE *fp = fopen(fname.c_str(), "a");
+            if (fp != NULL) {
+                fprintf(fp, "%s\n", key.c_str());
+                fclose(fp);
+            }
+            else {
+                esyslog("%s %d can not write %s: %m",
+                        __FILE__, __LINE__, fname.c_str());
+            }
+        }
+    }
+}
@@ -0,0 +1,108 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class calculates the AccurateRip v1/v2 checksums and the CRC32 of
+ * each track while the sectors are read. The reader thread only copies
+ * the sectors into a queue, the sums are calculated by a worker thread.
+ * Completely read tracks are checked against a local AccurateRip
+ * database file (dBAR-nnn-xxxxxxxx-yyyyyyyy-zzzzzzzz.bin).
+ */
+
+#ifndef __ACCURATERIP_H__
+#define __ACCURATERIP_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <vdr/thread.h>
+#include "cdinfo.h"
+
+#define AR_SAMPLES_PER_BLOCK (CDIO_CD_FRAMESIZE_RAW / 4)
+// Samples at the start of the first and end of the last track which are
+// not included in the AccurateRip checksums
+#define AR_SKIP_SAMPLES      (5 * AR_SAMPLES_PER_BLOCK)
+#define AR_MAX_OFFSET        AR_SKIP_SAMPLES
+#define AR_QUEUE_BLOCKS      (4 * CDIO_CD_FRAMES_PER_SEC)
+#define AR_DB_DIR            "accuraterip/"
+#define AR_PARANOIA_FILE     "paranoia.discs"
+
+typedef enum _ar_result {
+    AR_UNVERIFIED,  // Not read completely
+    AR_UNKNOWN,     // Disc or track not in the database
+    AR_ACCURATE,    // Matches the database
+    AR_MISMATCH     // The disc is known but the track differs
+} AR_RESULT_T;
+
+typedef struct _ar_track {
+    lsn_t mStartLsn;
+    uint32_t mSamples;      // Number of samples of the track
+    uint32_t mNext;         // Next expected sample of the track
+    bool mBroken;           // Samples are missing, wait for the start
+    uint32_t mCrc32;
+    uint32_t mArV1;
+    uint32_t mArV2;
+    AR_RESULT_T mResult;
+    int mConfidence;
+} AR_TRACK_T;
+
+class cAccurateRip: public cThread {
+private:
+    cMutex mMutex;          // Protects the queue
+    cMutex mTrackMutex;     // Protects the tracks, taken after mMutex
+    bool mActive;           // Tracks are set up, copy of !mTracks.empty()
+    unsigned int mGeneration;   // Changed by Setup and Reset under both locks
+    cCondVar mCond;
+    uint8_t *mQueue;
+    lsn_t mQueueLsn[AR_QUEUE_BLOCKS];
+    int mHead;
+    int mCount;
+    std::vector<AR_TRACK_T> mTracks;
+    int mOffset;            // Read offset correction in samples
+    bool mParanoia;         // Disc is read with paranoia
+    uint32_t mDiscId1;
+    uint32_t mDiscId2;
+    uint32_t mCddbId;
+    std::vector<uint8_t> mDb;   // Content of the database file
+    bool mMarkParanoia;         // A track failed without paranoia
+
+    void Process(lsn_t lsn, const uint8_t *data);
+    void AddSamples(int track, int64_t pos, const uint32_t *samples,
+                    int count);
+    void Verify(int track);
+    void LoadDatabase(void);
+    static std::string GetDiscKey(int tracks, uint32_t id1, uint32_t id2,
+                                  uint32_t cddbid);
+protected:
+    virtual void Action(void);
+public:
+    cAccurateRip(void);
+    virtual ~cAccurateRip();
+    // Start with a new disc. start and end (inclusive) are the lsn of the
+    // audio tracks in CD order.
+    void Setup(const std::vector<lsn_t> &start, const std::vector<lsn_t> &end,
+               uint32_t cddbid, bool paranoia);
+    void Reset(void);
+    // Called by the reader thread for each sector, never blocks
+    void Feed(lsn_t lsn, const uint8_t *data);
+    // Result of a track in CD order
+    AR_RESULT_T GetResult(TRACK_IDX_T track, int *confidence = NULL,
+                          uint32_t *crc = NULL);
+    // Disc failed the verification without paranoia before
+    static bool NeedParanoia(const std::vector<lsn_t> &start,
+                             const std::vector<lsn_t> &end, uint32_t cddbid);
+    static void CalcDiscIds(const std::vector<lsn_t> &start,
+                            const std::vector<lsn_t> &end,
+                            uint32_t &id1, uint32_t &id2);
+    // Add count samples to the checksums, mul is the AccurateRip
+    // multiplier of the first sample.
+    static void ArSum(const uint32_t *samples, int count, uint32_t mul,
+                      uint32_t &v1, uint32_t &v2);
+    static uint32_t Crc32(uint32_t crc, const uint32_t *samples, int count);
+};
+
+#endif
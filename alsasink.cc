@@ -0,0 +1,296 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the ALSA output sink.
+ */
+
+#ifdef USE_ALSA
+
+#include <errno.h>
+#include <string.h>
+#include <vdr/tools.h>
+#include "alsasink.h"
+
+cAlsaSink::cAlsaSink(const std::string &device)
+    : mDevice(device), mPcm(NULL), mMmap(false), mPeriod(0), mBuffer(0),
+      mXruns(0)
+{
+}
+
+cAlsaSink::~cAlsaSink()
+{
+    Close();
+}
+
+// CD format in host order as written by the resampler, one sector per
+// period. Playback starts when half of the buffer is filled.
+bool cAlsaSink::SetParams(void)
+{
+    snd_pcm_hw_params_t *hw = NULL;
+    snd_pcm_sw_params_t *sw = NULL;
+    const char *what = NULL;
+    int dir = 0;
+    int err;
+
+    if ((snd_pcm_hw_params_malloc(&hw) < 0) ||
+        (snd_pcm_sw_params_malloc(&sw) < 0)) {
+        esyslog("%s %d Out of memory", __FILE__, __LINE__);
+        if (hw != NULL) {
+            snd_pcm_hw_params_free(hw);
+        }
+        return false;
+    }
+    mPeriod = ALSA_PERIOD_FRAMES;
+    mBuffer = ALSA_PERIOD_FRAMES * ALSA_PERIODS;
+    if ((err = snd_pcm_hw_params_any(mPcm, hw)) < 0) {
+        what = "hw params";
+    }
+    else {
+        mMmap = (snd_pcm_hw_params_set_access(mPcm, hw,
+                        SND_PCM_ACCESS_MMAP_INTERLEAVED) >= 0);
+        if (!mMmap) {
+            dsyslog("%s %d %s has no mmap access, using writei",
+                    __FILE__, __LINE__, mDevice.c_str());
+            err = snd_pcm_hw_params_set_access(mPcm, hw,
+                                               SND_PCM_ACCESS_RW_INTERLEAVED);
+        }
+        if (err < 0) {
+            what = "access";
+        }
+        else if ((err = snd_pcm_hw_params_set_format(mPcm, hw,
+                                                SND_PCM_FORMAT_S16)) < 0) {
+            what = "format";
+        }
+        else if ((err = snd_pcm_hw_params_set_channels(mPcm, hw, 2)) < 0) {
+            what = "channels";
+        }
+        else if ((err = snd_pcm_hw_params_set_rate(mPcm, hw, 44100, 0)) < 0) {
+            what = "rate 44100 (try plug:device)";
+        }
+        else if ((err = snd_pcm_hw_params_set_period_size_near(mPcm, hw,
+                                                    &mPeriod, &dir)) < 0) {
+            what = "period size";
+        }
+        else if ((err = snd_pcm_hw_params_set_buffer_size_near(mPcm, hw,
+                                                    &mBuffer)) < 0) {
+            what = "buffer size";
+        }
+        else if ((err = snd_pcm_hw_params(mPcm, hw)) < 0) {
+            what = "hw params";
+        }
+        else {
+            snd_pcm_hw_params_get_period_size(hw, &mPeriod, &dir);
+            snd_pcm_hw_params_get_buffer_size(hw, &mBuffer);
+            if (((err = snd_pcm_sw_params_current(mPcm, sw)) < 0) ||
+                ((err = snd_pcm_sw_params_set_start_threshold(mPcm, sw,
+                                                        mBuffer / 2)) < 0) ||
+                ((err = snd_pcm_sw_params_set_avail_min(mPcm, sw,
+                                                        mPeriod)) < 0) ||
+                ((err = snd_pcm_sw_params(mPcm, sw)) < 0)) {
+                what = "sw params";
+            }
+        }
+    }
+    snd_pcm_hw_params_free(hw);
+    snd_pcm_sw_params_free(sw);
+    if (what != NULL) {
+        esyslog("%s %d %s: can not set %s: %s", __FILE__, __LINE__,
+                mDevice.c_str(), what, snd_strerror(err));
+        return false;
+    }
+    mDrift.SetTarget(mBuffer / 2);
+    dsyslog("%s %d %s period %lu buffer %lu frames%s", __FILE__, __LINE__,
+            mDevice.c_str(), (unsigned long)mPeriod, (unsigned long)mBuffer,
+            mMmap ? " mmap" : "");
+    return true;
+}
+
+bool cAlsaSink::Open(void)
+{
+    int err;
+
+    mXruns = 0;
+    mResampler.Reset();
+    mDrift.Reset();
+    // Not blocking, so a busy device does not hang the sink
+    err = snd_pcm_open(&mPcm, mDevice.c_str(), SND_PCM_STREAM_PLAYBACK,
+                       SND_PCM_NONBLOCK);
+    if (err < 0) {
+        esyslog("%s %d Can not open %s: %s", __FILE__, __LINE__,
+                mDevice.c_str(), snd_strerror(err));
+        mPcm = NULL;
+        return false;
+    }
+    if (!SetParams()) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+// Underruns and suspends are recovered, the device starts again when
+// enough data is written
+bool cAlsaSink::Recover(int err)
+{
+    if (err == -EAGAIN) {
+        return true;
+    }
+    if (err == -EPIPE) {
+        mXruns++;
+    }
+    mDrift.Restart();
+    err = snd_pcm_recover(mPcm, err, 1);
+    if (err < 0) {
+        esyslog("%s %d %s: %s", __FILE__, __LINE__, mDevice.c_str(),
+                snd_strerror(err));
+        return false;
+    }
+    // A resumed device may still hold the queued frames
+    return StartFilled();
+}
+
+// The start threshold only applies to snd_pcm_writei, a device written by
+// mmap stays prepared until it is started
+bool cAlsaSink::StartFilled(void)
+{
+    snd_pcm_sframes_t avail;
+    int err;
+
+    if (snd_pcm_state(mPcm) != SND_PCM_STATE_PREPARED) {
+        return true;
+    }
+    avail = snd_pcm_avail_update(mPcm);
+    if ((avail < 0) || (mBuffer - (snd_pcm_uframes_t)avail < mBuffer / 2)) {
+        return true;
+    }
+    err = snd_pcm_start(mPcm);
+    if (err < 0) {
+        esyslog("%s %d %s: can not start: %s", __FILE__, __LINE__,
+                mDevice.c_str(), snd_strerror(err));
+        return false;
+    }
+    return true;
+}
+
+// The queue depth is only meaningful while the device plays, the start
+// threshold is the target
+void cAlsaSink::UpdateDrift(void)
+{
+    snd_pcm_sframes_t delay;
+
+    if ((snd_pcm_state(mPcm) != SND_PCM_STATE_RUNNING) ||
+        (snd_pcm_delay(mPcm, &delay) < 0)) {
+        mDrift.Restart();
+        return;
+    }
+    mResampler.SetRatio(mDrift.Update(delay));
+}
+
+bool cAlsaSink::Write(const uint8_t *data, int blocks)
+{
+    for (int i = 0; i < blocks; i++) {
+        int frames = mResampler.Process(data, mOut);
+        if (!WriteFrames(mOut, frames)) {
+            return false;
+        }
+        UpdateDrift();
+        data += CDIO_CD_FRAMESIZE_RAW;
+    }
+    return true;
+}
+
+bool cAlsaSink::WriteFrames(const int16_t *data, snd_pcm_uframes_t frames)
+{
+    cTimeMs stall(ALSA_STALL_MS);
+
+    while (frames > 0) {
+        snd_pcm_sframes_t avail;
+        snd_pcm_uframes_t n = (frames < mPeriod) ? frames : mPeriod;
+
+        if (stall.TimedOut()) {
+            esyslog("%s %d %s does not play", __FILE__, __LINE__,
+                    mDevice.c_str());
+            return false;
+        }
+        avail = snd_pcm_avail_update(mPcm);
+        if (avail < 0) {
+            if (!Recover(avail)) {
+                return false;
+            }
+            continue;
+        }
+        if ((snd_pcm_uframes_t)avail < n) {
+            // Wait until the device has played a period
+            if (!StartFilled()) {
+                return false;
+            }
+            int err = snd_pcm_wait(mPcm, ALSA_WAIT_MS);
+            if ((err < 0) && !Recover(err)) {
+                return false;
+            }
+            continue;
+        }
+        if (mMmap) {
+            const snd_pcm_channel_area_t *areas;
+            snd_pcm_uframes_t offset;
+            snd_pcm_sframes_t done;
+            int err = snd_pcm_mmap_begin(mPcm, &areas, &offset, &n);
+            if (err < 0) {
+                if (!Recover(err)) {
+                    return false;
+                }
+                continue;
+            }
+            // Interleaved: the frames are contiguous. first and step are
+            // in bits, for 16 bit stereo 0 and 32.
+            memcpy((uint8_t *)areas[0].addr +
+                   (areas[0].first + offset * areas[0].step) / 8,
+                   data, n * ALSA_FRAME_SIZE);
+            done = snd_pcm_mmap_commit(mPcm, offset, n);
+            if (done < 0) {
+                if (!Recover(done)) {
+                    return false;
+                }
+                continue;
+            }
+            n = done;
+            if (!StartFilled()) {
+                return false;
+            }
+        }
+        else {
+            snd_pcm_sframes_t done = snd_pcm_writei(mPcm, data, n);
+            if (done < 0) {
+                if (!Recover(done)) {
+                    return false;
+                }
+                continue;
+            }
+            n = done;
+        }
+        data += n * 2;
+        frames -= n;
+        if (n > 0) {
+            stall.Set(ALSA_STALL_MS);
+        }
+    }
+    return true;
+}
+
+void cAlsaSink::Close(void)
+{
+    if (mPcm != NULL) {
+        dsyslog("%s %d %s closed, %u underruns, drift %.0f ppm", __FILE__,
+                __LINE__, mDevice.c_str(), mXruns, mDrift.GetPpm());
+        snd_pcm_drop(mPcm);
+        snd_pcm_close(mPcm);
+        mPcm = NULL;
+    }
+}
+
+#endif
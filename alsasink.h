@@ -0,0 +1,68 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements an output sink writing the played audio directly
+ * to an ALSA device, e.g. a DAC which is not connected to the TV, without
+ * the PES conversion and the audio path of the VDR device. The data is
+ * copied into the mmap buffer of the device one period (one sector) at a
+ * time, whenever the device has played a period, so the sink is paced by
+ * the clock of the sound card. Devices without mmap support are written
+ * with snd_pcm_writei.
+ *
+ * As the player is paced by the VDR device, the queue of the sound card
+ * slowly fills or drains. The queue depth is measured after each block
+ * and the blocks are resampled by up to 0.1 % to hold it at half of the
+ * buffer (resampler.h).
+ */
+
+#ifndef __ALSASINK_H__
+#define __ALSASINK_H__
+
+#ifdef USE_ALSA
+
+#include <string>
+#include <alsa/asoundlib.h>
+#include "outputsink.h"
+#include "resampler.h"
+
+#define ALSA_FRAME_SIZE     4       // 16 bit stereo
+#define ALSA_PERIOD_FRAMES  (CDIO_CD_FRAMESIZE_RAW / ALSA_FRAME_SIZE)
+#define ALSA_PERIODS        8       // Buffer of about 100 ms
+#define ALSA_WAIT_MS        100
+#define ALSA_STALL_MS       2000    // No progress, the device is gone
+#define SINK_ALSA_BUDGET    SINK_NET_BUDGET
+
+class cAlsaSink: public cOutputSink {
+private:
+    std::string mDevice;
+    snd_pcm_t *mPcm;
+    bool mMmap;                 // Else written with snd_pcm_writei
+    snd_pcm_uframes_t mPeriod;
+    snd_pcm_uframes_t mBuffer;
+    unsigned int mXruns;
+    cResampler mResampler;
+    cDriftControl mDrift;
+    int16_t mOut[RESAMPLE_MAX_OUT * 2];
+
+    bool SetParams(void);
+    bool Recover(int err);
+    bool StartFilled(void);
+    bool WriteFrames(const int16_t *data, snd_pcm_uframes_t frames);
+    void UpdateDrift(void);
+public:
+    cAlsaSink(const std::string &device);
+    virtual ~cAlsaSink();
+    virtual bool Open(void);
+    virtual bool Write(const uint8_t *data, int blocks);
+    virtual void Close(void);
+    virtual std::string GetName(void) { return "alsa " + mDevice; }
+    virtual int GetBudget(void) { return SINK_ALSA_BUDGET; }
+};
+
+#endif
+#endif
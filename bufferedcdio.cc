@@ -49,16 +49,29 @@ const char *cBufferedCdio::cd_text_field[MAX_CDTEXT_FIELDS+1] = {
 };
 #endif
 cBufferedCdio::cBufferedCdio(void) :
-        mRingBuffer(CCDIO_MAX_BLOCKS)
+        mPlaylist(mCdInfo),
+        mFingerprinter(mCdInfo),
+#ifdef USE_FLAC
+        mRipper(mCdInfo),
+#endif
+        mRingBuffer(CCDIO_MAX_BLOCKS, CCDIO_HISTORY_BLOCKS)
 {
     cMutexLock MutexLock(&mCdMutex);
-#ifdef USE_PARANOIA
-    pParanoiaDrive = NULL;
-    pParanoiaCd = NULL;
-#endif
-    pCdio = NULL;
+    mSource = NULL;
     mCurrTrackIdx = INVALID_TRACK_IDX;
-    mState = BCDIO_STARTING;
+    mPlayTrackIdx = 0;
+    mPlayLsn = 0;
+    mUseParanoia = false;
+    mPlayRandom = false;
+    mResumeTrack = INVALID_TRACK_IDX;
+    mResumeLsn = 0;
+    mQueueVersion = 0;
+    mLoopMode = CD_LOOP_OFF;
+    mLoopA = CDIO_INVALID_LSN;
+    mLibKey.mNumTracks = 0;
+    mLibTrack = INVALID_TRACK_IDX;
+    mLibPos = 0;
+    SetState(BCDIO_STARTING);
     SetDescription("BufferedCdio");
     cd_text_field[CDTEXT_ARRANGER]  = tr("Arranger");
     cd_text_field[CDTEXT_COMPOSER]  = tr("Composer");
@@ -76,38 +89,38 @@ cBufferedCdio::cBufferedCdio(void) :
     cd_text_field[CDTEXT_TOC_INFO]  = tr("Info1");
     cd_text_field[CDTEXT_TOC_INFO2] = tr("Info2");
 #endif
-    mSpanPlugin = cPluginManager::CallFirstService(SPAN_SET_PCM_DATA_ID, NULL);
 }
 
 cBufferedCdio::~cBufferedCdio(void)
 {
-    cMutexLock MutexLock(&mCdMutex);
-    mState = BCDIO_STOP;
+    SetState(BCDIO_STOP);
     if (Active()) {
+        mRingBuffer.InterruptPut();
         Cancel(3);
     }
-#ifdef USE_PARANOIA
-    pParanoiaDrive = NULL;
-    if (pParanoiaCd != NULL) {
-        cdio_paranoia_free(pParanoiaCd);
-    }
-#endif
-    if (pCdio != NULL) {
-        cdio_destroy(pCdio);
-    }
+    cMutexLock MutexLock(&mCdMutex);
+    delete mSource;
 }
 
+// Return the track which is currently played (not read)
 TRACK_IDX_T cBufferedCdio::GetCurrTrack(int *total, int *curr)
 {
+    TRACK_IDX_T track = mPlayTrackIdx;
     if (total != NULL) {
-        *total = (GetEndLsn(mCurrTrackIdx) - GetStartLsn(mCurrTrackIdx))
+        *total = (GetEndLsn(track) - GetStartLsn(track))
                             / CDIO_CD_FRAMES_PER_SEC;
     }
     if (curr != NULL) {
-        *curr = (mCurrLsn - GetStartLsn(mCurrTrackIdx))  / CDIO_CD_FRAMES_PER_SEC;
+        *curr = (mPlayLsn - GetStartLsn(track))  / CDIO_CD_FRAMES_PER_SEC;
     }
-    return mCurrTrackIdx;
+    return track;
+}
+void cBufferedCdio::SetState(BUFCDIO_STATE_T state)
+{
+    mState = state;
+    cPluginCdplayer::GetPlayState().SetState(state);
 }
+
 // Get name of a CD-Text field
 const char *cBufferedCdio::GetCdTextField(const cdtext_field_t type)
 {
@@ -117,111 +130,78 @@ const char *cBufferedCdio::GetCdTextField(const cdtext_field_t type)
     return cd_text_field[type];
 }
 
-#if LIBCDIO_VERSION_NUM > 83
-// Get all available CD-Text for a track
-void cBufferedCdio::GetCDText (const track_t track_no, CD_TEXT_T &cd_text)
-{
-    int i;
-    const char *txt;
-
-    for (i = 0; i < MAX_CDTEXT_FIELDS; i++) {
-        txt = cdtext_get_const (pCdioCdtext, (cdtext_field_t)i, track_no);
-        if (txt != NULL) {
-            cd_text[i] = txt;
-            dsyslog ("CD-Text %d: %s", i, cd_text[i].c_str());
-        }
-    }
-}
-#else
-// Get all available CD-Text for a track
-void cBufferedCdio::GetCDText (const track_t track_no, CD_TEXT_T &cd_text)
-{
-    int i;
-    const cdtext_t *cdtext = cdio_get_cdtext(pCdio, track_no);
-
-    if (cdtext == NULL) {
-        dsyslog ("No CD-Text found");
-        return;
-    }
-    for (i = 0; i < MAX_CDTEXT_FIELDS; i++) {
-        if (cdtext->field[i] != NULL) {
-            cd_text[i] = cdtext->field[i];
-            dsyslog ("CD-Text %d: %s", i, cdtext->field[i]);
-        }
-    }
-}
-#endif
 // Close access and destroy and reset all internal buffers
 void cBufferedCdio::CloseDevice(void)
 {
     cMutexLock MutexLock(&mCdMutex);
-    mState = BCDIO_STOP;
-#ifdef USE_PARANOIA
-    pParanoiaDrive = NULL;
-    if (pParanoiaCd != NULL) {
-        cdio_paranoia_free(pParanoiaCd);
-        pParanoiaCd = NULL;
-    }
+    SetState(BCDIO_STOP);
+    if (mSource != NULL) {
+        mSource->Close();
+    }
+    mLibKey.mNumTracks = 0;
+    mResumeTrack = INVALID_TRACK_IDX;
+    cPluginCdplayer::GetPlayQueue().SetDisc(NULL);
+    mPlaylist.Clear();
+    SetLoop(CD_LOOP_OFF);
+    mFingerprinter.Reset(0);
+    mAccurateRip.Reset();
+#ifdef USE_FLAC
+    mRipper.Reset();
 #endif
-    if (pCdio != NULL) {
-        cdio_destroy(pCdio);
-        pCdio = NULL;
-    }
     mCdInfo.Clear();
     mRingBuffer.Clear();
     mCurrTrackIdx = 0;
+    mPlayTrackIdx = 0;
+    mPlayLsn = 0;
+    cPluginCdplayer::GetPlayState().Reset();
 }
 
 // Get a block of raw audio data from buffer
 bool cBufferedCdio::GetData (uint8_t *data, lsn_t *lsn, int *frame)
 {
-    if (pCdio == NULL) {
+    int track;
+    if ((mSource == NULL) || !mSource->IsOpen()) {
         return false;
     }
     if ((mState == BCDIO_FAILED) || (mState == BCDIO_STOP)) {
         return false;
     }
-    while (!mRingBuffer.GetBlock(data, lsn, frame))
+    while (!mRingBuffer.GetBlock(data, lsn, frame, &track))
     {
-        if (!Running() || (pCdio == NULL) || (mState == BCDIO_FAILED) ||
+        if (!Running() || !mSource->IsOpen() || (mState == BCDIO_FAILED) ||
             (mState == BCDIO_STOP)) {
             return false;
         }
     }
+    mPlayTrackIdx = track;
+    mPlayLsn = *lsn;
+    PublishPosition();
     return true;
 }
 
-#ifdef USE_PARANOIA
-bool cBufferedCdio::ParanoiaLogMsg (void)
+// Publish the currently played position
+void cBufferedCdio::PublishPosition(void)
 {
-    bool iserr = false;
-    if (pParanoiaDrive != NULL) {
-        char *err = cdio_cddap_errors(pParanoiaDrive);
-        char *mes = cdio_cddap_messages(pParanoiaDrive);
-        if (mes != NULL) {
-            dsyslog (mes);
-            free(mes);
-        }
-        if (err != NULL) {
-            esyslog (err);
-            free(err);
-            iserr = true;
-        }
+    int total, curr;
+    TRACK_IDX_T track = GetCurrTrack(&total, &curr);
+    lsn_t offset = mPlayLsn - GetStartLsn(track);
+    cPluginCdplayer::GetPlayState().SetPosition(track,
+                                        (offset > 0) ? offset : 0, total);
+    // The resume point is stored once per second
+    if ((mLibKey.mNumTracks != 0) &&
+        ((track != mLibTrack) || (curr != mLibPos))) {
+        mLibTrack = track;
+        mLibPos = curr;
+        cPluginCdplayer::GetLibrary().SetPosition(mLibKey, GetDiscTrack(track),
+                                                  (offset > 0) ? offset : 0);
     }
-    return iserr;
 }
-#endif
 
 void cBufferedCdio::SetSpeed (int speed)
 {
-    if (pCdio != NULL) {
-        if (cdio_set_speed (pCdio, speed) != 0) {
-            esyslog("%s %d mmc_set_drive_speed failed", __FILE__, __LINE__);
-        }
-        else {
-            dsyslog ("Change cd speed to %dx",speed);
-        }
-     }
+    if (mSource != NULL) {
+        mSource->SetSpeed(speed);
+    }
 }
 
 // Open access to the audio cd and retrieve all available CD-Text
@@ -229,172 +209,219 @@ void cBufferedCdio::SetSpeed (int speed)
 bool cBufferedCdio::OpenDevice (const string &FileName)
 {
     bool hasaudiotrack = false;
-    char *str;
+    bool knowndisc = false;
+    bool inlibrary = false;
+    LIB_DISC_INFO_T libinfo;
+    std::vector<uint8_t> queued;
+    SRC_TOC_T toc;
+    SRC_ERROR_T err;
     string txt;
-    CD_TEXT_T cdtxt;
 
     mSpeed = cMenuCDPlayer::GetMaxSpeed();
     CloseDevice();
     cMutexLock MutexLock(&mCdMutex);
-    mState = BCDIO_OPEN_DEVICE;
-#if LIBCDIO_VERSION_NUM > 83
-    pCdio = cdio_open(FileName.c_str(), DRIVER_UNKNOWN);
-#else
-    pCdio = cdio_open(FileName.c_str(), DRIVER_DEVICE);
-#endif
-    if (pCdio == NULL) {
-        mState = BCDIO_FAILED;
-        txt = tr("Can not open");
-        mErrtxt = txt  + " " + FileName;
-        esyslog("%s %d Can not open %s", __FILE__, __LINE__, FileName.c_str());
-        return false;
-    }
-#if LIBCDIO_VERSION_NUM > 83
-    pCdioCdtext = cdio_get_cdtext(pCdio);
-    if (pCdioCdtext == NULL) {
-        dsyslog ("No CD-Text available");
-    }
-#endif
-    SetSpeed (mSpeed);
-#ifdef USE_PARANOIA
-    if (cMenuCDPlayer::GetUseParanoia()) {
-        dsyslog("Use Paranoia");
-    }
-    else {
-        dsyslog("Paranoia disabled");
-    }
-    pParanoiaDrive=cdio_cddap_identify_cdio(pCdio, 1, NULL);
-    if (pParanoiaDrive == NULL) {
-        esyslog ("Drive Init failed");
+    SetState(BCDIO_OPEN_DEVICE);
+    mCmdQueue.Clear();
+    // The source is kept, GetData may still look at it
+    if (mSource == NULL) {
+        mSource = cPluginCdplayer::NewSectorSource(FileName);
+    }
+    err = mSource->Open(toc);
+    switch (err) {
+    case SRC_OK:
+        break;
+    case SRC_ERR_INIT:
         CloseDevice();
         return false;
-    }
-    cdio_cddap_open (pParanoiaDrive);
-
-    pParanoiaCd = cdio_paranoia_init(pParanoiaDrive);
-    if (pParanoiaCd == NULL) {
-        esyslog ("Paranoia Init failed");
-        CloseDevice();
-        return false;
-    }
-     /* Set reading mode for full paranoia, but allow skipping sectors. */
-    cdio_paranoia_modeset(pParanoiaCd,
-                             PARANOIA_MODE_FULL^PARANOIA_MODE_NEVERSKIP);
-#endif
-    dsyslog("The driver selected is %s", cdio_get_driver_name(pCdio));
-    str = cdio_get_default_device(pCdio);
-    dsyslog("The default device for this driver is %s", str);
-    free(str);
-
-    mFirstTrackNum = cdio_get_first_track_num(pCdio);
-    if (mFirstTrackNum == CDIO_INVALID_TRACK) {
-        txt = tr("No disc in drive");
-        mErrtxt = txt + " " + FileName;
-        mState = BCDIO_FAILED;
-        esyslog("%s %d Problem on read first track %s",
-                __FILE__, __LINE__, FileName.c_str());
-        return false;
-    }
-    mNumOfTracks = cdio_get_num_tracks(pCdio);
-    if (mNumOfTracks == CDIO_INVALID_TRACK) {
-        mState = BCDIO_FAILED;
-        txt = tr("Problem on read");
-        mErrtxt = txt + " " + FileName;
-        esyslog("%s %d Problem on read no of tracks %s",
-                __FILE__, __LINE__, FileName.c_str());
-        return false;
-    }
-    dsyslog("CD-ROM Track List (%d - %d)\n", mFirstTrackNum, mNumOfTracks);
-
-    GetCDText (0, cdtxt);
-    mCdInfo.SetCdInfo (cdtxt);
-
-    for (int i = 0; i < mNumOfTracks; i++) {
-        track_t track_no = (track_t)i + mFirstTrackNum;
-        lsn_t startlsn = cdio_get_track_lsn(pCdio, track_no);
-        lsn_t endlsn = cdio_get_track_last_lsn(pCdio, track_no);
-        lba_t lba = cdio_get_track_lba(pCdio, track_no);
-        if (endlsn == CDIO_INVALID_LSN) {
-            mState = BCDIO_FAILED;
+    default:
+        SetState(BCDIO_FAILED);
+        switch (err) {
+        case SRC_ERR_OPEN:
+            txt = tr("Can not open");
+            break;
+        case SRC_ERR_NODISC:
+            txt = tr("No disc in drive");
+            break;
+        case SRC_ERR_LSN:
             txt = tr("Problem on read lsn");
-            mErrtxt = txt + " " + FileName;
-            esyslog("%s %d Problem on read last lsn %s",
-                     __FILE__, __LINE__, FileName.c_str());
-            return false;
-        }
-        if (lba == CDIO_INVALID_LBA) {
-            mState = BCDIO_FAILED;
+            break;
+        case SRC_ERR_LBA:
             txt = tr("Problem on read lba");
-            mErrtxt = txt + " " + FileName;
-            esyslog("%s %d Problem on read lba %s",
-                    __FILE__, __LINE__, FileName.c_str());
-            return false;
+            break;
+        case SRC_ERR_CONNECT:
+            txt = tr("Drive server not reachable");
+            break;
+        default:
+            txt = tr("Problem on read");
+            break;
         }
-        track_format_t fmt = cdio_get_track_format(pCdio, track_no);
-        if ((fmt == TRACK_FORMAT_AUDIO) && (startlsn != CDIO_INVALID_LSN)) {
-            CD_TEXT_T cdtextfields;
-            dsyslog ("get_track_info for track %d S %d E %d L %d",
-                     track_no, startlsn, endlsn, lba);
-            GetCDText (track_no, cdtextfields);
-            mCdInfo.Add(track_no, startlsn, endlsn, lba, cdtextfields);
+        mErrtxt = txt + " " + mSource->GetName();
+        return false;
+    }
+    SetSpeed (mSpeed);
+
+    mCdInfo.SetCdInfo (toc.mCdText);
+    for (size_t i = 0; i < toc.mTracks.size(); i++) {
+        SRC_TRACK_T &t = toc.mTracks[i];
+        if (t.mAudio) {
+            mCdInfo.Add(t.mTrackNo, t.mStartLsn, t.mEndLsn, t.mLba, t.mCdText);
             hasaudiotrack = true;
         }
         else {
-            mCdInfo.AddData(lba);
+            mCdInfo.AddData(t.mLba);
         }
     }
     if (!hasaudiotrack) {
-        mState = BCDIO_FAILED;
+        SetState(BCDIO_FAILED);
         txt = tr("Not an audio disk");
-        mErrtxt = txt + " " + FileName;
+        mErrtxt = txt + " " + mSource->GetName();
         esyslog("%s %d no audio track found %s",
-                __FILE__, __LINE__, FileName.c_str());
+                __FILE__, __LINE__, mSource->GetName().c_str());
         return false;
     }
-    mPlayList = mCdInfo.GetDefaultPlayList();
-    if (cPluginCdplayer::GetCDDBEnabled()) {
-        mCdInfo.SetLeadOut (cdio_get_track_lba(pCdio, CDIO_CDROM_LEADOUT_TRACK));
-        mCdInfo.Start(); // Start CDDB query
+    mCdInfo.PublishCdText();
+    mCdInfo.SetLeadOut (toc.mLeadOut);
+    {
+        // A disc known from the library needs no CDDB query
+        cCdTextRef ref;
+        mLibKey = mCdInfo.GetLibraryKey();
+        mCdInfo.GetCdText(ref);
+        inlibrary = cPluginCdplayer::GetLibrary().Lookup(mLibKey, libinfo);
+        if (*ref->GetDisc(CDTEXT_TITLE) != '\0') {
+            mCdInfo.StoreInLibrary(LIB_SOURCE_CDTEXT);
+        }
+        else {
+            if (inlibrary) {
+                knowndisc = mCdInfo.SetLibraryText(libinfo);
+            }
+            mCdInfo.StoreInLibrary(0);
+        }
+        cPluginCdplayer::GetLibrary().Played(mLibKey);
+        cPluginCdplayer::GetPlayQueue().SetDisc(&mLibKey);
+        mQueueVersion = cPluginCdplayer::GetPlayQueue().GetVersion();
+        mLibTrack = INVALID_TRACK_IDX;
+        mLibPos = 0;
+    }
+    {
+        std::vector<lsn_t> start, end;
+        unsigned int cddbid = mCdInfo.GetCddbDiscId();
+        for (TRACK_IDX_T i = 0; i < GetNumTracks(); i++) {
+            start.push_back(mCdInfo.GetStartLsn(i));
+            end.push_back(mCdInfo.GetEndLsn(i));
+        }
+        mUseParanoia = cMenuCDPlayer::GetUseParanoia();
+#ifdef USE_PARANOIA
+        // Discs which were not read accurately are read with paranoia
+        if (!mUseParanoia && cAccurateRip::NeedParanoia(start, end, cddbid)) {
+            mUseParanoia = true;
+        }
+        dsyslog("Paranoia %s", mUseParanoia ? "enabled" : "disabled");
+#else
+        mUseParanoia = false;
+#endif
+        mSource->SetParanoia(mUseParanoia);
+        mAccurateRip.Setup(start, end, cddbid, mUseParanoia);
+        mAccurateRip.Start();
+#ifdef USE_FLAC
+        if (cMenuCDPlayer::GetRip()) {
+            char dir[16];
+            snprintf(dir, sizeof(dir), "%08x/", cddbid);
+            mRipper.Setup(start, end, cPluginCdplayer::GetRipDir() + dir);
+        }
+#endif
+    }
+    mFingerprinter.Reset(GetNumTracks());
+    mFingerprinter.Start();
+    mPlaylist.Sort();
+    PublishPlayList();
+    // Queued tracks are played instead of resuming
+    if (inlibrary && !cPluginCdplayer::GetPlayQueue().GetTracks(mLibKey,
+                                                                queued)) {
+        SetResumePoint(libinfo);
+    }
+    PublishPosition();
+    if (cPluginCdplayer::GetCDDBEnabled() && !knowndisc) {
+        mCdInfo.StartQuery();
     }
     return true;
 }
 
-// Hand over the PCM16-data to span plugin
+#ifdef USE_FLAC
+// Read sectors only for the ripper. Playback has priority: this is only
+// called while the ring buffer is well filled or playback is paused. It
+// reads at most RIP_AHEAD_BLOCKS at once and stops when playback drained
+// the buffer to RIP_REFILL blocks. mCdMutex is only held for each read,
+// like ReadTrack. Returns false if nothing was read.
+bool cBufferedCdio::RipAhead(void)
+{
+    uint8_t buf[CDIO_CD_FRAMESIZE_RAW];
+    uint8_t *bufptr;
+    lsn_t lsn;
+    int count;
+    int i;
+    bool ok;
 
-void cBufferedCdio::SendToSpanPlugin (const uchar *data, int len, int frame) {
-    Span_SetPcmData_1_0 setpcmdata;
-    if (mSpanPlugin) {
-        setpcmdata.length = len;
-        // the timestamp (ms) of the frame(s) to be visualized:
-        setpcmdata.index = (frame * 1000) / CDIO_CD_FRAMES_PER_SEC;
-        // tell span the ringbuffer's size for it's internal bookkeeping of the data to be visualized:
-        setpcmdata.bufferSize = CCDIO_MAX_BLOCKS * PES_MAX_PACKSIZE;
-        setpcmdata.data = data;
-        setpcmdata.bigEndian = true;
-        cPluginManager::CallFirstService(SPAN_SET_PCM_DATA_ID, &setpcmdata);
+    if (!mRipper.IsActive() || !mRipper.GetNextRead(lsn, count)) {
+        return false;
+    }
+    mCdMutex.Lock();
+    if (mSource->IsOpen() && (mSpeed != cMenuCDPlayer::GetMaxSpeed())) {
+        mSpeed = cMenuCDPlayer::GetMaxSpeed();
+        SetSpeed(mSpeed);
+    }
+    mCdMutex.Unlock();
+    for (i = 0; i < count; i++) {
+        mCdMutex.Lock();
+        ok = mSource->IsOpen() && mSource->Read(lsn + i, buf, bufptr);
+        mCdMutex.Unlock();
+        // A read error is left to playback, the ripper reads again later
+        if (!ok) {
+            dsyslog("%s %d Rip read error at %d", __FILE__, __LINE__, lsn + i);
+            break;
+        }
+        mRipper.Feed(lsn + i, bufptr);
+        if (!Running() || mCmdQueue.Pending() ||
+            ((mState == BCDIO_PLAY) &&
+             (mRingBuffer.GetPending() <= RIP_REFILL))) {
+            i++;
+            break;
+        }
     }
+    return i > 0;
 }
+#endif
 
 // Read an audio track from CD and buffer the output into ringbuffer
 bool cBufferedCdio::ReadTrack (TRACK_IDX_T trackidx)
 {
     uint8_t *bufptr;
     uint8_t buf[CDIO_CD_FRAMESIZE_RAW];
+    const uint8_t *pinned;
+    bool frommem;
     int frame = 0;
     int percent;
+    bool ripping;
+    TRACK_IDX_T disctrack;
     lsn_t endlsn = GetEndLsn(trackidx);
     mTrackChange = false;
     mCurrLsn = mStartLsn;
     dsyslog("%s %d Read Track %d Start %d End %d",
             __FILE__, __LINE__, trackidx, mCurrLsn, endlsn);
-#ifdef USE_PARANOIA
-    if (cMenuCDPlayer::GetUseParanoia()) {
-        cdio_paranoia_seek(pParanoiaCd, mCurrLsn, SEEK_SET);
-    }
-#endif
-    while (mCurrLsn < endlsn) {
+    // endlsn is the last sector of the track
+    while (mCurrLsn <= endlsn) {
+        ProcessCommands();
+        if (mTrackChange) {
+            return true;
+        }
         if (mState == BCDIO_PAUSE) {
+#ifdef USE_FLAC
+            // The drive is free for the ripper
+            if (!RipAhead()) {
+                cCondWait::SleepMs(250);
+            }
+#else
             cCondWait::SleepMs(250);
+#endif
         }
         // Stop from external
         else if ((mState == BCDIO_STOP) || (mState == BCDIO_FAILED)) {
@@ -402,35 +429,29 @@ bool cBufferedCdio::ReadTrack (TRACK_IDX_T trackidx)
         }
         // Play
         else {
+            // Repetitions of a loop are served from memory. The block is
+            // copied, as the loop may change while waiting for the buffer.
+            pinned = mLoop.Get(mCurrLsn);
+            frommem = (pinned != NULL);
+            if (frommem) {
+                memcpy(buf, pinned, CDIO_CD_FRAMESIZE_RAW);
+                bufptr = buf;
+            }
             mCdMutex.Lock();
-            if (pCdio == NULL) {
+            if (!mSource->IsOpen()) {
                 mCdMutex.Unlock();
-                mState = BCDIO_FAILED;
+                SetState(BCDIO_FAILED);
                 return false;
             }
-#ifdef USE_PARANOIA
-            if (cMenuCDPlayer::GetUseParanoia()) {
-                bufptr = (uint8_t *)cdio_paranoia_read(pParanoiaCd, NULL);
-                if (ParanoiaLogMsg()) {
+            if (!frommem) {
+                if (!mSource->Read(mCurrLsn, buf, bufptr)) {
                     mErrtxt = tr("Read error");
-                    mState = BCDIO_FAILED;
+                    SetState(BCDIO_FAILED);
                     mCdMutex.Unlock();
                     return false;
                 }
+                mLoop.Put(mCurrLsn, bufptr);
             }
-            else {
-#endif
-            bufptr = buf;
-            if (cdio_read_audio_sectors(pCdio, bufptr, mCurrLsn, 1)
-                                                        != DRIVER_OP_SUCCESS) {
-                mErrtxt = tr("Read error");
-                mState = BCDIO_FAILED;
-                mCdMutex.Unlock();
-                return false;
-            }
-#ifdef USE_PARANOIA
-            }
-#endif
             mCurrLsn++;
             mCdMutex.Unlock();
             if (!Running()) {
@@ -439,20 +460,54 @@ bool cBufferedCdio::ReadTrack (TRACK_IDX_T trackidx)
             if (mTrackChange) {
                 return true;
             }
-            SendToSpanPlugin (bufptr, CDIO_CD_FRAMESIZE_RAW, frame);
-            while (!mRingBuffer.PutBlock(bufptr, mCurrLsn-1, frame)) {
+            while (!mRingBuffer.PutBlock(bufptr, mCurrLsn-1, frame, trackidx)) {
                 if (!Running()) {
                     return false;
                 }
+                ProcessCommands();
                 if (mTrackChange) {
                     return true;
                 }
             }
+            // Blocks from memory were already verified
+            if (!frommem) {
+                disctrack = GetTrackPlaylist(trackidx);
+                mFingerprinter.Feed(disctrack, mCurrLsn - 1 -
+                                    mCdInfo.GetStartLsn(disctrack),
+                                    GetLengthLsn(trackidx), bufptr);
+                mAccurateRip.Feed(mCurrLsn - 1, bufptr);
+            }
+#ifdef USE_FLAC
+            if (!frommem) {
+                mRipper.Feed(mCurrLsn - 1, bufptr);
+            }
+#endif
             frame++;
-            // Slow down CD-Rom drive when buffer is full
+            // The loop end was read, continue at the loop start
+            if (mLoop.IsActive() && (mCurrLsn - 1 == mLoop.GetEnd())) {
+                mCurrLsn = mLoop.GetStart();
+            }
+            ripping = false;
+#ifdef USE_FLAC
+            // Rip from RIP_MIN_FILL down to RIP_REFILL blocks, then fill
+            // the buffer again in one run
+            ripping = mRipper.IsActive();
+            mRingBuffer.SetMaxPending(ripping ? RIP_READAHEAD_BLOCKS
+                                              : CCDIO_MAX_BLOCKS);
+            if (ripping && (mRingBuffer.GetPending() >= RIP_MIN_FILL)) {
+                while ((mRingBuffer.GetPending() > RIP_REFILL) &&
+                       Running() && !mCmdQueue.Pending() &&
+                       (mState == BCDIO_PLAY) && RipAhead()) {
+                }
+            }
+#endif
             percent = mRingBuffer.GetFreePercent();
+            // Slow down CD-Rom drive when buffer is full. While ripping
+            // the drive keeps one speed, each change spins it up again.
             int sp = 1;
-            if (percent < 25) {
+            if (ripping) {
+                sp = cMenuCDPlayer::GetMaxSpeed();
+            } else if (percent < 25) {
                 sp = 8;
             } else if (percent < 50) {
                 sp = 4;
@@ -467,6 +522,7 @@ bool cBufferedCdio::ReadTrack (TRACK_IDX_T trackidx)
                 SetSpeed(sp);
                 mSpeed = sp;
             }
+            cPluginCdplayer::GetPlayState().SetBufferFill(percent);
             mBufferStat += percent;
             mBufferCnt ++;
         }
@@ -487,17 +543,25 @@ void cBufferedCdio::Action(void)
 {
     dsyslog ("cBufferedCdio::Action");
     bool first_time = true;
-    TRACK_IDX_T numTracks = GetNumTracks();
+    PL_RANGE_T next;
     mRingBuffer.Clear();
-    SetTrack(0);
-    mState = BCDIO_PLAY;
+    // A resume point is already set by OpenDevice
+    if ((mResumeTrack == INVALID_TRACK_IDX) && !DoQueuePlay()) {
+        if (mPlayRandom) {
+            DoRandomPlay();
+        }
+        else {
+            DoSortedPlay();
+        }
+    }
+    SetState(BCDIO_PLAY);
     while (mRestart || first_time) {
         first_time = false;
-        while (mCurrTrackIdx < numTracks) {
+        while (mCurrTrackIdx < GetPlayListLength()) {
             mBufferStat = 0;
             mBufferCnt = 0;
             if (!ReadTrack (mCurrTrackIdx)) {
-                mState = BCDIO_FAILED;
+                SetState(BCDIO_FAILED);
                 return;
             }
             // Output Buffer statistics
@@ -508,7 +572,7 @@ void cBufferedCdio::Action(void)
                 dsyslog ("Av. buffer usage %d", (mBufferStat / mBufferCnt));
             }
             if (!Running()) {
-                mState = BCDIO_STOP;
+                SetState(BCDIO_STOP);
                 return;
             }
             if (mTrackChange) {
@@ -516,108 +580,422 @@ void cBufferedCdio::Action(void)
                 cCondWait::SleepMs(500);
             }
             else {
-                mCurrTrackIdx++;
-                mStartLsn = GetStartLsn(mCurrTrackIdx);
+                // Continue with the next range in play order
+                if (mPlaylist.GetLookahead(mCurrTrackIdx + 1, CDIO_INVALID_LSN,
+                                           1, &next, 1) == 1) {
+                    mCurrTrackIdx = next.mTrack;
+                    mStartLsn = next.mStart;
+                }
+                else {
+                    mCurrTrackIdx = GetPlayListLength();
+                    WaitPlayed();
+                    if (mTrackChange) {
+                        mRingBuffer.Clear();
+                    }
+                }
             }
         }
-        mRingBuffer.WaitEmpty();
         cCondWait::SleepMs(500);
+        if (DoQueuePlay()) {
+            continue;
+        }
         if (mPlayRandom) {
-            RandomPlay();
+            DoRandomPlay();
         }
         else {
-            SortedPlay();
+            DoSortedPlay();
         }
     }
+    // Played to the end, next time start from the beginning
+    cPluginCdplayer::GetLibrary().SetResume(mLibKey, LIB_RESUME_NONE,
+                                            std::vector<uint8_t>());
     cCondWait::SleepMs(500);
-    mState = BCDIO_STOP;
+    SetState(BCDIO_STOP);
+}
+
+// Wait until all buffered data is played. Commands are still executed, so
+// a skip back restarts reading.
+void cBufferedCdio::WaitPlayed(void)
+{
+    while (!mRingBuffer.IsEmpty() && Running()) {
+        ProcessCommands();
+        if (mTrackChange) {
+            return;
+        }
+        cCondWait::SleepMs(100);
+    }
+}
+
+// Queue a command for the reader thread
+void cBufferedCdio::PutCommand(CDIO_CMD_TYPE_T type, int arg, int arg2)
+{
+    if (!mCmdQueue.Put(type, arg, arg2)) {
+        esyslog("%s %d Command queue full, command %d dropped",
+                __FILE__, __LINE__, type);
+        return;
+    }
+    // Reader may wait for free space in the ring buffer
+    mRingBuffer.InterruptPut();
+}
+
+// Execute all queued commands, called by the reader thread between reads
+void cBufferedCdio::ProcessCommands(void)
+{
+    CDIO_CMD_T cmd;
+    unsigned int queueversion = cPluginCdplayer::GetPlayQueue().GetVersion();
+
+    // The play queue was changed by the user
+    if (queueversion != mQueueVersion) {
+        mQueueVersion = queueversion;
+        DoQueuePlay();
+    }
+    while (mCmdQueue.Get(cmd)) {
+        switch (cmd.mType) {
+        case CDIO_CMD_SET_TRACK:
+            DoSetTrack(cmd.mArg);
+            break;
+        case CDIO_CMD_NEXT_TRACK:
+            DoSetTrack(mPlayTrackIdx + 1);
+            break;
+        case CDIO_CMD_PREV_TRACK:
+            if (mPlayTrackIdx > 0) {
+                DoSetTrack(mPlayTrackIdx - 1);
+            }
+            break;
+        case CDIO_CMD_SKIP_TIME:
+            DoSkipTime(cmd.mArg);
+            break;
+        case CDIO_CMD_SEEK:
+            DoSeek(cmd.mArg, cmd.mArg2);
+            break;
+        case CDIO_CMD_SORTED:
+            DoSortedPlay();
+            break;
+        case CDIO_CMD_RANDOM:
+            DoRandomPlay(cmd.mArg);
+            break;
+        case CDIO_CMD_LOOP_A:
+            DoLoopA();
+            break;
+        case CDIO_CMD_LOOP_B:
+            DoLoopB();
+            break;
+        case CDIO_CMD_LOOP_TRACK:
+            DoLoopTrack(mPlayTrackIdx);
+            break;
+        case CDIO_CMD_LOOP_OFF:
+            SetLoop(CD_LOOP_OFF);
+            break;
+        default:
+            esyslog("%s %d Unknown command %d", __FILE__, __LINE__, cmd.mType);
+            break;
+        }
+    }
 }
 
 // Set new track
-void cBufferedCdio::SetTrack (TRACK_IDX_T newtrack)
+void cBufferedCdio::DoSetTrack (TRACK_IDX_T newtrack)
 {
-  cMutexLock MutexLock(&mCdMutex);
-  if (newtrack > GetNumTracks()-1) {
+  if ((newtrack < 0) || (newtrack > GetPlayListLength()-1)) {
       return;
   }
-  mStartLsn = GetStartLsn(newtrack);
-  mCurrTrackIdx = newtrack;
+  bool trackchange = (newtrack != mPlayTrackIdx);
+  SeekTo(newtrack, GetStartLsn(newtrack));
+  if (trackchange) {
+      MoveLoop(newtrack);
+  }
+}
+
+// Seek to a position within a track
+void cBufferedCdio::DoSeek (TRACK_IDX_T track, lsn_t offset)
+{
+  // The position published below replaces the target shown by the OSD
+  cPluginCdplayer::GetPlayState().SeekDone();
+  if ((track < 0) || (track > GetPlayListLength()-1)) {
+      return;
+  }
+  if (offset >= GetLengthLsn(track)) {
+      offset = GetLengthLsn(track) - 1;
+  }
+  if (offset < 0) {
+      offset = 0;
+  }
+  bool trackchange = (track != mPlayTrackIdx);
+  SeekTo(track, GetStartLsn(track) + offset);
+  if (trackchange) {
+      MoveLoop(track);
+  }
+}
+
+// Restart the reader at the given position. The ring buffer is flushed
+// by Action.
+void cBufferedCdio::ReadFrom (TRACK_IDX_T track, lsn_t lsn)
+{
+  mStartLsn = lsn;
+  mCurrTrackIdx = track;
+  mPlayTrackIdx = track;
+  mPlayLsn = lsn;
   mTrackChange = true;
+  PublishPosition();
+}
+
+// Seek to a new position. If the block is still or already in the ring
+// buffer only the read position of the buffer is moved, otherwise the
+// reader is restarted.
+void cBufferedCdio::SeekTo (TRACK_IDX_T track, lsn_t lsn)
+{
+  if (mRingBuffer.SkipTo(lsn, track)) {
+      dsyslog("Seek to track %d lsn %d within buffer", track, lsn);
+      mPlayTrackIdx = track;
+      mPlayLsn = lsn;
+      PublishPosition();
+      return;
+  }
+  ReadFrom(track, lsn);
 }
 
-void cBufferedCdio::SkipTimeFwd(lsn_t lsncnt) {
-    lsn_t cur;
-    cur = mCurrLsn - GetStartLsn(mCurrTrackIdx);
-    lsncnt += cur;
-    while (lsncnt > GetLengthLsn(mCurrTrackIdx)) {
-        cur = GetLengthLsn(mCurrTrackIdx);
-        mCurrTrackIdx++;
-        if (mCurrTrackIdx > GetNumTracks()) {
-            mCurrTrackIdx--;
-            mCurrLsn = GetEndLsn(mCurrTrackIdx)-CDIO_CD_FRAMES_PER_SEC;
-            mStartLsn = mCurrLsn;
+// Calculate the position lsncnt blocks after track/lsn
+void cBufferedCdio::SkipTimeFwd(lsn_t lsncnt, TRACK_IDX_T &track, lsn_t &lsn) {
+    lsn_t pos = lsn - GetStartLsn(track) + lsncnt;
+
+    while (pos >= GetLengthLsn(track)) {
+        pos -= GetLengthLsn(track);
+        track++;
+        if (track >= GetPlayListLength()) {
+            track = GetPlayListLength() - 1;
+            lsn = GetEndLsn(track)-CDIO_CD_FRAMES_PER_SEC;
             return;
         }
-        lsncnt -= cur;
     }
-    mCurrLsn = GetStartLsn(mCurrTrackIdx) + lsncnt;
-    mStartLsn = mCurrLsn;
+    lsn = GetStartLsn(track) + pos;
 }
 
-void cBufferedCdio::SkipTimeBack(lsn_t lsncnt) {
-    lsn_t cur;
-    cur = mCurrLsn - GetStartLsn(mCurrTrackIdx);
-    lsncnt -= cur;
-    while (lsncnt > 0) {
-        cur = GetLengthLsn(mCurrTrackIdx);
-        mCurrTrackIdx--;
-        if (mCurrTrackIdx < 0) {
-            mCurrTrackIdx = 0;
-            mCurrLsn = GetStartLsn(mCurrTrackIdx);
-            mStartLsn = mCurrLsn;
+// Calculate the position lsncnt blocks before track/lsn
+void cBufferedCdio::SkipTimeBack(lsn_t lsncnt, TRACK_IDX_T &track, lsn_t &lsn) {
+    lsn_t pos = lsn - GetStartLsn(track) - lsncnt;
+
+    while (pos < 0) {
+        track--;
+        if (track < 0) {
+            track = 0;
+            lsn = GetStartLsn(track);
             return;
         }
-        lsncnt -= cur;
+        pos += GetLengthLsn(track);
     }
-    // NOTE: lsncnt is negative here
-    mCurrLsn = GetEndLsn(mCurrTrackIdx) + lsncnt;
-    mStartLsn = mCurrLsn;
+    lsn = GetStartLsn(track) + pos;
 }
 
-void cBufferedCdio::SkipTime(int tm) {
-    cMutexLock MutexLock(&mCdMutex);
+void cBufferedCdio::DoSkipTime(int tm) {
     lsn_t lsncnt = abs(tm * CDIO_CD_FRAMES_PER_SEC);
+    TRACK_IDX_T track = mPlayTrackIdx;
+    lsn_t lsn = mPlayLsn;
 
     // Find track which contains calculated lsn
     if (tm >= 0) {
-        SkipTimeFwd(lsncnt);
+        SkipTimeFwd(lsncnt, track, lsn);
     }
     else {
-        SkipTimeBack(lsncnt);
+        SkipTimeBack(lsncnt, track, lsn);
+    }
+    SeekTo(track, lsn);
+}
+
+void cBufferedCdio::SetLoop(CD_LOOP_T mode, lsn_t start, lsn_t end)
+{
+    mLoopMode = mode;
+    if ((mode == CD_LOOP_AB) || (mode == CD_LOOP_TRACK)) {
+        dsyslog("%s %d Loop %d to %d", __FILE__, __LINE__, start, end);
+        mLoop.Set(start, end);
+    }
+    else {
+        mLoop.Clear();
+    }
+    if (mode != CD_LOOP_A) {
+        mLoopA = CDIO_INVALID_LSN;
+    }
+    cPluginCdplayer::GetPlayState().SetLoop(mode);
+}
+
+// Start of an A-B loop at the played position
+void cBufferedCdio::DoLoopA(void)
+{
+    SetLoop(CD_LOOP_A);
+    mLoopA = mPlayLsn;
+}
+
+// End of an A-B loop at the played position. The reader is already ahead,
+// so it restarts at the loop start and keeps the blocks from then on.
+void cBufferedCdio::DoLoopB(void)
+{
+    TRACK_IDX_T track = mPlayTrackIdx;
+    lsn_t end = mPlayLsn;
+
+    // Loops are limited to one track
+    if ((mLoopMode != CD_LOOP_A) || (mLoopA < GetStartLsn(track)) ||
+        (mLoopA >= end)) {
+        SetLoop(CD_LOOP_OFF);
+        return;
+    }
+    SetLoop(CD_LOOP_AB, mLoopA, end);
+    ReadFrom(track, mLoop.GetStart());
+}
+
+// Repeat a track. If the reader already passed its end, it restarts at
+// the played position.
+void cBufferedCdio::DoLoopTrack(TRACK_IDX_T track)
+{
+    lsn_t end = GetEndLsn(track);
+
+    SetLoop(CD_LOOP_TRACK, GetStartLsn(track), end);
+    if (!mTrackChange && ((mCurrTrackIdx != track) || (mCurrLsn > end))) {
+        ReadFrom(track, mPlayLsn);
     }
+}
 
-    mTrackChange = true;
+// After a track change an A-B loop ends, a track loop repeats the new track
+void cBufferedCdio::MoveLoop(TRACK_IDX_T track)
+{
+    if (mLoopMode == CD_LOOP_TRACK) {
+        DoLoopTrack(track);
+    }
+    else if (mLoopMode != CD_LOOP_OFF) {
+        SetLoop(CD_LOOP_OFF);
+    }
 }
 
-void cBufferedCdio::SortedPlay(void) {
+void cBufferedCdio::DoSortedPlay(void) {
     dsyslog("%s %d Sorted", __FILE__, __LINE__);
-    SetPlayList(GetDefaultPlayList());
-    SetTrack(0);
+    mPlaylist.Sort();
+    ReadFrom(0, GetStartLsn(0));
+    MoveLoop(0);
     mPlayRandom = false;
+    PublishPlayList();
+    StoreResumeMode();
 }
 
-void cBufferedCdio::RandomPlay(void)
+void cBufferedCdio::DoRandomPlay(uint32_t seed)
 {
-    PlayList pl = GetDefaultPlayList();
-    PlayList newlist;
-    int idx;
-    dsyslog("%s %d Random", __FILE__, __LINE__);
-    while (!pl.empty()) {
-        idx = rand() % pl.size();
-        newlist.push_back(pl[idx]);
-        pl.erase(pl.begin() + idx);
-    }
-    SetPlayList(newlist);
-    SetTrack(0);
+    dsyslog("%s %d Random seed %u", __FILE__, __LINE__, seed);
+    if (seed != 0) {
+        mPlaylist.SetSeed(seed);
+    }
+    mPlaylist.Shuffle();
+    ReadFrom(0, GetStartLsn(0));
+    MoveLoop(0);
     mPlayRandom = true;
+    PublishPlayList();
+    StoreResumeMode();
+}
+
+// Play the tracks queued for this disc. Without queued tracks a queue
+// order is replaced by the normal play order.
+bool cBufferedCdio::DoQueuePlay(void)
+{
+    std::vector<uint8_t> tracks;
+
+    if (cPluginCdplayer::GetPlayQueue().GetTracks(mLibKey, tracks) &&
+        mPlaylist.SetOrder(tracks, PL_QUEUE)) {
+        dsyslog("%s %d Queue with %d tracks", __FILE__, __LINE__,
+                (int)tracks.size());
+        ReadFrom(0, GetStartLsn(0));
+        MoveLoop(0);
+        PublishPlayList();
+        return true;
+    }
+    if (mPlaylist.GetMode() == PL_QUEUE) {
+        if (mPlayRandom) {
+            DoRandomPlay();
+        }
+        else {
+            DoSortedPlay();
+        }
+    }
+    return false;
+}
+
+void cBufferedCdio::PublishPlayList(void)
+{
+    cPluginCdplayer::GetPlayState().SetNumTracks(GetPlayListLength());
+    cPluginCdplayer::GetPlayState().SetPlayList(
+        mPlaylist.GetMode() == PL_RANDOM);
+}
+
+// Remember the play order for the resume point
+void cBufferedCdio::StoreResumeMode(void)
+{
+    std::vector<uint8_t> order;
+
+    if (mPlaylist.GetMode() == PL_QUEUE) {
+        return;
+    }
+    mPlaylist.GetOrder(order);
+    cPluginCdplayer::GetLibrary().SetResume(mLibKey,
+            mPlayRandom ? LIB_RESUME_RANDOM : LIB_RESUME_SORTED, order);
+}
+
+// Continue where the disc was stopped, in the same play order. The reader
+// starts at the resume point, so it is buffered at once.
+void cBufferedCdio::SetResumePoint(const LIB_DISC_INFO_T &info)
+{
+    TRACK_IDX_T numtracks = GetNumTracks();
+    TRACK_IDX_T track = INVALID_TRACK_IDX;
+    bool random = (info.mResume == LIB_RESUME_RANDOM);
+    std::vector<uint8_t> pl;
+    lsn_t offset;
+
+    if (!cMenuCDPlayer::GetResume() || (info.mResume == LIB_RESUME_NONE) ||
+        ((TRACK_IDX_T)info.mLastTrack >= numtracks)) {
+        return;
+    }
+    if (random) {
+        std::vector<bool> used(numtracks, false);
+        if ((TRACK_IDX_T)info.mResumeOrder.size() != numtracks) {
+            return;
+        }
+        for (TRACK_IDX_T i = 0; i < numtracks; i++) {
+            TRACK_IDX_T t = info.mResumeOrder[i];
+            if ((t >= numtracks) || used[t]) {
+                return;
+            }
+            used[t] = true;
+            pl.push_back(t);
+        }
+    }
+    else {
+        for (TRACK_IDX_T i = 0; i < numtracks; i++) {
+            pl.push_back(i);
+        }
+    }
+    for (TRACK_IDX_T i = 0; i < numtracks; i++) {
+        if (pl[i] == info.mLastTrack) {
+            track = i;
+        }
+    }
+    offset = info.mLastPos;
+    if ((track == 0) && (offset < CCDIO_RESUME_MIN_BLOCKS)) {
+        return;
+    }
+    if (!mPlaylist.SetOrder(pl, random ? PL_RANDOM : PL_SORTED)) {
+        return;
+    }
+    mPlayRandom = random;
+    PublishPlayList();
+    if (offset >= GetLengthLsn(track)) {
+        offset = GetLengthLsn(track) - 1;
+    }
+    dsyslog("Resume at track %d offset %d", info.mLastTrack, offset);
+    mResumeTrack = track;
+    mResumeLsn = GetStartLsn(track) + offset;
+    ReadFrom(mResumeTrack, mResumeLsn);
+}
+
+bool cBufferedCdio::GetResumePoint(TRACK_IDX_T &disctrack, int &secs)
+{
+    if (mResumeTrack == INVALID_TRACK_IDX) {
+        return false;
+    }
+    disctrack = GetDiscTrack(mResumeTrack);
+    secs = (mResumeLsn - GetStartLsn(mResumeTrack)) / CDIO_CD_FRAMES_PER_SEC;
+    return true;
 }
@@ -14,70 +14,67 @@
 #ifndef __BUFFEREDCDIO_H__
 #define __BUFFEREDCDIO_H__
 
-#define DO_NOT_WANT_PARANOIA_COMPATIBILITY 1
-
 #include <string>
 #include <stdio.h>
 #include <stdint.h>
-#include <cdio/version.h>
-
-#if USE_PARANOIA
-#if LIBCDIO_VERSION_NUM < 90
-#include <cdio/cdda.h>
-#include <cdio/paranoia.h>
-#else
-#include <cdio/paranoia/cdda.h>
-#include <cdio/paranoia/paranoia.h>
-#endif
-#endif
-
-#include <cdio/cdio.h>
-#include <cdio/track.h>
-#include <cdio/cd_types.h>
 #include <cdio/mmc.h>
+#include "sectorsource.h"
 #include "cdioringbuf.h"
+#include "cdioloopbuf.h"
+#include "cdiocmdqueue.h"
+#include "cdstate.h"
 #include "cdinfo.h"
+#include "cdfingerprint.h"
+#include "accuraterip.h"
+#include "playlist.h"
+#include "ripper.h"
 
 using namespace std;
 
-// Maximum number of raw blocks to buffer
+// Maximum number of raw blocks to buffer. The drive speed is chosen by
+// the fill level of these blocks.
 static const int CCDIO_MAX_BLOCKS=128;
-
-typedef enum _bufcdio_state {
-    BCDIO_STOP = 0,
-    BCDIO_STARTING,
-    BCDIO_OPEN_DEVICE,
-    BCDIO_PAUSE,
-    BCDIO_PLAY,
-    BCDIO_NEWTIME,
-    BCDIO_FAILED
-} BUFCDIO_STATE_T;
+// Number of already played blocks kept for seeking backwards (2.6 MB)
+static const int CCDIO_HISTORY_BLOCKS=15*CDIO_CD_FRAMES_PER_SEC;
+// Number of blocks to buffer before playback starts
+static const int CCDIO_PREBUFFER_BLOCKS=32;
+// A disc stopped within this time of the start is not resumed
+static const int CCDIO_RESUME_MIN_BLOCKS=10*CDIO_CD_FRAMES_PER_SEC;
 
 // Class for accessing the audio cd
 class cBufferedCdio: public cThread {
 private:
     static const char *cd_text_field[MAX_CDTEXT_FIELDS+1];
-#ifdef USE_PARANOIA
-    cdrom_drive_t   *pParanoiaDrive;
-    cdrom_paranoia_t *pParanoiaCd;
-#endif
-#if LIBCDIO_VERSION_NUM > 83
-    const cdtext_t *pCdioCdtext;
-#endif
-    CdIo_t          *pCdio;
-    PlayList mPlayList;
-    track_t mFirstTrackNum;  // CDIO first track
-    track_t mNumOfTracks;    // CDIO number of tracks
+    cSectorSource   *mSource;    // Local drive or drive server
 
     volatile lsn_t             mStartLsn;
     volatile lsn_t             mCurrLsn;
     volatile TRACK_IDX_T       mCurrTrackIdx; // Audio Track index
+    volatile lsn_t             mPlayLsn;      // LSN currently played
+    volatile TRACK_IDX_T       mPlayTrackIdx; // Track currently played
     volatile bool mTrackChange;  // Indication for external track change
     volatile bool mRestart;
     bool mPlayRandom;
+    bool mUseParanoia;       // Paranoia for this disc
+    LIB_KEY_T mLibKey;       // Disc in the library
+    TRACK_IDX_T mResumeTrack; // Resume point given at open
+    lsn_t mResumeLsn;
+    TRACK_IDX_T mLibTrack;   // Position stored in the library
+    int mLibPos;
 
     cCdInfo         mCdInfo;    // CD Information per audio track
+    cPlaylist       mPlaylist;  // Play order of the tracks
+    unsigned int    mQueueVersion; // Play queue last applied
+    cFingerprinter  mFingerprinter; // Identifies tracks without CD-Text
+    cAccurateRip    mAccurateRip;   // Verifies the read tracks
+#ifdef USE_FLAC
+    cRipper         mRipper;        // Rips the read tracks to FLAC
+#endif
     cCdIoRingBuffer mRingBuffer;
+    cCdIoLoopBuffer mLoop;      // Repeated segment kept in memory
+    CD_LOOP_T       mLoopMode;
+    lsn_t           mLoopA;     // Loop start while waiting for the end
+    cCdIoCmdQueue   mCmdQueue;  // Commands for the reader thread
     BUFCDIO_STATE_T mState;
     cMutex          mCdMutex;
     volatile int  mSpeed;
@@ -86,21 +83,36 @@ private:
     int mBufferStat;
     int mBufferCnt;
 
-    void GetCDText(const track_t track_no, CD_TEXT_T &cd_text);
     bool ReadTrack (TRACK_IDX_T trackidx);
+#ifdef USE_FLAC
+    bool RipAhead(void);
+#endif
     void SetSpeed (int speed);
-    void SkipTimeFwd(lsn_t lsncnt);
-    void SkipTimeBack(lsn_t lsncnt);
+    void SeekTo(TRACK_IDX_T track, lsn_t lsn);
+    void ReadFrom(TRACK_IDX_T track, lsn_t lsn);
+    void SetState(BUFCDIO_STATE_T state);
+    void PublishPosition(void);
+    void PutCommand(CDIO_CMD_TYPE_T type, int arg = 0, int arg2 = 0);
+    void ProcessCommands(void);
+    void WaitPlayed(void);
+    void DoSetTrack(TRACK_IDX_T newtrack);
+    void DoSkipTime(int tm);
+    void DoSeek(TRACK_IDX_T track, lsn_t offset);
+    void DoRandomPlay(uint32_t seed = 0);
+    void DoSortedPlay(void);
+    void DoLoopA(void);
+    void DoLoopB(void);
+    void DoLoopTrack(TRACK_IDX_T track);
+    void MoveLoop(TRACK_IDX_T track);
+    void SetLoop(CD_LOOP_T mode, lsn_t start = CDIO_INVALID_LSN,
+                 lsn_t end = CDIO_INVALID_LSN);
+    bool DoQueuePlay(void);
+    void PublishPlayList(void);
+    void StoreResumeMode(void);
+    void SetResumePoint(const LIB_DISC_INFO_T &info);
     TRACK_IDX_T GetTrackPlaylist (const TRACK_IDX_T track) {
-        return mPlayList[track];
+        return mPlaylist.GetDiscTrack(track);
     }
-#ifdef USE_PARANOIA
-    bool ParanoiaLogMsg(void);
-#endif
-
-    // Span Plugin
-    void SendToSpanPlugin(const uchar *data, int len, int frame);
-    cPlugin *mSpanPlugin;
 
 public:
     cBufferedCdio(void);
@@ -108,23 +120,18 @@ public:
     bool OpenDevice(const string &FileName);
     void CloseDevice(void);
 
-    PlayList GetDefaultPlayList (void) {
-        return mCdInfo.GetDefaultPlayList();
-    }
-    void SetPlayList (const PlayList li) {
-        mPlayList = li;
-    }
-
     const string &GetErrorText(void) { return mErrtxt; };
 
     TRACK_IDX_T GetCurrTrack(int *total = NULL, int *curr=NULL);
     static const char *GetCdTextField(const cdtext_field_t type);
-    void GetCdInfo (CD_TEXT_T &txt) {
-       mCdInfo.GetCdInfo(txt);
+    // Get CD-Text of disc and all tracks. Tracks are indexed in CD order,
+    // use GetDiscTrack to get the index for a playlist entry.
+    void GetCdText (cCdTextRef &ref) {
+        mCdInfo.GetCdText(ref);
+    }
+    TRACK_IDX_T GetDiscTrack (const TRACK_IDX_T track) {
+        return GetTrackPlaylist(track);
     }
-    void GetCdTextFields(const TRACK_IDX_T track, CD_TEXT_T &txt) {
-        mCdInfo.GetCdTextFields(GetTrackPlaylist(track), txt);
-    };
     lsn_t GetStartLsn (const TRACK_IDX_T track) {
         return mCdInfo.GetStartLsn(GetTrackPlaylist(track));
     }
@@ -141,6 +148,18 @@ public:
     TRACK_IDX_T GetNumTracks (void) {
         return mCdInfo.GetNumTracks();
     }
+    // Number of entries of the play order, a queue may have fewer or
+    // more entries than the disc has tracks
+    TRACK_IDX_T GetPlayListLength (void) {
+        return mPlaylist.GetLength();
+    }
+    // AccurateRip result of a track in CD order
+    AR_RESULT_T GetVerifyResult (const TRACK_IDX_T disctrack) {
+        return mAccurateRip.GetResult(disctrack);
+    }
+    // Calculate the position lsncnt blocks after/before track/lsn
+    void SkipTimeFwd(lsn_t lsncnt, TRACK_IDX_T &track, lsn_t &lsn);
+    void SkipTimeBack(lsn_t lsncnt, TRACK_IDX_T &track, lsn_t &lsn);
     bool GetData (uint8_t *data, lsn_t *lsn, int *frame); // Get a raw audio block
     BUFCDIO_STATE_T GetState(void) {
         return mState;
@@ -149,40 +168,71 @@ public:
     void Action(void);
 
     void SetRestartMode(bool restart) {mRestart = restart;}
-    void SetTrack (TRACK_IDX_T newtrack);
+    // Play mode used when the reader starts without resume point
+    void SetPlayMode(bool random) {mPlayRandom = random;}
+    // Resume point of the disc, only valid after OpenDevice
+    bool GetResumePoint(TRACK_IDX_T &disctrack, int &secs);
+    // The following calls are only queued and executed by the reader
+    // thread, so they never block.
+    void SetTrack (TRACK_IDX_T newtrack) {
+        PutCommand(CDIO_CMD_SET_TRACK, newtrack);
+    }
     void NextTrack(void) {
-        cMutexLock MutexLock(&mCdMutex);
-        SetTrack(mCurrTrackIdx+1);
+        PutCommand(CDIO_CMD_NEXT_TRACK);
     };
     void PrevTrack(void) {
-        cMutexLock MutexLock(&mCdMutex);
-        if (mCurrTrackIdx > 0) SetTrack(mCurrTrackIdx-1);
+        PutCommand(CDIO_CMD_PREV_TRACK);
     };
+    void SkipTime(int tm) {
+        PutCommand(CDIO_CMD_SKIP_TIME, tm);
+    }
+    // Seek to offset blocks after the start of track
+    void SeekTrack(TRACK_IDX_T track, lsn_t offset) {
+        PutCommand(CDIO_CMD_SEEK, track, offset);
+    }
+    // Shuffle, a seed other than 0 repeats a previous order
+    void RandomPlay(uint32_t seed = 0) {
+        PutCommand(CDIO_CMD_RANDOM, seed);
+    }
+    void SortedPlay(void) {
+        PutCommand(CDIO_CMD_SORTED);
+    }
+    // A-B loop: set the start, then the end at the played position
+    void LoopStart(void) {
+        PutCommand(CDIO_CMD_LOOP_A);
+    }
+    void LoopEnd(void) {
+        PutCommand(CDIO_CMD_LOOP_B);
+    }
+    // Repeat the played track
+    void LoopTrack(void) {
+        PutCommand(CDIO_CMD_LOOP_TRACK);
+    }
+    void LoopOff(void) {
+        PutCommand(CDIO_CMD_LOOP_OFF);
+    }
+    // The reader takes mCdMutex for each read, so it is not held while
+    // waiting for the thread. The device is closed when the reader is gone.
     void Stop(void) {
-        cMutexLock MutexLock(&mCdMutex);
-        mState = BCDIO_STOP;
+        SetState(BCDIO_STOP);
+        mRingBuffer.InterruptPut();
         Cancel(5);
         CloseDevice();
     }
 
-    void RandomPlay(void);
-    void SortedPlay(void);
-
     void Play(void) {
-         if (mState == BCDIO_PAUSE) mState = BCDIO_PLAY;
+         if (mState == BCDIO_PAUSE) SetState(BCDIO_PLAY);
     }
     void Pause(void) {
-        if (mState == BCDIO_PLAY) mState = BCDIO_PAUSE;
-        else if (mState == BCDIO_PAUSE) mState = BCDIO_PLAY;
+        if (mState == BCDIO_PLAY) SetState(BCDIO_PAUSE);
+        else if (mState == BCDIO_PAUSE) SetState(BCDIO_PLAY);
     }
 
     bool CDDBInfoAvailable(void) {
         return mCdInfo.CDDBInfoAvailable();
     }
-    void SkipTime(int tm);
-
     // Wait until some buffers are available on first play.
-    void WaitBuffer (void) { mRingBuffer.WaitBlocksAvail (CCDIO_MAX_BLOCKS/4); }
+    void WaitBuffer (void) { mRingBuffer.WaitBlocksAvail (CCDIO_PREBUFFER_BLOCKS); }
 };
 
 #endif
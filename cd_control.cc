@@ -14,6 +14,7 @@
 #include "pes_audio_converter.h"
 #include "bufferedcdio.h"
 #include "cdmenu.h"
+#include <vdr/remote.h>
 #include <time.h>
 #include <assert.h>
 #include <langinfo.h>
@@ -23,25 +24,31 @@ const char *cCdControl::menukindDetail = "NormalDetail";
 const char *cCdControl::specialMenu[CD_DISPLAY_LAST][CH_CHAR_LAST] =
 {
     {ASCII_CHAR_PAUSE, ASCII_CHAR_PLAY, ASCII_CHAR_RESTART,
-     ASCII_CHAR_NORMAL,ASCII_CHAR_RANDOM, ASCII_CHAR_SORTED},
+     ASCII_CHAR_NORMAL,ASCII_CHAR_RANDOM, ASCII_CHAR_SORTED, ASCII_CHAR_LOOP},
     {UTF8_CHAR_PAUSE, UTF8_CHAR_PLAY, UTF8_CHAR_RESTART,
-     UTF8_CHAR_NORMAL,UTF8_CHAR_RANDOM, UTF8_CHAR_SORTED}
+     UTF8_CHAR_NORMAL,UTF8_CHAR_RANDOM, UTF8_CHAR_SORTED, UTF8_CHAR_LOOP}
 };
 
 cCdControl::cCdControl(void)
     : cControl(mCdPlayer = new cCdPlayer), mMenuPlaylist(NULL),
-      mShowDetail(false), mCurrtitle(INVALID_TRACK_IDX)
+      mShowDetail(false), mShownDetail(false), mShownRestart(false),
+      mShownRandom(false), mShownTextVersion(0), mShownOffset(-1),
+      mShownCurrRow(-1), mStatus(menukindPlayList), mRowsValid(false),
+      mRowsTextVersion(0), mRowsPlayListVersion(0), mRowsVerifyVersion(0),
+      mRowsShowArtist(false)
 {
     char *codeset = nl_langinfo(CODESET);
 
+    memset(&mShown, 0, sizeof(mShown));
+    mShown.mTrack = INVALID_TRACK_IDX;
+    mShown.mNumTracks = -1;
+    mShown.mState = BCDIO_FAILED;
+    mShown.mSpeed = -1;
+
     cStatus::MsgReplaying(this,tr("CD Player"), NULL,true);
+    mStatus.Start();
     mPlayRandom = cMenuCDPlayer::GetPlayMode();
-    if (mPlayRandom) {
-        mCdPlayer->RandomPlay();
-    }
-    else {
-        mCdPlayer->SortedPlay();
-    }
+    mCdPlayer->SetPlayMode(mPlayRandom);
     mRestart = cMenuCDPlayer::GetRestart();
     mCdPlayer->SetRestartMode(mRestart);
     mIsUTF8 = false;
@@ -70,10 +77,7 @@ void cCdControl::Hide(void)
     if (mMenuPlaylist != NULL) {
         mMenuPlaylist->Clear();
         delete mMenuPlaylist;
-        cStatus::MsgOsdClear();
-#ifdef USE_GRAPHTFT
-        cStatus::MsgOsdMenuDestroy();
-#endif
+        mStatus.Close();
     }
     mMenuPlaylist = NULL;
 }
@@ -104,7 +108,6 @@ eOSState cCdControl::ProcessKey(eKeys Key)
             mCdPlayer->RandomPlay();
             mPlayRandom = true;
         }
-        mCurrtitle = INVALID_TRACK_IDX;
         break;
     case kGreen: // 1min back
         mCdPlayer->ChangeTime(-60);
@@ -138,9 +141,34 @@ eOSState cCdControl::ProcessKey(eKeys Key)
     case kPause:
         mCdPlayer->Pause();
         break;
-    case kLeft:
-        mRestart = !mRestart;
-        mCdPlayer->SetRestartMode(mRestart);
+    case kLeft: // Repeat the disc, repeat the track, no repeat
+        if (mShown.mLoop == CD_LOOP_TRACK) {
+            mCdPlayer->LoopOff();
+        }
+        else if (mRestart) {
+            mRestart = false;
+            mCdPlayer->SetRestartMode(mRestart);
+            mCdPlayer->LoopTrack();
+        }
+        else {
+            mRestart = true;
+            mCdPlayer->SetRestartMode(mRestart);
+        }
+        break;
+    case kRight: // Set the loop start, the loop end, end the loop
+        if (mShown.mLoop == CD_LOOP_A) {
+            mCdPlayer->LoopEnd();
+        }
+        else if (mShown.mLoop == CD_LOOP_AB) {
+            mCdPlayer->LoopOff();
+        }
+        else {
+            mCdPlayer->LoopStart();
+        }
+        break;
+    case k0: // Search the library
+        cPluginCdplayer::ShowLibrary();
+        cRemote::CallPlugin("cdplayer");
         break;
     default:
         if ((Key >= k1) && (Key <= k9))
@@ -158,6 +186,7 @@ eOSState cCdControl::ProcessKey(eKeys Key)
         break;
     }
 
+    mCdPlayer->CommitSeek();
     if (mCdPlayer->GetState() == BCDIO_FAILED) {
         cStatus::MsgOsdStatusMessage(mCdPlayer->GetErrorText().c_str());
         Skins.QueueMessage(mtError, mCdPlayer->GetErrorText().c_str());
@@ -179,29 +208,28 @@ eOSState cCdControl::ProcessKey(eKeys Key)
 void cCdControl::DisplayLine(const char *buf, int line)
 {
     mMenuPlaylist->SetItem(buf, line, false, true);
-    cStatus::MsgOsdItem(buf, line);
+    mStatus.SetItem(buf, line);
 }
 
-void cCdControl::ShowDetail()
+void cCdControl::ShowDetail(const cCdTextRef &text, const CD_PLAY_STATE_T &ps)
 {
-    CD_TEXT_T cd_info;
+    const char *txt;
     char buf[100];
     int i;
     int lncnt = 1;
     string str;
-    TRACK_IDX_T currtitle = mCdPlayer->GetCurrTrack();
+    TRACK_IDX_T currtitle = mCdPlayer->GetDiscTrack(ps.mTrack);
 
     mMenuPlaylist->SetTabs(18);
     str = tr("CD Information");
     str = "\t" + str;
     DisplayLine(str.c_str(), lncnt++);
-    mCdPlayer->GetCdInfo(cd_info);
 
     for (i = 0; i < MAX_CDTEXT_FIELDS; i++) {
-        if (!cd_info[i].empty()) {
+        txt = text->GetDisc(i);
+        if (*txt != '\0') {
             sprintf(buf, "%.15s\t: %.50s",
-                    cBufferedCdio::GetCdTextField((cdtext_field_t)i),
-                    cd_info[i].c_str());
+                    cBufferedCdio::GetCdTextField((cdtext_field_t)i), txt);
             DisplayLine(buf, lncnt++);
         }
     }
@@ -210,16 +238,14 @@ void cCdControl::ShowDetail()
     str = "\t" + str;
     DisplayLine(str.c_str(), lncnt++);
 
-    mCdPlayer->GetCdTextFields(currtitle, cd_info);
     for (i = 0; i < MAX_CDTEXT_FIELDS; i++) {
-        if (!cd_info[i].empty()) {
+        txt = text->GetTrack(currtitle, i);
+        if (*txt != '\0') {
             sprintf(buf, "%.15s\t: %.50s",
-                     cBufferedCdio::GetCdTextField((cdtext_field_t) i),
-                     cd_info[i].c_str());
+                     cBufferedCdio::GetCdTextField((cdtext_field_t) i), txt);
             DisplayLine(buf, lncnt++);
         }
     }
-    SetHelpkeys();
 }
 
 void cCdControl::SetHelpkeys(void)
@@ -239,52 +265,105 @@ void cCdControl::SetHelpkeys(void)
     if (mPlayRandom) {
         rtext = redtxtsort;
     }
-    cStatus::MsgOsdHelpKeys(rtext, greentxt, yellowtxt, btext);
+    mStatus.SetHelpKeys(rtext, greentxt, yellowtxt, btext);
     mMenuPlaylist->SetButtons(rtext, greentxt, yellowtxt, btext);
 }
 
-void cCdControl::ShowList()
+// Format the rows of all tracks. This is only done if the CD-Text, the
+// playlist or the artist setting changed, not on every track change.
+void cCdControl::UpdateRows(const cCdTextRef &text, const CD_PLAY_STATE_T &ps)
 {
-    TRACK_IDX_T numtrk = mCdPlayer->GetNumTracks();
-    TRACK_IDX_T currtitle = mCdPlayer->GetCurrTrack();
-    int offset = 0;
-    int maxitems = mMenuPlaylist->MaxItems();
+    bool showartist = cMenuCDPlayer::GetShowArtist();
     char *str;
 
-    // Build Playlist
-    mMenuPlaylist->SetTabs(3, 6, 10);
-    if (numtrk > mMenuPlaylist->MaxItems()) {
+    if (mRowsValid &&
+        (mRowsTextVersion == text->GetVersion()) &&
+        (mRowsPlayListVersion == ps.mPlayListVersion) &&
+        (mRowsVerifyVersion == ps.mVerifyVersion) &&
+        (mRowsShowArtist == showartist) &&
+        ((int)mMenuRows.size() == ps.mNumTracks)) {
+        return;
+    }
+    mMenuRows.resize(ps.mNumTracks);
+    mOsdRows.resize(ps.mNumTracks);
+    for (TRACK_IDX_T i = 0; i < ps.mNumTracks; i++) {
+        str = BuildMenuStr(text, i);
+        mMenuRows[i] = str;
+        free(str);
+        str = BuildOSDStr(text, i);
+        mOsdRows[i] = str;
+        free(str);
+    }
+    mRowsValid = true;
+    mRowsTextVersion = text->GetVersion();
+    mRowsPlayListVersion = ps.mPlayListVersion;
+    mRowsVerifyVersion = ps.mVerifyVersion;
+    mRowsShowArtist = showartist;
+}
+
+// Send only the visible rows which differ from the ones already shown
+void cCdControl::ShowList(const CD_PLAY_STATE_T &ps, bool full)
+{
+    TRACK_IDX_T numtrk = ps.mNumTracks;
+    TRACK_IDX_T currtitle = ps.mTrack;
+    int offset = 0;
+    int maxitems = mMenuPlaylist->MaxItems();
+    int rows;
+    int currrow = -1;
+
+    if (full) {
+        mMenuPlaylist->SetTabs(3, 6, 10);
+        mSkinRows.assign(maxitems, "");
+        mShownOffset = -1;
+        mShownCurrRow = -1;
+    }
+    if (numtrk > maxitems) {
         int itemcnt = maxitems / 2;
         if ((int) currtitle > itemcnt) {
             offset = currtitle - itemcnt;
-            if (offset + maxitems > (int) mCdPlayer->GetNumTracks()) {
-                offset = mCdPlayer->GetNumTracks() - maxitems;
+            if (offset + maxitems > (int) numtrk) {
+                offset = numtrk - maxitems;
             }
         }
-        mMenuPlaylist->SetScrollbar(mCdPlayer->GetNumTracks(), offset);
+        if (offset != mShownOffset) {
+            mMenuPlaylist->SetScrollbar(numtrk, offset);
+        }
     }
-    if (maxitems > numtrk) {
-        maxitems = numtrk;
+    mShownOffset = offset;
+    rows = maxitems;
+    if (rows > (int)numtrk) {
+        rows = numtrk;
     }
-    for (int i = 0; i < maxitems; i++) {
-        TRACK_IDX_T trk = i + offset;
-        str = BuildMenuStr(trk);
-        mMenuPlaylist->SetItem(str, i, (trk == mCdPlayer->GetCurrTrack()), true);
-        free(str);
+    if ((currtitle != INVALID_TRACK_IDX) &&
+        ((int)currtitle >= offset) && ((int)currtitle < offset + rows)) {
+        currrow = currtitle - offset;
     }
 
-    for (TRACK_IDX_T i = 0; i < numtrk; i++) {
-        str = BuildOSDStr(i);
-        cStatus::MsgOsdItem(str, i + 1);
-        free(str);
+    for (int i = 0; i < rows; i++) {
+        TRACK_IDX_T trk = i + offset;
+        bool current = (i == currrow);
+        if ((mSkinRows[i] != mMenuRows[trk]) ||
+            (current != (i == mShownCurrRow))) {
+            mMenuPlaylist->SetItem(mMenuRows[trk].c_str(), i, current, true);
+            mSkinRows[i] = mMenuRows[trk];
+        }
+        mStatus.SetItem(mOsdRows[trk].c_str(), i);
     }
-    if ((currtitle != INVALID_TRACK_IDX) && (numtrk > 0)) {
-        str = BuildOSDStr(currtitle);
-        cStatus::MsgOsdCurrentItem(str);
-        free(str);
+    // Blank rows left over from a disc with more tracks
+    for (int i = rows; i < maxitems; i++) {
+        if (!mSkinRows[i].empty()) {
+            mMenuPlaylist->SetItem("", i, false, false);
+            mSkinRows[i].clear();
+        }
+    }
+    mShownCurrRow = currrow;
+    mStatus.TruncateItems(rows);
+
+    if ((currtitle != INVALID_TRACK_IDX) && (currtitle < numtrk)) {
+        mStatus.SetCurrentItem(mOsdRows[currtitle].c_str());
     }
-    SetHelpkeys();
 }
+
 void cCdControl::Replace (string &s, const char *repl, const char *with)
 {
     string::size_type idx;
@@ -295,31 +374,106 @@ void cCdControl::Replace (string &s, const char *repl, const char *with)
     }
 }
 
+string cCdControl::BuildTitle(const cCdTextRef &text, const CD_PLAY_STATE_T &ps)
+{
+    string title;
+    const char *cdtitle = text->GetDisc(CDTEXT_TITLE);
+    const char *perform = text->GetDisc(CDTEXT_PERFORMER);
+
+    if (*cdtitle != '\0') {
+        title = cdtitle;
+    } else if (*perform != '\0') {
+        title = perform;
+    } else {
+        title = tr("Playlist");
+    }
+
+    title += "  ";
+    switch (ps.mState) {
+    case BCDIO_FAILED:
+    case BCDIO_STARTING:
+        title += "-";
+        break;
+    case BCDIO_STOP:
+    case BCDIO_PAUSE:
+        title += GetString(CD_CHAR_PAUSE);
+        break;
+    case BCDIO_PLAY:
+        title += GetString(CD_CHAR_PLAY);
+        break;
+    default:
+        break;
+    }
+
+    title += " ";
+    if (ps.mLoop == CD_LOOP_TRACK) {
+        title += GetString(CD_CHAR_LOOP);
+    }
+    else if (mRestart) {
+        title += GetString(CD_CHAR_RESTART);
+    }
+    else {
+        title += GetString(CD_CHAR_NORMAL);
+    }
+    if (ps.mLoop == CD_LOOP_A) {
+        title += " A-";
+    }
+    else if (ps.mLoop == CD_LOOP_AB) {
+        title += " A-B";
+    }
+
+    switch (ps.mSpeed) {
+    case 1:
+        title += " x1,1";
+        break;
+    case 2:
+        title += " x2";
+        break;
+    default:
+        break;
+    }
+
+    title += " ";
+    if (mPlayRandom) {
+        title += GetString(CD_CHAR_RANDOM);
+    }
+    else {
+        title += GetString(CD_CHAR_SORTED);
+    }
+    return title;
+}
+
 void cCdControl::ShowPlaylist()
 {
     cMutexLock MutexLock(&mControlMutex);
-    CD_TEXT_T cd_info;
-    bool render_all = false;
-    static BUFCDIO_STATE_T state = BCDIO_FAILED;
-    static int speed = -1;
-    static int numtrk = -1;
-    static bool cddbinfo = false;
-    static bool detail = false;
-    static bool restart = false;
-    static bool playrandom = false;
-
-    if ((mCurrtitle != mCdPlayer->GetCurrTrack()) ||
-        (numtrk != mCdPlayer->GetNumTracks()) ||
-        (state != mCdPlayer->GetState()) ||
-        (cddbinfo != mCdPlayer->CDDBInfoAvailable()) ||
-        (detail != mShowDetail) ||
-        (restart != mRestart) ||
-        (playrandom != mPlayRandom) ||
-        (speed != mCdPlayer->GetSpeed())) {
-        render_all = true;
+    cCdTextRef text;
+    CD_PLAY_STATE_T ps;
+    bool full = false;
+    bool changed;
+    bool help;
+    string title;
+
+    mCdPlayer->GetPlayState(ps);
+    mCdPlayer->GetCdText(text);
+    // The play mode may be restored from the resume point
+    if (ps.mPlayListVersion != mShown.mPlayListVersion) {
+        mPlayRandom = ps.mRandom;
     }
+    changed = ((mShown.mTrack != ps.mTrack) ||
+               (mShown.mNumTracks != ps.mNumTracks) ||
+               (mShown.mState != ps.mState) ||
+               (mShown.mCddbInfo != ps.mCddbInfo) ||
+               (mShown.mSpeed != ps.mSpeed) ||
+               (mShown.mLoop != ps.mLoop) ||
+               (mShown.mPlayListVersion != ps.mPlayListVersion) ||
+               (mShown.mVerifyVersion != ps.mVerifyVersion) ||
+               (mShownTextVersion != text->GetVersion()) ||
+               (mShownDetail != mShowDetail) ||
+               (mShownRestart != mRestart) ||
+               (mShownRandom != mPlayRandom));
+
     // If no change in display and any other OSD is open then don't show Playlist menu
-    if ((!render_all) && cOsd::IsOpen() && (mMenuPlaylist == NULL)) {
+    if ((!changed) && cOsd::IsOpen() && (mMenuPlaylist == NULL)) {
         return;
     }
 
@@ -333,94 +487,41 @@ void cCdControl::ShowPlaylist()
     // Display Playlist menu
     if (mMenuPlaylist == NULL) {
         dsyslog("Show OSD");
-        render_all = true;
+        full = true;
         mMenuPlaylist = Skins.Current()->DisplayMenu();
 #if VDRVERSNUM >= 10734
         mMenuPlaylist->SetMenuCategory(mcUnknown);
 #endif
-#ifdef USE_GRAPHTFT
-        cStatus::MsgOsdMenuDestroy();
-#if VDRVERSNUM >= 20200
-        cStatus::MsgOsdMenuDisplay(mcText);
-#else
-        cStatus::MsgOsdMenuDisplay(menukindPlayList);
-#endif
-#endif
+        mStatus.Open();
+    }
+    if (!full && !changed) {
+        return;
     }
 
-    if (render_all) {
-        if (detail != mShowDetail) {
-            mMenuPlaylist->Clear();
-        }
-        playrandom = mPlayRandom;
-        restart = mRestart;
-        detail = mShowDetail;
-        mCurrtitle = mCdPlayer->GetCurrTrack();
-        state = mCdPlayer->GetState();
-        speed = mCdPlayer->GetSpeed();
-        numtrk = mCdPlayer->GetNumTracks();
-        cddbinfo = mCdPlayer->CDDBInfoAvailable();
-
-        mCdPlayer->GetCdInfo(cd_info);
-        string title;
-        string cdtitle = cd_info[CDTEXT_TITLE];
-        string perform = cd_info[CDTEXT_PERFORMER];
-
-        // Build title information
-        if (!cdtitle.empty()) {
-            title = cdtitle;
-        } else if (!perform.empty()) {
-            title = perform;
-        } else {
-            title = tr("Playlist");
-        }
-
-        title += "  ";
-        switch (mCdPlayer->GetState()) {
-        case BCDIO_FAILED:
-        case BCDIO_STARTING:
-            title += "-";
-            break;
-        case BCDIO_STOP:
-        case BCDIO_PAUSE:
-            title += GetString(CD_CHAR_PAUSE);
-            break;
-        case BCDIO_PLAY:
-            title += GetString(CD_CHAR_PLAY);
-            break;
-        default:
-            break;
-        }
-
-        title += " ";
-        if (mRestart) {
-            title += GetString(CD_CHAR_RESTART);
-        }
-        else {
-            title += GetString(CD_CHAR_NORMAL);
-        }
+    // The detail view is small and its line count varies, so it is
+    // always redrawn completely.
+    if ((mShownDetail != mShowDetail) ||
+        (mShowDetail && ((mShown.mTrack != ps.mTrack) ||
+                         (mShownTextVersion != text->GetVersion())))) {
+        mMenuPlaylist->Clear();
+        full = true;
+    }
+    help = full || (mShownRandom != mPlayRandom);
 
-        switch (mCdPlayer->GetSpeed()) {
-        case 1:
-            title += " x1,1";
-            break;
-        case 2:
-            title += " x2";
-            break;
-        default:
-            break;
-        }
+    mShown = ps;
+    mShownTextVersion = text->GetVersion();
+    mShownDetail = mShowDetail;
+    mShownRestart = mRestart;
+    mShownRandom = mPlayRandom;
 
-        title += " ";
-        if (mPlayRandom) {
-            title += GetString(CD_CHAR_RANDOM);
-        }
-        else {
-            title += GetString(CD_CHAR_SORTED);
-        }
+    if (full) {
+        mStatus.Clear();
+    }
+    title = BuildTitle(text, ps);
+    if (full || (title != mShownTitle)) {
+        mShownTitle = title;
         Skins.Message(mtStatus, NULL);
         mMenuPlaylist->SetTitle(title.c_str());
-        cStatus::MsgOsdClear();
         if (cMenuCDPlayer::GetGraphTFT() && mIsUTF8) {
             Replace(title, UTF8_CHAR_PLAY, GRAPHTFT_CHAR_DISK);
             Replace(title, UTF8_CHAR_PAUSE, GRAPHTFT_CHAR_PAUSE);
@@ -429,47 +530,64 @@ void cCdControl::ShowPlaylist()
             Replace(title, UTF8_CHAR_RANDOM, GRAPHTFT_CHAR_RANDOM);
             Replace(title, UTF8_CHAR_SORTED, GRAPHTFT_CHAR_SORTED);
         }
-        cStatus::MsgOsdTitle(title.c_str());
+        mStatus.SetTitle(title.c_str());
+    }
 
-        if (mShowDetail) {
-            ShowDetail();
-        } else {
-            ShowList();
+    if (mShowDetail) {
+        if (full) {
+            ShowDetail(text, ps);
         }
-        mMenuPlaylist->Flush();
+    } else {
+        UpdateRows(text, ps);
+        ShowList(ps, full);
+    }
+    if (help) {
+        SetHelpkeys();
     }
+    mMenuPlaylist->Flush();
 }
 
 
-char *cCdControl::BuildOSDStr(TRACK_IDX_T idx)
+char *cCdControl::BuildOSDStr(const cCdTextRef &text, TRACK_IDX_T idx)
 {
-    CD_TEXT_T text;
     char *str;
     int min, sec;
-    mCdPlayer->GetCdTextFields(idx, text);
-    string title = text[CDTEXT_TITLE];
+    const char *title = text->GetTrack(mCdPlayer->GetDiscTrack(idx), CDTEXT_TITLE);
     mCdPlayer->GetTrackTime(idx, &min, &sec);
-    asprintf(&str, "%2d %2d:%02d %s", idx+1, min, sec, title.c_str());
+    asprintf(&str, "%2d %2d:%02d%s %s", idx+1, min, sec, GetVerifyMark(idx),
+             title);
     return str;
 }
 
-char *cCdControl::BuildMenuStr(TRACK_IDX_T idx)
+// Mark behind the track time: bit-perfect or read error
+const char *cCdControl::GetVerifyMark(TRACK_IDX_T idx)
+{
+    switch (mCdPlayer->GetVerifyResult(idx)) {
+    case AR_ACCURATE:
+        return "*";
+    case AR_MISMATCH:
+        return "!";
+    default:
+        return "";
+    }
+}
+
+char *cCdControl::BuildMenuStr(const cCdTextRef &text, TRACK_IDX_T idx)
 {
-    CD_TEXT_T text;
     char *str;
     int min, sec;
-
-    mCdPlayer->GetCdTextFields(idx, text);
-    string artist = text[CDTEXT_PERFORMER];
-    string title = text[CDTEXT_TITLE];
+    TRACK_IDX_T disctrack = mCdPlayer->GetDiscTrack(idx);
+    const char *artist = text->GetTrack(disctrack, CDTEXT_PERFORMER);
+    const char *title = text->GetTrack(disctrack, CDTEXT_TITLE);
 
     mCdPlayer->GetTrackTime(idx, &min, &sec);
     if (cMenuCDPlayer::GetShowArtist()) {
-        asprintf(&str, "%2d\t%2d:%02d\t%s\t %s", idx+1, min, sec, artist.c_str(),
-                title.c_str());
+        asprintf(&str, "%2d\t%2d:%02d%s\t%s\t %s", idx+1, min, sec,
+                 GetVerifyMark(idx), artist, title);
     }
     else {
-        asprintf(&str, "%2d\t%2d:%02d\t%s", idx+1, min, sec, title.c_str());
+        asprintf(&str, "%2d\t%2d:%02d%s\t%s", idx+1, min, sec,
+                 GetVerifyMark(idx), title);
     }
     return str;
 }
@@ -482,16 +600,30 @@ const PCM_FREQ_T cCdPlayer::mSpeedTypes[] = {
         PCM_FREQ_96000
 };
 
+const int cCdPlayer::mSpeedRates[] = {
+        44100,
+        48000,
+        96000
+};
+
 cCdPlayer::cCdPlayer(void)
     :cPlayer (pmAudioVideo)
 {
     pStillBuf = NULL;
     mStillBufLen = 0;
-    mSpeed = 0;
+    SetSpeed(0);
     mPurge = false;
+    mTsOutput = false;
+    mTsNoDolby = false;
+    mTsPatPmt = 0;
+    mTsPts = TSMUX_PTS_START;
+    mTsPtsFrac = 0;
     mPlayRandom = false;
     mSpanPlugin = cPluginManager::CallFirstService(SPAN_SET_PCM_DATA_ID, NULL);
     SetDescription ("cdplayer");
+    if (mSpanPlugin != NULL) {
+        mSpanFeeder.Start();
+    }
 }
 
 cCdPlayer::~cCdPlayer()
@@ -503,24 +635,44 @@ cCdPlayer::~cCdPlayer()
 
 bool cCdPlayer::GetReplayMode(bool &Play, bool &Forward, int &Speed)
 {
-    cMutexLock MutexLock(&mPlayerMutex);
-    Play = (GetState() == BCDIO_PLAY);
+    CD_PLAY_STATE_T ps;
+    GetPlayState(ps);
+    Play = (ps.mState == BCDIO_PLAY);
     Forward = true;
     Speed = -1;
-    if (GetSpeed() != 0) {
-        Speed = GetSpeed();
+    if (ps.mSpeed != 0) {
+        Speed = ps.mSpeed;
     }
     return (true);
 }
 
 bool cCdPlayer::GetIndex(int &Current, int &Total, UNUSED_ARG bool SnapToIFrame)
 {
-    cMutexLock MutexLock(&mPlayerMutex);
-    Current = GetCurrTrack();
-    Total = GetNumTracks();
+    CD_PLAY_STATE_T ps;
+    GetPlayState(ps);
+    Current = ps.mTrack;
+    Total = ps.mNumTracks;
     return (true);
 }
 
+void cCdPlayer::GetPlayState(CD_PLAY_STATE_T &state)
+{
+    cPluginCdplayer::GetPlayState().Get(state);
+    if (SeekShown(state)) {
+        state.mTrack = state.mSeekTrack;
+        state.mOffset = state.mSeekOffset;
+        state.mPosition = state.mSeekOffset / CDIO_CD_FRAMES_PER_SEC;
+        state.mLength = mBufCdio.GetLengthLsn(state.mSeekTrack) /
+                        CDIO_CD_FRAMES_PER_SEC;
+    }
+}
+
+void cCdPlayer::SetSpeed(int speed)
+{
+    mSpeed = speed;
+    cPluginCdplayer::GetPlayState().SetSpeed(speed);
+}
+
 void cCdPlayer::DisplayStillPicture (void)
 {
     if (pStillBuf != NULL) {
@@ -623,9 +775,7 @@ void cCdPlayer::Play ()
             return;
         }
         mBufCdio.Start();
-    }
-    if (mPlayRandom) {
-        RandomPlay();
+        ShowResumePoint();
     }
     mBufCdio.Play();
     SpeedNormal();
@@ -635,6 +785,24 @@ void cCdPlayer::Play ()
     }
 }
 
+// Tell where a resumed disc continues
+void cCdPlayer::ShowResumePoint(void)
+{
+    TRACK_IDX_T track;
+    int secs;
+    char buf[128];
+
+    if (mBufCdio.GetResumePoint(track, secs)) {
+        // Key 1 plays the first entry of the restored order, which is
+        // not track 1 after a shuffle
+        snprintf(buf, sizeof(buf),
+                 tr("Continued at track %d, %d:%02d "
+                    "(1 = start of the play order)"),
+                 track + 1, secs / 60, secs % 60);
+        Skins.QueueMessage(mtInfo, buf);
+    }
+}
+
 void cCdPlayer::Stop(void)
 {
     dsyslog("cCdPlayer Stop");
@@ -646,41 +814,112 @@ void cCdPlayer::Stop(void)
     Detach();
 }
 
+// The seek target is shown while it is pending and after commit until
+// the reader executed it. A lost command is shown for SEEK_SHOW_MS.
+bool cCdPlayer::SeekShown(const CD_PLAY_STATE_T &ps)
+{
+    return (ps.mSeek == CD_SEEK_PENDING) ||
+           ((ps.mSeek == CD_SEEK_COMMITTED) &&
+            (cTimeMs::Now() - ps.mSeekTime < SEEK_SHOW_MS));
+}
+
+// Must be called with locked mSeekMutex. A new change starts at the
+// pending target, so repeated keys add up.
+void cCdPlayer::GetSeekBase(TRACK_IDX_T &track, lsn_t &offset)
+{
+    CD_PLAY_STATE_T ps;
+
+    cPluginCdplayer::GetPlayState().Get(ps);
+    if (SeekShown(ps)) {
+        track = ps.mSeekTrack;
+        offset = ps.mSeekOffset;
+        return;
+    }
+    track = ps.mTrack;
+    offset = ps.mOffset;
+}
+
+// Must be called with locked mSeekMutex
+void cCdPlayer::SetSeek(TRACK_IDX_T track, lsn_t offset)
+{
+    cPluginCdplayer::GetPlayState().SetSeek(track, offset);
+}
+
+// Called by the player and the OSD, only one of them gets the target
+void cCdPlayer::CommitSeek(void)
+{
+    int track;
+    int offset;
+
+    if (!cPluginCdplayer::GetPlayState().CommitSeek(SEEK_SETTLE_MS, track,
+                                                    offset)) {
+        return;
+    }
+    dsyslog("cCdPlayer Seek track %d offset %d", track, offset);
+    mBufCdio.SeekTrack(track, offset);
+    DeviceClear();
+}
+
 void cCdPlayer::SetTrack(TRACK_IDX_T track)
 {
     dsyslog("cCdPlayer SetTrack");
-    mBufCdio.SetTrack(track);
-    DeviceClear();
+    cMutexLock MutexLock(&mSeekMutex);
+    if ((track >= 0) && (track < mBufCdio.GetPlayListLength())) {
+        SetSeek(track, 0);
+    }
 }
 
 void cCdPlayer::NextTrack(void)
 {
+    TRACK_IDX_T track;
+    lsn_t offset;
+
     dsyslog("cCdPlayer Next");
-    mBufCdio.NextTrack();
-    DeviceClear();
+    cMutexLock MutexLock(&mSeekMutex);
+    GetSeekBase(track, offset);
+    if (track + 1 < mBufCdio.GetPlayListLength()) {
+        SetSeek(track + 1, 0);
+    }
 }
 
 void cCdPlayer::PrevTrack(void)
 {
+    TRACK_IDX_T track;
+    lsn_t offset;
+
     dsyslog("cCdPlayer Prev");
-    mBufCdio.PrevTrack();
-    DeviceClear();
+    cMutexLock MutexLock(&mSeekMutex);
+    GetSeekBase(track, offset);
+    if (track > 0) {
+        SetSeek(track - 1, 0);
+    }
 }
 
 void cCdPlayer::ChangeTime(int tm)
 {
+    TRACK_IDX_T track;
+    lsn_t offset;
+    lsn_t lsn;
+    lsn_t lsncnt = abs(tm * CDIO_CD_FRAMES_PER_SEC);
+
     dsyslog("cCdPlayer ChangeTime");
-    mBufCdio.SkipTime(tm);
-    DeviceClear();
+    cMutexLock MutexLock(&mSeekMutex);
+    GetSeekBase(track, offset);
+    if ((track < 0) || (track >= mBufCdio.GetPlayListLength())) {
+        return;
+    }
+    lsn = mBufCdio.GetStartLsn(track) + offset;
+    if (tm >= 0) {
+        mBufCdio.SkipTimeFwd(lsncnt, track, lsn);
+    }
+    else {
+        mBufCdio.SkipTimeBack(lsncnt, track, lsn);
+    }
+    SetSeek(track, lsn - mBufCdio.GetStartLsn(track));
 }
 
 bool cCdPlayer::PlayData (const uint8_t *buf, int frame) {
-    const uchar *pesdata;
-    static uint8_t pesbuf[CDIO_CD_FRAMESIZE_RAW];
-    int peslen;
-    int idx = 0;
-    cPesAudioConverter converter;
-    cPoller oPoller;
+    bool tsoutput;
 
 #if 0
 FILE *fp=fopen("/tmp/out.raw","a");
@@ -693,6 +932,53 @@ fclose(fp);
         SetPlayindexData.index = (frame * 1000) / CDIO_CD_FRAMES_PER_SEC;
         cPluginManager::CallFirstService(SPAN_SET_PLAYINDEX_ID, &SetPlayindexData);
     }
+    cPluginCdplayer::GetSpectrum().Feed(buf, frame);
+    cPluginCdplayer::GetPcmTap().Put(buf, frame);
+    tsoutput = UseTsOutput();
+    if (tsoutput != mTsOutput) {
+        dsyslog("%s %d %s output", __FILE__, __LINE__,
+                tsoutput ? "TS" : "PES");
+        mTsOutput = tsoutput;
+        mTsMux.Reset();
+        mTsPatPmt = 0;
+        DeviceSetCurrentAudioTrack(GetAudioTrack());
+    }
+    if (mTsOutput) {
+        return PlayTsData(buf);
+    }
+    return PlayPesData(buf);
+}
+
+// VDR plays the audio of a TS only from the selected track, the LPCM
+// PID is a Dolby track which it ignores without "Use Dolby Digital"
+bool cCdPlayer::UseTsOutput(void)
+{
+    if (!cMenuCDPlayer::GetTsOutput(cDevice::PrimaryDevice()->DeviceNumber())) {
+        mTsNoDolby = false;
+        return false;
+    }
+    if (!Setup.UseDolbyDigital) {
+        if (!mTsNoDolby) {
+            esyslog("%s %d TS output needs \"Use Dolby Digital\", using PES",
+                    __FILE__, __LINE__);
+            mTsNoDolby = true;
+        }
+        return false;
+    }
+    mTsNoDolby = false;
+    return true;
+}
+
+// Each half of the sector as LPCM PES packet
+bool cCdPlayer::PlayPesData(const uint8_t *buf)
+{
+    const uchar *pesdata;
+    static uint8_t pesbuf[CDIO_CD_FRAMESIZE_RAW];
+    int peslen;
+    int idx = 0;
+    cPesAudioConverter converter;
+    cPoller oPoller;
+
     while (idx < CDIO_CD_FRAMESIZE_RAW) {
         if (DevicePoll(oPoller, 100)) {
 
@@ -726,6 +1012,52 @@ fclose(fp);
     return true;
 }
 
+// The sector as one LPCM PES packet in TS, PAT and PMT once per second
+bool cCdPlayer::PlayTsData(const uint8_t *buf)
+{
+    const int ticks = (CDIO_CD_FRAMESIZE_RAW / 4) * 90000;
+    int rate = mSpeedRates[mSpeed];
+    uint8_t *p = mTsBuf;
+    int len = 0;
+    cPoller oPoller;
+
+    if (mTsPatPmt == 0) {
+        len = mTsMux.PutPatPmt(mTsBuf);
+    }
+    mTsPatPmt = (mTsPatPmt + 1) % CDIO_CD_FRAMES_PER_SEC;
+    mTsMux.SetFreq(mSpeedTypes[mSpeed]);
+    len += mTsMux.PutSector(mTsBuf + len, buf, mTsPts);
+    // Duration of the sector at the played rate
+    mTsPts += ticks / rate;
+    mTsPtsFrac += ticks % rate;
+    if (mTsPtsFrac >= rate) {
+        mTsPts++;
+        mTsPtsFrac -= rate;
+    }
+    while (len > 0) {
+        if (DevicePoll(oPoller, 100)) {
+            int w;
+            if (mPurge) {
+                return true;
+            }
+            w = PlayTs(p, len, false);
+            if (w < 0) {
+                esyslog("%s %d PlayTs failed", __FILE__, __LINE__);
+                return false;
+            }
+            p += w;
+            len -= w;
+        }
+        if (!Running()) {
+            return false;
+        }
+        if (mPurge) {
+            return true;
+        }
+    }
+    return true;
+}
+
 void cCdPlayer::Action(void)
 {
     bool play = true;
@@ -735,13 +1067,17 @@ void cCdPlayer::Action(void)
     // Clear and flush output device
     DeviceClear();
     DeviceFlush(100);
-    DeviceSetCurrentAudioTrack(ttAudio);
+    mTsOutput = UseTsOutput();
+    mTsMux.Reset();
+    DeviceSetCurrentAudioTrack(GetAudioTrack());
     DevicePlay();
 
     // Wait until some Data is in the ring buffer
     mBufCdio.WaitBuffer();
     mPurge = false;
+    mTsPatPmt = 0;
     while (play) {
+        CommitSeek();
         if (!mBufCdio.GetData(buf, &lsn, &frame)) {
             dsyslog ("cCdPlayer GetData stop");
             play = false;
@@ -749,8 +1085,10 @@ void cCdPlayer::Action(void)
         if (play) {
             if (mPurge) {
                 DevicePlay();
-                DeviceSetCurrentAudioTrack(ttAudio);
+                DeviceSetCurrentAudioTrack(GetAudioTrack());
                 mPurge = false;
+                // The device gets PAT and PMT again with the next sector
+                mTsPatPmt = 0;
             } else {
                 play = PlayData(buf, frame);
             }
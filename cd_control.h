@@ -12,15 +12,22 @@
 #ifndef _CD_CONTROL_H
 #define _CD_CONTROL_H
 
+#include <vector>
+#include <string>
 #include <vdr/player.h>
 #include "bufferedcdio.h"
 #include "pes_audio_converter.h"
 #include "service.h"
+#include "cdstatus.h"
+#include "pcmtap.h"
+#include "tsmux.h"
 
 // The maximum size of a single frame (up to HDTV 1920x1080):
 #define TS_SIZE 188
 #define CDMAXFRAMESIZE  (KILOBYTE(1024) / TS_SIZE * TS_SIZE) // multiple of TS_SIZE to avoid breaking up TS packets
 #define MAX_SPEED 2
+#define SEEK_SETTLE_MS 300   // Collect track/time changes before seeking
+#define SEEK_SHOW_MS   1000  // Show the seek target until the reader got it
 
 #define ASCII_CHAR_PAUSE   "||"
 #define ASCII_CHAR_PLAY    ">"
@@ -28,6 +35,7 @@
 #define ASCII_CHAR_NORMAL  "N"
 #define ASCII_CHAR_RANDOM  "r"
 #define ASCII_CHAR_SORTED  "S"
+#define ASCII_CHAR_LOOP    "1"
 
 #define UTF8_CHAR_PAUSE   "\u01c1"     // ǁ
 #define UTF8_CHAR_PLAY    "\u00BB"     // »
@@ -35,6 +43,7 @@
 #define UTF8_CHAR_NORMAL  "\u21A6"     // ↦
 #define UTF8_CHAR_RANDOM  "\u21AD"     // ↭
 #define UTF8_CHAR_SORTED  "\u21F5"     // ⇵
+#define UTF8_CHAR_LOOP    "\u21BB"     // ↻
 
 #define GRAPHTFT_CHAR_PAUSE     "\x88"
 #define GRAPHTFT_CHAR_PLAY      "\u00BB"     // »
@@ -55,14 +64,40 @@ protected:
     volatile bool mTrackChange;  // Indication for external track change
     volatile bool mPurge;
     static const PCM_FREQ_T mSpeedTypes[MAX_SPEED+1];
+    static const int mSpeedRates[MAX_SPEED+1];
     cMutex mPlayerMutex;
 
+    // TS output, selected in the setup for the primary device
+    cTsMux mTsMux;
+    bool mTsOutput;
+    bool mTsNoDolby;        // TS selected, but "Use Dolby Digital" is off
+    int mTsPatPmt;          // Sectors until PAT and PMT are repeated
+    int64_t mTsPts;
+    int mTsPtsFrac;         // Remainder of mTsPts in 1/rate ticks
+    uint8_t mTsBuf[TSMUX_PATPMT_SIZE + TSMUX_SECTOR_SIZE];
+
+    // Track and time changes are collected into one pending seek, which
+    // is executed when no further change came within SEEK_SETTLE_MS. The
+    // target is kept in the published play state, mSeekMutex serializes
+    // the key handlers which change it.
+    cMutex mSeekMutex;
+    static bool SeekShown(const CD_PLAY_STATE_T &ps);
+    void GetSeekBase(TRACK_IDX_T &track, lsn_t &offset);
+    void SetSeek(TRACK_IDX_T track, lsn_t offset);
+
     virtual void Activate(bool On);
     void Action(void);
     void DeviceClear() {mPurge = true; cPlayer::DeviceClear();}
     void DisplayStillPicture (void);
     bool PlayData (const uint8_t *buf, int frame);
+    bool PlayPesData(const uint8_t *buf);
+    bool PlayTsData(const uint8_t *buf);
+    bool UseTsOutput(void);
+    // The LPCM of the TS output is announced as Dolby track (tsmux.h)
+    eTrackType GetAudioTrack(void) { return mTsOutput ? ttDolby : ttAudio; }
+    void ShowResumePoint(void);
     cPlugin *mSpanPlugin;
+    cSpanFeeder mSpanFeeder;    // Hands the played data to span
 
 public:
     cCdPlayer(void);
@@ -73,47 +108,48 @@ public:
     void LoadStillPicture (const std::string FileName);
 
     void SetRestartMode (bool restart) {mBufCdio.SetRestartMode(restart);}
-    void RandomPlay(void)
+    // Play mode at start, a resume point restores its own mode
+    void SetPlayMode(bool random)
+    {
+        mBufCdio.SetPlayMode(random);
+        mPlayRandom = random;
+    }
+    void RandomPlay(uint32_t seed = 0)
     {
-        mBufCdio.RandomPlay();
+        mBufCdio.RandomPlay(seed);
         mPlayRandom = true;
     }
     void SortedPlay(void) {
         mBufCdio.SortedPlay();
         mPlayRandom = false;
     }
+    void LoopStart(void) { mBufCdio.LoopStart(); }
+    void LoopEnd(void) { mBufCdio.LoopEnd(); }
+    void LoopTrack(void) { mBufCdio.LoopTrack(); }
+    void LoopOff(void) { mBufCdio.LoopOff(); }
 
     void SetTrack(TRACK_IDX_T track);
     void NextTrack(void);
     void PrevTrack(void);
+    // Execute the pending seek once the settle time has elapsed
+    void CommitSeek(void);
     void Stop(void);
     void Pause(void);
 
     void Play();
-    void SpeedNormal(void) {mSpeed = 0;}
-    void SpeedFaster(void) {if (mSpeed < MAX_SPEED) mSpeed++;}
-    void SpeedSlower(void) {if (mSpeed > 0) mSpeed--;}
+    void SetSpeed(int speed);
+    void SpeedNormal(void) {SetSpeed(0);}
+    void SpeedFaster(void) {if (mSpeed < MAX_SPEED) SetSpeed(mSpeed + 1);}
+    void SpeedSlower(void) {if (mSpeed > 0) SetSpeed(mSpeed - 1);}
     void ChangeTime(int tm);
-    TRACK_IDX_T GetNumTracks (void) {
-        cMutexLock MutexLock(&mPlayerMutex);
-        return mBufCdio.GetNumTracks();
-    };
-    // Return current track index and optional the total length in seconds and
-    // the current second
-    TRACK_IDX_T GetCurrTrack(int *total = NULL, int *curr = NULL) {
-        cMutexLock MutexLock(&mPlayerMutex);
-        return mBufCdio.GetCurrTrack(total, curr);
-    };
-    void GetCdTextFields(const TRACK_IDX_T track, CD_TEXT_T &txt) {
-        cMutexLock MutexLock(&mPlayerMutex);
-        mBufCdio.GetCdTextFields(track, txt);
-    };
-    void GetCdInfo (CD_TEXT_T &txt) {
-        cMutexLock MutexLock(&mPlayerMutex);
-        mBufCdio.GetCdInfo(txt);
+    // Get a consistent snapshot of track, position, state and speed. A
+    // pending seek is already reported as the new position.
+    void GetPlayState(CD_PLAY_STATE_T &state);
+    void GetCdText(cCdTextRef &ref) {
+        mBufCdio.GetCdText(ref);
     }
-    int GetSpeed(void) {
-        return mSpeed;
+    TRACK_IDX_T GetDiscTrack(const TRACK_IDX_T track) {
+        return mBufCdio.GetDiscTrack(track);
     }
     BUFCDIO_STATE_T GetState(void) {
         return mBufCdio.GetState();
@@ -124,9 +160,8 @@ public:
     void GetTrackTime (const TRACK_IDX_T track, int *min, int *sec) {
         mBufCdio.GetTrackTime (track, min, sec);
     }
-
-    bool CDDBInfoAvailable(void) {
-        return mBufCdio.CDDBInfoAvailable();
+    AR_RESULT_T GetVerifyResult(const TRACK_IDX_T track) {
+        return mBufCdio.GetVerifyResult(mBufCdio.GetDiscTrack(track));
     }
 };
 
@@ -139,6 +174,7 @@ private:
         CD_CHAR_NORMAL,
         CD_CHAR_RANDOM,
         CD_CHAR_SORTED,
+        CD_CHAR_LOOP,
         CH_CHAR_LAST
     } CD_MENU_CHAR;
 
@@ -155,7 +191,28 @@ private:
     bool mPlayRandom;
     bool mRestart;
     bool mIsUTF8;
-    TRACK_IDX_T mCurrtitle;
+
+    // State currently shown on the OSD, used to redraw only what changed
+    CD_PLAY_STATE_T mShown;
+    bool mShownDetail;
+    bool mShownRestart;
+    bool mShownRandom;
+    unsigned int mShownTextVersion;
+    std::string mShownTitle;
+    int mShownOffset;
+    int mShownCurrRow;
+    std::vector<std::string> mSkinRows;     // Rows sent to the skin
+    cCdStatusPublisher mStatus;             // Rows sent to cStatus
+
+    // Formatted rows of all tracks, rebuilt only if CD-Text or playlist
+    // changed
+    std::vector<std::string> mMenuRows;
+    std::vector<std::string> mOsdRows;
+    bool mRowsValid;
+    unsigned int mRowsTextVersion;
+    unsigned int mRowsPlayListVersion;
+    unsigned int mRowsVerifyVersion;
+    bool mRowsShowArtist;
     static const char *menukindPlayList;
     static const char *menukindDetail;
     static const char *specialMenu[CD_DISPLAY_LAST][CH_CHAR_LAST];
@@ -168,11 +225,14 @@ private:
         }
         return (specialMenu[CD_DISPLAY_ASCII][cdchar]);
     };
-    char *BuildOSDStr(TRACK_IDX_T);
-    char *BuildMenuStr(TRACK_IDX_T);
+    char *BuildOSDStr(const cCdTextRef &text, TRACK_IDX_T);
+    char *BuildMenuStr(const cCdTextRef &text, TRACK_IDX_T);
+    const char *GetVerifyMark(TRACK_IDX_T idx);
+    std::string BuildTitle(const cCdTextRef &text, const CD_PLAY_STATE_T &ps);
+    void UpdateRows(const cCdTextRef &text, const CD_PLAY_STATE_T &ps);
     void SetHelpkeys(void);
-    void ShowDetail(void);
-    void ShowList(void);
+    void ShowDetail(const cCdTextRef &text, const CD_PLAY_STATE_T &ps);
+    void ShowList(const CD_PLAY_STATE_T &ps, bool full);
     void ShowPlaylist(void);
     void DisplayLine(const char *buf, int line);
 public:
@@ -181,6 +241,9 @@ public:
     virtual void Hide(void);
     virtual cOsdObject *GetInfo(void) { return NULL; }
     virtual eOSState ProcessKey(eKeys Key);
+    // Random play with a given seed, so the order can be repeated. The
+    // shown play mode follows the play state.
+    void Shuffle(uint32_t seed) { mCdPlayer->RandomPlay(seed); }
 };
 
 #endif
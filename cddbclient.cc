@@ -0,0 +1,690 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements a non blocking CDDBP client.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cddbclient.h"
+#include "cdplayer.h"
+
+// Categories searched in the cache, same as libcddb
+static const char *CddbCategories[] = {
+    "data", "folk", "jazz", "misc", "rock", "country", "blues", "newage",
+    "reggae", "classical", "soundtrack", NULL
+};
+
+const char *cCddbClient::GetCategory(int idx)
+{
+    if ((idx < 0) ||
+        (idx >= (int)(sizeof(CddbCategories) / sizeof(CddbCategories[0])))) {
+        return NULL;
+    }
+    return CddbCategories[idx];
+}
+
+int cCddbClient::FindCategory(const std::string &name)
+{
+    for (int i = 0; CddbCategories[i] != NULL; i++) {
+        if (name == CddbCategories[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Split "Artist / Title". Without separator both are the same.
+static void SplitTitle(const std::string &str, std::string &artist,
+                       std::string &title)
+{
+    std::string::size_type idx = str.find(" / ");
+
+    if (idx == std::string::npos) {
+        artist = str;
+        title = str;
+        return;
+    }
+    artist = str.substr(0, idx);
+    title = str.substr(idx + 3);
+}
+
+static void SetNonBlocking(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+cCddbClient::cCddbClient(void)
+    : mSocket(-1), mPort(CDDB_DEFAULT_PORT), mResolved(false), mAddrLen(0),
+      mDeadline(0), mCacheEnabled(false)
+{
+    memset(&mAddr, 0, sizeof(mAddr));
+    if (pipe(mCancelPipe) < 0) {
+        esyslog("%s %d pipe failed %d", __FILE__, __LINE__, errno);
+        mCancelPipe[0] = mCancelPipe[1] = -1;
+    }
+    else {
+        SetNonBlocking(mCancelPipe[0]);
+        SetNonBlocking(mCancelPipe[1]);
+    }
+}
+
+cCddbClient::~cCddbClient()
+{
+    Disconnect();
+    if (mCancelPipe[0] >= 0) {
+        close(mCancelPipe[0]);
+        close(mCancelPipe[1]);
+    }
+}
+
+void cCddbClient::SetServer(const std::string &server)
+{
+    std::string::size_type idx = server.rfind(':');
+    cMutexLock MutexLock(&mMutex);
+
+    Disconnect();
+    mResolved = false;
+    mHost = server;
+    mPort = CDDB_DEFAULT_PORT;
+    if (idx != std::string::npos) {
+        mHost = server.substr(0, idx);
+        mPort = atoi(server.c_str() + idx + 1);
+    }
+}
+
+void cCddbClient::SetCache(const std::string &dir, bool enabled)
+{
+    cMutexLock MutexLock(&mMutex);
+    mCacheDir = dir;
+    mCacheEnabled = enabled && !dir.empty();
+}
+
+void cCddbClient::Abort(void)
+{
+    if (mCancelPipe[1] >= 0) {
+        if (write(mCancelPipe[1], "x", 1) < 0) {
+            // Pipe is full, a cancel is already pending
+        }
+    }
+}
+
+void cCddbClient::DrainCancel(void)
+{
+    char buf[16];
+
+    if (mCancelPipe[0] >= 0) {
+        while (read(mCancelPipe[0], buf, sizeof(buf)) > 0) {
+        }
+    }
+}
+
+// Name resolution can not be aborted, so its result is kept until the
+// connection fails.
+bool cCddbClient::Resolve(void)
+{
+    struct addrinfo hints;
+    struct addrinfo *res;
+    char port[16];
+    int err;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(port, sizeof(port), "%d", mPort);
+    err = getaddrinfo(mHost.c_str(), port, &hints, &res);
+    if (err != 0) {
+        esyslog("%s %d CDDB can not resolve %s: %s",
+                __FILE__, __LINE__, mHost.c_str(), gai_strerror(err));
+        return false;
+    }
+    memcpy(&mAddr, res->ai_addr, res->ai_addrlen);
+    mAddrLen = res->ai_addrlen;
+    freeaddrinfo(res);
+    mResolved = true;
+    return true;
+}
+
+// Wait until the socket is ready, the deadline passed or the lookup was
+// aborted.
+CDDB_RESULT_T cCddbClient::WaitFd(short events)
+{
+    struct pollfd fds[2];
+    int64_t remaining;
+    int ret;
+
+    for (;;) {
+        remaining = (int64_t)(mDeadline - cTimeMs::Now());
+        if (remaining <= 0) {
+            esyslog("%s %d CDDB timeout", __FILE__, __LINE__);
+            return CDDB_ERROR;
+        }
+        fds[0].fd = mSocket;
+        fds[0].events = events;
+        fds[0].revents = 0;
+        fds[1].fd = mCancelPipe[0];
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        ret = poll(fds, 2, (int)remaining);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            esyslog("%s %d CDDB poll failed %d", __FILE__, __LINE__, errno);
+            return CDDB_ERROR;
+        }
+        if (fds[1].revents & POLLIN) {
+            dsyslog("%s %d CDDB lookup aborted", __FILE__, __LINE__);
+            return CDDB_CANCELLED;
+        }
+        if (fds[0].revents != 0) {
+            // Errors are reported by the following send/recv
+            return CDDB_OK;
+        }
+    }
+}
+
+CDDB_RESULT_T cCddbClient::Connect(void)
+{
+    CDDB_RESULT_T res;
+    uint64_t deadline = mDeadline;
+    int err = 0;
+    socklen_t len = sizeof(err);
+
+    if (!mResolved && !Resolve()) {
+        return CDDB_ERROR;
+    }
+    mSocket = socket(mAddr.ss_family, SOCK_STREAM, 0);
+    if (mSocket < 0) {
+        esyslog("%s %d CDDB socket failed %d", __FILE__, __LINE__, errno);
+        return CDDB_ERROR;
+    }
+    SetNonBlocking(mSocket);
+    mRecvBuf.clear();
+    if ((connect(mSocket, (struct sockaddr *)&mAddr, mAddrLen) < 0) &&
+        (errno != EINPROGRESS)) {
+        esyslog("%s %d CDDB connect to %s failed %d",
+                __FILE__, __LINE__, mHost.c_str(), errno);
+        Disconnect();
+        mResolved = false;
+        return CDDB_ERROR;
+    }
+    if (mDeadline > cTimeMs::Now() + CDDB_CONNECT_TIMEOUT_MS) {
+        mDeadline = cTimeMs::Now() + CDDB_CONNECT_TIMEOUT_MS;
+    }
+    res = WaitFd(POLLOUT);
+    mDeadline = deadline;
+    if (res != CDDB_OK) {
+        Disconnect();
+        return res;
+    }
+    if ((getsockopt(mSocket, SOL_SOCKET, SO_ERROR, &err, &len) < 0) ||
+        (err != 0)) {
+        esyslog("%s %d CDDB connect to %s failed %d",
+                __FILE__, __LINE__, mHost.c_str(), err);
+        Disconnect();
+        mResolved = false;
+        return CDDB_ERROR;
+    }
+    dsyslog("CDDB connected to %s:%d", mHost.c_str(), mPort);
+    return CDDB_OK;
+}
+
+void cCddbClient::Disconnect(void)
+{
+    if (mSocket >= 0) {
+        close(mSocket);
+        mSocket = -1;
+    }
+    mRecvBuf.clear();
+}
+
+CDDB_RESULT_T cCddbClient::SendLine(const std::string &line)
+{
+    std::string buf = line + "\r\n";
+    std::string::size_type pos = 0;
+    CDDB_RESULT_T res;
+    ssize_t len;
+
+    while (pos < buf.size()) {
+        len = send(mSocket, buf.data() + pos, buf.size() - pos, MSG_NOSIGNAL);
+        if (len > 0) {
+            pos += len;
+        }
+        else if ((len < 0) && ((errno == EAGAIN) || (errno == EINTR))) {
+            res = WaitFd(POLLOUT);
+            if (res != CDDB_OK) {
+                return res;
+            }
+        }
+        else {
+            esyslog("%s %d CDDB send failed %d", __FILE__, __LINE__, errno);
+            return CDDB_ERROR;
+        }
+    }
+    return CDDB_OK;
+}
+
+CDDB_RESULT_T cCddbClient::ReadLine(std::string &line)
+{
+    std::string::size_type idx;
+    CDDB_RESULT_T res;
+    char buf[1024];
+    ssize_t len;
+
+    while ((idx = mRecvBuf.find('\n')) == std::string::npos) {
+        len = recv(mSocket, buf, sizeof(buf), 0);
+        if (len > 0) {
+            mRecvBuf.append(buf, len);
+        }
+        else if (len == 0) {
+            dsyslog("%s %d CDDB connection closed by server",
+                    __FILE__, __LINE__);
+            return CDDB_ERROR;
+        }
+        else if ((errno == EAGAIN) || (errno == EINTR)) {
+            res = WaitFd(POLLIN);
+            if (res != CDDB_OK) {
+                return res;
+            }
+        }
+        else {
+            esyslog("%s %d CDDB recv failed %d", __FILE__, __LINE__, errno);
+            return CDDB_ERROR;
+        }
+    }
+    line = mRecvBuf.substr(0, idx);
+    mRecvBuf.erase(0, idx + 1);
+    if (!line.empty() && (line[line.size() - 1] == '\r')) {
+        line.erase(line.size() - 1);
+    }
+    return CDDB_OK;
+}
+
+// Send a command and read the status line
+CDDB_RESULT_T cCddbClient::Command(const std::string &cmd, int &code,
+                                   std::string &line)
+{
+    CDDB_RESULT_T res = SendLine(cmd);
+
+    if (res == CDDB_OK) {
+        res = ReadLine(line);
+    }
+    if (res != CDDB_OK) {
+        return res;
+    }
+    code = atoi(line.c_str());
+    return CDDB_OK;
+}
+
+// Read data lines up to the terminating "."
+CDDB_RESULT_T cCddbClient::ReadData(std::string &data)
+{
+    CDDB_RESULT_T res;
+    std::string line;
+
+    data.clear();
+    for (;;) {
+        res = ReadLine(line);
+        if (res != CDDB_OK) {
+            return res;
+        }
+        if (line == ".") {
+            return CDDB_OK;
+        }
+        if (line.compare(0, 2, "..") == 0) {
+            line.erase(0, 1);
+        }
+        data += line + "\n";
+    }
+}
+
+CDDB_RESULT_T cCddbClient::Handshake(void)
+{
+    CDDB_RESULT_T res;
+    std::string line;
+    char hostname[64];
+    char cmd[256];
+    int code;
+
+    // Server banner
+    res = ReadLine(line);
+    if (res != CDDB_OK) {
+        return res;
+    }
+    code = atoi(line.c_str());
+    if ((code != 200) && (code != 201)) {
+        esyslog("%s %d CDDB server refused: %s",
+                __FILE__, __LINE__, line.c_str());
+        return CDDB_ERROR;
+    }
+    if (gethostname(hostname, sizeof(hostname)) < 0) {
+        strcpy(hostname, "localhost");
+    }
+    hostname[sizeof(hostname) - 1] = '\0';
+    snprintf(cmd, sizeof(cmd), "cddb hello vdr %s vdr-cdplayer %s",
+             hostname, VERSION);
+    res = Command(cmd, code, line);
+    if (res != CDDB_OK) {
+        return res;
+    }
+    if ((code != 200) && (code != 402)) {
+        esyslog("%s %d CDDB hello failed: %s",
+                __FILE__, __LINE__, line.c_str());
+        return CDDB_ERROR;
+    }
+    // Protocol level 6 delivers UTF-8
+    res = Command("proto 6", code, line);
+    if (res != CDDB_OK) {
+        return res;
+    }
+    if ((code != 201) && (code != 502)) {
+        dsyslog("%s %d CDDB proto 6 not supported: %s",
+                __FILE__, __LINE__, line.c_str());
+    }
+    return CDDB_OK;
+}
+
+CDDB_RESULT_T cCddbClient::Query(const std::vector<int> &offsets, int length,
+                                 unsigned int discid, CDDB_DISC_T &disc,
+                                 std::string &xmcd)
+{
+    CDDB_RESULT_T res;
+    std::string cmd;
+    std::string line;
+    std::string list;
+    char buf[64];
+    char category[64];
+    const char *catname;
+    unsigned int matchid;
+    int code;
+    int catidx;
+
+    snprintf(buf, sizeof(buf), "cddb query %08x %d", discid,
+             (int)offsets.size());
+    cmd = buf;
+    for (unsigned int i = 0; i < offsets.size(); i++) {
+        snprintf(buf, sizeof(buf), " %d", offsets[i]);
+        cmd += buf;
+    }
+    snprintf(buf, sizeof(buf), " %d", length);
+    cmd += buf;
+
+    res = Command(cmd, code, line);
+    if (res != CDDB_OK) {
+        return res;
+    }
+    switch (code) {
+    case 200:   // Exact match
+        line.erase(0, 4);
+        break;
+    case 210:   // Exact matches
+    case 211:   // Inexact matches, use the first one
+        res = ReadData(list);
+        if (res != CDDB_OK) {
+            return res;
+        }
+        line = list.substr(0, list.find('\n'));
+        break;
+    case 202:
+        dsyslog("CDDB no match for %08x", discid);
+        return CDDB_NOT_FOUND;
+    default:
+        esyslog("%s %d CDDB query failed: %s",
+                __FILE__, __LINE__, line.c_str());
+        return CDDB_ERROR;
+    }
+    if (sscanf(line.c_str(), "%63s %x", category, &matchid) != 2) {
+        esyslog("%s %d CDDB invalid match: %s",
+                __FILE__, __LINE__, line.c_str());
+        return CDDB_ERROR;
+    }
+    // The category becomes a directory of the cache, only known ones
+    catidx = FindCategory(category);
+    if (catidx < 0) {
+        esyslog("%s %d CDDB unknown category: %s",
+                __FILE__, __LINE__, line.c_str());
+        return CDDB_ERROR;
+    }
+    catname = CddbCategories[catidx];
+
+    snprintf(buf, sizeof(buf), " %08x", matchid);
+    res = Command(std::string("cddb read ") + catname + buf, code, line);
+    if (res != CDDB_OK) {
+        return res;
+    }
+    if (code == 401) {
+        return CDDB_NOT_FOUND;
+    }
+    if (code != 210) {
+        esyslog("%s %d CDDB read failed: %s",
+                __FILE__, __LINE__, line.c_str());
+        return CDDB_ERROR;
+    }
+    res = ReadData(xmcd);
+    if (res != CDDB_OK) {
+        return res;
+    }
+    if (!ParseXmcd(xmcd, offsets.size(), disc)) {
+        esyslog("%s %d CDDB invalid entry %s %08x",
+                __FILE__, __LINE__, catname, matchid);
+        return CDDB_NOT_FOUND;
+    }
+    disc.mCategory = catname;
+    return CDDB_FOUND;
+}
+
+bool cCddbClient::CacheRead(unsigned int discid, int numtracks,
+                            CDDB_DISC_T &disc)
+{
+    char name[16];
+    char buf[4096];
+    size_t len;
+    FILE *fp;
+
+    snprintf(name, sizeof(name), "%08x", discid);
+    for (int i = 0; CddbCategories[i] != NULL; i++) {
+        std::string path = mCacheDir + "/" + CddbCategories[i] + "/" + name;
+        std::string xmcd;
+        fp = fopen(path.c_str(), "r");
+        if (fp == NULL) {
+            continue;
+        }
+        while ((len = fread(buf, 1, sizeof(buf), fp)) > 0) {
+            xmcd.append(buf, len);
+        }
+        fclose(fp);
+        if (ParseXmcd(xmcd, numtracks, disc)) {
+            disc.mCategory = CddbCategories[i];
+            dsyslog("CDDB cache hit %s", path.c_str());
+            return true;
+        }
+    }
+    return false;
+}
+
+void cCddbClient::CacheWrite(const CDDB_DISC_T &disc, const std::string &xmcd)
+{
+    char name[16];
+    FILE *fp;
+
+    if (FindCategory(disc.mCategory) < 0) {
+        esyslog("%s %d CDDB unknown category %s not cached",
+                __FILE__, __LINE__, disc.mCategory.c_str());
+        return;
+    }
+    snprintf(name, sizeof(name), "%08x", disc.mDiscId);
+    std::string path = mCacheDir + "/" + disc.mCategory + "/" + name;
+    if (!MakeDirs(path.c_str(), false)) {
+        esyslog("%s %d CDDB can not create cache directory for %s",
+                __FILE__, __LINE__, path.c_str());
+        return;
+    }
+    fp = fopen(path.c_str(), "w");
+    if (fp == NULL) {
+        esyslog("%s %d CDDB can not write %s", __FILE__, __LINE__,
+                path.c_str());
+        return;
+    }
+    fwrite(xmcd.data(), 1, xmcd.size(), fp);
+    fclose(fp);
+}
+
+CDDB_RESULT_T cCddbClient::Lookup(const std::vector<int> &offsets, int length,
+                                  CDDB_DISC_T &disc)
+{
+    cMutexLock MutexLock(&mMutex);
+    unsigned int discid = CalcDiscId(offsets, length);
+    std::map<unsigned int, time_t>::iterator it;
+    CDDB_RESULT_T res = CDDB_ERROR;
+    std::string xmcd;
+    bool reused;
+
+    if (mCacheEnabled && CacheRead(discid, offsets.size(), disc)) {
+        disc.mDiscId = discid;
+        return CDDB_FOUND;
+    }
+    it = mNegCache.find(discid);
+    if (it != mNegCache.end()) {
+        if (time(NULL) - it->second < CDDB_NEGATIVE_TTL) {
+            dsyslog("CDDB %08x is known to be unknown", discid);
+            return CDDB_NOT_FOUND;
+        }
+        mNegCache.erase(it);
+    }
+    if (mHost.empty()) {
+        return CDDB_NOT_FOUND;
+    }
+
+    dsyslog("CDDB lookup %08x on %s", discid, mHost.c_str());
+    mDeadline = cTimeMs::Now() + CDDB_REQUEST_TIMEOUT_MS;
+    // The server may have closed a kept connection meanwhile, in this case
+    // retry once with a new connection.
+    for (int attempt = 0; attempt < 2; attempt++) {
+        reused = (mSocket >= 0);
+        res = CDDB_OK;
+        if (!reused) {
+            res = Connect();
+            if (res == CDDB_OK) {
+                res = Handshake();
+            }
+        }
+        if (res == CDDB_OK) {
+            res = Query(offsets, length, discid, disc, xmcd);
+        }
+        if ((res == CDDB_ERROR) || (res == CDDB_CANCELLED)) {
+            Disconnect();
+        }
+        if ((res != CDDB_ERROR) || !reused) {
+            break;
+        }
+    }
+    DrainCancel();
+
+    disc.mDiscId = discid;
+    if (res == CDDB_FOUND) {
+        if (mCacheEnabled) {
+            CacheWrite(disc, xmcd);
+        }
+    }
+    else if (res == CDDB_NOT_FOUND) {
+        mNegCache[discid] = time(NULL);
+    }
+    return res;
+}
+
+unsigned int cCddbClient::CalcDiscId(const std::vector<int> &offsets,
+                                     int length)
+{
+    unsigned int sum = 0;
+    int secs;
+
+    if (offsets.empty()) {
+        return 0;
+    }
+    for (unsigned int i = 0; i < offsets.size(); i++) {
+        secs = offsets[i] / CDIO_CD_FRAMES_PER_SEC;
+        do {
+            sum += secs % 10;
+            secs /= 10;
+        } while (secs > 0);
+    }
+    return ((sum % 0xff) << 24) |
+           ((length - offsets[0] / CDIO_CD_FRAMES_PER_SEC) << 8) |
+           offsets.size();
+}
+
+bool cCddbClient::ParseXmcd(const std::string &xmcd, int numtracks,
+                            CDDB_DISC_T &disc)
+{
+    std::string::size_type pos = 0;
+    std::string::size_type end;
+    std::string dtitle;
+    std::vector<std::string> ttitle(numtracks);
+
+    disc.mGenre.clear();
+    while (pos < xmcd.size()) {
+        end = xmcd.find('\n', pos);
+        if (end == std::string::npos) {
+            end = xmcd.size();
+        }
+        std::string line = xmcd.substr(pos, end - pos);
+        pos = end + 1;
+        if (!line.empty() && (line[line.size() - 1] == '\r')) {
+            line.erase(line.size() - 1);
+        }
+        if (line.empty() || (line[0] == '#')) {
+            continue;
+        }
+        std::string::size_type eq = line.find('=');
+        if (eq == std::string::npos) {
+            continue;
+        }
+        std::string key = line.substr(0, eq);
+        std::string val = line.substr(eq + 1);
+        // Long values are split over several lines with the same key
+        if (key == "DTITLE") {
+            dtitle += val;
+        }
+        else if (key == "DGENRE") {
+            disc.mGenre += val;
+        }
+        else if (key.compare(0, 6, "TTITLE") == 0) {
+            int n = atoi(key.c_str() + 6);
+            if ((n >= 0) && (n < numtracks)) {
+                ttitle[n] += val;
+            }
+        }
+    }
+    if (dtitle.empty()) {
+        return false;
+    }
+    SplitTitle(dtitle, disc.mArtist, disc.mTitle);
+    disc.mTrackArtist.resize(numtracks);
+    disc.mTrackTitle.resize(numtracks);
+    for (int i = 0; i < numtracks; i++) {
+        // Compilations use "Artist / Title" for the tracks
+        if (ttitle[i].find(" / ") != std::string::npos) {
+            SplitTitle(ttitle[i], disc.mTrackArtist[i], disc.mTrackTitle[i]);
+        }
+        else {
+            disc.mTrackArtist[i] = disc.mArtist;
+            disc.mTrackTitle[i] = ttitle[i];
+        }
+    }
+    return true;
+}
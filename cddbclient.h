@@ -0,0 +1,108 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements a CDDBP client. All socket operations are non
+ * blocking with a deadline per lookup and can be aborted at any time from
+ * another thread. The connection is kept open for the next lookup. Results
+ * are cached in xmcd files using the same layout as libcddb
+ * (<cachedir>/<category>/<discid>).
+ */
+
+#ifndef __CDDBCLIENT_H__
+#define __CDDBCLIENT_H__
+
+#include <sys/socket.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+#include <stdint.h>
+
+#define CDDB_DEFAULT_PORT       8880
+#define CDDB_CONNECT_TIMEOUT_MS 5000
+#define CDDB_REQUEST_TIMEOUT_MS 15000
+#define CDDB_NEGATIVE_TTL       3600    // Seconds to remember unknown discs
+#define CDDB_RETRY_MIN_MS       10000   // First retry after network errors
+#define CDDB_RETRY_MAX_MS       (15 * 60 * 1000)
+
+typedef enum _cddb_result {
+    CDDB_OK,            // Step succeeded (internal)
+    CDDB_FOUND,
+    CDDB_NOT_FOUND,
+    CDDB_ERROR,         // Network or protocol error, retry later
+    CDDB_CANCELLED
+} CDDB_RESULT_T;
+
+typedef struct _cddb_disc {
+    unsigned int mDiscId;
+    std::string mCategory;
+    std::string mArtist;
+    std::string mTitle;
+    std::string mGenre;
+    std::vector<std::string> mTrackArtist;
+    std::vector<std::string> mTrackTitle;
+} CDDB_DISC_T;
+
+class cCddbClient {
+private:
+    cMutex mMutex;          // Only one lookup at a time
+    int mSocket;
+    int mCancelPipe[2];
+    std::string mHost;
+    int mPort;
+    bool mResolved;
+    struct sockaddr_storage mAddr;
+    socklen_t mAddrLen;
+    std::string mRecvBuf;
+    uint64_t mDeadline;     // End of the current lookup in ms
+    std::string mCacheDir;
+    bool mCacheEnabled;
+    std::map<unsigned int, time_t> mNegCache;
+
+    bool Resolve(void);
+    CDDB_RESULT_T Connect(void);
+    void Disconnect(void);
+    void DrainCancel(void);
+    CDDB_RESULT_T WaitFd(short events);
+    CDDB_RESULT_T SendLine(const std::string &line);
+    CDDB_RESULT_T ReadLine(std::string &line);
+    CDDB_RESULT_T Command(const std::string &cmd, int &code, std::string &line);
+    CDDB_RESULT_T ReadData(std::string &data);
+    CDDB_RESULT_T Handshake(void);
+    CDDB_RESULT_T Query(const std::vector<int> &offsets, int length,
+                        unsigned int discid, CDDB_DISC_T &disc,
+                        std::string &xmcd);
+    bool CacheRead(unsigned int discid, int numtracks, CDDB_DISC_T &disc);
+    void CacheWrite(const CDDB_DISC_T &disc, const std::string &xmcd);
+public:
+    cCddbClient(void);
+    ~cCddbClient();
+    // Server as host or host:port
+    void SetServer(const std::string &server);
+    void SetCache(const std::string &dir, bool enabled);
+
+    // Look up a disc. offsets are the frame offsets (LBA including the
+    // 150 frames lead-in) of all tracks, length is the disc length in
+    // seconds. Blocks at most CDDB_REQUEST_TIMEOUT_MS.
+    CDDB_RESULT_T Lookup(const std::vector<int> &offsets, int length,
+                         CDDB_DISC_T &disc);
+    // Abort a running lookup, may be called from any thread
+    void Abort(void);
+
+    // Names of the CDDB categories, NULL if idx is out of range
+    static const char *GetCategory(int idx);
+    static int FindCategory(const std::string &name);
+    static unsigned int CalcDiscId(const std::vector<int> &offsets,
+                                   int length);
+    static bool ParseXmcd(const std::string &xmcd, int numtracks,
+                          CDDB_DISC_T &disc);
+};
+
+#endif
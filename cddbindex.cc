@@ -0,0 +1,502 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements an offline CDDB database.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vdr/tools.h>
+#include "cddbindex.h"
+#include "cdplayer.h"
+
+// Sort entries by disc id
+static bool CompareDiscId(const CDDB_IDX_ENTRY_T &a, const CDDB_IDX_ENTRY_T &b)
+{
+    return a.mDiscId < b.mDiscId;
+}
+
+// Sort entry numbers by number of tracks and disc length
+class cCompareTracks {
+private:
+    const std::vector<CDDB_IDX_ENTRY_T> &mEntries;
+public:
+    cCompareTracks(const std::vector<CDDB_IDX_ENTRY_T> &entries)
+        : mEntries(entries) {}
+    bool operator()(uint32_t a, uint32_t b) const {
+        if (mEntries[a].mTracks != mEntries[b].mTracks) {
+            return mEntries[a].mTracks < mEntries[b].mTracks;
+        }
+        return mEntries[a].mLength < mEntries[b].mLength;
+    }
+};
+
+static bool ReadFile(const std::string &path, std::string &data)
+{
+    char buf[4096];
+    size_t len;
+    FILE *fp = fopen(path.c_str(), "r");
+
+    if (fp == NULL) {
+        return false;
+    }
+    data.clear();
+    while ((len = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        data.append(buf, len);
+    }
+    fclose(fp);
+    return true;
+}
+
+cCddbIndex::cCddbIndex(void)
+    : cThread("cdplayer cddb import"), mMap(NULL), mMapLen(0), mHeader(NULL),
+      mEntries(NULL), mByTracks(NULL), mOffsets(NULL), mData(NULL),
+      mNewData(NULL), mNewDataLen(0), mImported(0), mSkipped(0)
+{
+}
+
+cCddbIndex::~cCddbIndex()
+{
+    Cancel(10);
+    cMutexLock MutexLock(&mMutex);
+    Unmap();
+}
+
+// Must be called with locked mMutex
+void cCddbIndex::Unmap(void)
+{
+    if (mMap != NULL) {
+        munmap(mMap, mMapLen);
+    }
+    mMap = NULL;
+    mMapLen = 0;
+    mHeader = NULL;
+    mEntries = NULL;
+    mByTracks = NULL;
+    mOffsets = NULL;
+    mData = NULL;
+}
+
+bool cCddbIndex::Open(const std::string &filename)
+{
+    cMutexLock MutexLock(&mMutex);
+    const CDDB_IDX_HEADER_T *hdr;
+    struct stat st;
+    void *map;
+    int fd;
+
+    Unmap();
+    mFileName = filename;
+    fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            esyslog("%s %d can not open CDDB index %s: %d",
+                    __FILE__, __LINE__, filename.c_str(), errno);
+        }
+        return false;
+    }
+    if ((fstat(fd, &st) < 0) ||
+        (st.st_size < (off_t)sizeof(CDDB_IDX_HEADER_T))) {
+        esyslog("%s %d invalid CDDB index %s",
+                __FILE__, __LINE__, filename.c_str());
+        close(fd);
+        return false;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        esyslog("%s %d mmap of CDDB index %s failed: %d",
+                __FILE__, __LINE__, filename.c_str(), errno);
+        return false;
+    }
+    mMap = (uint8_t *)map;
+    mMapLen = st.st_size;
+
+    hdr = (const CDDB_IDX_HEADER_T *)mMap;
+    if ((memcmp(hdr->mMagic, CDDB_IDX_MAGIC, sizeof(CDDB_IDX_MAGIC)) != 0) ||
+        (hdr->mFileSize != mMapLen) ||
+        (hdr->mEntryPos + (uint64_t)hdr->mEntries * sizeof(CDDB_IDX_ENTRY_T) >
+         hdr->mByTracksPos) ||
+        (hdr->mByTracksPos + (uint64_t)hdr->mEntries * sizeof(uint32_t) >
+         hdr->mOffsetPos) ||
+        (hdr->mOffsetPos + (uint64_t)hdr->mNumOffsets * sizeof(uint32_t) >
+         hdr->mDataPos) ||
+        (hdr->mDataPos > mMapLen)) {
+        esyslog("%s %d invalid CDDB index %s",
+                __FILE__, __LINE__, filename.c_str());
+        Unmap();
+        return false;
+    }
+    mHeader = hdr;
+    mEntries = (const CDDB_IDX_ENTRY_T *)(mMap + hdr->mEntryPos);
+    mByTracks = (const uint32_t *)(mMap + hdr->mByTracksPos);
+    mOffsets = (const uint32_t *)(mMap + hdr->mOffsetPos);
+    mData = (const char *)(mMap + hdr->mDataPos);
+    isyslog("CDDB index %s with %u entries", filename.c_str(), hdr->mEntries);
+    return true;
+}
+
+int cCddbIndex::GetNumEntries(void)
+{
+    cMutexLock MutexLock(&mMutex);
+    return (mHeader != NULL) ? mHeader->mEntries : 0;
+}
+
+// Sum of the offset differences, -1 if the TOC does not match
+int cCddbIndex::TocDiff(const CDDB_IDX_ENTRY_T &e,
+                        const std::vector<int> &offsets) const
+{
+    int sum = 0;
+    int diff;
+
+    if ((e.mTracks != offsets.size()) ||
+        (e.mOffsets + e.mTracks > mHeader->mNumOffsets)) {
+        return -1;
+    }
+    for (unsigned int i = 0; i < offsets.size(); i++) {
+        diff = abs((int)mOffsets[e.mOffsets + i] - offsets[i]);
+        if (diff > CDDB_FUZZY_FRAMES) {
+            return -1;
+        }
+        sum += diff;
+    }
+    return sum;
+}
+
+bool cCddbIndex::Lookup(const std::vector<int> &offsets, int length,
+                        CDDB_DISC_T &disc)
+{
+    cMutexLock MutexLock(&mMutex);
+    unsigned int discid;
+    uint32_t lo, hi, mid;
+    uint32_t count;
+    uint32_t tracks = offsets.size();
+    int best = -1;
+    int bestdiff = 0;
+    int diff;
+
+    if ((mHeader == NULL) || offsets.empty()) {
+        return false;
+    }
+    count = mHeader->mEntries;
+    discid = cCddbClient::CalcDiscId(offsets, length);
+
+    // Entries with the same disc id
+    lo = 0;
+    hi = count;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (mEntries[mid].mDiscId < discid) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    for (; (lo < count) && (mEntries[lo].mDiscId == discid); lo++) {
+        diff = TocDiff(mEntries[lo], offsets);
+        if ((diff >= 0) && ((best < 0) || (diff < bestdiff))) {
+            best = lo;
+            bestdiff = diff;
+        }
+    }
+
+    // Fuzzy match: same number of tracks and about the same length
+    if (best < 0) {
+        uint32_t minlen = (length > CDDB_FUZZY_SECS) ?
+                          length - CDDB_FUZZY_SECS : 0;
+        lo = 0;
+        hi = count;
+        while (lo < hi) {
+            mid = lo + (hi - lo) / 2;
+            if (mByTracks[mid] >= count) {
+                return false;
+            }
+            const CDDB_IDX_ENTRY_T &e = mEntries[mByTracks[mid]];
+            if ((e.mTracks < tracks) ||
+                ((e.mTracks == tracks) && (e.mLength < minlen))) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        for (; lo < count; lo++) {
+            uint32_t idx = mByTracks[lo];
+            if (idx >= count) {
+                break;
+            }
+            const CDDB_IDX_ENTRY_T &e = mEntries[idx];
+            if ((e.mTracks != tracks) ||
+                ((int)e.mLength > length + CDDB_FUZZY_SECS)) {
+                break;
+            }
+            diff = TocDiff(e, offsets);
+            if ((diff >= 0) && ((best < 0) || (diff < bestdiff))) {
+                best = idx;
+                bestdiff = diff;
+            }
+        }
+    }
+    if (best < 0) {
+        return false;
+    }
+
+    const CDDB_IDX_ENTRY_T &e = mEntries[best];
+    if (e.mData + e.mDataLen > mHeader->mFileSize - mHeader->mDataPos) {
+        return false;
+    }
+    std::string xmcd(mData + e.mData, e.mDataLen);
+    if (!cCddbClient::ParseXmcd(xmcd, tracks, disc)) {
+        return false;
+    }
+    disc.mCategory = NotNull(cCddbClient::GetCategory(e.mCategory));
+    disc.mDiscId = discid;
+    dsyslog("CDDB index match %08x for %08x, difference %d frames",
+            e.mDiscId, discid, bestdiff);
+    return true;
+}
+
+bool cCddbIndex::StartImport(const std::string &dir)
+{
+    if (Active() || mFileName.empty()) {
+        return false;
+    }
+    mImportDir = dir;
+    Start();
+    return true;
+}
+
+void cCddbIndex::Action(void)
+{
+    if (Import()) {
+        Open(mFileName);
+    }
+}
+
+// Add one xmcd file. Only the TOC, the disc ids and the titles are kept.
+void cCddbIndex::ImportFile(const std::string &path, int category)
+{
+    std::string::size_type pos = 0;
+    std::string::size_type end;
+    std::string xmcd;
+    std::string text;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> discids;
+    bool intoc = false;
+    int length = 0;
+    int val;
+
+    if (!ReadFile(path, xmcd)) {
+        mSkipped++;
+        return;
+    }
+    while (pos < xmcd.size()) {
+        end = xmcd.find('\n', pos);
+        if (end == std::string::npos) {
+            end = xmcd.size();
+        }
+        std::string line = xmcd.substr(pos, end - pos);
+        pos = end + 1;
+        if (!line.empty() && (line[line.size() - 1] == '\r')) {
+            line.erase(line.size() - 1);
+        }
+        if (line.compare(0, 1, "#") == 0) {
+            if (line.find("Track frame offsets") != std::string::npos) {
+                intoc = true;
+            }
+            else if (intoc && (sscanf(line.c_str() + 1, "%d", &val) == 1)) {
+                offsets.push_back(val);
+            }
+            else {
+                intoc = false;
+                sscanf(line.c_str(), "# Disc length: %d", &length);
+            }
+        }
+        else if (line.compare(0, 7, "DISCID=") == 0) {
+            const char *p = line.c_str() + 7;
+            char *next;
+            for (;;) {
+                unsigned long id = strtoul(p, &next, 16);
+                if (next == p) {
+                    break;
+                }
+                discids.push_back(id);
+                p = next;
+                while ((*p == ',') || (*p == ' ')) {
+                    p++;
+                }
+            }
+        }
+        else if ((line.compare(0, 7, "DTITLE=") == 0) ||
+                 (line.compare(0, 6, "DYEAR=") == 0) ||
+                 (line.compare(0, 7, "DGENRE=") == 0) ||
+                 (line.compare(0, 6, "TTITLE") == 0)) {
+            text += line + "\n";
+        }
+    }
+    if (offsets.empty() || discids.empty() || (length <= 0) ||
+        (offsets.size() > 0xffff) || text.empty()) {
+        mSkipped++;
+        return;
+    }
+    if (fwrite(text.data(), 1, text.size(), mNewData) != text.size()) {
+        mSkipped++;
+        return;
+    }
+    for (unsigned int i = 0; i < discids.size(); i++) {
+        CDDB_IDX_ENTRY_T e;
+        memset(&e, 0, sizeof(e));
+        e.mDiscId = discids[i];
+        e.mTracks = offsets.size();
+        e.mCategory = category;
+        e.mLength = length;
+        e.mOffsets = mNewOffsets.size();
+        e.mDataLen = text.size();
+        e.mData = mNewDataLen;
+        mNewEntries.push_back(e);
+    }
+    mNewOffsets.insert(mNewOffsets.end(), offsets.begin(), offsets.end());
+    mNewDataLen += text.size();
+    mImported++;
+}
+
+void cCddbIndex::ImportDir(const std::string &dir, int category)
+{
+    cReadDir d(dir.c_str());
+    struct dirent *e;
+
+    if (!d.Ok()) {
+        esyslog("%s %d can not read %s", __FILE__, __LINE__, dir.c_str());
+        return;
+    }
+    while (((e = d.Next()) != NULL) && Running()) {
+        ImportFile(dir + "/" + e->d_name, category);
+    }
+}
+
+// Read all xmcd files of mImportDir. Subdirectories are the categories,
+// files in mImportDir itself are sorted to "misc".
+bool cCddbIndex::Import(void)
+{
+    std::string tmpname = mFileName + ".tmp";
+    std::string dataname = mFileName + ".data";
+    std::vector<uint32_t> bytracks;
+    CDDB_IDX_HEADER_T hdr;
+    cReadDir d(mImportDir.c_str());
+    struct dirent *e;
+    struct stat st;
+    char buf[65536];
+    size_t len;
+    bool ok = true;
+    FILE *fp;
+
+    isyslog("CDDB import of %s started", mImportDir.c_str());
+    if (!d.Ok()) {
+        esyslog("%s %d can not read %s",
+                __FILE__, __LINE__, mImportDir.c_str());
+        return false;
+    }
+    mNewData = fopen(dataname.c_str(), "w+");
+    if (mNewData == NULL) {
+        esyslog("%s %d can not create %s",
+                __FILE__, __LINE__, dataname.c_str());
+        return false;
+    }
+    mNewDataLen = 0;
+    mImported = 0;
+    mSkipped = 0;
+    while (((e = d.Next()) != NULL) && Running()) {
+        std::string path = mImportDir + "/" + e->d_name;
+        if (stat(path.c_str(), &st) < 0) {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            int category = cCddbClient::FindCategory(e->d_name);
+            if (category < 0) {
+                dsyslog("CDDB import skips unknown category %s", e->d_name);
+                continue;
+            }
+            ImportDir(path, category);
+        }
+        else if (S_ISREG(st.st_mode)) {
+            ImportFile(path, cCddbClient::FindCategory("misc"));
+        }
+    }
+    if (!Running()) {
+        ok = false;
+    }
+
+    std::sort(mNewEntries.begin(), mNewEntries.end(), CompareDiscId);
+    for (uint32_t i = 0; i < mNewEntries.size(); i++) {
+        bytracks.push_back(i);
+    }
+    std::sort(bytracks.begin(), bytracks.end(), cCompareTracks(mNewEntries));
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.mMagic, CDDB_IDX_MAGIC, sizeof(CDDB_IDX_MAGIC));
+    hdr.mEntries = mNewEntries.size();
+    hdr.mNumOffsets = mNewOffsets.size();
+    hdr.mEntryPos = sizeof(hdr);
+    hdr.mByTracksPos = hdr.mEntryPos +
+                       (uint64_t)hdr.mEntries * sizeof(CDDB_IDX_ENTRY_T);
+    hdr.mOffsetPos = hdr.mByTracksPos +
+                     (uint64_t)hdr.mEntries * sizeof(uint32_t);
+    hdr.mDataPos = hdr.mOffsetPos +
+                   (uint64_t)hdr.mNumOffsets * sizeof(uint32_t);
+    hdr.mFileSize = hdr.mDataPos + mNewDataLen;
+
+    fp = ok ? fopen(tmpname.c_str(), "w") : NULL;
+    if (fp != NULL) {
+        ok = (fwrite(&hdr, sizeof(hdr), 1, fp) == 1);
+        if (ok && !mNewEntries.empty()) {
+            ok = (fwrite(&mNewEntries[0], sizeof(CDDB_IDX_ENTRY_T),
+                         mNewEntries.size(), fp) == mNewEntries.size()) &&
+                 (fwrite(&bytracks[0], sizeof(uint32_t),
+                         bytracks.size(), fp) == bytracks.size()) &&
+                 (fwrite(&mNewOffsets[0], sizeof(uint32_t),
+                         mNewOffsets.size(), fp) == mNewOffsets.size());
+        }
+        rewind(mNewData);
+        while (ok && ((len = fread(buf, 1, sizeof(buf), mNewData)) > 0)) {
+            ok = (fwrite(buf, 1, len, fp) == len);
+        }
+        if (fclose(fp) != 0) {
+            ok = false;
+        }
+    }
+    else {
+        ok = false;
+    }
+    fclose(mNewData);
+    mNewData = NULL;
+    unlink(dataname.c_str());
+    std::vector<CDDB_IDX_ENTRY_T>().swap(mNewEntries);
+    std::vector<uint32_t>().swap(mNewOffsets);
+
+    if (ok && (rename(tmpname.c_str(), mFileName.c_str()) < 0)) {
+        ok = false;
+    }
+    if (!ok) {
+        esyslog("%s %d CDDB import into %s failed",
+                __FILE__, __LINE__, mFileName.c_str());
+        unlink(tmpname.c_str());
+        return false;
+    }
+    isyslog("CDDB import finished, %d discs imported, %d files skipped",
+            mImported, mSkipped);
+    return true;
+}
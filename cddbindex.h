@@ -0,0 +1,99 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements an offline CDDB database. A freedb/gnudb dump or
+ * a directory of xmcd files (<dir>/<category>/<discid>) is imported into
+ * a single index file which is memory mapped for lookups.
+ *
+ * File layout:
+ *   CDDB_IDX_HEADER_T
+ *   CDDB_IDX_ENTRY_T[mEntries]   sorted by disc id
+ *   uint32_t[mEntries]           entry numbers sorted by tracks, length
+ *   uint32_t[mNumOffsets]        track frame offsets of all entries
+ *   char[]                       reduced xmcd text of all entries
+ */
+
+#ifndef __CDDBINDEX_H__
+#define __CDDBINDEX_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <vdr/thread.h>
+#include "cddbclient.h"
+
+#define CDDB_IDX_MAGIC        "CDPIDX1"
+#define CDDB_FUZZY_SECS       4           // Allowed difference of disc length
+#define CDDB_FUZZY_FRAMES     (4 * 75)    // Allowed difference per track
+
+typedef struct _cddb_idx_header {
+    char mMagic[8];
+    uint32_t mEntries;
+    uint32_t mNumOffsets;
+    uint64_t mEntryPos;
+    uint64_t mByTracksPos;
+    uint64_t mOffsetPos;
+    uint64_t mDataPos;
+    uint64_t mFileSize;
+} CDDB_IDX_HEADER_T;
+
+typedef struct _cddb_idx_entry {
+    uint32_t mDiscId;
+    uint16_t mTracks;
+    uint8_t mCategory;      // Index for cCddbClient::GetCategory
+    uint8_t mReserved;
+    uint32_t mLength;       // Disc length in seconds
+    uint32_t mOffsets;      // Index of the first track offset
+    uint32_t mDataLen;
+    uint64_t mData;         // Position of the text in the data area
+} CDDB_IDX_ENTRY_T;
+
+class cCddbIndex: public cThread {
+private:
+    cMutex mMutex;          // Protects the mapping
+    std::string mFileName;
+    std::string mImportDir;
+    uint8_t *mMap;
+    size_t mMapLen;
+    const CDDB_IDX_HEADER_T *mHeader;
+    const CDDB_IDX_ENTRY_T *mEntries;
+    const uint32_t *mByTracks;
+    const uint32_t *mOffsets;
+    const char *mData;
+
+    // Import state
+    std::vector<CDDB_IDX_ENTRY_T> mNewEntries;
+    std::vector<uint32_t> mNewOffsets;
+    FILE *mNewData;
+    uint64_t mNewDataLen;
+    int mImported;
+    int mSkipped;
+
+    int TocDiff(const CDDB_IDX_ENTRY_T &e,
+                const std::vector<int> &offsets) const;
+    void Unmap(void);
+    void ImportDir(const std::string &dir, int category);
+    void ImportFile(const std::string &path, int category);
+    bool Import(void);
+protected:
+    virtual void Action(void);
+public:
+    cCddbIndex(void);
+    virtual ~cCddbIndex();
+    // Map the index file, a missing file is no error
+    bool Open(const std::string &filename);
+    // Search a disc by id and TOC, allows small differences of the TOC
+    bool Lookup(const std::vector<int> &offsets, int length,
+                CDDB_DISC_T &disc);
+    // Import dir into the index file in the background
+    bool StartImport(const std::string &dir);
+    int GetNumEntries(void);
+};
+
+#endif
@@ -0,0 +1,457 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements acoustic fingerprints of the first seconds of
+ * each track and the local fingerprint index.
+ *
+ * Index file layout:
+ *   char[8]                            FP_INDEX_MAGIC
+ *   per entry:
+ *     uint16_t artist, title, album    Length of the strings
+ *     uint16_t frames                  Number of codes
+ *     char[]                           The strings without termination
+ *     uint32_t[frames]                 The codes
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <vdr/tools.h>
+#include "cdfingerprint.h"
+#include "cdmenu.h"
+#include "cdplayer.h"
+
+static uint64_t ThreadCpuUs(void)
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return 0;
+    }
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+cCpuBudget::cCpuBudget(int percent)
+{
+    mPercent = (percent < 1) ? 1 : percent;
+    mWallStart = cTimeMs::Now() * 1000;
+    mCpuStart = ThreadCpuUs();
+}
+
+void cCpuBudget::Check(void)
+{
+    uint64_t cpu = ThreadCpuUs() - mCpuStart;
+    uint64_t wall = cTimeMs::Now() * 1000 - mWallStart;
+    uint64_t allowed = cpu * 100 / mPercent;
+
+    if (allowed > wall + 1000) {
+        cCondWait::SleepMs((allowed - wall) / 1000);
+    }
+}
+
+//
+// Local fingerprint index
+//
+bool cFingerprintIndex::Open(const std::string &filename)
+{
+    cMutexLock MutexLock(&mMutex);
+    char magic[8];
+    uint16_t hdr[4];
+
+    mFileName = filename;
+    mEntries.clear();
+    FILE *fp = fopen(filename.c_str(), "rb");
+    if (fp == NULL) {
+        dsyslog("%s %d no fingerprint index %s",
+                __FILE__, __LINE__, filename.c_str());
+        return true;
+    }
+    if ((fread(magic, sizeof(magic), 1, fp) != 1) ||
+        (strncmp(magic, FP_INDEX_MAGIC, sizeof(magic)) != 0)) {
+        esyslog("%s %d %s is no fingerprint index",
+                __FILE__, __LINE__, filename.c_str());
+        fclose(fp);
+        return false;
+    }
+    // A partly written last entry is ignored
+    while (fread(hdr, sizeof(hdr), 1, fp) == 1) {
+        FP_ENTRY_T entry;
+        std::vector<char> txt(hdr[0] + hdr[1] + hdr[2] + 1);
+        entry.mCodes.resize(hdr[3]);
+        if ((fread(&txt[0], 1, txt.size() - 1, fp) != txt.size() - 1) ||
+            ((hdr[3] > 0) &&
+             (fread(&entry.mCodes[0], sizeof(uint32_t), hdr[3], fp) != hdr[3]))) {
+            break;
+        }
+        entry.mArtist.assign(&txt[0], hdr[0]);
+        entry.mTitle.assign(&txt[hdr[0]], hdr[1]);
+        entry.mAlbum.assign(&txt[hdr[0] + hdr[1]], hdr[2]);
+        mEntries.push_back(entry);
+    }
+    fclose(fp);
+    isyslog("cdplayer: %d fingerprints in %s", (int)mEntries.size(),
+            filename.c_str());
+    return true;
+}
+
+bool cFingerprintIndex::Add(const FP_ENTRY_T &entry)
+{
+    cMutexLock MutexLock(&mMutex);
+    uint16_t hdr[4];
+    bool ok;
+
+    if (mFileName.empty()) {
+        return false;
+    }
+    FILE *fp = fopen(mFileName.c_str(), "ab");
+    if (fp == NULL) {
+        esyslog("%s %d can not write %s: %m",
+                __FILE__, __LINE__, mFileName.c_str());
+        return false;
+    }
+    if (ftell(fp) == 0) {
+        char magic[8];
+        strncpy(magic, FP_INDEX_MAGIC, sizeof(magic));
+        fwrite(magic, sizeof(magic), 1, fp);
+    }
+    hdr[0] = entry.mArtist.size() & 0xffff;
+    hdr[1] = entry.mTitle.size() & 0xffff;
+    hdr[2] = entry.mAlbum.size() & 0xffff;
+    hdr[3] = entry.mCodes.size() & 0xffff;
+    ok = (fwrite(hdr, sizeof(hdr), 1, fp) == 1);
+    ok = ok && (fwrite(entry.mArtist.data(), 1, hdr[0], fp) == hdr[0]);
+    ok = ok && (fwrite(entry.mTitle.data(), 1, hdr[1], fp) == hdr[1]);
+    ok = ok && (fwrite(entry.mAlbum.data(), 1, hdr[2], fp) == hdr[2]);
+    ok = ok && ((hdr[3] == 0) ||
+                (fwrite(&entry.mCodes[0], sizeof(uint32_t), hdr[3], fp) == hdr[3]));
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        esyslog("%s %d write error %s", __FILE__, __LINE__, mFileName.c_str());
+        return false;
+    }
+    mEntries.push_back(entry);
+    return true;
+}
+
+int cFingerprintIndex::GetNumEntries(void)
+{
+    cMutexLock MutexLock(&mMutex);
+    return mEntries.size();
+}
+
+float cFingerprintIndex::Compare(const FINGERPRINT_T &a, const FINGERPRINT_T &b)
+{
+    float best = 1.0;
+    int na = a.size();
+    int nb = b.size();
+
+    for (int shift = -FP_MAX_SHIFT; shift <= FP_MAX_SHIFT; shift++) {
+        int start = (shift < 0) ? -shift : 0;
+        int end = (nb - shift < na) ? nb - shift : na;
+        int bits = 0;
+        int cnt = 0;
+        for (int i = start; i < end; i++) {
+            uint32_t ca = a[i];
+            uint32_t cb = b[i + shift];
+            // Silence in both is no evidence
+            if ((ca | cb) != 0) {
+                bits += __builtin_popcount(ca ^ cb);
+                cnt++;
+            }
+        }
+        if (cnt >= FP_MIN_FRAMES) {
+            float ber = (float)bits / (cnt * FP_BITS);
+            if (ber < best) {
+                best = ber;
+            }
+        }
+    }
+    return best;
+}
+
+bool cFingerprintIndex::Lookup(const FINGERPRINT_T &fp, FP_ENTRY_T &entry,
+                               cCpuBudget &budget)
+{
+    cMutexLock MutexLock(&mMutex);
+    float best = FP_MAX_BER;
+    int found = -1;
+
+    for (int i = 0; i < (int)mEntries.size(); i++) {
+        float ber = Compare(fp, mEntries[i].mCodes);
+        if (ber < best) {
+            best = ber;
+            found = i;
+        }
+        if ((i % 64) == 63) {
+            budget.Check();
+        }
+    }
+    if (found < 0) {
+        return false;
+    }
+    dsyslog("%s %d fingerprint match %s (%.3f)",
+            __FILE__, __LINE__, mEntries[found].mTitle.c_str(), best);
+    entry = mEntries[found];
+    return true;
+}
+
+//
+// Fingerprint calculation
+//
+cFingerprinter::cFingerprinter(cCdInfo &cdinfo) :
+    mCdInfo(cdinfo), mGeneration(0), mTextVersion(0),
+    mTrack(INVALID_TRACK_IDX), mBlocks(0), mNeeded(0), mBusy(false),
+    mFft(FP_FFT_SIZE), mFrame(FP_FFT_SIZE), mPower(FP_FFT_SIZE / 2 + 1),
+    mChromaBin(FP_FFT_SIZE / 2 + 1)
+{
+    mPcm = new uint8_t[FP_BLOCKS * CDIO_CD_FRAMESIZE_RAW];
+    mFirstBin = (FP_MIN_FREQ * FP_FFT_SIZE) / FP_SAMPLE_RATE;
+    mLastBin = (FP_MAX_FREQ * FP_FFT_SIZE) / FP_SAMPLE_RATE;
+    for (int k = 0; k <= FP_FFT_SIZE / 2; k++) {
+        mChromaBin[k] = -1;
+        if ((k >= mFirstBin) && (k <= mLastBin)) {
+            double freq = (double)k * FP_SAMPLE_RATE / FP_FFT_SIZE;
+            int note = (int)floor(12.0 * log2(freq / 440.0) + 69.5);
+            mChromaBin[k] = note % 12;
+        }
+    }
+}
+
+cFingerprinter::~cFingerprinter()
+{
+    Cancel(-1);
+    mMutex.Lock();
+    mCond.Broadcast();
+    mMutex.Unlock();
+    Cancel(3);
+    delete[] mPcm;
+}
+
+void cFingerprinter::Reset(int numtracks)
+{
+    cMutexLock MutexLock(&mMutex);
+    mGeneration++;
+    mState.assign(numtracks, FP_NONE);
+    mPrints.clear();
+    mPrints.resize(numtracks);
+    mTextVersion = 0;
+    if (!mBusy) {
+        mTrack = INVALID_TRACK_IDX;
+    }
+}
+
+// Collect the first FP_BLOCKS of a track which are read in one go. When
+// the reader jumps the track is skipped until it is read from its start.
+void cFingerprinter::DoFeed(TRACK_IDX_T track, lsn_t offset, lsn_t length,
+                            const uint8_t *data)
+{
+    if (cMenuCDPlayer::GetFingerprintCpu() == 0) {
+        return;
+    }
+    cMutexLock MutexLock(&mMutex);
+    if (mBusy || (track < 0) || (track >= (TRACK_IDX_T)mState.size()) ||
+        (mState[track] != FP_NONE)) {
+        return;
+    }
+    if (offset == 0) {
+        mTrack = track;
+        mBlocks = 0;
+        mNeeded = (length < FP_BLOCKS) ? length : FP_BLOCKS;
+    }
+    if ((track != mTrack) || (offset != mBlocks)) {
+        mTrack = INVALID_TRACK_IDX;
+        return;
+    }
+    memcpy(mPcm + mBlocks * CDIO_CD_FRAMESIZE_RAW, data, CDIO_CD_FRAMESIZE_RAW);
+    mBlocks++;
+    if (mBlocks >= mNeeded) {
+        mBusy = true;
+        mCond.Broadcast();
+    }
+}
+
+bool cFingerprinter::Analyze(int blocks, FINGERPRINT_T &fp, cCpuBudget &budget)
+{
+    int samples = blocks * CDIO_CD_FRAMESIZE_RAW / 4;
+    float prev[12];
+    int voiced = 0;
+
+    memset(prev, 0, sizeof(prev));
+    fp.clear();
+    for (int pos = 0; pos + FP_FFT_SIZE <= samples; pos += FP_HOP) {
+        // Little endian stereo to mono
+        const uint8_t *pcm = mPcm + pos * 4;
+        float *frame = &mFrame[0];
+        for (int i = 0; i < FP_FFT_SIZE; i++) {
+            int16_t l = pcm[4 * i] | (pcm[4 * i + 1] << 8);
+            int16_t r = pcm[4 * i + 2] | (pcm[4 * i + 3] << 8);
+            frame[i] = (l + r) * (0.5f / 32768.0f);
+        }
+        mFft.Power(frame, &mPower[0]);
+
+        float chroma[12];
+        float sum = 0;
+        memset(chroma, 0, sizeof(chroma));
+        for (int k = mFirstBin; k <= mLastBin; k++) {
+            chroma[mChromaBin[k]] += mPower[k];
+        }
+        for (int c = 0; c < 12; c++) {
+            sum += chroma[c];
+        }
+        uint32_t code = 0;
+        if (sum > FP_SILENCE) {
+            float mean = sum / 12;
+            for (int c = 0; c < 12; c++) {
+                if (chroma[c] > mean) {
+                    code |= 1 << c;
+                }
+                chroma[c] /= sum;
+                if (chroma[c] > prev[c]) {
+                    code |= 1 << (c + 12);
+                }
+                prev[c] = chroma[c];
+            }
+            voiced++;
+        }
+        else {
+            memset(prev, 0, sizeof(prev));
+        }
+        fp.push_back(code);
+        if ((fp.size() % 16) == 0) {
+            budget.Check();
+            if (!Running()) {
+                return false;
+            }
+        }
+    }
+    return voiced >= FP_MIN_FRAMES;
+}
+
+// Take the title of an unknown track from the index
+void cFingerprinter::Identify(TRACK_IDX_T track, unsigned int generation,
+                              const FINGERPRINT_T &fp, cCpuBudget &budget)
+{
+    cCdTextRef ref;
+    FP_ENTRY_T entry;
+
+    mCdInfo.GetCdText(ref);
+    if (*ref->GetTrack(track, CDTEXT_TITLE) != '\0') {
+        return;
+    }
+    if (!cPluginCdplayer::GetFingerprintIndex().Lookup(fp, entry, budget)) {
+        return;
+    }
+    cMutexLock MutexLock(&mMutex);
+    if (generation != mGeneration) {
+        return;
+    }
+    mState[track] = FP_IDENTIFIED;
+    mCdInfo.SetFingerprintText(track, entry.mArtist, entry.mTitle,
+                               entry.mAlbum);
+}
+
+// Add all tracks with fingerprint and known title to the index
+void cFingerprinter::Learn(void)
+{
+    std::vector<TRACK_IDX_T> tracks;
+    std::vector<FP_ENTRY_T> entries;
+    unsigned int generation;
+    cCdTextRef ref;
+
+    mMutex.Lock();
+    // The CD-Text can not be cleared while the lock is held
+    mCdInfo.GetCdText(ref);
+    if (ref->GetVersion() == mTextVersion) {
+        mMutex.Unlock();
+        return;
+    }
+    mTextVersion = ref->GetVersion();
+    generation = mGeneration;
+    for (TRACK_IDX_T i = 0; i < (TRACK_IDX_T)mState.size(); i++) {
+        if ((mState[i] != FP_DONE) ||
+            (*ref->GetTrack(i, CDTEXT_TITLE) == '\0')) {
+            continue;
+        }
+        FP_ENTRY_T entry;
+        entry.mArtist = ref->GetTrack(i, CDTEXT_PERFORMER);
+        if (entry.mArtist.empty()) {
+            entry.mArtist = ref->GetDisc(CDTEXT_PERFORMER);
+        }
+        entry.mTitle = ref->GetTrack(i, CDTEXT_TITLE);
+        entry.mAlbum = ref->GetDisc(CDTEXT_TITLE);
+        entry.mCodes = mPrints[i];
+        tracks.push_back(i);
+        entries.push_back(entry);
+    }
+    mMutex.Unlock();
+
+    cFingerprintIndex &index = cPluginCdplayer::GetFingerprintIndex();
+    cCpuBudget budget(cMenuCDPlayer::GetFingerprintCpu());
+    for (int i = 0; i < (int)entries.size(); i++) {
+        FP_ENTRY_T known;
+        if (!index.Lookup(entries[i].mCodes, known, budget) ||
+            (known.mTitle != entries[i].mTitle)) {
+            dsyslog("%s %d learn fingerprint %s",
+                    __FILE__, __LINE__, entries[i].mTitle.c_str());
+            index.Add(entries[i]);
+        }
+        cMutexLock MutexLock(&mMutex);
+        if (generation == mGeneration) {
+            mState[tracks[i]] = FP_LEARNED;
+        }
+    }
+}
+
+void cFingerprinter::Action(void)
+{
+    while (Running()) {
+        mMutex.Lock();
+        if (!mBusy) {
+            mCond.TimedWait(mMutex, 500);
+        }
+        if (!mBusy || !Running()) {
+            mMutex.Unlock();
+            // CD-Text or CDDB information may have arrived
+            if (Running() && (cMenuCDPlayer::GetFingerprintCpu() > 0)) {
+                Learn();
+            }
+            continue;
+        }
+        TRACK_IDX_T track = mTrack;
+        int blocks = mBlocks;
+        unsigned int generation = mGeneration;
+        mMutex.Unlock();
+
+        cCpuBudget budget(cMenuCDPlayer::GetFingerprintCpu());
+        FINGERPRINT_T fp;
+        bool ok = Analyze(blocks, fp, budget);
+        dsyslog("%s %d fingerprint track %d %s",
+                __FILE__, __LINE__, track, ok ? "done" : "failed");
+
+        mMutex.Lock();
+        if ((generation == mGeneration) && (track >= 0) &&
+            (track < (TRACK_IDX_T)mState.size())) {
+            mState[track] = ok ? FP_DONE : FP_FAILED;
+            mPrints[track] = fp;
+        }
+        else {
+            ok = false;
+        }
+        mBusy = false;
+        mTrack = INVALID_TRACK_IDX;
+        mTextVersion = 0;
+        mMutex.Unlock();
+
+        if (ok) {
+            Identify(track, generation, fp, budget);
+            Learn();
+        }
+    }
+}
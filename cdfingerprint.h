@@ -0,0 +1,136 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements acoustic fingerprints of the first seconds of
+ * each track. The reader thread copies the blocks, a background thread
+ * calculates chroma features and either learns the fingerprint of tracks
+ * with known title or identifies unknown tracks from the local index.
+ *
+ * Each fingerprint frame is a 24 bit code: bits 0-11 are set when the
+ * pitch class is above the average of the frame, bits 12-23 when it
+ * increased since the previous frame.
+ */
+
+#ifndef __CDFINGERPRINT_H__
+#define __CDFINGERPRINT_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <vdr/thread.h>
+#include "cdinfo.h"
+#include "fft.h"
+
+#define FP_INDEX_MAGIC   "CDPFP1"
+#define FP_SAMPLE_RATE   44100
+#define FP_FFT_SIZE      4096
+#define FP_HOP           (FP_FFT_SIZE / 2)
+#define FP_MIN_FREQ      200
+#define FP_MAX_FREQ      5000
+#define FP_SILENCE       1.0         // Minimum chroma power of a frame
+#define FP_SECONDS       12          // Analyzed seconds at start of track
+#define FP_BLOCKS        (FP_SECONDS * CDIO_CD_FRAMES_PER_SEC)
+#define FP_MIN_FRAMES    64          // Needed non silent frames (~3 s)
+#define FP_MAX_SHIFT     16          // Allowed start difference (~0.75 s)
+#define FP_BITS          24
+#define FP_MAX_BER       0.30        // Maximum bit error rate of a match
+
+typedef std::vector<uint32_t> FINGERPRINT_T;
+
+typedef struct _fp_entry {
+    std::string mArtist;
+    std::string mTitle;
+    std::string mAlbum;
+    FINGERPRINT_T mCodes;
+} FP_ENTRY_T;
+
+// Limits the CPU time of the calling thread to percent of one core
+class cCpuBudget {
+private:
+    int mPercent;
+    uint64_t mWallStart;    // us
+    uint64_t mCpuStart;     // us
+public:
+    cCpuBudget(int percent);
+    // Sleep when more than the budget was used since construction
+    void Check(void);
+};
+
+// Fingerprints of our own library, loaded into memory, new entries are
+// appended to the file.
+class cFingerprintIndex {
+private:
+    cMutex mMutex;
+    std::string mFileName;
+    std::vector<FP_ENTRY_T> mEntries;
+public:
+    // Load the index file, a missing file is no error
+    bool Open(const std::string &filename);
+    bool Add(const FP_ENTRY_T &entry);
+    // Find the best entry with a bit error rate below FP_MAX_BER
+    bool Lookup(const FINGERPRINT_T &fp, FP_ENTRY_T &entry,
+                cCpuBudget &budget);
+    int GetNumEntries(void);
+    // Bit error rate of the best alignment, 1.0 if not comparable
+    static float Compare(const FINGERPRINT_T &a, const FINGERPRINT_T &b);
+};
+
+class cFingerprinter: public cThread {
+private:
+    typedef enum _fp_state {
+        FP_NONE,
+        FP_DONE,        // Fingerprint available
+        FP_LEARNED,     // Added to or already in the index
+        FP_IDENTIFIED,  // Title taken from the index
+        FP_FAILED       // Too short or silent
+    } FP_STATE_T;
+
+    cCdInfo &mCdInfo;
+    cMutex mMutex;
+    cCondVar mCond;
+    unsigned int mGeneration;   // Incremented for each disc
+    std::vector<FP_STATE_T> mState;     // Per disc track
+    std::vector<FINGERPRINT_T> mPrints;
+    unsigned int mTextVersion;  // CD-Text version of the last Learn
+    uint8_t *mPcm;              // Collected blocks of mTrack
+    TRACK_IDX_T mTrack;
+    int mBlocks;
+    int mNeeded;
+    bool mBusy;                 // mPcm is analyzed, Feed must not write
+
+    cFft mFft;
+    std::vector<float> mFrame;
+    std::vector<float> mPower;
+    std::vector<signed char> mChromaBin; // Pitch class per bin, -1 unused
+    int mFirstBin;
+    int mLastBin;
+
+    bool Analyze(int blocks, FINGERPRINT_T &fp, cCpuBudget &budget);
+    void Identify(TRACK_IDX_T track, unsigned int generation,
+                  const FINGERPRINT_T &fp, cCpuBudget &budget);
+    void Learn(void);
+    void DoFeed(TRACK_IDX_T track, lsn_t offset, lsn_t length,
+                const uint8_t *data);
+protected:
+    virtual void Action(void);
+public:
+    cFingerprinter(cCdInfo &cdinfo);
+    virtual ~cFingerprinter();
+    // Start with a new disc, must be called before the CD info is cleared
+    void Reset(int numtracks);
+    // Called by the reader thread for each block, offset is the block
+    // number within the disc track.
+    void Feed(TRACK_IDX_T track, lsn_t offset, lsn_t length,
+              const uint8_t *data) {
+        if (offset < FP_BLOCKS) {
+            DoFeed(track, offset, length, data);
+        }
+    }
+};
+
+#endif
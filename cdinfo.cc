@@ -17,22 +17,6 @@
 /*
  * Trackinfo class holds information about a single track.
  */
-cTrackInfo::cTrackInfo(track_t TrackNo, lsn_t StartLsn, lsn_t EndLsn, lba_t lba,
-                          CD_TEXT_T CdTextFields)
-                          : mTrackNo(TrackNo), mStartLsn(StartLsn), mEndLsn(EndLsn),
-                            mLba(lba)
-{
-    SetCdTextFields (CdTextFields);
-}
-
-void cTrackInfo::SetCdTextFields (const CD_TEXT_T CdTextFields)
-{
-    int i;
-    for (i = 0; i < MAX_CDTEXT_FIELDS; i++) {
-        mCdTextFields[i] = CdTextFields[i];
-    }
-}
-
 void cTrackInfo::GetCDDATime(int *min, int *sec)
 {
     int s = GetTimeSecs();
@@ -46,9 +30,12 @@ void cTrackInfo::GetCDDATime(int *min, int *sec)
 void cCdInfo::Add(track_t TrackNo, lsn_t StartLsn, lsn_t EndLsn, lba_t lba,
                   CD_TEXT_T &CdTextFields)
 {
-    cTrackInfo ti(TrackNo, StartLsn, EndLsn, lba, CdTextFields);
+    cTrackInfo ti(TrackNo, StartLsn, EndLsn, lba);
     mTrackInfo.push_back(ti);
-    mPlayList.push_back(mLastTrackIdx);
+    {
+        cMutexLock MutexLock (&mInfoMutex);
+        mCdTextBuilder.SetTrack(mLastTrackIdx, CdTextFields);
+    }
     mLastTrackIdx++;
     AddData(lba);
 }
@@ -62,134 +49,191 @@ void cCdInfo::AddData(lba_t lba)
 
 void cCdInfo::SetCdInfo(const CD_TEXT_T CdTextFields) {
     cMutexLock MutexLock (&mInfoMutex);
-    int i;
-    for (i = 0; i < MAX_CDTEXT_FIELDS; i++) {
-        mCdText[i] = CdTextFields[i];
-    }
+    mCdTextBuilder.SetDisc(CdTextFields);
 }
 
-void cCdInfo::GetCdInfo(CD_TEXT_T &txt) {
+void cCdInfo::PublishCdText(void) {
     cMutexLock MutexLock (&mInfoMutex);
-    int i;
-    for (i = 0; i < MAX_CDTEXT_FIELDS; i++) {
-        txt[i] = mCdText[i];
+    mCdTextStore.Publish(mCdTextBuilder.Build());
+}
+
+void cCdInfo::GetCddbToc(std::vector<int> &offsets, int &length) {
+    offsets.clear();
+    for (TRACK_IDX_T i = 0; i < (TRACK_IDX_T)mCddbInfo.size(); i++) {
+        offsets.push_back(mCddbInfo[i].GetCDDALba());
     }
+    length = mLeadOut / CDIO_CD_FRAMES_PER_SEC;
 }
 
-void cCdInfo::GetCdTextFields(const TRACK_IDX_T track, CD_TEXT_T &CdTextFields)
-{
-    cMutexLock MutexLock(&mInfoMutex);
-    int i;
+unsigned int cCdInfo::GetCddbDiscId(void) {
+    std::vector<int> offsets;
+    int length;
 
-    if (track < (TRACK_IDX_T)mTrackInfo.size()) {
-        for (i = 0; i < MAX_CDTEXT_FIELDS; i++) {
-            CdTextFields[i] = mTrackInfo[track].mCdTextFields[i];
-        }
+    GetCddbToc(offsets, length);
+    return cCddbClient::CalcDiscId(offsets, length);
+}
+
+void cCdInfo::StopQuery(void) {
+    if (Active()) {
+        mStopQuery = true;
+        cPluginCdplayer::GetCddbClient().Abort();
+        mRetryWait.Signal();
+        Cancel(3);
     }
 }
 
+// Query CDDB until an entry is found or the disc is known to be unknown.
+// After network errors the query is repeated with increasing delay.
 void cCdInfo::Action(void) {
-    while (!mCddbInfoAvail) {
-        Query();
-        cCondWait::SleepMs(10000);
+    std::vector<int> offsets;
+    int length;
+    int delay = CDDB_RETRY_MIN_MS;
+    CDDB_RESULT_T res;
+
+    GetCddbToc(offsets, length);
+    dsyslog("CDDB Query started");
+    {
+        CDDB_DISC_T disc;
+        if (cPluginCdplayer::GetCddbIndex().Lookup(offsets, length, disc)) {
+            SetCddbText(disc);
+            return;
+        }
     }
+    while (Running() && !mStopQuery) {
+        CDDB_DISC_T disc;
+        res = cPluginCdplayer::GetCddbClient().Lookup(offsets, length, disc);
+        if (res == CDDB_FOUND) {
+            SetCddbText(disc);
+            break;
+        }
+        if (res == CDDB_NOT_FOUND) {
+            dsyslog("%s %d CDDB no result.", __FILE__, __LINE__);
+            break;
+        }
+        if (mStopQuery) {
+            break;
+        }
+        // A cancel may be left from a previous disc, retry at once
+        if (res == CDDB_ERROR) {
+            dsyslog("CDDB query failed, retry in %d s", delay / 1000);
+            mRetryWait.Wait(delay);
+            delay *= 2;
+            if (delay > CDDB_RETRY_MAX_MS) {
+                delay = CDDB_RETRY_MAX_MS;
+            }
+        }
+    }
+    dsyslog("CDDB Query finished");
 }
 
-void cCdInfo::Query(void) {
-    TRACK_IDX_T i;
-    int nrfound;
-    cddb_conn_t *cddb_conn;
-    cddb_disc_t *cddb_disc;
-    cddb_track_t *track;
-    CD_TEXT_T txt;
+void cCdInfo::SetCddbText(const CDDB_DISC_T &disc) {
+    mInfoMutex.Lock();
+    mCdTextBuilder.SetDiscField(CDTEXT_TITLE, disc.mTitle);
+    mCdTextBuilder.SetDiscField(CDTEXT_SONGWRITER, disc.mArtist);
+    mCdTextBuilder.SetDiscField(CDTEXT_PERFORMER, disc.mArtist);
+    mCdTextBuilder.SetDiscField(CDTEXT_GENRE, disc.mCategory);
+    dsyslog("category: %s %08x", disc.mCategory.c_str(), disc.mDiscId);
+    dsyslog("%s by %s", disc.mTitle.c_str(), disc.mArtist.c_str());
+
+    for (TRACK_IDX_T i = 0; i < GetNumTracks(); i++) {
+        if (i < (TRACK_IDX_T)disc.mTrackTitle.size()) {
+            mCdTextBuilder.SetTrackField(i, CDTEXT_TITLE, disc.mTrackTitle[i]);
+            mCdTextBuilder.SetTrackField(i, CDTEXT_SONGWRITER, disc.mTrackArtist[i]);
+            mCdTextBuilder.SetTrackField(i, CDTEXT_PERFORMER, disc.mTrackArtist[i]);
+        }
+    }
+    mCdTextStore.Publish(mCdTextBuilder.Build());
+    mInfoMutex.Unlock();
 
-    dsyslog("CDDB Query started");
-    cddb_conn = cddb_new();
-    if (cddb_conn == NULL) {
-        dsyslog("%s %d Cddb Connection failed %s",
-                __FILE__, __LINE__, cddb_error_str(cddb_errno(cddb_conn)));
+    mCddbInfoAvail = true;
+    cPluginCdplayer::GetPlayState().SetCddbInfo(true);
+    StoreInLibrary(LIB_SOURCE_CDDB);
+}
+
+void cCdInfo::SetFingerprintText(TRACK_IDX_T track, const std::string &artist,
+                                 const std::string &title,
+                                 const std::string &album) {
+    mInfoMutex.Lock();
+    if (track >= GetNumTracks()) {
+        mInfoMutex.Unlock();
         return;
     }
+    mCdTextBuilder.SetTrackField(track, CDTEXT_TITLE, title);
+    mCdTextBuilder.SetTrackField(track, CDTEXT_PERFORMER, artist);
+    if (mCdTextBuilder.GetDiscField(CDTEXT_TITLE).empty()) {
+        mCdTextBuilder.SetDiscField(CDTEXT_TITLE, album);
+    }
+    dsyslog("Track %d identified as %s by %s", track, title.c_str(),
+            artist.c_str());
+    mCdTextStore.Publish(mCdTextBuilder.Build());
+    mInfoMutex.Unlock();
+
+    mCddbInfoAvail = true;
+    cPluginCdplayer::GetPlayState().SetCddbInfo(true);
+    StoreInLibrary(LIB_SOURCE_FINGERPRINT);
+}
+
+LIB_KEY_T cCdInfo::GetLibraryKey(void) {
+    LIB_KEY_T key;
 
-    cddb_set_server_name(cddb_conn, cPluginCdplayer::GetCDDBServer().c_str());
-    if (!cPluginCdplayer::GetCDDBCacheDir().empty()) {
-        cddb_cache_set_dir(cddb_conn, cPluginCdplayer::GetCDDBCacheDir().c_str());
+    key.mCddbId = GetCddbDiscId();
+    key.mLeadOut = mLeadOut;
+    key.mNumTracks = GetNumTracks();
+    return key;
+}
+
+// Titles found by fingerprinting alone leave the disc unknown, so CDDB is
+// still asked for it
+bool cCdInfo::SetLibraryText(const LIB_DISC_INFO_T &info) {
+    bool hastext = !info.mTitle.empty();
+
+    for (size_t i = 0; i < info.mTrackTitle.size(); i++) {
+        if (!info.mTrackTitle[i].empty()) {
+            hastext = true;
+        }
     }
-    if (!cPluginCdplayer::GetCDDBCacheEnabled()) {
-        cddb_cache_disable(cddb_conn);
+    if (!hastext) {
+        return false;
     }
-
-    cddb_disc = cddb_disc_new();
-    if (cddb_disc == NULL) {
-       esyslog("%s %d unable to create CDDB disc structure %s",
-               __FILE__, __LINE__, cddb_error_str(cddb_errno(cddb_conn)));
-       cddb_destroy(cddb_conn);
-       return;
-     }
-
-     for (i = 0; i < (TRACK_IDX_T)mCddbInfo.size(); i++) {
-       cddb_track_t *t = cddb_track_new();
-       if (t == NULL) {
-           esyslog("%s %d cddb_track_new failed %s",
-                   __FILE__, __LINE__, cddb_error_str(cddb_errno(cddb_conn)));
-           cddb_destroy(cddb_conn);
-           return;
-       }
-       cddb_track_set_frame_offset(t,mCddbInfo[i].GetCDDALba());
-       cddb_disc_add_track(cddb_disc, t);
-     }
-
-     cddb_disc_set_length(cddb_disc, mLeadOut / CDIO_CD_FRAMES_PER_SEC);
-
-     if (!cddb_disc_calc_discid(cddb_disc)) {
-       dsyslog("%s %d libcddb calc discid failed %s.",
-               __FILE__, __LINE__, cddb_error_str(cddb_errno(cddb_conn)));
-       cddb_destroy(cddb_conn);
-       return;
-     }
-
-     nrfound = cddb_query(cddb_conn, cddb_disc);
-     if (nrfound <= 0) {
-        dsyslog("%s %d CDDB no result.", __FILE__, __LINE__);
-        cddb_destroy(cddb_conn);
-        return;
-     }
-     dsyslog("CDDB %d matches found", nrfound);
-     if (cddb_read(cddb_conn, cddb_disc) == 0) {
-         dsyslog("%s %d CDDB read failed %s.",
-                 __FILE__, __LINE__, cddb_error_str(cddb_errno(cddb_conn)));
-         cddb_destroy(cddb_conn);
-         return;
-     }
-     GetCdInfo (txt);
-
-     txt[CDTEXT_TITLE] = NotNull(cddb_disc_get_title(cddb_disc));
-     txt[CDTEXT_SONGWRITER] = NotNull(cddb_disc_get_artist(cddb_disc));
-     txt[CDTEXT_PERFORMER] = NotNull(cddb_disc_get_artist(cddb_disc));
-     txt[CDTEXT_GENRE] = NotNull(cddb_disc_get_category_str(cddb_disc));
-     SetCdInfo (txt);
-     dsyslog("category: %s (%d) %08x",
-             cddb_disc_get_category_str(cddb_disc),
-             cddb_disc_get_category(cddb_disc),
-             cddb_disc_get_discid(cddb_disc));
-     dsyslog("%s by %s",
-             cddb_disc_get_title(cddb_disc),
-             cddb_disc_get_artist(cddb_disc));
-
-     for (i = 0; i <  GetNumTracks(); i++) {
-        track = cddb_disc_get_track(cddb_disc, i);
-        if (track != NULL) {
-            GetCdTextFields(i, txt);
-            txt[CDTEXT_TITLE] = NotNull(cddb_track_get_title(track));
-            txt[CDTEXT_SONGWRITER] = NotNull(cddb_track_get_artist(track));
-            txt[CDTEXT_PERFORMER] = NotNull(cddb_track_get_artist(track));
-            SetCdTextFields(i, txt);
+    mInfoMutex.Lock();
+    mCdTextBuilder.SetDiscField(CDTEXT_TITLE, info.mTitle);
+    mCdTextBuilder.SetDiscField(CDTEXT_PERFORMER, info.mPerformer);
+    mCdTextBuilder.SetDiscField(CDTEXT_GENRE, info.mGenre);
+    for (TRACK_IDX_T i = 0; i < GetNumTracks(); i++) {
+        if (i < (TRACK_IDX_T)info.mTrackTitle.size()) {
+            mCdTextBuilder.SetTrackField(i, CDTEXT_TITLE, info.mTrackTitle[i]);
+            mCdTextBuilder.SetTrackField(i, CDTEXT_PERFORMER,
+                                         info.mTrackPerformer[i]);
         }
-     }
-
-     cddb_disc_destroy(cddb_disc);
-     cddb_destroy(cddb_conn);
-     dsyslog("CDDB Query finished");
-     mCddbInfoAvail = true;
+    }
+    dsyslog("%s by %s found in library", info.mTitle.c_str(),
+            info.mPerformer.c_str());
+    mCdTextStore.Publish(mCdTextBuilder.Build());
+    mInfoMutex.Unlock();
+
+    mCddbInfoAvail = true;
+    cPluginCdplayer::GetPlayState().SetCddbInfo(true);
+    return ((info.mSource & LIB_SOURCE_COMPLETE) != 0) &&
+           !info.mTitle.empty();
 }
 
+void cCdInfo::StoreInLibrary(int source) {
+    LIB_DISC_INFO_T info;
+
+    info.mKey = GetLibraryKey();
+    info.mSource = source;
+    mInfoMutex.Lock();
+    info.mTitle = mCdTextBuilder.GetDiscField(CDTEXT_TITLE);
+    info.mPerformer = mCdTextBuilder.GetDiscField(CDTEXT_PERFORMER);
+    info.mGenre = mCdTextBuilder.GetDiscField(CDTEXT_GENRE);
+    for (TRACK_IDX_T i = 0; i < GetNumTracks(); i++) {
+        info.mStartLsn.push_back(mTrackInfo[i].GetCDDAStartLsn());
+        info.mLength.push_back(mTrackInfo[i].GetCDDAEndLsn() -
+                               mTrackInfo[i].GetCDDAStartLsn() + 1);
+        info.mTrackTitle.push_back(mCdTextBuilder.GetTrackField(i, CDTEXT_TITLE));
+        info.mTrackPerformer.push_back(
+            mCdTextBuilder.GetTrackField(i, CDTEXT_PERFORMER));
+    }
+    mInfoMutex.Unlock();
+    cPluginCdplayer::GetLibrary().Update(info);
+}
@@ -23,9 +23,11 @@
 #endif
 
 #include <vdr/plugin.h>
-#include <cddb/cddb.h>
 #include <vector>
 #include <string>
+#include "cdtextstore.h"
+#include "cddbclient.h"
+#include "library.h"
 
 #if LIBCDIO_VERSION_NUM > 83
 
@@ -42,7 +44,6 @@
 #define CDTEXT_INVALID      CDTEXT_FIELD_INVALID
 #endif
 
-typedef std::string CD_TEXT_T[MAX_CDTEXT_FIELDS];
 typedef int TRACK_IDX_T;
 
 #define INVALID_TRACK_IDX ((TRACK_IDX_T)-1)
@@ -55,13 +56,11 @@ private:
     lsn_t mStartLsn;
     lsn_t mEndLsn;
     lba_t mLba;
-    CD_TEXT_T mCdTextFields;
 public:
     cTrackInfo(void) : mTrackNo(0), mStartLsn(0), mEndLsn(0), mLba(0) {}
-    cTrackInfo(track_t TrackNo, lsn_t StartLsn, lsn_t EndLsn, lba_t lba,
-               CD_TEXT_T CdTextFields);
+    cTrackInfo(track_t TrackNo, lsn_t StartLsn, lsn_t EndLsn, lba_t lba)
+        : mTrackNo(TrackNo), mStartLsn(StartLsn), mEndLsn(EndLsn), mLba(lba) {}
     ~cTrackInfo() {}
-    void SetCdTextFields (const CD_TEXT_T CdTextFields);
     track_t GetCDDATrack(void) { return mTrackNo; }
     lsn_t GetCDDAStartLsn(void) { return mStartLsn; }
     lsn_t GetCDDAEndLsn(void) { return mEndLsn; }
@@ -85,44 +84,68 @@ public:
 typedef std::vector<cTrackInfo> TrackInfoVector;
 // Vector containing all track information required for CDDB query
 typedef std::vector<cCddbInfo> CddbInfoVector;
-// List containing the PlayList
-typedef std::vector<track_t> PlayList;
 
 class cCdInfo: public cThread {
 private:
     TRACK_IDX_T mLastTrackIdx;
     TrackInfoVector mTrackInfo;
     CddbInfoVector mCddbInfo;
-    PlayList mPlayList;
 
     lba_t mLeadOut;
-    cMutex mInfoMutex;
-    CD_TEXT_T mCdText;
+    cMutex mInfoMutex;          // Serializes writers of the CD-Text
+    cCdTextBuilder mCdTextBuilder; // Master copy for writers
+    cCdTextStore mCdTextStore;  // Published CD-Text for readers
     bool mCddbInfoAvail;
-    void Query(void);
-    void SetCdTextFields(const TRACK_IDX_T track, CD_TEXT_T CdTextFields) {
-          cMutexLock MutexLock (&mInfoMutex);
-          mTrackInfo[track].SetCdTextFields(CdTextFields);
-     }
+    volatile bool mStopQuery;
+    cCondWait mRetryWait;       // Wait between failed queries
+    void SetCddbText(const CDDB_DISC_T &disc);
 public:
-    cCdInfo(void) {mCddbInfoAvail = false; mLastTrackIdx = 0; mLeadOut = 0;}
-    ~cCdInfo(void) {if (Active()) Cancel(3);}
+    cCdInfo(void) {
+        mCddbInfoAvail = false;
+        mStopQuery = false;
+        mLastTrackIdx = 0;
+        mLeadOut = 0;
+    }
+    ~cCdInfo(void) {StopQuery();}
 
     void Clear(void) {
+        StopQuery();
+        cMutexLock MutexLock (&mInfoMutex);
         mTrackInfo.clear();
-        mPlayList.clear();
+        mCddbInfo.clear();
         mLastTrackIdx = 0;
+        mCddbInfoAvail = false;
+        mCdTextBuilder.Clear();
+        mCdTextStore.Clear();
     }
 
     void Add(track_t TrackNo, lsn_t StartLsn, lsn_t EndLsn, lba_t lba, CD_TEXT_T &CdTextFields);
     void AddData(lba_t lba);
 
     void SetLeadOut (lba_t leadout) { mLeadOut = leadout; }
-
-    void GetCdTextFields(const TRACK_IDX_T track, CD_TEXT_T &CdTextFields);
+    // Track offsets (lba) and disc length in seconds as used by CDDB
+    void GetCddbToc(std::vector<int> &offsets, int &length);
+    unsigned int GetCddbDiscId(void);
 
     void SetCdInfo(const CD_TEXT_T CdTextFields);
-    void GetCdInfo(CD_TEXT_T &txt);
+    // Make the CD-Text collected by Add and SetCdInfo visible to readers
+    void PublishCdText(void);
+    // Set the text of a track identified by its fingerprint
+    void SetFingerprintText(TRACK_IDX_T track, const std::string &artist,
+                            const std::string &title,
+                            const std::string &album);
+    // Key of the disc in the library
+    LIB_KEY_T GetLibraryKey(void);
+    // Set the text of a disc known from the library, returns false if
+    // the library has no complete text (from CD-Text or CDDB) for the disc.
+    bool SetLibraryText(const LIB_DISC_INFO_T &info);
+    // Add TOC and text of the disc to the library, source is the origin of
+    // the text (LIB_SOURCE_*)
+    void StoreInLibrary(int source);
+    // Get the current CD-Text without copying
+    void GetCdText(cCdTextRef &ref) {
+        mCdTextStore.Get(ref);
+    }
 
     TRACK_IDX_T GetNumTracks(void) {
         return mTrackInfo.size();
@@ -139,10 +162,14 @@ public:
     bool CDDBInfoAvailable(void) {
         return mCddbInfoAvail;
     }
-    PlayList GetDefaultPlayList(void) {
-        return mPlayList;
+    // Start the CDDB query in the background
+    void StartQuery(void) {
+        mStopQuery = false;
+        Start();
     }
-    void Action(void); // Start cddb query
+    // Abort a running CDDB query, returns immediately
+    void StopQuery(void);
+    void Action(void);
 };
 
 #endif /* CDINFO_H_ */
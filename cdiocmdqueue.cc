@@ -0,0 +1,73 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements a lock free command queue which passes
+ * control commands (track change, skip, ...) from the OSD to the
+ * thread reading from the CD-Rom device. Any thread may put commands,
+ * only the reader thread fetches them.
+ *
+ * Each slot carries a sequence number. A slot at position pos is free
+ * for writing if its sequence number equals pos and contains a command
+ * for reading if it equals pos+1.
+ */
+
+#include "cdiocmdqueue.h"
+
+cCdIoCmdQueue::cCdIoCmdQueue(void)
+{
+    for (unsigned int i = 0; i < QUEUE_SIZE; i++) {
+        mSlots[i].mSeq = i;
+    }
+    mPutPos = 0;
+    mGetPos = 0;
+}
+
+bool cCdIoCmdQueue::Put(CDIO_CMD_TYPE_T type, int arg, int arg2)
+{
+    CMD_SLOT_T *slot;
+    unsigned int pos = __atomic_load_n(&mPutPos, __ATOMIC_RELAXED);
+
+    for (;;) {
+        slot = &mSlots[pos & (QUEUE_SIZE - 1)];
+        unsigned int seq = __atomic_load_n(&slot->mSeq, __ATOMIC_ACQUIRE);
+        int diff = (int)(seq - pos);
+        if (diff == 0) {
+            // Slot is free, try to reserve it
+            if (__atomic_compare_exchange_n(&mPutPos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            return false; // Queue is full
+        }
+        else {
+            pos = __atomic_load_n(&mPutPos, __ATOMIC_RELAXED);
+        }
+    }
+    slot->mCmd.mType = type;
+    slot->mCmd.mArg = arg;
+    slot->mCmd.mArg2 = arg2;
+    __atomic_store_n(&slot->mSeq, pos + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool cCdIoCmdQueue::Get(CDIO_CMD_T &cmd)
+{
+    CMD_SLOT_T *slot = &mSlots[mGetPos & (QUEUE_SIZE - 1)];
+    unsigned int seq = __atomic_load_n(&slot->mSeq, __ATOMIC_ACQUIRE);
+
+    if ((int)(seq - (mGetPos + 1)) < 0) {
+        return false; // Queue is empty
+    }
+    cmd = slot->mCmd;
+    __atomic_store_n(&slot->mSeq, mGetPos + QUEUE_SIZE, __ATOMIC_RELEASE);
+    mGetPos++;
+    return true;
+}
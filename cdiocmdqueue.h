@@ -0,0 +1,69 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements a lock free command queue which passes
+ * control commands (track change, skip, ...) from the OSD to the
+ * thread reading from the CD-Rom device. Any thread may put commands,
+ * only the reader thread fetches them.
+ */
+
+#ifndef __CDIOCMDQUEUE_H__
+#define __CDIOCMDQUEUE_H__
+
+typedef enum _cdio_cmd_type {
+    CDIO_CMD_SET_TRACK = 0,
+    CDIO_CMD_NEXT_TRACK,
+    CDIO_CMD_PREV_TRACK,
+    CDIO_CMD_SKIP_TIME,
+    CDIO_CMD_SEEK,
+    CDIO_CMD_SORTED,
+    CDIO_CMD_RANDOM,
+    CDIO_CMD_LOOP_A,
+    CDIO_CMD_LOOP_B,
+    CDIO_CMD_LOOP_TRACK,
+    CDIO_CMD_LOOP_OFF
+} CDIO_CMD_TYPE_T;
+
+typedef struct _cdio_cmd {
+    CDIO_CMD_TYPE_T mType;
+    int mArg;
+    int mArg2;
+} CDIO_CMD_T;
+
+class cCdIoCmdQueue {
+private:
+    static const unsigned int QUEUE_SIZE = 32; // Must be a power of 2
+    typedef struct _cmd_slot {
+        unsigned int mSeq;  // Sequence number, tells if slot is free or used
+        CDIO_CMD_T mCmd;
+    } CMD_SLOT_T;
+
+    CMD_SLOT_T mSlots[QUEUE_SIZE];
+    unsigned int mPutPos;   // Next position to write, shared by all writers
+    unsigned int mGetPos;   // Next position to read, only used by reader
+public:
+    cCdIoCmdQueue(void);
+    // Put a command to the queue, returns false if the queue is full
+    bool Put(CDIO_CMD_TYPE_T type, int arg = 0, int arg2 = 0);
+    // Get the next command, returns false if the queue is empty
+    bool Get(CDIO_CMD_T &cmd);
+    // A command is waiting (reader side only)
+    bool Pending(void) {
+        const CMD_SLOT_T *slot = &mSlots[mGetPos & (QUEUE_SIZE - 1)];
+        return (int)(__atomic_load_n(&slot->mSeq, __ATOMIC_ACQUIRE) -
+                     (mGetPos + 1)) >= 0;
+    }
+    // Remove all pending commands (reader side only)
+    void Clear(void) {
+        CDIO_CMD_T cmd;
+        while (Get(cmd)) {
+        }
+    }
+};
+
+#endif
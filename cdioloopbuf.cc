@@ -0,0 +1,78 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class keeps the blocks of a repeated segment in memory.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <vdr/tools.h>
+#include "cdioloopbuf.h"
+
+cCdIoLoopBuffer::cCdIoLoopBuffer(void)
+    : mData(NULL), mStart(CDIO_INVALID_LSN), mEnd(CDIO_INVALID_LSN)
+{
+}
+
+cCdIoLoopBuffer::~cCdIoLoopBuffer()
+{
+    free(mData);
+}
+
+void cCdIoLoopBuffer::Set(lsn_t start, lsn_t end)
+{
+    int blocks = end - start + 1;
+
+    Clear();
+    if (blocks <= 0) {
+        return;
+    }
+    mStart = start;
+    mEnd = end;
+    if (blocks > CCDIO_LOOP_MAX_BLOCKS) {
+        dsyslog("%s %d Loop of %d blocks, only the first %d are kept",
+                __FILE__, __LINE__, blocks, CCDIO_LOOP_MAX_BLOCKS);
+        blocks = CCDIO_LOOP_MAX_BLOCKS;
+    }
+    mData = (uint8_t *)malloc((size_t)blocks * CDIO_CD_FRAMESIZE_RAW);
+    if (mData == NULL) {
+        esyslog("%s %d Out of memory for loop of %d blocks",
+                __FILE__, __LINE__, blocks);
+        return;
+    }
+    mValid.assign(blocks, false);
+}
+
+void cCdIoLoopBuffer::Clear(void)
+{
+    free(mData);
+    mData = NULL;
+    mValid.clear();
+    mStart = CDIO_INVALID_LSN;
+    mEnd = CDIO_INVALID_LSN;
+}
+
+const uint8_t *cCdIoLoopBuffer::Get(lsn_t lsn) const
+{
+    if ((mData == NULL) || (lsn < mStart) ||
+        (lsn - mStart >= (lsn_t)mValid.size()) || !mValid[lsn - mStart]) {
+        return NULL;
+    }
+    return mData + (size_t)(lsn - mStart) * CDIO_CD_FRAMESIZE_RAW;
+}
+
+void cCdIoLoopBuffer::Put(lsn_t lsn, const uint8_t *block)
+{
+    if ((mData == NULL) || (lsn < mStart) ||
+        (lsn - mStart >= (lsn_t)mValid.size())) {
+        return;
+    }
+    memcpy(mData + (size_t)(lsn - mStart) * CDIO_CD_FRAMESIZE_RAW, block,
+           CDIO_CD_FRAMESIZE_RAW);
+    mValid[lsn - mStart] = true;
+}
@@ -0,0 +1,49 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class keeps the blocks of a repeated segment (A-B loop or track
+ * loop) in memory once they were read, so each repetition is served
+ * without accessing the CD-Rom device. It is only used by the reader
+ * thread and needs no locking.
+ */
+
+#ifndef __CDIOLOOPBUF_H__
+#define __CDIOLOOPBUF_H__
+
+#include <vector>
+#include <cdio/cdio.h>
+#ifdef VERSION
+#undef VERSION
+#endif
+
+// Blocks kept of a loop (10 MB), the rest of a longer loop is read from
+// the device each time
+static const int CCDIO_LOOP_MAX_BLOCKS=60*CDIO_CD_FRAMES_PER_SEC;
+
+class cCdIoLoopBuffer {
+private:
+    uint8_t *mData;
+    std::vector<bool> mValid;   // Block was read, one per kept block
+    lsn_t mStart;               // First and last block of the loop
+    lsn_t mEnd;
+public:
+    cCdIoLoopBuffer(void);
+    ~cCdIoLoopBuffer();
+    // Repeat the blocks start to end, both inclusive
+    void Set(lsn_t start, lsn_t end);
+    void Clear(void);
+    bool IsActive(void) const { return mStart != CDIO_INVALID_LSN; }
+    lsn_t GetStart(void) const { return mStart; }
+    lsn_t GetEnd(void) const { return mEnd; }
+    // Block in memory, NULL if not yet read
+    const uint8_t *Get(lsn_t lsn) const;
+    // Keep a block read from the device
+    void Put(lsn_t lsn, const uint8_t *block);
+};
+
+#endif
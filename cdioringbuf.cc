@@ -17,17 +17,25 @@
 cCdIoRingBuffer::cCdIoRingBuffer()
 {
     mData = NULL;
+    mBlocks = 0;
+    mMaxPending = 0;
     Clear();
 }
 
-cCdIoRingBuffer::cCdIoRingBuffer(int blocks)
+/*
+ * The buffer holds up to blocks not yet fetched entries. Additionally up to
+ * history already fetched blocks are kept, so that a seek backwards can be
+ * served from memory.
+ */
+cCdIoRingBuffer::cCdIoRingBuffer(int blocks, int history)
 {
-    mData = (BUFFER_DATA *)malloc(sizeof (BUFFER_DATA) * blocks);
+    mBlocks = blocks + history;
+    mMaxPending = blocks;
+    mData = (BUFFER_DATA *)malloc(sizeof (BUFFER_DATA) * mBlocks);
     if (mData == NULL) {
         esyslog ("%s %d Out of memory", __FILE__, __LINE__);
         exit(-1);
     }
-    mBlocks = blocks;
     Clear();
 }
 
@@ -60,55 +68,151 @@ void cCdIoRingBuffer::WaitEmpty (void)
  * currently no data is available
  */
 
-bool cCdIoRingBuffer::GetBlock(uint8_t *block, lsn_t *lsn, int *frame)
+bool cCdIoRingBuffer::GetBlock(uint8_t *block, lsn_t *lsn, int *frame, int *track)
 {
     if (!mGetAllowed.WaitAllow()) {
         return false;
     }
     mBufferMutex.Lock();
+    if (mNumBlocks == 0) { // Buffer was cleared while waiting
+        mBufferMutex.Unlock();
+        return false;
+    }
     *lsn = mData[mGetIdx].mLsn;
     *frame = mData[mGetIdx].mFrame;
+    *track = mData[mGetIdx].mTrack;
     memcpy (block, mData[mGetIdx].mData, CDIO_CD_FRAMESIZE_RAW);
     mGetIdx++;
     if (mGetIdx >= mBlocks) {
         mGetIdx = 0;
     }
-    if (mGetIdx == mPutIdx) { // All data in buffer fetched
+    mNumBlocks--;
+    mHistBlocks++;
+    if (mNumBlocks == 0) { // All data in buffer fetched
         mGetAllowed.Deny();
     }
     mPutAllowed.Allow();
-    mNumBlocks--;
     mBufferMutex.Unlock();
     return true;
 }
 
 /*
  * Put a block to the ring buffer, wait if
- * no space is left on the buffer
+ * no space is left on the buffer. The oldest history block
+ * is overwritten if required.
  */
 
-bool cCdIoRingBuffer::PutBlock(const uint8_t *block, const lsn_t lsn, const int frame)
+bool cCdIoRingBuffer::PutBlock(const uint8_t *block, const lsn_t lsn,
+                               const int frame, const int track)
 {
     if (!mPutAllowed.WaitAllow()) {
         return false;
     }
     mBufferMutex.Lock();
+    if (mNumBlocks >= mMaxPending) {
+        mBufferMutex.Unlock();
+        return false;
+    }
     mData[mPutIdx].mLsn = lsn;
     mData[mPutIdx].mFrame = frame;
+    mData[mPutIdx].mTrack = track;
     memcpy (mData[mPutIdx].mData, block, CDIO_CD_FRAMESIZE_RAW);
     mPutIdx++;
     if (mPutIdx >= mBlocks) {
         mPutIdx = 0;
     }
-    if (mGetIdx == mPutIdx) { // Buffer is full
+    mNumBlocks++;
+    if (mNumBlocks + mHistBlocks > mBlocks) {
+        mHistBlocks--;
+    }
+    if (mNumBlocks >= mMaxPending) { // Buffer is full
         mPutAllowed.Deny();
     }
     mGetAllowed.Allow();
-    mNumBlocks++;
     mBufferMutex.Unlock();
     return true;
 }
 
+/*
+ * Find the position of a block relative to the oldest valid block.
+ * The data is normally contiguous, so the position is first calculated
+ * from the LSN of the oldest block. Only if this fails (track change within
+ * the buffer) the buffer is searched. Returns -1 if not found.
+ * Must be called with locked mBufferMutex.
+ */
+int cCdIoRingBuffer::FindBlock(const lsn_t lsn, const int track)
+{
+    int valid = mHistBlocks + mNumBlocks;
+    int oldest = (mGetIdx - mHistBlocks + mBlocks) % mBlocks;
+    int i;
+
+    if (valid == 0) {
+        return -1;
+    }
+    i = lsn - mData[oldest].mLsn;
+    if ((i >= 0) && (i < valid)) {
+        BUFFER_DATA *d = &mData[(oldest + i) % mBlocks];
+        if ((d->mLsn == lsn) && (d->mTrack == track)) {
+            return i;
+        }
+    }
+    for (i = 0; i < valid; i++) {
+        BUFFER_DATA *d = &mData[(oldest + i) % mBlocks];
+        if ((d->mLsn == lsn) && (d->mTrack == track)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Move the read position to the block with the given LSN, if this
+ * block is still or already in the buffer.
+ */
+bool cCdIoRingBuffer::SkipTo(const lsn_t lsn, const int track)
+{
+    cMutexLock MutexLock(&mBufferMutex);
+    int pos = FindBlock(lsn, track);
+    if (pos < 0) {
+        return false;
+    }
+    int valid = mHistBlocks + mNumBlocks;
+    mGetIdx = (mGetIdx - mHistBlocks + pos + mBlocks) % mBlocks;
+    mHistBlocks = pos;
+    mNumBlocks = valid - pos;
+    if (mNumBlocks > 0) {
+        mGetAllowed.Allow();
+    }
+    else {
+        mGetAllowed.Deny();
+    }
+    if (mNumBlocks < mMaxPending) {
+        mPutAllowed.Allow();
+    }
+    else {
+        mPutAllowed.Deny();
+    }
+    return true;
+}
+
+void cCdIoRingBuffer::SetMaxPending(int blocks)
+{
+    cMutexLock MutexLock(&mBufferMutex);
+    if (blocks > mBlocks) {
+        blocks = mBlocks;
+    }
+    if (blocks == mMaxPending) {
+        return;
+    }
+    mMaxPending = blocks;
+    if (mNumBlocks < mMaxPending) {
+        mPutAllowed.Allow();
+    }
+    else {
+        mPutAllowed.Deny();
+    }
+}
+
 /*
  * Clear and reset ringbuffer
  */
@@ -117,6 +221,7 @@ void cCdIoRingBuffer::Clear(void)
 {
     mBufferMutex.Lock();
     mNumBlocks = 0;
+    mHistBlocks = 0;
     mPutIdx = 0;
     mGetIdx = 0;
     mGetAllowed.Deny(); // No data available, so lock get call
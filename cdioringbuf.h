@@ -24,10 +24,11 @@ class cAllowed : public cCondWait
 {
 private:
     volatile bool mAllowed;  // Access allowed ?
+    volatile bool mInterrupted; // Stop waiting without access
     cMutex mMutex;   // Mutex for waiting
 public:
 
-    cAllowed() : mAllowed(true) {};
+    cAllowed() : mAllowed(true), mInterrupted(false) {};
 
     // Allow Access
     void Allow(void)
@@ -47,11 +48,24 @@ public:
         mMutex.Unlock();
     }
 
-    // Wait until access is allowed or time out after 2 seconds (returns
-    // false in this case)
+    // Wake up a waiting thread without allowing access
+    void Interrupt(void)
+    {
+        mMutex.Lock();
+        mInterrupted = true;
+        Signal();
+        mMutex.Unlock();
+    }
+
+    // Wait until access is allowed or time out after 2 seconds or
+    // interrupted (returns false in this case)
     bool WaitAllow(void)
     {
         while (!mAllowed) {
+            if (mInterrupted) {
+                mInterrupted = false;
+                return false;
+            }
             if (!Wait(2000)) {
                 return false;
             }
@@ -67,31 +81,45 @@ private:
     typedef struct _buffer_data {
         lsn_t mLsn;     // LSN for attached data
         int mFrame;      // Framenumber
+        int mTrack;      // Playlist index of the track
         uint8_t mData[CDIO_CD_FRAMESIZE_RAW];
     } BUFFER_DATA;
 
     BUFFER_DATA *mData;
     volatile int mPutIdx;
     volatile int mGetIdx;
-    int mBlocks;
-    volatile int mNumBlocks;
+    int mBlocks;        // Number of slots (pending + history)
+    int mMaxPending;    // Maximum number of not yet fetched blocks
+    volatile int mNumBlocks;    // Blocks not yet fetched
+    volatile int mHistBlocks;   // Already fetched blocks still valid
     cMutex mBufferMutex;
     cAllowed mGetAllowed;
     cAllowed mPutAllowed;
     cCdIoRingBuffer();
+    int FindBlock(const lsn_t lsn, const int track);
 public:
-    cCdIoRingBuffer(int blocks);
+    cCdIoRingBuffer(int blocks, int history = 0);
     ~cCdIoRingBuffer();
-    bool GetBlock(uint8_t *block, lsn_t *lsn, int *frame);
-    bool PutBlock(const uint8_t *block, const lsn_t lsn, const int frame);
+    bool GetBlock(uint8_t *block, lsn_t *lsn, int *frame, int *track);
+    bool PutBlock(const uint8_t *block, const lsn_t lsn, const int frame,
+                  const int track);
+    // Move the read position to an already buffered block. Returns false
+    // if the block is not in the buffer.
+    bool SkipTo(const lsn_t lsn, const int track);
     void Clear(void);
+    // Let a waiting PutBlock return without putting the block
+    void InterruptPut(void) { mPutAllowed.Interrupt(); }
+    bool IsEmpty(void) { return mNumBlocks == 0; }
+    int GetPending(void) { return mNumBlocks; }
+    // Change the read-ahead, taken from or given back to the history
+    void SetMaxPending(int blocks);
     // Wait until number of blocks are available in the ring buffer.
     void WaitBlocksAvail (int numblocks);
     // Wait until all blocks are removed from ring buffer.
     void WaitEmpty (void);
     // Return average usage for debugging purposes
     int GetFreePercent(void) {
-        return ((100*mNumBlocks)/mBlocks);
+        return ((100*mNumBlocks)/mMaxPending);
     }
 };
 
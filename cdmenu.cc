@@ -11,6 +11,7 @@
  */
 
 #include "cdmenu.h"
+#include "accuraterip.h"
 
 static const char *MAXCDSPEED = "MaxCDSpeed";
 static const char *ENABLEPARANOIA = "EnableParanoia";
@@ -18,7 +19,13 @@ static const char *ENABLEMAINMENU = "EnableMainMenu";
 static const char *PLAYMODE = "PlayMode";
 static const char *SHOWPERFORMER ="ShowArtist";
 static const char *RESTART="Restart";
+static const char *RESUME = "Resume";
 static const char *GRAPHTFT = "GraphTFT";
+static const char *STATUSRATE = "StatusRate";
+static const char *FINGERPRINTCPU = "FingerprintCpu";
+static const char *READOFFSET = "ReadOffset";
+static const char *RIP = "Rip";
+static const char *TSOUTPUT = "TsOutput";
 static const char *KEY_OK = "KeyOk";
 static const char *KEY_BACK = "KeyBack";
 
@@ -27,7 +34,13 @@ int cMenuCDPlayer::mShowMainMenu = true;
 int cMenuCDPlayer::mPlayMode = false;
 int cMenuCDPlayer::mShowArtist = true;
 int cMenuCDPlayer::mRestart = false;
+int cMenuCDPlayer::mResume = true;
 int cMenuCDPlayer::mGraphTFT = false;
+int cMenuCDPlayer::mStatusRate = 5;
+int cMenuCDPlayer::mFingerprintCpu = 10;
+int cMenuCDPlayer::mReadOffset = 0;
+int cMenuCDPlayer::mRip = false;
+int cMenuCDPlayer::mTsOutput = 0;
 cMenuCDPlayer::KEY_ASSIGNMENT cMenuCDPlayer::mOK_Key = KEY_EXIT;
 cMenuCDPlayer::KEY_ASSIGNMENT cMenuCDPlayer::mBACK_Key = KEY_EXIT;
 
@@ -56,12 +69,35 @@ cMenuCDPlayer::cMenuCDPlayer(void) : cMenuSetupPage()
                                   2, playmode_entry));
     Add(new cMenuEditBoolItem(tr("Show artist"), &mShowArtist));
     Add(new cMenuEditBoolItem(tr("Restart playback"), &mRestart));
+    Add(new cMenuEditBoolItem(tr("Resume playback"), &mResume));
 #ifdef USE_PARANOIA
     Add(new cMenuEditBoolItem(tr("Enable Paranoia"), &mUseParanoia));
 #else
     mUseParanoia = false;
 #endif
     Add(new cMenuEditBoolItem(tr("Use GraphTFT special characters"), &mGraphTFT));
+    Add(new cMenuEditIntItem(tr("Status updates per second"), &mStatusRate,
+                             1, 25));
+    Add(new cMenuEditIntItem(tr("Fingerprint CPU usage (%)"), &mFingerprintCpu,
+                             0, 100, tr("off")));
+    Add(new cMenuEditIntItem(tr("Read offset (samples)"), &mReadOffset,
+                             -AR_MAX_OFFSET, AR_MAX_OFFSET));
+#ifdef USE_FLAC
+    Add(new cMenuEditBoolItem(tr("Rip while playing"), &mRip));
+#else
+    mRip = false;
+#endif
+    for (int i = 0; i < MAXDEVICES; i++) {
+        mTsDevice[i] = GetTsOutput(i);
+    }
+    for (int i = 0; i < cDevice::NumDevices(); i++) {
+        cDevice *device = cDevice::GetDevice(i);
+        if ((device != NULL) && device->HasDecoder()) {
+            Add(new cMenuEditBoolItem(
+                    *cString::sprintf(tr("TS output on device %d"), i + 1),
+                    &mTsDevice[i]));
+        }
+    }
     Add(new cMenuEditStraItem(tr("Back Key"), (int *)&mBACK_Key, KEY_LAST,
                               key_assignment));
     Add(new cMenuEditStraItem(tr("OK Key"), (int *)&mOK_Key, KEY_LAST,
@@ -92,9 +128,36 @@ bool cMenuCDPlayer::SetupParse(const char *Name, const char *Value)
   else if (strcasecmp(Name, RESTART) == 0) {
       mRestart = atoi(Value);
   }
+  else if (strcasecmp(Name, RESUME) == 0) {
+      mResume = atoi(Value);
+  }
   else if (strcasecmp(Name, GRAPHTFT) == 0) {
       mGraphTFT  = atoi(Value);
   }
+  else if (strcasecmp(Name, STATUSRATE) == 0) {
+      mStatusRate = atoi(Value);
+      if (mStatusRate < 1) {
+          mStatusRate = 1;
+      }
+  }
+  else if (strcasecmp(Name, FINGERPRINTCPU) == 0) {
+      mFingerprintCpu = atoi(Value);
+      if (mFingerprintCpu < 0) {
+          mFingerprintCpu = 0;
+      }
+      if (mFingerprintCpu > 100) {
+          mFingerprintCpu = 100;
+      }
+  }
+  else if (strcasecmp(Name, READOFFSET) == 0) {
+      mReadOffset = atoi(Value);
+  }
+  else if (strcasecmp(Name, RIP) == 0) {
+      mRip = atoi(Value);
+  }
+  else if (strcasecmp(Name, TSOUTPUT) == 0) {
+      mTsOutput = atoi(Value);
+  }
   else if (strcasecmp(Name, KEY_OK) == 0) {
       mOK_Key = (cMenuCDPlayer::KEY_ASSIGNMENT)atoi(Value);
   }
@@ -115,7 +178,19 @@ void cMenuCDPlayer::Store(void)
     SetupStore(PLAYMODE, mPlayMode);
     SetupStore(SHOWPERFORMER, mShowArtist);
     SetupStore(RESTART, mRestart);
+    SetupStore(RESUME, mResume);
     SetupStore(GRAPHTFT, mGraphTFT);
+    SetupStore(STATUSRATE, mStatusRate);
+    SetupStore(FINGERPRINTCPU, mFingerprintCpu);
+    SetupStore(READOFFSET, mReadOffset);
+    SetupStore(RIP, mRip);
+    mTsOutput = 0;
+    for (int i = 0; i < MAXDEVICES; i++) {
+        if (mTsDevice[i]) {
+            mTsOutput |= 1 << i;
+        }
+    }
+    SetupStore(TSOUTPUT, mTsOutput);
     SetupStore(KEY_OK, (int)mOK_Key);
     SetupStore(KEY_BACK, (int)mBACK_Key);
 }
@@ -11,6 +11,7 @@
  */
 
 #include <vdr/plugin.h>
+#include <vdr/device.h>
 #include "cdplayer.h"
 
 class cMenuCDPlayer: public cMenuSetupPage {
@@ -23,10 +24,17 @@ private:
     static int mPlayMode;
     static int mShowArtist;
     static int mRestart;
+    static int mResume;
     static int mGraphTFT;
+    static int mStatusRate;
+    static int mFingerprintCpu;
+    static int mReadOffset;
+    static int mRip;
+    static int mTsOutput;       // Bit per device number
     static KEY_ASSIGNMENT mOK_Key;
     static KEY_ASSIGNMENT mBACK_Key;
     static eKeys TranslateKey (KEY_ASSIGNMENT key);
+    int mTsDevice[MAXDEVICES];
 protected:
     virtual void Store(void);
 
@@ -38,7 +46,17 @@ public:
     static bool GetPlayMode(void) {return mPlayMode; }
     static bool GetShowArtist(void) {return mShowArtist;}
     static bool GetRestart(void) {return mRestart;}
+    static bool GetResume(void) {return mResume;}
     static bool GetGraphTFT(void) {return mGraphTFT;}
+    static int GetStatusRate(void) {return mStatusRate;}
+    static int GetFingerprintCpu(void) {return mFingerprintCpu;}
+    static int GetReadOffset(void) {return mReadOffset;}
+    static bool GetRip(void) {return mRip;}
+    // Play to the device as TS instead of PES
+    static bool GetTsOutput(int device) {
+        return (device >= 0) && (device < MAXDEVICES) &&
+               ((mTsOutput & (1 << device)) != 0);
+    }
     static eKeys GetOkKey(void) {return TranslateKey(mOK_Key);}
     static eKeys GetBackKey(void) {return TranslateKey(mBACK_Key);}
     static bool SetupParse(const char *Name, const char *Value);
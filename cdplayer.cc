@@ -12,23 +12,46 @@
 
 #include <getopt.h>
 #include <stdlib.h>
+#include <time.h>
+#include <sstream>
 #include "cdplayer.h"
 #include "cdmenu.h"
+#include "librarymenu.h"
 #include <vdr/remote.h>
 
 static const char *MAINMENUENTRY  = trNOOP("CD-Player");
 
+#define BENCH_SECTORS   (100 * CDIO_CD_FRAMES_PER_SEC)
+#define BENCH_MAX_SECTORS (3600 * CDIO_CD_FRAMES_PER_SEC)
+
 // Defaults for command line arguments
 
 std::string cPluginCdplayer::mDevice ="/dev/cdrom";
 std::string cPluginCdplayer::mStillPicture = "cd.mpg";
 std::string cPluginCdplayer::mcfgDir = "cdplayer";
-std::string cPluginCdplayer::mCDDBServer = "freedb.freedb.org";
+std::string cPluginCdplayer::mCDDBServer = "gnudb.gnudb.org";
 std::string cPluginCdplayer::mCDDBCacheDir = "";
+std::string cPluginCdplayer::mCDDBIndexFile = "";
+std::string cPluginCdplayer::mRipDir = "";
+std::string cPluginCdplayer::mHttpPort = "";
+std::string cPluginCdplayer::mRemoteDrive = "";
+std::string cPluginCdplayer::mAlsaDevice = "";
+std::string cPluginCdplayer::mDriveServerPort = "";
 bool cPluginCdplayer::mEnableCDDB = true;
 bool cPluginCdplayer::mEnableCDDBCache = true;
+cCdPlayState cPluginCdplayer::mPlayState;
+cCddbClient cPluginCdplayer::mCddbClient;
+cCddbIndex cPluginCdplayer::mCddbIndex;
+cFingerprintIndex cPluginCdplayer::mFingerprintIndex;
+cLibrary cPluginCdplayer::mLibrary;
+bool cPluginCdplayer::mShowLibrary = false;
+cPlayQueue cPluginCdplayer::mPlayQueue;
+cSpectrum cPluginCdplayer::mSpectrum;
+cPcmTap cPluginCdplayer::mPcmTap;
+cSinkList cPluginCdplayer::mSinks;
 
-cPluginCdplayer::cPluginCdplayer(void) : mShowMainMenu(true), mCdControl(NULL)
+cPluginCdplayer::cPluginCdplayer(void) : mShowMainMenu(true), mCdControl(NULL),
+    mDriveServer(NULL), mRecorder(NULL)
 {
 
 }
@@ -38,8 +61,16 @@ const char *cPluginCdplayer::CommandLineHelp(void)
     return "-d  --device  <device>    CD-Rom device : /dev/cdrom\n"
             "-s  --stillpic <file>     Still-Picture : cd.mpg\n"
             "-c  --configdir <dir>     Directory for config files : cdplayer\n"
-            "-S  --cddbserver <server> CDDB server name : freedb.freedb.org\n"
+            "-S  --cddbserver <server> CDDB server name[:port] : gnudb.gnudb.org\n"
             "-C  --cddbcache <dir>     CDDB cache directory\n"
+            "-I  --cddbindex <file>    Offline CDDB index : <configdir>/cddb.idx\n"
+            "-r  --ripdir <dir>        Directory for ripped discs : <configdir>/rip\n"
+            "-H  --httpport <port>     Stream the played audio by HTTP,\n"
+            "                          [address:]port, svdrphosts.conf applies\n"
+            "-a  --alsa <device>       Play the audio also on an ALSA device\n"
+            "-R  --remotedrive <host>  Read the drive of host[:port]\n"
+            "-D  --driveserver <port>  Serve the drive to other hosts,\n"
+            "                          [address:]port, svdrphosts.conf applies\n"
             "-N  --disablecddbcache    Disable CDDB cache\n"
             "-n  --disablecddb         Disable CDDB query\n";
 }
@@ -54,13 +85,19 @@ bool cPluginCdplayer::ProcessArgs(int argc, char *argv[])
         { "configdir",      required_argument, NULL, 'c' },
         { "cddbserver",     required_argument, NULL, 'S' },
         { "cddbcache",      required_argument, NULL, 'C' },
+        { "cddbindex",      required_argument, NULL, 'I' },
+        { "ripdir",         required_argument, NULL, 'r' },
+        { "httpport",       required_argument, NULL, 'H' },
+        { "alsa",           required_argument, NULL, 'a' },
+        { "remotedrive",    required_argument, NULL, 'R' },
+        { "driveserver",    required_argument, NULL, 'D' },
         { "disablecddb",        no_argument, NULL, 'n' },
         { "disablecddbcache",   no_argument, NULL, 'N' },
         { NULL, no_argument, NULL, '\0' }
     };
     int c, option_index = 0;
 
-    while ((c = getopt_long(argc, argv, "d:s:c:S:C:nN",
+    while ((c = getopt_long(argc, argv, "d:s:c:S:C:I:r:H:a:R:D:nN",
                             long_options, &option_index)) != -1) {
         switch (c) {
         case 'd':
@@ -78,6 +115,24 @@ bool cPluginCdplayer::ProcessArgs(int argc, char *argv[])
         case 'C':
             mCDDBCacheDir.assign(optarg);
             break;
+        case 'I':
+            mCDDBIndexFile.assign(optarg);
+            break;
+        case 'r':
+            mRipDir.assign(optarg);
+            break;
+        case 'H':
+            mHttpPort.assign(optarg);
+            break;
+        case 'a':
+            mAlsaDevice.assign(optarg);
+            break;
+        case 'R':
+            mRemoteDrive.assign(optarg);
+            break;
+        case 'D':
+            mDriveServerPort.assign(optarg);
+            break;
         case 'n':
             mEnableCDDB = false;
             break;
@@ -110,6 +165,14 @@ bool cPluginCdplayer::ProcessArgs(int argc, char *argv[])
     return true;
 }
 
+cSectorSource *cPluginCdplayer::NewSectorSource(const std::string &device)
+{
+    if (mRemoteDrive.empty()) {
+        return new cLocalSource(device);
+    }
+    return new cRemoteSource(mRemoteDrive);
+}
+
 bool cPluginCdplayer::Initialize(void)
 {
     return true;
@@ -117,12 +180,46 @@ bool cPluginCdplayer::Initialize(void)
 
 bool cPluginCdplayer::Start(void)
 {
+    std::string cachedir = mCDDBCacheDir;
+
+    // Same default as libcddb, so existing caches are used
+    if (cachedir.empty() && (getenv("HOME") != NULL)) {
+        cachedir = getenv("HOME");
+        cachedir += "/.cddbslave";
+    }
+    mCddbClient.SetServer(mCDDBServer);
+    mCddbClient.SetCache(cachedir, mEnableCDDBCache);
+    if (mCDDBIndexFile.empty()) {
+        mCDDBIndexFile = GetConfigDir() + "cddb.idx";
+    }
+    mCddbIndex.Open(mCDDBIndexFile);
+    mFingerprintIndex.Open(GetConfigDir() + "fingerprints.db");
+    mLibrary.Open(GetConfigDir() + "library.db");
+    if (!mHttpPort.empty()) {
+        mSinks.Add(new cHttpSink(mHttpPort));
+    }
+    if (!mAlsaDevice.empty()) {
+#ifdef USE_ALSA
+        mSinks.Add(new cAlsaSink(mAlsaDevice));
+#else
+        esyslog("%s %d Compiled without ALSA support", __FILE__, __LINE__);
+#endif
+    }
+    if (!mDriveServerPort.empty()) {
+        mDriveServer = new cDriveServer(mDriveServerPort, mDevice);
+        mDriveServer->Start();
+    }
     return true;
 }
 
 void cPluginCdplayer::Stop(void)
 {
   // Stop any background activities the plugin is performing.
+    mSinks.Clear();
+    delete mDriveServer;
+    mDriveServer = NULL;
+    delete mRecorder;
+    mRecorder = NULL;
     cMutexLock MutexLock(&mCdMutex);
     if (mCdControl != NULL) {
         mCdControl->ProcessKey(kStop);
@@ -163,6 +260,10 @@ const char *cPluginCdplayer::MainMenuEntry(void)
 cOsdObject *cPluginCdplayer::MainMenuAction(void)
 {
     dsyslog("MainMenuAction");
+    if (mShowLibrary) {
+        mShowLibrary = false;
+        return new cMenuLibrary;
+    }
     cMutexLock MutexLock(&mCdMutex);
     mCdControl = new cCdControl();
     cControl::Launch(mCdControl);
@@ -191,6 +292,35 @@ bool cPluginCdplayer::Service(const char *Id, void *Data)
         }
         return true;
     }
+    if (strcmp(Id, CDPLAYER_GET_STATE_ID) == 0) {
+        if (Data != NULL) {
+            CdPlayer_GetState_1_0 *st = (CdPlayer_GetState_1_0 *)Data;
+            CD_PLAY_STATE_T ps;
+            mPlayState.Get(ps);
+            st->track = (ps.mNumTracks > 0) ? ps.mTrack + 1 : 0;
+            st->numTracks = ps.mNumTracks;
+            st->position = ps.mPosition;
+            st->length = ps.mLength;
+            st->playing = (ps.mState == BCDIO_PLAY);
+            st->speed = ps.mSpeed;
+            st->bufferFill = ps.mBufferFill;
+            st->cddbInfo = ps.mCddbInfo;
+            st->random = ps.mRandom;
+        }
+        return true;
+    }
+    if (strcmp(Id, CDPLAYER_GET_SPECTRUM_ID) == 0) {
+        if (Data != NULL) {
+            mSpectrum.Get(*(CdPlayer_GetSpectrum_1_0 *)Data);
+        }
+        return true;
+    }
+    if (strcmp(Id, CDPLAYER_PCM_TAP_ID) == 0) {
+        if (Data != NULL) {
+            return mPcmTap.Service(*(CdPlayer_PcmTap_1_0 *)Data);
+        }
+        return true;
+    }
     return false;
 }
 
@@ -202,13 +332,410 @@ const char **cPluginCdplayer::SVDRPHelpPages(void)
             "STOP:  Stop\n",
             "NEXT:  Next title\n",
             "PREV:  Previous title\n",
+            "STAT:  Show playback state\n",
+            "IMPORT <dir>\n"
+            "    Import the xmcd files of a freedb/gnudb dump or CDDB cache\n"
+            "    (<dir>/<category>/<discid>) into the offline CDDB index\n",
+            "SEARCH <words>\n"
+            "    Search the library for discs and tracks containing all words\n",
+            "QUEUE [ADD <tracks> | CLEAR | SAVE <name> | LOAD <name> | NAMES]\n"
+            "    List the play queue, add tracks of the inserted disc, clear it,\n"
+            "    save it, load a saved queue or list the saved queues\n",
+            "SHUFFLE [seed]\n"
+            "    Play the tracks in random order, the same seed gives the\n"
+            "    same order\n",
+            "SINK [WAV <file> | FLAC <file> | UDP <host>:<port> |\n"
+            "      RTP <host>:<port> | HTTP [<address>:]<port> |\n"
+            "      ALSA <device> | NULL | DEL <n>]\n"
+            "    List the additional outputs of the played audio, add a WAV\n"
+            "    or FLAC file, a UDP or RTP stream, an HTTP server, an ALSA\n"
+            "    device or a null sink, or remove output <n>\n",
+            "BENCH [sectors]\n"
+            "    Compare the CPU time of the PES and the TS output for\n"
+            "    packetizing the given number of sectors\n",
+            "RECORD [ALL | <tracks> | STOP]\n"
+            "    Show the progress of the recording, record the disc or the\n"
+            "    given tracks as VDR recording or stop the recording\n",
             NULL
     };
     return HelpPages;
 }
 
-cString cPluginCdplayer::SVDRPCommand(const char *Command, UNUSED_ARG const char *Option, UNUSED_ARG int &ReplyCode)
+// Handle the QUEUE command, the first word of the option is the action
+cString cPluginCdplayer::QueueCommand(const char *Option, int &ReplyCode)
+{
+    std::string action, arg;
+    std::string reply;
+    char buf[64];
+
+    if (Option != NULL) {
+        std::istringstream is(Option);
+        is >> action;
+        std::getline(is >> std::ws, arg);
+    }
+    if (action.empty()) {
+        std::vector<PL_QUEUE_ENTRY_T> entries;
+        mPlayQueue.Get(entries);
+        if (entries.empty()) {
+            ReplyCode = 550;
+            return "Queue is empty";
+        }
+        for (size_t i = 0; i < entries.size(); i++) {
+            LIB_DISC_INFO_T info;
+            const PL_QUEUE_ENTRY_T &e = entries[i];
+            if (!reply.empty()) {
+                reply += "\n";
+            }
+            snprintf(buf, sizeof(buf), "%08x %2d ", e.mKey.mCddbId,
+                     e.mTrack + 1);
+            reply += buf;
+            if (mLibrary.Lookup(e.mKey, info) &&
+                (e.mTrack < (int)info.mTrackTitle.size())) {
+                reply += info.mPerformer + " - " + info.mTrackTitle[e.mTrack];
+            }
+        }
+        return reply.c_str();
+    }
+    if (strcasecmp(action.c_str(), "ADD") == 0) {
+        std::istringstream is(arg);
+        int track;
+        int added = 0;
+        while (is >> track) {
+            if (!mPlayQueue.Add(track - 1)) {
+                ReplyCode = 501;
+                return cString::sprintf("Invalid track %d", track);
+            }
+            added++;
+        }
+        if (added == 0) {
+            ReplyCode = 501;
+            return "Missing tracks";
+        }
+        return cString::sprintf("%d tracks queued", added);
+    }
+    if (strcasecmp(action.c_str(), "CLEAR") == 0) {
+        mPlayQueue.Clear();
+        return "Queue cleared";
+    }
+    if (strcasecmp(action.c_str(), "SAVE") == 0) {
+        if (!mPlayQueue.Save(arg)) {
+            ReplyCode = 550;
+            return cString::sprintf("Can not save queue \"%s\"", arg.c_str());
+        }
+        return "Queue saved";
+    }
+    if (strcasecmp(action.c_str(), "LOAD") == 0) {
+        if (!mPlayQueue.Load(arg)) {
+            ReplyCode = 550;
+            return cString::sprintf("Can not load queue \"%s\"", arg.c_str());
+        }
+        return "Queue loaded";
+    }
+    if (strcasecmp(action.c_str(), "NAMES") == 0) {
+        std::vector<std::string> names;
+        cPlayQueue::GetNames(names);
+        if (names.empty()) {
+            ReplyCode = 550;
+            return "No saved queues";
+        }
+        for (size_t i = 0; i < names.size(); i++) {
+            if (!reply.empty()) {
+                reply += "\n";
+            }
+            reply += names[i];
+        }
+        return reply.c_str();
+    }
+    ReplyCode = 501;
+    return cString::sprintf("Unknown action \"%s\"", action.c_str());
+}
+
+// Handle the SINK command, the first word of the option is the sink type
+cString cPluginCdplayer::SinkCommand(const char *Option, int &ReplyCode)
+{
+    std::string action, arg;
+
+    if (Option != NULL) {
+        std::istringstream is(Option);
+        is >> action;
+        std::getline(is >> std::ws, arg);
+    }
+    if (action.empty()) {
+        std::string reply = mSinks.List();
+        if (reply.empty()) {
+            ReplyCode = 550;
+            return "No sinks";
+        }
+        return reply.c_str();
+    }
+    if (strcasecmp(action.c_str(), "WAV") == 0) {
+        if (arg.empty()) {
+            ReplyCode = 501;
+            return "Missing file name";
+        }
+        mSinks.Add(new cWavSink(arg));
+        return "Sink added";
+    }
+#ifdef USE_FLAC
+    if (strcasecmp(action.c_str(), "FLAC") == 0) {
+        if (arg.empty()) {
+            ReplyCode = 501;
+            return "Missing file name";
+        }
+        mSinks.Add(new cFlacSink(arg));
+        return "Sink added";
+    }
+#endif
+    if ((strcasecmp(action.c_str(), "UDP") == 0) ||
+        (strcasecmp(action.c_str(), "RTP") == 0)) {
+        size_t colon = arg.rfind(':');
+        if ((colon == std::string::npos) || (colon == 0) ||
+            (colon + 1 == arg.size())) {
+            ReplyCode = 501;
+            return "Missing <host>:<port>";
+        }
+        if (strcasecmp(action.c_str(), "RTP") == 0) {
+            mSinks.Add(new cRtpSink(arg.substr(0, colon),
+                                    arg.substr(colon + 1)));
+        }
+        else {
+            mSinks.Add(new cUdpSink(arg.substr(0, colon),
+                                    arg.substr(colon + 1)));
+        }
+        return "Sink added";
+    }
+    if (strcasecmp(action.c_str(), "HTTP") == 0) {
+        if (arg.empty()) {
+            ReplyCode = 501;
+            return "Missing port";
+        }
+        mSinks.Add(new cHttpSink(arg));
+        return "Sink added";
+    }
+#ifdef USE_ALSA
+    if (strcasecmp(action.c_str(), "ALSA") == 0) {
+        if (arg.empty()) {
+            ReplyCode = 501;
+            return "Missing device";
+        }
+        mSinks.Add(new cAlsaSink(arg));
+        return "Sink added";
+    }
+#endif
+    if (strcasecmp(action.c_str(), "NULL") == 0) {
+        mSinks.Add(new cNullSink());
+        return "Sink added";
+    }
+    if (strcasecmp(action.c_str(), "DEL") == 0) {
+        int idx = atoi(arg.c_str());
+        if ((idx <= 0) || !mSinks.Remove(idx - 1)) {
+            ReplyCode = 550;
+            return "No such sink";
+        }
+        return "Sink removed";
+    }
+    ReplyCode = 501;
+    return cString::sprintf("Unknown sink \"%s\"", action.c_str());
+}
+
+// Handle the RECORD command
+cString cPluginCdplayer::RecordCommand(const char *Option, int &ReplyCode)
 {
+    std::vector<int> tracks;
+    std::string action;
+
+    if (Option != NULL) {
+        std::istringstream is(Option);
+        is >> action;
+    }
+    if (action.empty()) {
+        if (mRecorder == NULL) {
+            ReplyCode = 550;
+            return "No recording";
+        }
+        return mRecorder->GetProgress().c_str();
+    }
+    if (strcasecmp(action.c_str(), "STOP") == 0) {
+        if ((mRecorder == NULL) || !mRecorder->Active()) {
+            ReplyCode = 550;
+            return "No recording running";
+        }
+        mRecorder->Abort();
+        return "Recording stopped";
+    }
+    if (strcasecmp(action.c_str(), "ALL") != 0) {
+        std::istringstream is(Option);
+        int track;
+        while (is >> track) {
+            if ((track < 1) || (track > CDIO_CD_MAX_TRACKS)) {
+                ReplyCode = 501;
+                return cString::sprintf("Invalid track %d", track);
+            }
+            tracks.push_back(track);
+        }
+        if (!is.eof() || tracks.empty()) {
+            ReplyCode = 501;
+            return cString::sprintf("Invalid tracks \"%s\"", Option);
+        }
+    }
+    if ((mRecorder != NULL) && mRecorder->Active()) {
+        ReplyCode = 550;
+        return "Recording already running";
+    }
+    delete mRecorder;
+    mRecorder = new cDiscRecorder(mDevice, tracks);
+    mRecorder->Start();
+    return "Recording started";
+}
+
+// CPU time of the thread in microseconds
+static uint64_t BenchTime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Handle the BENCH command: packetize sectors as the player does for the
+// PES and for the TS output, without a device
+cString cPluginCdplayer::BenchCommand(const char *Option, int &ReplyCode)
+{
+    int sectors = BENCH_SECTORS;
+    uint8_t *data;
+    uint8_t pesbuf[CDIO_CD_FRAMESIZE_RAW];
+    uint8_t tsbuf[TSMUX_PATPMT_SIZE + TSMUX_SECTOR_SIZE];
+    cPesAudioConverter converter;
+    cTsMux mux;
+    uint64_t pesbytes = 0, tsbytes = 0;
+    uint64_t start, pestime, tstime;
+    unsigned int check = 0;
+
+    if ((Option != NULL) && (*Option != '\0')) {
+        sectors = atoi(Option);
+        if ((sectors <= 0) || (sectors > BENCH_MAX_SECTORS)) {
+            ReplyCode = 501;
+            return cString::sprintf("Invalid number of sectors \"%s\"",
+                                    Option);
+        }
+    }
+    // One second of audio, reused
+    data = (uint8_t *)malloc(CDIO_CD_FRAMES_PER_SEC * CDIO_CD_FRAMESIZE_RAW);
+    if (data == NULL) {
+        esyslog("%s %d Out of memory", __FILE__, __LINE__);
+        ReplyCode = 451;
+        return "Out of memory";
+    }
+    for (int i = 0; i < CDIO_CD_FRAMES_PER_SEC * CDIO_CD_FRAMESIZE_RAW; i++) {
+        data[i] = rand();
+    }
+    start = BenchTime();
+    for (int i = 0; i < sectors; i++) {
+        const uint8_t *buf = data + (i % CDIO_CD_FRAMES_PER_SEC) *
+                                    CDIO_CD_FRAMESIZE_RAW;
+        for (int idx = 0; idx < CDIO_CD_FRAMESIZE_RAW;
+             idx += CDIO_CD_FRAMESIZE_RAW / 2) {
+            converter.SetFreq(PCM_FREQ_44100);
+            converter.SetData(&buf[idx], CDIO_CD_FRAMESIZE_RAW / 2);
+            memcpy(pesbuf, converter.GetPesData(), converter.GetPesLength());
+            pesbytes += converter.GetPesLength();
+            check += pesbuf[PES_HEADER_LEN + LPCM_HEADER_LEN];
+        }
+    }
+    pestime = BenchTime() - start;
+    start = BenchTime();
+    for (int i = 0; i < sectors; i++) {
+        const uint8_t *buf = data + (i % CDIO_CD_FRAMES_PER_SEC) *
+                                    CDIO_CD_FRAMESIZE_RAW;
+        int len = 0;
+        if ((i % CDIO_CD_FRAMES_PER_SEC) == 0) {
+            len = mux.PutPatPmt(tsbuf);
+        }
+        mux.SetFreq(PCM_FREQ_44100);
+        len += mux.PutSector(tsbuf + len, buf,
+                             TSMUX_PTS_START + i * TSMUX_PTS_PER_SECTOR);
+        tsbytes += len;
+        check += tsbuf[len - 1];
+    }
+    tstime = BenchTime() - start;
+    free(data);
+    dsyslog("%s %d Bench check %u", __FILE__, __LINE__, check);
+    return cString::sprintf("%d sectors\n"
+            "PES: %llu us, %.3f us/sector, %llu bytes/sector\n"
+            "TS:  %llu us, %.3f us/sector, %llu bytes/sector",
+            sectors,
+            (unsigned long long)pestime, (double)pestime / sectors,
+            (unsigned long long)(pesbytes / sectors),
+            (unsigned long long)tstime, (double)tstime / sectors,
+            (unsigned long long)(tsbytes / sectors));
+}
+
+cString cPluginCdplayer::SVDRPCommand(const char *Command, const char *Option, int &ReplyCode)
+{
+    if (strcasecmp(Command, "IMPORT") == 0) {
+        if ((Option == NULL) || (*Option == '\0')) {
+            ReplyCode = 501;
+            return "Missing directory";
+        }
+        if (!mCddbIndex.StartImport(Option)) {
+            ReplyCode = 550;
+            return "Import already running";
+        }
+        return cString::sprintf("Import of %s into %s started", Option,
+                                mCDDBIndexFile.c_str());
+    }
+    if (strcasecmp(Command, "SEARCH") == 0) {
+        std::vector<LIB_HIT_T> hits;
+        std::string reply;
+        char buf[512];
+        if ((Option == NULL) || (*Option == '\0')) {
+            ReplyCode = 501;
+            return "Missing search words";
+        }
+        if (mLibrary.Search(Option, hits) == 0) {
+            ReplyCode = 550;
+            return "Nothing found";
+        }
+        for (size_t i = 0; i < hits.size(); i++) {
+            snprintf(buf, sizeof(buf), "%08x %s - %s", hits[i].mKey.mCddbId,
+                     hits[i].mPerformer.c_str(), hits[i].mTitle.c_str());
+            if (!reply.empty()) {
+                reply += "\n";
+            }
+            reply += buf;
+            if (hits[i].mTrack >= 0) {
+                snprintf(buf, sizeof(buf), " (%d. %s)", hits[i].mTrack + 1,
+                         hits[i].mTrackTitle.c_str());
+                reply += buf;
+            }
+        }
+        return reply.c_str();
+    }
+    if (strcasecmp(Command, "QUEUE") == 0) {
+        return QueueCommand(Option, ReplyCode);
+    }
+    if (strcasecmp(Command, "SINK") == 0) {
+        return SinkCommand(Option, ReplyCode);
+    }
+    if (strcasecmp(Command, "RECORD") == 0) {
+        return RecordCommand(Option, ReplyCode);
+    }
+    if (strcasecmp(Command, "BENCH") == 0) {
+        return BenchCommand(Option, ReplyCode);
+    }
+    if (strcasecmp(Command, "STAT") == 0) {
+        CD_PLAY_STATE_T ps;
+        mPlayState.Get(ps);
+        if ((ps.mState == BCDIO_STOP) || (ps.mNumTracks == 0)) {
+            return "stopped";
+        }
+        return cString::sprintf("%s track %d/%d %d:%02d/%d:%02d buffer %d%%",
+                                (ps.mState == BCDIO_PLAY) ? "playing" : "paused",
+                                ps.mTrack + 1, ps.mNumTracks,
+                                ps.mPosition / 60, ps.mPosition % 60,
+                                ps.mLength / 60, ps.mLength % 60,
+                                ps.mBufferFill);
+    }
     cMutexLock MutexLock(&mCdMutex);
     if ((strcasecmp(Command, "PLAY") == 0) && (mCdControl == NULL)) {
         cRemote::CallPlugin(Name());
@@ -230,6 +757,9 @@ cString cPluginCdplayer::SVDRPCommand(const char *Command, UNUSED_ARG const char
         else if (strcasecmp(Command, "PREV") == 0) {
             mCdControl->ProcessKey(kPrev);
         }
+        else if (strcasecmp(Command, "SHUFFLE") == 0) {
+            mCdControl->Shuffle((Option != NULL) ? strtoul(Option, NULL, 0) : 0);
+        }
         else {
             return NULL;
         }
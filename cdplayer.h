@@ -25,6 +25,18 @@
 #include <cctype>
 #include <string>
 #include "cd_control.h"
+#include "cddbclient.h"
+#include "cddbindex.h"
+#include "cdfingerprint.h"
+#include "library.h"
+#include "playlist.h"
+#include "spectrum.h"
+#include "pcmtap.h"
+#include "outputsink.h"
+#include "streamsink.h"
+#include "remotedrive.h"
+#include "discrecorder.h"
+#include "alsasink.h"
 
 static const char *VERSION        = "1.2.4";
 static const char *DESCRIPTION    = trNOOP("CD-Player");
@@ -36,12 +48,35 @@ private:
     static std::string mcfgDir;
     static std::string mCDDBServer;
     static std::string mCDDBCacheDir;
+    static std::string mCDDBIndexFile;
+    static std::string mRipDir;
+    static std::string mHttpPort;
+    static std::string mRemoteDrive;
+    static std::string mAlsaDevice;
+    static std::string mDriveServerPort;
     static bool mEnableCDDB;
     static bool mEnableCDDBCache;
+    static cCdPlayState mPlayState;
+    static cCddbClient mCddbClient;
+    static cCddbIndex mCddbIndex;
+    static cFingerprintIndex mFingerprintIndex;
+    static cLibrary mLibrary;
+    static bool mShowLibrary;
+    static cPlayQueue mPlayQueue;
+    static cSpectrum mSpectrum;
+    static cPcmTap mPcmTap;
+    static cSinkList mSinks;
 
     bool mShowMainMenu;
     cCdControl *mCdControl;
+    cDriveServer *mDriveServer;
+    cDiscRecorder *mRecorder;
     cMutex mCdMutex;
+
+    cString QueueCommand(const char *Option, int &ReplyCode);
+    cString SinkCommand(const char *Option, int &ReplyCode);
+    cString RecordCommand(const char *Option, int &ReplyCode);
+    cString BenchCommand(const char *Option, int &ReplyCode);
 public:
     cPluginCdplayer(void);
     virtual ~cPluginCdplayer() {if (mCdControl != NULL) delete mCdControl;}
@@ -79,18 +114,61 @@ public:
     static const std::string GetDeviceName(void) {
         return mDevice;
     }
+    // New source of the sectors of device, or of the drive server
+    // host[:port] if set
+    static cSectorSource *NewSectorSource(const std::string &device);
     static const std::string GetCDDBServer(void) {
         return mCDDBServer;
     }
     static const std::string GetCDDBCacheDir (void) {
         return mCDDBCacheDir;
     }
+    // Directory for the FLAC files, one subdirectory per disc
+    static const std::string GetRipDir(void) {
+        return mRipDir.empty() ? GetConfigDir() + "rip/" : mRipDir + "/";
+    }
     static bool GetCDDBEnabled(void) {
         return mEnableCDDB;
     }
     static bool GetCDDBCacheEnabled(void) {
         return mEnableCDDBCache;
     }
+    // Snapshot of the playback state, readable without locking
+    static cCdPlayState &GetPlayState(void) {
+        return mPlayState;
+    }
+    // CDDB client shared by all discs, keeps the server connection
+    static cCddbClient &GetCddbClient(void) {
+        return mCddbClient;
+    }
+    // Offline CDDB database, searched before the server is asked
+    static cCddbIndex &GetCddbIndex(void) {
+        return mCddbIndex;
+    }
+    // Fingerprints of the tracks of known discs
+    static cFingerprintIndex &GetFingerprintIndex(void) {
+        return mFingerprintIndex;
+    }
+    // All discs played so far
+    static cLibrary &GetLibrary(void) {
+        return mLibrary;
+    }
+    // Open the library search menu instead of the player
+    static void ShowLibrary(void) {
+        mShowLibrary = true;
+    }
+    // Tracks queued by the user
+    static cPlayQueue &GetPlayQueue(void) {
+        return mPlayQueue;
+    }
+    // Band levels of the played audio
+    static cSpectrum &GetSpectrum(void) {
+        return mSpectrum;
+    }
+    // Played PCM data for other plugins
+    static cPcmTap &GetPcmTap(void) {
+        return mPcmTap;
+    }
 };
 
 static inline const char *NotNull (const char *s) { return s ? s : ""; }
@@ -0,0 +1,204 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class publishes a consistent snapshot of the playback state.
+ * Writers are serialized by a mutex, readers never lock but retry if
+ * the snapshot was modified while copying (sequence lock).
+ */
+
+#include <string.h>
+#include <cdio/cdio.h>
+#include <vdr/tools.h>
+#include "cdstate.h"
+
+cCdPlayState::cCdPlayState(void)
+{
+    mSeq = 0;
+    memset(&mState, 0, sizeof(mState));
+    mState.mState = BCDIO_STOP;
+}
+
+void cCdPlayState::Get(CD_PLAY_STATE_T &state) const
+{
+    unsigned int seq1, seq2;
+
+    do {
+        seq1 = __atomic_load_n(&mSeq, __ATOMIC_ACQUIRE);
+        memcpy(&state, (const void *)&mState, sizeof(state));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        seq2 = __atomic_load_n(&mSeq, __ATOMIC_RELAXED);
+    } while ((seq1 & 1) || (seq1 != seq2));
+}
+
+// Must be called with locked mWriteMutex
+void cCdPlayState::BeginWrite(void)
+{
+    __atomic_store_n(&mSeq, mSeq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void cCdPlayState::EndWrite(void)
+{
+    __atomic_store_n(&mSeq, mSeq + 1, __ATOMIC_RELEASE);
+}
+
+void cCdPlayState::Reset(void)
+{
+    cMutexLock MutexLock(&mWriteMutex);
+    BeginWrite();
+    mState.mTrack = 0;
+    mState.mNumTracks = 0;
+    mState.mPosition = 0;
+    mState.mLength = 0;
+    mState.mState = BCDIO_STOP;
+    mState.mBufferFill = 0;
+    mState.mCddbInfo = false;
+    mState.mLoop = CD_LOOP_OFF;
+    mState.mPlayListVersion++;
+    mState.mOffset = 0;
+    mState.mSeek = CD_SEEK_NONE;
+    EndWrite();
+}
+
+void cCdPlayState::SetPosition(int track, int offset, int length)
+{
+    cMutexLock MutexLock(&mWriteMutex);
+    if ((mState.mTrack == track) && (mState.mOffset == offset) &&
+        (mState.mLength == length)) {
+        return;
+    }
+    BeginWrite();
+    mState.mTrack = track;
+    mState.mOffset = offset;
+    mState.mPosition = offset / CDIO_CD_FRAMES_PER_SEC;
+    mState.mLength = length;
+    EndWrite();
+}
+
+void cCdPlayState::SetState(BUFCDIO_STATE_T state)
+{
+    cMutexLock MutexLock(&mWriteMutex);
+    if (mState.mState == state) {
+        return;
+    }
+    BeginWrite();
+    mState.mState = state;
+    EndWrite();
+}
+
+void cCdPlayState::SetSpeed(int speed)
+{
+    cMutexLock MutexLock(&mWriteMutex);
+    if (mState.mSpeed == speed) {
+        return;
+    }
+    BeginWrite();
+    mState.mSpeed = speed;
+    EndWrite();
+}
+
+void cCdPlayState::SetBufferFill(int percent)
+{
+    cMutexLock MutexLock(&mWriteMutex);
+    if (mState.mBufferFill == percent) {
+        return;
+    }
+    BeginWrite();
+    mState.mBufferFill = percent;
+    EndWrite();
+}
+
+void cCdPlayState::SetNumTracks(int numtracks)
+{
+    cMutexLock MutexLock(&mWriteMutex);
+    if (mState.mNumTracks == numtracks) {
+        return;
+    }
+    BeginWrite();
+    mState.mNumTracks = numtracks;
+    EndWrite();
+}
+
+void cCdPlayState::SetCddbInfo(bool avail)
+{
+    cMutexLock MutexLock(&mWriteMutex);
+    if (mState.mCddbInfo == avail) {
+        return;
+    }
+    BeginWrite();
+    mState.mCddbInfo = avail;
+    EndWrite();
+}
+
+void cCdPlayState::SetLoop(CD_LOOP_T loop)
+{
+    cMutexLock MutexLock(&mWriteMutex);
+    if (mState.mLoop == loop) {
+        return;
+    }
+    BeginWrite();
+    mState.mLoop = loop;
+    EndWrite();
+}
+
+void cCdPlayState::SetPlayList(bool random)
+{
+    cMutexLock MutexLock(&mWriteMutex);
+    BeginWrite();
+    mState.mRandom = random;
+    mState.mPlayListVersion++;
+    // The target is a playlist index of the old list
+    mState.mSeek = CD_SEEK_NONE;
+    EndWrite();
+}
+
+void cCdPlayState::SetVerified(void)
+{
+    cMutexLock MutexLock(&mWriteMutex);
+    BeginWrite();
+    mState.mVerifyVersion++;
+    EndWrite();
+}
+
+void cCdPlayState::SetSeek(int track, int offset)
+{
+    cMutexLock MutexLock(&mWriteMutex);
+    BeginWrite();
+    mState.mSeek = CD_SEEK_PENDING;
+    mState.mSeekTrack = track;
+    mState.mSeekOffset = offset;
+    mState.mSeekTime = cTimeMs::Now();
+    EndWrite();
+}
+
+bool cCdPlayState::CommitSeek(uint64_t settle, int &track, int &offset)
+{
+    cMutexLock MutexLock(&mWriteMutex);
+    if ((mState.mSeek != CD_SEEK_PENDING) ||
+        (cTimeMs::Now() - mState.mSeekTime < settle)) {
+        return false;
+    }
+    BeginWrite();
+    mState.mSeek = CD_SEEK_COMMITTED;
+    mState.mSeekTime = cTimeMs::Now();
+    EndWrite();
+    track = mState.mSeekTrack;
+    offset = mState.mSeekOffset;
+    return true;
+}
+
+void cCdPlayState::SeekDone(void)
+{
+    cMutexLock MutexLock(&mWriteMutex);
+    if (mState.mSeek != CD_SEEK_COMMITTED) {
+        return;
+    }
+    BeginWrite();
+    mState.mSeek = CD_SEEK_NONE;
+    EndWrite();
+}
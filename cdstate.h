@@ -0,0 +1,98 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class publishes a consistent snapshot of the playback state.
+ * Writers are serialized by a mutex, readers never lock but retry if
+ * the snapshot was modified while copying (sequence lock).
+ */
+
+#ifndef __CDSTATE_H__
+#define __CDSTATE_H__
+
+#include <stdint.h>
+#include <vdr/thread.h>
+
+typedef enum _bufcdio_state {
+    BCDIO_STOP = 0,
+    BCDIO_STARTING,
+    BCDIO_OPEN_DEVICE,
+    BCDIO_PAUSE,
+    BCDIO_PLAY,
+    BCDIO_NEWTIME,
+    BCDIO_FAILED
+} BUFCDIO_STATE_T;
+
+typedef enum _cd_loop {
+    CD_LOOP_OFF = 0,
+    CD_LOOP_A,          // Loop start set, waiting for the end
+    CD_LOOP_AB,         // Repeat from loop start to end
+    CD_LOOP_TRACK       // Repeat the current track
+} CD_LOOP_T;
+
+typedef enum _cd_seek {
+    CD_SEEK_NONE = 0,
+    CD_SEEK_PENDING,    // Collecting track and time changes
+    CD_SEEK_COMMITTED   // Sent to the reader, maybe not yet executed
+} CD_SEEK_T;
+
+typedef struct _cd_play_state {
+    int mTrack;         // Playlist index of the current track
+    int mNumTracks;     // Number of audio tracks
+    int mPosition;      // Played seconds of current track
+    int mOffset;        // Played blocks of current track
+    int mLength;        // Length of current track in seconds
+    BUFCDIO_STATE_T mState;
+    int mSpeed;         // Replay speed index
+    int mBufferFill;    // Fill level of the ring buffer in percent
+    bool mCddbInfo;     // CDDB information available
+    bool mRandom;       // Shuffle mode
+    CD_LOOP_T mLoop;    // Repeated segment
+    unsigned int mPlayListVersion; // Incremented on every new playlist
+    unsigned int mVerifyVersion;   // Incremented when a track was verified
+    CD_SEEK_T mSeek;
+    int mSeekTrack;     // Playlist index of the seek target
+    int mSeekOffset;    // Blocks after the start of mSeekTrack
+    uint64_t mSeekTime; // cTimeMs::Now() of the last seek change
+} CD_PLAY_STATE_T;
+
+class cCdPlayState {
+private:
+    unsigned int mSeq;      // Odd while a writer modifies mState
+    CD_PLAY_STATE_T mState;
+    cMutex mWriteMutex;
+
+    void BeginWrite(void);
+    void EndWrite(void);
+public:
+    cCdPlayState(void);
+    // Get a consistent copy of the current state, never blocks
+    void Get(CD_PLAY_STATE_T &state) const;
+
+    void Reset(void);
+    // Offset in blocks, length in seconds
+    void SetPosition(int track, int offset, int length);
+    void SetState(BUFCDIO_STATE_T state);
+    void SetSpeed(int speed);
+    void SetBufferFill(int percent);
+    void SetNumTracks(int numtracks);
+    void SetCddbInfo(bool avail);
+    // A new playlist was set, random gives the play mode
+    void SetPlayList(bool random);
+    void SetLoop(CD_LOOP_T loop);
+    // The AccurateRip result of a track is available
+    void SetVerified(void);
+    // A new seek target, replaces a pending one. A new playlist drops it.
+    void SetSeek(int track, int offset);
+    // Hand a pending target unchanged for settle ms to the reader.
+    // Returns false if there is none.
+    bool CommitSeek(uint64_t settle, int &track, int &offset);
+    // The reader executed a committed seek
+    void SeekDone(void);
+};
+
+#endif
@@ -0,0 +1,230 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class passes the OSD contents to the cStatus observers.
+ */
+
+#include <vdr/status.h>
+#include "cdstatus.h"
+#include "cdmenu.h"
+
+cCdStatusPublisher::cCdStatusPublisher(const char *menukind)
+    : cThread("cdplayer status"), mDirty(false), mMenuKind(menukind)
+{
+    mWanted.mOpen = false;
+    mWanted.mGeneration = 0;
+    mPublished.mOpen = false;
+    mPublished.mGeneration = 0;
+}
+
+cCdStatusPublisher::~cCdStatusPublisher()
+{
+    Cancel(3);
+    // Send the final state, normally the close of the menu
+    cMutexLock MutexLock(&mMutex);
+    if (mDirty) {
+        Publish(mWanted);
+        mDirty = false;
+    }
+}
+
+void cCdStatusPublisher::ResetContents(CD_OSD_STATUS_T &st)
+{
+    st.mTitle.clear();
+    for (int i = 0; i < CDSTATUS_HELP_KEYS; i++) {
+        st.mHelp[i].clear();
+    }
+    st.mItems.clear();
+    st.mCurrent.clear();
+}
+
+// Must be called with locked mMutex
+void cCdStatusPublisher::Changed(void)
+{
+    mDirty = true;
+    mCond.Broadcast();
+}
+
+void cCdStatusPublisher::Open(void)
+{
+    cMutexLock MutexLock(&mMutex);
+    if (!mWanted.mOpen) {
+        mWanted.mOpen = true;
+        Changed();
+    }
+}
+
+void cCdStatusPublisher::Close(void)
+{
+    cMutexLock MutexLock(&mMutex);
+    if (mWanted.mOpen) {
+        mWanted.mOpen = false;
+        ResetContents(mWanted);
+        Changed();
+    }
+}
+
+void cCdStatusPublisher::Clear(void)
+{
+    cMutexLock MutexLock(&mMutex);
+    mWanted.mGeneration++;
+    ResetContents(mWanted);
+    Changed();
+}
+
+void cCdStatusPublisher::SetTitle(const char *title)
+{
+    cMutexLock MutexLock(&mMutex);
+    if (mWanted.mTitle != title) {
+        mWanted.mTitle = title;
+        Changed();
+    }
+}
+
+void cCdStatusPublisher::SetHelpKeys(const char *red, const char *green,
+                                     const char *yellow, const char *blue)
+{
+    const char *keys[CDSTATUS_HELP_KEYS] = {red, green, yellow, blue};
+    cMutexLock MutexLock(&mMutex);
+
+    for (int i = 0; i < CDSTATUS_HELP_KEYS; i++) {
+        const char *key = (keys[i] != NULL) ? keys[i] : "";
+        if (mWanted.mHelp[i] != key) {
+            mWanted.mHelp[i] = key;
+            Changed();
+        }
+    }
+}
+
+void cCdStatusPublisher::SetItem(const char *text, int index)
+{
+    cMutexLock MutexLock(&mMutex);
+    if (index >= (int)mWanted.mItems.size()) {
+        mWanted.mItems.resize(index + 1);
+    }
+    if (mWanted.mItems[index] != text) {
+        mWanted.mItems[index] = text;
+        Changed();
+    }
+}
+
+void cCdStatusPublisher::TruncateItems(int count)
+{
+    cMutexLock MutexLock(&mMutex);
+    if (count < (int)mWanted.mItems.size()) {
+        mWanted.mItems.resize(count);
+        Changed();
+    }
+}
+
+void cCdStatusPublisher::SetCurrentItem(const char *text)
+{
+    cMutexLock MutexLock(&mMutex);
+    if (mWanted.mCurrent != text) {
+        mWanted.mCurrent = text;
+        Changed();
+    }
+}
+
+// Send the differences between st and mPublished to the observers
+void cCdStatusPublisher::Publish(const CD_OSD_STATUS_T &st)
+{
+    bool help = false;
+
+    if (st.mOpen != mPublished.mOpen) {
+        mPublished.mOpen = st.mOpen;
+        if (!st.mOpen) {
+            cStatus::MsgOsdClear();
+#ifdef USE_GRAPHTFT
+            cStatus::MsgOsdMenuDestroy();
+#endif
+            mPublished.mGeneration = st.mGeneration;
+            ResetContents(mPublished);
+            return;
+        }
+#ifdef USE_GRAPHTFT
+        cStatus::MsgOsdMenuDestroy();
+#if VDRVERSNUM >= 20200
+        cStatus::MsgOsdMenuDisplay(mcText);
+#else
+        cStatus::MsgOsdMenuDisplay(mMenuKind);
+#endif
+#endif
+    }
+    if (!st.mOpen) {
+        return;
+    }
+    // Observers can not remove single items, so start from scratch if
+    // the list got shorter.
+    if ((st.mGeneration != mPublished.mGeneration) ||
+        (st.mItems.size() < mPublished.mItems.size())) {
+        cStatus::MsgOsdClear();
+        mPublished.mGeneration = st.mGeneration;
+        ResetContents(mPublished);
+    }
+    if (st.mTitle != mPublished.mTitle) {
+        cStatus::MsgOsdTitle(st.mTitle.c_str());
+        mPublished.mTitle = st.mTitle;
+    }
+    for (int i = 0; i < CDSTATUS_HELP_KEYS; i++) {
+        if (st.mHelp[i] != mPublished.mHelp[i]) {
+            help = true;
+            mPublished.mHelp[i] = st.mHelp[i];
+        }
+    }
+    if (help) {
+        cStatus::MsgOsdHelpKeys(mPublished.mHelp[0].c_str(),
+                                mPublished.mHelp[1].c_str(),
+                                mPublished.mHelp[2].c_str(),
+                                mPublished.mHelp[3].c_str());
+    }
+    mPublished.mItems.resize(st.mItems.size());
+    for (unsigned int i = 0; i < st.mItems.size(); i++) {
+        if (st.mItems[i] != mPublished.mItems[i]) {
+            cStatus::MsgOsdItem(st.mItems[i].c_str(), i);
+            mPublished.mItems[i] = st.mItems[i];
+        }
+    }
+    if (st.mCurrent != mPublished.mCurrent) {
+        if (!st.mCurrent.empty()) {
+            cStatus::MsgOsdCurrentItem(st.mCurrent.c_str());
+        }
+        mPublished.mCurrent = st.mCurrent;
+    }
+}
+
+void cCdStatusPublisher::Action(void)
+{
+    CD_OSD_STATUS_T st;
+    uint64_t last = 0;
+
+    dsyslog("%s %d status publisher started", __FILE__, __LINE__);
+    while (Running()) {
+        mMutex.Lock();
+        while (!mDirty && Running()) {
+            mCond.TimedWait(mMutex, 100);
+        }
+        mMutex.Unlock();
+        if (!Running()) {
+            break;
+        }
+        // Collect further changes until the minimum interval has elapsed
+        uint64_t interval = 1000 / cMenuCDPlayer::GetStatusRate();
+        uint64_t elapsed = cTimeMs::Now() - last;
+        if (elapsed < interval) {
+            cCondWait::SleepMs(interval - elapsed);
+        }
+        mMutex.Lock();
+        st = mWanted;
+        mDirty = false;
+        mMutex.Unlock();
+        Publish(st);
+        last = cTimeMs::Now();
+    }
+    dsyslog("%s %d status publisher stopped", __FILE__, __LINE__);
+}
@@ -0,0 +1,63 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class passes the OSD contents to the cStatus observers (graphtft,
+ * lcdproc, ...). The control only records what should be shown, a
+ * separate thread sends the differences to the last publish at a limited
+ * rate, so slow observers do not delay the key processing.
+ */
+
+#ifndef __CDSTATUS_H__
+#define __CDSTATUS_H__
+
+#include <string>
+#include <vector>
+#include <vdr/thread.h>
+
+#define CDSTATUS_HELP_KEYS 4
+
+typedef struct _cd_osd_status {
+    bool mOpen;                 // Playlist menu is shown
+    unsigned int mGeneration;   // Incremented when the menu is cleared
+    std::string mTitle;
+    std::string mHelp[CDSTATUS_HELP_KEYS];
+    std::vector<std::string> mItems;
+    std::string mCurrent;
+} CD_OSD_STATUS_T;
+
+class cCdStatusPublisher: public cThread {
+private:
+    cMutex mMutex;
+    cCondVar mCond;
+    bool mDirty;
+    CD_OSD_STATUS_T mWanted;    // Requested by the control
+    CD_OSD_STATUS_T mPublished; // Last sent to the observers
+    const char *mMenuKind;
+
+    void Changed(void);
+    void Publish(const CD_OSD_STATUS_T &st);
+    static void ResetContents(CD_OSD_STATUS_T &st);
+protected:
+    virtual void Action(void);
+public:
+    cCdStatusPublisher(const char *menukind);
+    virtual ~cCdStatusPublisher();
+
+    void Open(void);
+    void Close(void);
+    void Clear(void);
+    void SetTitle(const char *title);
+    void SetHelpKeys(const char *red, const char *green, const char *yellow,
+                     const char *blue);
+    void SetItem(const char *text, int index);
+    // Remove all items from index count on
+    void TruncateItems(int count);
+    void SetCurrentItem(const char *text);
+};
+
+#endif
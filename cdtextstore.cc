@@ -0,0 +1,217 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This module implements a compact store for the CD-Text/CDDB
+ * information. All strings of a disc are interned into one memory
+ * block. The data is published as immutable, reference counted snapshot,
+ * so readers get the strings without copying and without locking.
+ */
+
+#include <map>
+#include <sched.h>
+#include <string.h>
+#include <vdr/tools.h>
+#include "cdtextstore.h"
+
+static const std::string EmptyString;
+
+/*
+ * Snapshot
+ */
+cCdTextSnapshot::cCdTextSnapshot(void)
+    : mRefCnt(1), mVersion(0), mNumTracks(0), mIndex(NULL), mArena("")
+{
+}
+
+cCdTextSnapshot::~cCdTextSnapshot()
+{
+    free(mIndex);   // Index and arena are allocated as one block
+}
+
+// Snapshot without any information, never freed
+cCdTextSnapshot *cCdTextSnapshot::Empty(void)
+{
+    static cCdTextSnapshot empty;
+    return &empty;
+}
+
+void cCdTextSnapshot::AddRef(void) const
+{
+    __atomic_add_fetch(&mRefCnt, 1, __ATOMIC_RELAXED);
+}
+
+void cCdTextSnapshot::Release(void) const
+{
+    if (__atomic_sub_fetch(&mRefCnt, 1, __ATOMIC_ACQ_REL) == 0) {
+        delete this;
+    }
+}
+
+const char *cCdTextSnapshot::GetDisc(int field) const
+{
+    if ((mIndex == NULL) || (field < 0) || (field >= MAX_CDTEXT_FIELDS)) {
+        return "";
+    }
+    return &mArena[mIndex[field]];
+}
+
+const char *cCdTextSnapshot::GetTrack(int track, int field) const
+{
+    if ((mIndex == NULL) || (track < 0) || (track >= mNumTracks) ||
+        (field < 0) || (field >= MAX_CDTEXT_FIELDS)) {
+        return "";
+    }
+    return &mArena[mIndex[(track + 1) * MAX_CDTEXT_FIELDS + field]];
+}
+
+/*
+ * Builder
+ */
+void cCdTextBuilder::Clear(void)
+{
+    mNumTracks = 0;
+    mFields.clear();
+    mFields.resize(MAX_CDTEXT_FIELDS);
+}
+
+void cCdTextBuilder::SetNumTracks(int numtracks)
+{
+    mNumTracks = numtracks;
+    mFields.resize((mNumTracks + 1) * MAX_CDTEXT_FIELDS);
+}
+
+void cCdTextBuilder::SetDisc(const CD_TEXT_T txt)
+{
+    for (int i = 0; i < MAX_CDTEXT_FIELDS; i++) {
+        mFields[i] = txt[i];
+    }
+}
+
+void cCdTextBuilder::SetTrack(int track, const CD_TEXT_T txt)
+{
+    if (track >= mNumTracks) {
+        SetNumTracks(track + 1);
+    }
+    for (int i = 0; i < MAX_CDTEXT_FIELDS; i++) {
+        mFields[(track + 1) * MAX_CDTEXT_FIELDS + i] = txt[i];
+    }
+}
+
+void cCdTextBuilder::SetDiscField(int field, const std::string &txt)
+{
+    mFields[field] = txt;
+}
+
+void cCdTextBuilder::SetTrackField(int track, int field, const std::string &txt)
+{
+    if (track < mNumTracks) {
+        mFields[(track + 1) * MAX_CDTEXT_FIELDS + field] = txt;
+    }
+}
+
+const std::string &cCdTextBuilder::GetDiscField(int field) const
+{
+    return mFields[field];
+}
+
+const std::string &cCdTextBuilder::GetTrackField(int track, int field) const
+{
+    if (track >= mNumTracks) {
+        return EmptyString;
+    }
+    return mFields[(track + 1) * MAX_CDTEXT_FIELDS + field];
+}
+
+// Build the snapshot. Identical strings (e.g. the performer of all
+// tracks) are stored only once.
+cCdTextSnapshot *cCdTextBuilder::Build(void) const
+{
+    std::map<std::string, uint32_t> interned;
+    std::map<std::string, uint32_t>::iterator it;
+    std::string arena;
+    std::vector<uint32_t> index(mFields.size());
+    size_t i;
+
+    arena.push_back('\0');  // Offset 0 is the empty string
+    interned[EmptyString] = 0;
+    for (i = 0; i < mFields.size(); i++) {
+        it = interned.find(mFields[i]);
+        if (it != interned.end()) {
+            index[i] = it->second;
+        }
+        else {
+            index[i] = arena.size();
+            interned[mFields[i]] = index[i];
+            arena.append(mFields[i]);
+            arena.push_back('\0');
+        }
+    }
+
+    size_t idxlen = index.size() * sizeof(uint32_t);
+    uint8_t *mem = (uint8_t *)malloc(idxlen + arena.size());
+    if (mem == NULL) {
+        esyslog("%s %d Out of memory", __FILE__, __LINE__);
+        cCdTextSnapshot *empty = cCdTextSnapshot::Empty();
+        empty->AddRef();
+        return empty;
+    }
+    memcpy(mem, &index[0], idxlen);
+    memcpy(mem + idxlen, arena.data(), arena.size());
+
+    cCdTextSnapshot *snap = new cCdTextSnapshot;
+    snap->mNumTracks = mNumTracks;
+    snap->mIndex = (uint32_t *)mem;
+    snap->mArena = (const char *)(mem + idxlen);
+    return snap;
+}
+
+/*
+ * Store
+ */
+cCdTextStore::cCdTextStore(void) : mReaders(0), mVersion(0)
+{
+    mCurrent = cCdTextSnapshot::Empty();
+    mCurrent->AddRef();
+}
+
+cCdTextStore::~cCdTextStore()
+{
+    mCurrent->Release();
+}
+
+void cCdTextStore::Publish(cCdTextSnapshot *snap)
+{
+    if (snap != cCdTextSnapshot::Empty()) {
+        snap->mVersion = ++mVersion;
+    }
+    const cCdTextSnapshot *old = __atomic_exchange_n(&mCurrent,
+                                     (const cCdTextSnapshot *)snap,
+                                     __ATOMIC_SEQ_CST);
+    // A reader may have fetched the old pointer but not yet incremented
+    // the reference count. This window is only a few instructions.
+    while (__atomic_load_n(&mReaders, __ATOMIC_SEQ_CST) != 0) {
+        sched_yield();
+    }
+    old->Release();
+}
+
+void cCdTextStore::Clear(void)
+{
+    cCdTextSnapshot *empty = cCdTextSnapshot::Empty();
+    empty->AddRef();
+    Publish(empty);
+}
+
+void cCdTextStore::Get(cCdTextRef &ref)
+{
+    __atomic_add_fetch(&mReaders, 1, __ATOMIC_SEQ_CST);
+    const cCdTextSnapshot *snap = __atomic_load_n(&mCurrent, __ATOMIC_SEQ_CST);
+    snap->AddRef();
+    __atomic_sub_fetch(&mReaders, 1, __ATOMIC_RELEASE);
+    ref.Set(snap);
+}
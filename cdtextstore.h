@@ -0,0 +1,109 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This module implements a compact store for the CD-Text/CDDB
+ * information. All strings of a disc are interned into one memory
+ * block. The data is published as immutable, reference counted snapshot,
+ * so readers get the strings without copying and without locking.
+ */
+
+#ifndef __CDTEXTSTORE_H__
+#define __CDTEXTSTORE_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <cdio/cdio.h>
+
+typedef std::string CD_TEXT_T[MAX_CDTEXT_FIELDS];
+
+// Immutable CD-Text information of a disc
+class cCdTextSnapshot {
+private:
+    friend class cCdTextBuilder;
+    friend class cCdTextStore;
+    mutable int mRefCnt;
+    unsigned int mVersion;  // Incremented on each publish
+    int mNumTracks;
+    uint32_t *mIndex;       // Offsets into mArena, disc info first
+    const char *mArena;     // All strings, each only once
+    cCdTextSnapshot(void);
+    ~cCdTextSnapshot();
+public:
+    static cCdTextSnapshot *Empty(void);
+    void AddRef(void) const;
+    void Release(void) const;
+    unsigned int GetVersion(void) const { return mVersion; }
+    int GetNumTracks(void) const { return mNumTracks; }
+    // Get a field of the disc information, never NULL
+    const char *GetDisc(int field) const;
+    // Get a field of a track (index in CD order), never NULL
+    const char *GetTrack(int track, int field) const;
+};
+
+// Holds a reference to a snapshot
+class cCdTextRef {
+private:
+    const cCdTextSnapshot *mSnap;
+public:
+    cCdTextRef(void) : mSnap(cCdTextSnapshot::Empty()) { mSnap->AddRef(); }
+    cCdTextRef(const cCdTextRef &ref) : mSnap(ref.mSnap) { mSnap->AddRef(); }
+    ~cCdTextRef() { mSnap->Release(); }
+    cCdTextRef &operator=(const cCdTextRef &ref) {
+        ref.mSnap->AddRef();
+        mSnap->Release();
+        mSnap = ref.mSnap;
+        return *this;
+    }
+    // Take over a reference already counted for this holder
+    void Set(const cCdTextSnapshot *snap) {
+        mSnap->Release();
+        mSnap = snap;
+    }
+    const cCdTextSnapshot *operator->() const { return mSnap; }
+};
+
+// Collects the information of a disc and builds a snapshot. Used only by
+// the writers.
+class cCdTextBuilder {
+private:
+    std::vector<std::string> mFields;   // Disc information first
+    int mNumTracks;
+public:
+    cCdTextBuilder(void) { Clear(); }
+    void Clear(void);
+    void SetNumTracks(int numtracks);
+    int GetNumTracks(void) const { return mNumTracks; }
+    void SetDisc(const CD_TEXT_T txt);
+    void SetTrack(int track, const CD_TEXT_T txt);
+    void SetDiscField(int field, const std::string &txt);
+    void SetTrackField(int track, int field, const std::string &txt);
+    const std::string &GetDiscField(int field) const;
+    const std::string &GetTrackField(int track, int field) const;
+    cCdTextSnapshot *Build(void) const;
+};
+
+// Publishes the current snapshot
+class cCdTextStore {
+private:
+    const cCdTextSnapshot *mCurrent;
+    int mReaders;       // Readers between fetching mCurrent and AddRef
+    unsigned int mVersion;
+public:
+    cCdTextStore(void);
+    ~cCdTextStore();
+    // Publish a new snapshot, the store takes over the reference.
+    // Writers must be serialized by the caller.
+    void Publish(cCdTextSnapshot *snap);
+    // Publish the empty snapshot
+    void Clear(void);
+    // Get the current snapshot, never blocks
+    void Get(cCdTextRef &ref);
+};
+
+#endif
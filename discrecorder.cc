@@ -0,0 +1,457 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements recording the disc as VDR recording.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <vdr/config.h>
+#include <vdr/recording.h>
+#include <vdr/videodir.h>
+#include "cdplayer.h"
+#include "cdmenu.h"
+#include "discrecorder.h"
+
+cRecWriter::cRecWriter(cUnbufferedFile *file) :
+    mFile(file), mHead(0), mQueued(0), mFill(0), mEnd(false), mError(false)
+{
+    SetDescription("cdplayer record writer");
+    for (int i = 0; i < REC_CHUNKS; i++) {
+        mChunks[i] = (uint8_t *)malloc(REC_CHUNK_SIZE);
+        if (mChunks[i] == NULL) {
+            esyslog("%s %d Out of memory", __FILE__, __LINE__);
+            exit(-1);
+        }
+        mLength[i] = 0;
+    }
+}
+
+cRecWriter::~cRecWriter()
+{
+    Cancel(3);
+    for (int i = 0; i < REC_CHUNKS; i++) {
+        free(mChunks[i]);
+    }
+}
+
+bool cRecWriter::Put(const uint8_t *data, int len)
+{
+    cMutexLock MutexLock(&mMutex);
+
+    while (len > 0) {
+        int idx, n;
+        while ((mQueued == REC_CHUNKS) && !mError) {
+            mCond.TimedWait(mMutex, 100);
+        }
+        if (mError) {
+            return false;
+        }
+        idx = (mHead + mQueued) % REC_CHUNKS;
+        n = REC_CHUNK_SIZE - mFill;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(mChunks[idx] + mFill, data, n);
+        mFill += n;
+        data += n;
+        len -= n;
+        if (mFill == REC_CHUNK_SIZE) {
+            mLength[idx] = mFill;
+            mQueued++;
+            mFill = 0;
+            mCond.Broadcast();
+        }
+    }
+    return true;
+}
+
+bool cRecWriter::Finish(void)
+{
+    cMutexLock MutexLock(&mMutex);
+
+    if ((mFill > 0) && !mError) {
+        while ((mQueued == REC_CHUNKS) && !mError) {
+            mCond.TimedWait(mMutex, 100);
+        }
+        mLength[(mHead + mQueued) % REC_CHUNKS] = mFill;
+        mQueued++;
+        mFill = 0;
+    }
+    mEnd = true;
+    mCond.Broadcast();
+    while ((mQueued > 0) && !mError) {
+        mCond.TimedWait(mMutex, 100);
+    }
+    return !mError;
+}
+
+void cRecWriter::Action(void)
+{
+    while (true) {
+        int idx;
+        mMutex.Lock();
+        while ((mQueued == 0) && !mEnd && Running()) {
+            mCond.TimedWait(mMutex, 100);
+        }
+        if (mQueued == 0) {
+            mMutex.Unlock();
+            break;
+        }
+        idx = mHead;
+        mMutex.Unlock();
+        // The chunk at mHead is not touched by Put while it is queued
+        if (mFile->Write(mChunks[idx], mLength[idx]) != mLength[idx]) {
+            LOG_ERROR_STR("Write recording");
+            mMutex.Lock();
+            mError = true;
+            mCond.Broadcast();
+            mMutex.Unlock();
+            break;
+        }
+        mMutex.Lock();
+        mHead = (mHead + 1) % REC_CHUNKS;
+        mQueued--;
+        mCond.Broadcast();
+        mMutex.Unlock();
+    }
+}
+
+cDiscRecorder::cDiscRecorder(const std::string &device,
+                             const std::vector<int> &tracks) :
+    mDevice(device), mSelected(tracks), mState(REC_RUNNING), mTrack(0),
+    mBlocks(0), mTotal(0), mErrors(0)
+{
+    SetDescription("cdplayer record");
+}
+
+cDiscRecorder::~cDiscRecorder()
+{
+    Cancel(10);
+}
+
+void cDiscRecorder::Fail(const std::string &msg)
+{
+    cMutexLock MutexLock(&mMutex);
+    esyslog("%s %d Recording failed: %s", __FILE__, __LINE__, msg.c_str());
+    mState = REC_FAILED;
+    mMessage = msg;
+}
+
+// Select the tracks and get their text from the CD-Text or the library
+bool cDiscRecorder::GetTracks(const SRC_TOC_T &toc)
+{
+    std::vector<int> offsets;
+    std::vector<const SRC_TRACK_T *> audio;
+    std::vector<REC_TRACK_T> tracks;
+    int total = 0;
+    LIB_DISC_INFO_T info;
+    LIB_KEY_T key;
+    bool inlibrary;
+
+    for (size_t i = 0; i < toc.mTracks.size(); i++) {
+        offsets.push_back(toc.mTracks[i].mLba);
+        if (toc.mTracks[i].mAudio) {
+            audio.push_back(&toc.mTracks[i]);
+        }
+    }
+    if (audio.empty()) {
+        Fail("Not an audio disc");
+        return false;
+    }
+    key.mCddbId = cCddbClient::CalcDiscId(offsets,
+                                          toc.mLeadOut / CDIO_CD_FRAMES_PER_SEC);
+    key.mLeadOut = toc.mLeadOut;
+    key.mNumTracks = audio.size();
+    inlibrary = cPluginCdplayer::GetLibrary().Lookup(key, info);
+    mTitle = toc.mCdText[CDTEXT_TITLE];
+    mPerformer = toc.mCdText[CDTEXT_PERFORMER];
+    if (mTitle.empty() && inlibrary) {
+        mTitle = info.mTitle;
+        mPerformer = info.mPerformer;
+    }
+    if (mTitle.empty()) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%08x", key.mCddbId);
+        mTitle = buf;
+    }
+    if (mSelected.empty()) {
+        for (size_t i = 0; i < audio.size(); i++) {
+            mSelected.push_back(audio[i]->mTrackNo);
+        }
+    }
+    for (size_t i = 0; i < mSelected.size(); i++) {
+        REC_TRACK_T t;
+        size_t idx;
+        for (idx = 0; idx < audio.size(); idx++) {
+            if (audio[idx]->mTrackNo == mSelected[i]) {
+                break;
+            }
+        }
+        if (idx == audio.size()) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "No audio track %d", mSelected[i]);
+            Fail(buf);
+            return false;
+        }
+        t.mTrackNo = audio[idx]->mTrackNo;
+        t.mStartLsn = audio[idx]->mStartLsn;
+        t.mEndLsn = audio[idx]->mEndLsn;
+        t.mTitle = audio[idx]->mCdText[CDTEXT_TITLE];
+        t.mPerformer = audio[idx]->mCdText[CDTEXT_PERFORMER];
+        if (t.mTitle.empty() && inlibrary && (idx < info.mTrackTitle.size())) {
+            t.mTitle = info.mTrackTitle[idx];
+            t.mPerformer = info.mTrackPerformer[idx];
+        }
+        tracks.push_back(t);
+        total += t.mEndLsn - t.mStartLsn + 1;
+    }
+    cMutexLock MutexLock(&mMutex);
+    mTracks = tracks;
+    mTotal = total;
+    return true;
+}
+
+// Create the directory of the recording in the folder REC_FOLDER
+bool cDiscRecorder::MakeDir(void)
+{
+    std::string name = mPerformer.empty() ? mTitle :
+                                            mPerformer + " - " + mTitle;
+    char date[32];
+    time_t now = time(NULL);
+    struct tm tm_r;
+    char *s;
+
+    // '~' separates the folders
+    for (size_t i = 0; i < name.size(); i++) {
+        if (name[i] == '~') {
+            name[i] = '-';
+        }
+    }
+    name = REC_FOLDER "~" + name;
+    s = ExchangeChars(strdup(name.c_str()), true);
+    strftime(date, sizeof(date), "%Y-%m-%d.%H.%M", localtime_r(&now, &tm_r));
+#if VDRVERSNUM >= 20102
+    mDir = cVideoDirectory::Name();
+#else
+    mDir = VideoDirectory;
+#endif
+    mDir = mDir + "/" + s + "/" + date + ".0-0.rec";
+    free(s);
+    if (access(mDir.c_str(), F_OK) == 0) {
+        Fail("Recording " + mDir + " exists");
+        return false;
+    }
+    if (!MakeDirs(mDir.c_str(), true)) {
+        Fail("Can not create " + mDir);
+        return false;
+    }
+    dsyslog("%s %d Recording to %s", __FILE__, __LINE__, mDir.c_str());
+    return true;
+}
+
+// Titles of the disc and the tracks, the description lists the tracks
+bool cDiscRecorder::WriteInfo(void)
+{
+    std::string fname = mDir + "/info";
+    FILE *fp = fopen(fname.c_str(), "w");
+
+    if (fp == NULL) {
+        Fail("Can not create " + fname);
+        return false;
+    }
+    fprintf(fp, "T %s\n", mTitle.c_str());
+    if (!mPerformer.empty()) {
+        fprintf(fp, "S %s\n", mPerformer.c_str());
+    }
+    fprintf(fp, "D ");
+    for (size_t i = 0; i < mTracks.size(); i++) {
+        const REC_TRACK_T &t = mTracks[i];
+        int secs = (t.mEndLsn - t.mStartLsn + 1) / CDIO_CD_FRAMES_PER_SEC;
+        fprintf(fp, "%s%d. %s", (i > 0) ? "|" : "", t.mTrackNo,
+                t.mTitle.c_str());
+        if (!t.mPerformer.empty() && (t.mPerformer != mPerformer)) {
+            fprintf(fp, " - %s", t.mPerformer.c_str());
+        }
+        fprintf(fp, " (%d:%02d)", secs / 60, secs % 60);
+    }
+    fprintf(fp, "\nF %d\nP %d\nL %d\n", CDIO_CD_FRAMES_PER_SEC, REC_PRIORITY,
+            REC_LIFETIME);
+    if (fclose(fp) != 0) {
+        Fail("Can not write " + fname);
+        return false;
+    }
+    return true;
+}
+
+// A mark at the start of each track
+bool cDiscRecorder::WriteMarks(void)
+{
+    std::string fname = mDir + "/marks";
+    FILE *fp = fopen(fname.c_str(), "w");
+    int pos = 0;
+
+    if (fp == NULL) {
+        Fail("Can not create " + fname);
+        return false;
+    }
+    for (size_t i = 0; i < mTracks.size(); i++) {
+        const REC_TRACK_T &t = mTracks[i];
+        fprintf(fp, "%s %d. %s\n",
+                *IndexToHMSF(pos, true, CDIO_CD_FRAMES_PER_SEC),
+                t.mTrackNo, t.mTitle.c_str());
+        pos += t.mEndLsn - t.mStartLsn + 1;
+    }
+    if (fclose(fp) != 0) {
+        Fail("Can not write " + fname);
+        return false;
+    }
+    return true;
+}
+
+// Read, multiplex and write the sectors of all tracks. Unreadable
+// sectors are replaced by silence.
+bool cDiscRecorder::Record(cSectorSource *source)
+{
+    static const uint8_t silence[CDIO_CD_FRAMESIZE_RAW] = { 0 };
+    uint8_t buf[CDIO_CD_FRAMESIZE_RAW];
+    uint8_t ts[TSMUX_PATPMT_SIZE + TSMUX_SECTOR_SIZE];
+    cFileName fileName(mDir.c_str(), true);
+    cUnbufferedFile *file = fileName.Open();
+    cTsMux mux;
+    int64_t pts = TSMUX_PTS_START;
+    off_t offset = 0;
+    int patpmt = 0;
+    bool ok = true;
+
+    if (file == NULL) {
+        Fail("Can not create the recording file");
+        return false;
+    }
+    cIndexFile index(mDir.c_str(), true);
+    cRecWriter writer(file);
+    writer.Start();
+    for (size_t i = 0; ok && (i < mTracks.size()); i++) {
+        const REC_TRACK_T &t = mTracks[i];
+        {
+            cMutexLock MutexLock(&mMutex);
+            mTrack = i;
+        }
+        // A player jumping to the track gets PAT and PMT at once
+        patpmt = 0;
+        for (lsn_t lsn = t.mStartLsn; lsn <= t.mEndLsn; lsn++) {
+            uint8_t *data = NULL;
+            bool readok = false;
+            int len = 0;
+
+            if (!Running()) {
+                Fail("Aborted");
+                ok = false;
+                break;
+            }
+            for (int r = 0; (r < REC_RETRIES) && !readok; r++) {
+                readok = source->Read(lsn, buf, data);
+            }
+            if (!readok) {
+                if (!source->IsOpen()) {
+                    Fail("Can not read " + source->GetName());
+                    ok = false;
+                    break;
+                }
+                esyslog("%s %d Read error at lsn %d, silence recorded",
+                        __FILE__, __LINE__, lsn);
+                data = (uint8_t *)silence;
+                cMutexLock MutexLock(&mMutex);
+                mErrors++;
+            }
+            if (patpmt == 0) {
+                len = mux.PutPatPmt(ts);
+            }
+            patpmt = (patpmt + 1) % REC_PATPMT_BLOCKS;
+            len += mux.PutSector(ts + len, data, pts);
+            pts += TSMUX_PTS_PER_SECTOR;
+            if (!index.Write(true, fileName.Number(), offset) ||
+                !writer.Put(ts, len)) {
+                Fail("Can not write " + mDir);
+                ok = false;
+                break;
+            }
+            offset += len;
+            cMutexLock MutexLock(&mMutex);
+            mBlocks++;
+        }
+    }
+    if (!writer.Finish() && ok) {
+        Fail("Can not write " + mDir);
+        ok = false;
+    }
+    fileName.Close();
+    return ok;
+}
+
+void cDiscRecorder::Action(void)
+{
+    cSectorSource *source = cPluginCdplayer::NewSectorSource(mDevice);
+    SRC_TOC_T toc;
+    bool ok = false;
+
+    if (source->Open(toc) != SRC_OK) {
+        Fail("Can not read the disc in " + source->GetName());
+    }
+    else if (GetTracks(toc) && MakeDir()) {
+        source->SetSpeed(cMenuCDPlayer::GetMaxSpeed());
+        source->SetParanoia(cMenuCDPlayer::GetUseParanoia());
+        ok = WriteInfo() && WriteMarks() && Record(source);
+        if (!ok) {
+            RemoveFileOrDir(mDir.c_str());
+        }
+    }
+    source->Close();
+    delete source;
+    if (ok) {
+        {
+#if VDRVERSNUM >= 20301
+            LOCK_RECORDINGS_WRITE;
+            Recordings->AddByName(mDir.c_str());
+#else
+            Recordings.AddByName(mDir.c_str());
+#endif
+        }
+        cMutexLock MutexLock(&mMutex);
+        isyslog("%s %d Recorded %s, %d read errors", __FILE__, __LINE__,
+                mDir.c_str(), mErrors);
+        mState = REC_DONE;
+    }
+}
+
+std::string cDiscRecorder::GetProgress(void)
+{
+    cMutexLock MutexLock(&mMutex);
+    char buf[128];
+
+    switch (mState) {
+    case REC_RUNNING:
+        if (mTracks.empty()) {
+            return "Reading the disc";
+        }
+        snprintf(buf, sizeof(buf), "Recording track %d (%d/%d) %d%%, "
+                 "%d read errors", mTracks[mTrack].mTrackNo, mTrack + 1,
+                 (int)mTracks.size(),
+                 (mTotal > 0) ? (int)(100LL * mBlocks / mTotal) : 0, mErrors);
+        return buf;
+    case REC_DONE:
+        snprintf(buf, sizeof(buf), ", %d read errors", mErrors);
+        return "Recorded " + mDir + buf;
+    case REC_FAILED:
+        return "Recording failed: " + mMessage;
+    }
+    return "";
+}
@@ -0,0 +1,111 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class records the disc or selected tracks as a VDR recording. The
+ * recorder reads the sectors through its own sector source, multiplexes
+ * them to TS (tsmux.h) and writes the index with one frame per sector,
+ * so the recording runs at 75 frames per second. Like the audio frames
+ * of VDR's radio recordings every frame is independent. The track starts
+ * are written as marks, the disc and track titles into the info file.
+ *
+ * The TS data is collected in chunks of 1 MB, which are written by a
+ * separate thread, so slow writes do not stall the drive.
+ */
+
+#ifndef __DISCRECORDER_H__
+#define __DISCRECORDER_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+#include "sectorsource.h"
+#include "tsmux.h"
+
+#define REC_CHUNK_SIZE      KILOBYTE(1024)
+#define REC_CHUNKS          4
+#define REC_RETRIES         3       // Reads of a sector before silence
+#define REC_PATPMT_BLOCKS   CDIO_CD_FRAMES_PER_SEC  // PAT/PMT repetition
+#define REC_FOLDER          "CD"
+#define REC_PRIORITY        50
+#define REC_LIFETIME        99
+
+typedef enum _rec_state {
+    REC_RUNNING,
+    REC_DONE,
+    REC_FAILED
+} REC_STATE_T;
+
+typedef struct _rec_track {
+    int mTrackNo;           // Number on the disc
+    lsn_t mStartLsn;
+    lsn_t mEndLsn;          // Last sector of the track
+    std::string mTitle;
+    std::string mPerformer;
+} REC_TRACK_T;
+
+// Writes the chunks to the file in the order filled
+class cRecWriter: public cThread {
+private:
+    cMutex mMutex;          // Protects the chunk queue
+    cCondVar mCond;
+    cUnbufferedFile *mFile;
+    uint8_t *mChunks[REC_CHUNKS];
+    int mLength[REC_CHUNKS];
+    int mHead;              // Chunk written next
+    int mQueued;            // Full chunks
+    int mFill;              // Bytes in the chunk being filled
+    bool mEnd;
+    bool mError;
+protected:
+    virtual void Action(void);
+public:
+    cRecWriter(cUnbufferedFile *file);
+    virtual ~cRecWriter();
+    // Append data, blocks while all chunks are queued. False after a
+    // write error.
+    bool Put(const uint8_t *data, int len);
+    // Write the remaining data and stop the thread
+    bool Finish(void);
+};
+
+class cDiscRecorder: public cThread {
+private:
+    cMutex mMutex;          // Protects the progress
+    std::string mDevice;
+    std::vector<int> mSelected; // Track numbers, all audio tracks if empty
+    std::vector<REC_TRACK_T> mTracks;
+    std::string mTitle;
+    std::string mPerformer;
+    std::string mDir;       // Directory of the recording
+    REC_STATE_T mState;
+    std::string mMessage;   // Reason of a failure
+    int mTrack;             // Index into mTracks being recorded
+    int mBlocks;            // Sectors written
+    int mTotal;             // Sectors of all tracks
+    int mErrors;            // Sectors replaced by silence
+
+    bool GetTracks(const SRC_TOC_T &toc);
+    bool MakeDir(void);
+    bool WriteInfo(void);
+    bool WriteMarks(void);
+    bool Record(cSectorSource *source);
+    void Fail(const std::string &msg);
+protected:
+    virtual void Action(void);
+public:
+    // tracks are the track numbers of the disc, empty for all tracks
+    cDiscRecorder(const std::string &device, const std::vector<int> &tracks);
+    virtual ~cDiscRecorder();
+    // Stop recording, the partial recording is removed
+    void Abort(void) { Cancel(10); }
+    std::string GetProgress(void);
+};
+
+#endif
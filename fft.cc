@@ -0,0 +1,94 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements a real valued radix-2 FFT. The real input is
+ * packed into a complex FFT of half the size and split afterwards.
+ */
+
+#include <math.h>
+#include "fft.h"
+
+cFft::cFft(int size) :
+    mSize(size), mHalf(size / 2), mRev(size / 2),
+    mTwRe(size / 2), mTwIm(size / 2),
+    mSplitRe(size / 2 + 1), mSplitIm(size / 2 + 1),
+    mWindow(size), mRe(size / 2), mIm(size / 2)
+{
+    int bits = 0;
+    while ((1 << bits) < mHalf) {
+        bits++;
+    }
+    for (int i = 0; i < mHalf; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++) {
+            if (i & (1 << b)) {
+                r |= 1 << (bits - 1 - b);
+            }
+        }
+        mRev[i] = r;
+    }
+    for (int h = 1; h < mHalf; h <<= 1) {
+        for (int j = 0; j < h; j++) {
+            double a = -M_PI * j / h;
+            mTwRe[h - 1 + j] = cos(a);
+            mTwIm[h - 1 + j] = sin(a);
+        }
+    }
+    for (int k = 0; k <= mHalf; k++) {
+        double a = -2.0 * M_PI * k / mSize;
+        mSplitRe[k] = cos(a);
+        mSplitIm[k] = sin(a);
+    }
+    for (int i = 0; i < mSize; i++) {
+        mWindow[i] = 0.5 - 0.5 * cos(2.0 * M_PI * i / (mSize - 1));
+    }
+}
+
+void cFft::Power(const float *samples, float *power)
+{
+    float *re = &mRe[0];
+    float *im = &mIm[0];
+    const float *win = &mWindow[0];
+
+    // Even samples are the real, odd samples the imaginary part
+    for (int i = 0; i < mHalf; i++) {
+        int r = mRev[i];
+        re[r] = samples[2 * i] * win[2 * i];
+        im[r] = samples[2 * i + 1] * win[2 * i + 1];
+    }
+    for (int h = 1; h < mHalf; h <<= 1) {
+        const float *twre = &mTwRe[h - 1];
+        const float *twim = &mTwIm[h - 1];
+        for (int i = 0; i < mHalf; i += 2 * h) {
+            float *are = re + i;
+            float *aim = im + i;
+            float *bre = re + i + h;
+            float *bim = im + i + h;
+            for (int j = 0; j < h; j++) {
+                float xr = bre[j] * twre[j] - bim[j] * twim[j];
+                float xi = bre[j] * twim[j] + bim[j] * twre[j];
+                bre[j] = are[j] - xr;
+                bim[j] = aim[j] - xi;
+                are[j] += xr;
+                aim[j] += xi;
+            }
+        }
+    }
+    // Split into the spectrum of the real input
+    for (int k = 0; k <= mHalf; k++) {
+        int k1 = (k == mHalf) ? 0 : k;
+        int k2 = (k == 0) ? 0 : mHalf - k;
+        float er = (re[k1] + re[k2]) * 0.5f;
+        float ei = (im[k1] - im[k2]) * 0.5f;
+        float orr = (im[k1] + im[k2]) * 0.5f;
+        float oi = (re[k2] - re[k1]) * 0.5f;
+        float xr = er + mSplitRe[k] * orr - mSplitIm[k] * oi;
+        float xi = ei + mSplitRe[k] * oi + mSplitIm[k] * orr;
+        power[k] = xr * xr + xi * xi;
+    }
+}
@@ -0,0 +1,39 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements a real valued radix-2 FFT. The tables are
+ * calculated once, the butterflies use contiguous twiddles per stage so
+ * the inner loops can be vectorized by the compiler.
+ */
+
+#ifndef __FFT_H__
+#define __FFT_H__
+
+#include <vector>
+
+class cFft {
+private:
+    int mSize;                  // Number of real input samples
+    int mHalf;                  // Size of the complex FFT
+    std::vector<int> mRev;      // Bit reversal of mHalf
+    std::vector<float> mTwRe;   // Twiddles of all stages, stage h at h-1
+    std::vector<float> mTwIm;
+    std::vector<float> mSplitRe; // Twiddles to split the real spectrum
+    std::vector<float> mSplitIm;
+    std::vector<float> mWindow; // Hann window
+    std::vector<float> mRe;
+    std::vector<float> mIm;
+public:
+    // size must be a power of 2
+    cFft(int size);
+    int GetSize(void) const { return mSize; }
+    // Power spectrum of the windowed samples, power gets size/2+1 values
+    void Power(const float *samples, float *power);
+};
+
+#endif
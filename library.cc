@@ -0,0 +1,760 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the library of all discs played so far.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <ctype.h>
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <vdr/tools.h>
+#include "library.h"
+
+static bool CompareInfo(const LIB_DISC_INFO_T &a, const LIB_DISC_INFO_T &b)
+{
+    return cLibrary::KeyLess(a.mKey, b.mKey);
+}
+
+// Same text and tracks, the play state is not compared
+static bool SameText(const LIB_DISC_INFO_T &a, const LIB_DISC_INFO_T &b)
+{
+    return (a.mTitle == b.mTitle) && (a.mPerformer == b.mPerformer) &&
+           (a.mGenre == b.mGenre) && (a.mStartLsn == b.mStartLsn) &&
+           (a.mLength == b.mLength) && (a.mTrackTitle == b.mTrackTitle) &&
+           (a.mTrackPerformer == b.mTrackPerformer) &&
+           (a.mSource == b.mSource);
+}
+
+// Collects the strings of the new file, each only once
+class cLibStrings {
+private:
+    std::string mData;
+    std::map<std::string, uint32_t> mOffsets;
+public:
+    cLibStrings(void) { mData.push_back('\0'); }
+    uint32_t Add(const std::string &str) {
+        if (str.empty()) {
+            return 0;
+        }
+        std::map<std::string, uint32_t>::iterator it = mOffsets.find(str);
+        if (it != mOffsets.end()) {
+            return it->second;
+        }
+        uint32_t offset = mData.size();
+        mData.append(str.c_str(), str.size() + 1);
+        mOffsets[str] = offset;
+        return offset;
+    }
+    const std::string &GetData(void) const { return mData; }
+};
+
+cLibrary::cLibrary(void)
+    : cThread("cdplayer library"), mMap(NULL), mMapLen(0), mHeader(NULL),
+      mDiscs(NULL), mTracks(NULL), mTerms(NULL), mPostings(NULL),
+      mStrings(NULL)
+{
+}
+
+cLibrary::~cLibrary()
+{
+    Cancel(-1);
+    mWait.Signal();
+    Cancel(3);
+    Write();
+    cMutexLock MutexLock(&mMutex);
+    Unmap();
+}
+
+bool cLibrary::KeyLess(const LIB_KEY_T &a, const LIB_KEY_T &b)
+{
+    if (a.mCddbId != b.mCddbId) {
+        return a.mCddbId < b.mCddbId;
+    }
+    if (a.mNumTracks != b.mNumTracks) {
+        return a.mNumTracks < b.mNumTracks;
+    }
+    return a.mLeadOut < b.mLeadOut;
+}
+
+bool cLibrary::KeyEqual(const LIB_KEY_T &a, const LIB_KEY_T &b)
+{
+    return (a.mCddbId == b.mCddbId) && (a.mNumTracks == b.mNumTracks) &&
+           (a.mLeadOut == b.mLeadOut);
+}
+
+// Words are separated by ASCII characters other than letters and digits,
+// UTF-8 sequences are kept.
+void cLibrary::GetWords(const std::string &text, std::vector<std::string> &words)
+{
+    std::string word;
+
+    words.clear();
+    for (size_t i = 0; i <= text.size(); i++) {
+        unsigned char c = (i < text.size()) ? text[i] : ' ';
+        if ((c >= 0x80) || isalnum(c)) {
+            word.push_back(tolower(c));
+        }
+        else if (!word.empty()) {
+            words.push_back(word);
+            word.clear();
+        }
+    }
+}
+
+// Must be called with locked mMutex
+void cLibrary::Unmap(void)
+{
+    if (mMap != NULL) {
+        munmap(mMap, mMapLen);
+    }
+    mMap = NULL;
+    mMapLen = 0;
+    mHeader = NULL;
+    mDiscs = NULL;
+    mTracks = NULL;
+    mTerms = NULL;
+    mPostings = NULL;
+    mStrings = NULL;
+}
+
+// Must be called with locked mMutex. The mapping is writable for play
+// count and position.
+bool cLibrary::Map(void)
+{
+    const LIB_HEADER_T *hdr;
+    struct stat st;
+    void *map;
+    int fd;
+
+    Unmap();
+    fd = open(mFileName.c_str(), O_RDWR);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            esyslog("%s %d can not open library %s: %d",
+                    __FILE__, __LINE__, mFileName.c_str(), errno);
+        }
+        return false;
+    }
+    if ((fstat(fd, &st) < 0) ||
+        (st.st_size < (off_t)sizeof(LIB_HEADER_T))) {
+        esyslog("%s %d invalid library %s",
+                __FILE__, __LINE__, mFileName.c_str());
+        close(fd);
+        return false;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        esyslog("%s %d mmap of library %s failed: %d",
+                __FILE__, __LINE__, mFileName.c_str(), errno);
+        return false;
+    }
+    mMap = (uint8_t *)map;
+    mMapLen = st.st_size;
+
+    hdr = (const LIB_HEADER_T *)mMap;
+    if ((memcmp(hdr->mMagic, LIB_MAGIC, sizeof(LIB_MAGIC)) != 0) ||
+        (hdr->mFileSize != mMapLen) ||
+        (hdr->mDiscPos + (uint64_t)hdr->mDiscs * sizeof(LIB_DISC_T) >
+         hdr->mTrackPos) ||
+        (hdr->mTrackPos + (uint64_t)hdr->mTracks * sizeof(LIB_TRACK_T) >
+         hdr->mTermPos) ||
+        (hdr->mTermPos + (uint64_t)hdr->mTerms * sizeof(LIB_TERM_T) >
+         hdr->mPostingPos) ||
+        (hdr->mPostingPos + (uint64_t)hdr->mPostings * sizeof(LIB_POSTING_T) >
+         hdr->mStringPos) ||
+        (hdr->mStringPos >= mMapLen) || (mMap[mMapLen - 1] != '\0')) {
+        esyslog("%s %d invalid library %s",
+                __FILE__, __LINE__, mFileName.c_str());
+        Unmap();
+        return false;
+    }
+    SetMap(mMap, mMapLen);
+    return true;
+}
+
+// Set the pointers into a checked mapping
+void cLibrary::SetMap(uint8_t *map, size_t len)
+{
+    const LIB_HEADER_T *hdr = (const LIB_HEADER_T *)map;
+
+    mMap = map;
+    mMapLen = len;
+    mHeader = hdr;
+    mDiscs = (LIB_DISC_T *)(map + hdr->mDiscPos);
+    mTracks = (const LIB_TRACK_T *)(map + hdr->mTrackPos);
+    mTerms = (const LIB_TERM_T *)(map + hdr->mTermPos);
+    mPostings = (const LIB_POSTING_T *)(map + hdr->mPostingPos);
+    mStrings = (const char *)(map + hdr->mStringPos);
+}
+
+bool cLibrary::Open(const std::string &filename)
+{
+    cMutexLock MutexLock(&mMutex);
+    mFileName = filename;
+    if (!Map()) {
+        return false;
+    }
+    isyslog("cdplayer: library %s with %d discs", filename.c_str(),
+            mHeader->mDiscs);
+    return true;
+}
+
+const char *cLibrary::GetString(uint32_t offset) const
+{
+    if (mStrings + offset >= (const char *)mMap + mMapLen) {
+        return "";
+    }
+    return mStrings + offset;
+}
+
+int cLibrary::FindDisc(const LIB_KEY_T &key) const
+{
+    return FindDisc(mDiscs, (mHeader != NULL) ? (int)mHeader->mDiscs : 0,
+                    key);
+}
+
+int cLibrary::FindDisc(const LIB_DISC_T *discs, int num, const LIB_KEY_T &key)
+{
+    int lo = 0;
+    int hi = num;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        LIB_KEY_T k;
+        k.mCddbId = discs[mid].mCddbId;
+        k.mLeadOut = discs[mid].mLeadOut;
+        k.mNumTracks = discs[mid].mNumTracks;
+        if (KeyEqual(k, key)) {
+            return mid;
+        }
+        if (KeyLess(k, key)) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return -1;
+}
+
+LIB_DISC_INFO_T *cLibrary::FindPending(const LIB_KEY_T &key)
+{
+    for (size_t i = 0; i < mPending.size(); i++) {
+        if (KeyEqual(mPending[i].mKey, key)) {
+            return &mPending[i];
+        }
+    }
+    return NULL;
+}
+
+void cLibrary::GetDiscInfo(int idx, LIB_DISC_INFO_T &info) const
+{
+    const LIB_DISC_T &d = mDiscs[idx];
+
+    info.mKey.mCddbId = d.mCddbId;
+    info.mKey.mLeadOut = d.mLeadOut;
+    info.mKey.mNumTracks = d.mNumTracks;
+    info.mTitle = GetString(d.mTitle);
+    info.mPerformer = GetString(d.mPerformer);
+    info.mGenre = GetString(d.mGenre);
+    info.mSource = d.mSource;
+    info.mStartLsn.clear();
+    info.mLength.clear();
+    info.mTrackTitle.clear();
+    info.mTrackPerformer.clear();
+    for (uint32_t i = 0; i < d.mNumTracks; i++) {
+        if (d.mFirstTrack + i >= mHeader->mTracks) {
+            break;
+        }
+        const LIB_TRACK_T &t = mTracks[d.mFirstTrack + i];
+        info.mStartLsn.push_back(t.mStartLsn);
+        info.mLength.push_back(t.mLength);
+        info.mTrackTitle.push_back(GetString(t.mTitle));
+        info.mTrackPerformer.push_back(GetString(t.mPerformer));
+    }
+    info.mPlayCount = d.mPlayCount;
+    info.mLastTrack = d.mLastTrack;
+    info.mLastPos = d.mLastPos;
+    info.mResume = d.mResume;
+    info.mResumeOrder.clear();
+    for (const char *p = GetString(d.mResumeOrder); *p != '\0'; p++) {
+        info.mResumeOrder.push_back((uint8_t)*p - 1);
+    }
+    info.mLastPlayed = d.mLastPlayed;
+}
+
+bool cLibrary::Lookup(const LIB_KEY_T &key, LIB_DISC_INFO_T &info)
+{
+    cMutexLock MutexLock(&mMutex);
+    LIB_DISC_INFO_T *p = FindPending(key);
+    int idx;
+
+    if (p != NULL) {
+        info = *p;
+        return true;
+    }
+    idx = FindDisc(key);
+    if (idx < 0) {
+        return false;
+    }
+    GetDiscInfo(idx, info);
+    return true;
+}
+
+void cLibrary::Update(const LIB_DISC_INFO_T &info)
+{
+    cMutexLock MutexLock(&mMutex);
+    LIB_DISC_INFO_T *p = FindPending(info.mKey);
+    LIB_DISC_INFO_T old;
+    LIB_DISC_INFO_T merged = info;
+    bool known = false;
+    int idx;
+
+    if (p != NULL) {
+        old = *p;
+        known = true;
+    }
+    else if ((idx = FindDisc(info.mKey)) >= 0) {
+        GetDiscInfo(idx, old);
+        known = true;
+    }
+    merged.mPlayCount = 0;
+    merged.mLastTrack = 0;
+    merged.mLastPos = 0;
+    merged.mResume = LIB_RESUME_NONE;
+    merged.mResumeOrder.clear();
+    merged.mLastPlayed = 0;
+    if (known) {
+        if (merged.mTitle.empty()) {
+            merged.mTitle = old.mTitle;
+        }
+        if (merged.mPerformer.empty()) {
+            merged.mPerformer = old.mPerformer;
+        }
+        if (merged.mGenre.empty()) {
+            merged.mGenre = old.mGenre;
+        }
+        merged.mSource |= old.mSource;
+        for (size_t i = 0; (i < merged.mTrackTitle.size()) &&
+                           (i < old.mTrackTitle.size()); i++) {
+            if (merged.mTrackTitle[i].empty()) {
+                merged.mTrackTitle[i] = old.mTrackTitle[i];
+            }
+            if (merged.mTrackPerformer[i].empty()) {
+                merged.mTrackPerformer[i] = old.mTrackPerformer[i];
+            }
+        }
+        merged.mPlayCount = old.mPlayCount;
+        merged.mLastTrack = old.mLastTrack;
+        merged.mLastPos = old.mLastPos;
+        merged.mResume = old.mResume;
+        merged.mResumeOrder = old.mResumeOrder;
+        merged.mLastPlayed = old.mLastPlayed;
+        if (SameText(merged, old)) {
+            return;
+        }
+    }
+    if (p != NULL) {
+        *p = merged;
+    }
+    else {
+        mPending.push_back(merged);
+    }
+    Start();
+}
+
+void cLibrary::Played(const LIB_KEY_T &key)
+{
+    cMutexLock MutexLock(&mMutex);
+    LIB_DISC_INFO_T *p = FindPending(key);
+    int idx;
+
+    if (p != NULL) {
+        p->mPlayCount++;
+        p->mLastPlayed = time(NULL);
+    }
+    else if ((idx = FindDisc(key)) >= 0) {
+        mDiscs[idx].mPlayCount++;
+        mDiscs[idx].mLastPlayed = time(NULL);
+    }
+}
+
+void cLibrary::SetPosition(const LIB_KEY_T &key, int track, int offset)
+{
+    cMutexLock MutexLock(&mMutex);
+    LIB_DISC_INFO_T *p = FindPending(key);
+    int idx;
+
+    if (p != NULL) {
+        p->mLastTrack = track;
+        p->mLastPos = offset;
+    }
+    else if ((idx = FindDisc(key)) >= 0) {
+        mDiscs[idx].mLastTrack = track;
+        mDiscs[idx].mLastPos = offset;
+    }
+}
+
+// The mode is changed in place, a new random order needs a rebuild
+void cLibrary::SetResume(const LIB_KEY_T &key, int mode,
+                         const std::vector<uint8_t> &order)
+{
+    cMutexLock MutexLock(&mMutex);
+    LIB_DISC_INFO_T *p = FindPending(key);
+    std::vector<uint8_t> neworder;
+    LIB_DISC_INFO_T info;
+    int idx;
+
+    if (mode == LIB_RESUME_RANDOM) {
+        neworder = order;
+    }
+    if (p != NULL) {
+        p->mResume = mode;
+        p->mResumeOrder = neworder;
+        return;
+    }
+    idx = FindDisc(key);
+    if (idx < 0) {
+        return;
+    }
+    mDiscs[idx].mResume = mode;
+    GetDiscInfo(idx, info);
+    if ((mode != LIB_RESUME_RANDOM) || (info.mResumeOrder == neworder)) {
+        return;
+    }
+    info.mResumeOrder = neworder;
+    mPending.push_back(info);
+    Start();
+}
+
+int cLibrary::GetNumDiscs(void)
+{
+    cMutexLock MutexLock(&mMutex);
+    int num = (mHeader != NULL) ? (int)mHeader->mDiscs : 0;
+
+    for (size_t i = 0; i < mPending.size(); i++) {
+        if (FindDisc(mPending[i].mKey) < 0) {
+            num++;
+        }
+    }
+    return num;
+}
+
+// Discs added since the last write are found after the next write
+int cLibrary::Search(const std::string &query, std::vector<LIB_HIT_T> &hits,
+                     int maxhits)
+{
+    cMutexLock MutexLock(&mMutex);
+    std::vector<std::string> words;
+    std::vector<uint32_t> result;
+    std::map<uint32_t, int> trackhit;
+
+    hits.clear();
+    GetWords(query, words);
+    if (words.empty() || (mHeader == NULL)) {
+        return 0;
+    }
+    for (size_t w = 0; w < words.size(); w++) {
+        const char *word = words[w].c_str();
+        size_t len = words[w].size();
+        std::vector<uint32_t> discs;
+        int lo = 0;
+        int hi = mHeader->mTerms;
+
+        // First term not less than the word, then all with it as prefix
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (strcmp(GetString(mTerms[mid].mText), word) < 0) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        for (uint32_t t = lo; (t < mHeader->mTerms) &&
+             (strncmp(GetString(mTerms[t].mText), word, len) == 0); t++) {
+            const LIB_TERM_T &term = mTerms[t];
+            for (uint32_t i = 0; (i < term.mCount) &&
+                                 (term.mFirst + i < mHeader->mPostings); i++) {
+                const LIB_POSTING_T &p = mPostings[term.mFirst + i];
+                discs.push_back(p.mDisc);
+                if ((p.mTrack != LIB_NO_TRACK) &&
+                    (trackhit.find(p.mDisc) == trackhit.end())) {
+                    trackhit[p.mDisc] = p.mTrack;
+                }
+            }
+        }
+        std::sort(discs.begin(), discs.end());
+        discs.erase(std::unique(discs.begin(), discs.end()), discs.end());
+        if (w == 0) {
+            result.swap(discs);
+        }
+        else {
+            std::vector<uint32_t> both;
+            std::set_intersection(result.begin(), result.end(),
+                                  discs.begin(), discs.end(),
+                                  std::back_inserter(both));
+            result.swap(both);
+        }
+        if (result.empty()) {
+            return 0;
+        }
+    }
+    for (size_t i = 0; (i < result.size()) && ((int)hits.size() < maxhits);
+         i++) {
+        if (result[i] >= mHeader->mDiscs) {
+            continue;
+        }
+        const LIB_DISC_T &d = mDiscs[result[i]];
+        LIB_HIT_T hit;
+        hit.mKey.mCddbId = d.mCddbId;
+        hit.mKey.mLeadOut = d.mLeadOut;
+        hit.mKey.mNumTracks = d.mNumTracks;
+        hit.mPerformer = GetString(d.mPerformer);
+        hit.mTitle = GetString(d.mTitle);
+        hit.mTrack = -1;
+        std::map<uint32_t, int>::iterator it = trackhit.find(result[i]);
+        if ((it != trackhit.end()) && (it->second < d.mNumTracks) &&
+            (d.mFirstTrack + it->second < mHeader->mTracks)) {
+            hit.mTrack = it->second;
+            hit.mTrackTitle = GetString(mTracks[d.mFirstTrack + it->second].mTitle);
+        }
+        hits.push_back(hit);
+    }
+    return hits.size();
+}
+
+// Rebuilds the file from a copy of the mapped and the pending discs. Only
+// the copy and the swap of the mapping lock mMutex, the reader thread
+// updating the position is not held up by building and writing the file.
+bool cLibrary::Write(void)
+{
+    std::vector<LIB_DISC_INFO_T> all;
+    std::vector<LIB_DISC_T> discs;
+    std::vector<LIB_TRACK_T> tracks;
+    std::vector<LIB_TERM_T> terms;
+    std::vector<LIB_POSTING_T> postings;
+    std::map<std::string, std::vector<LIB_POSTING_T> > index;
+    std::vector<std::string> words;
+    cLibStrings strings;
+    LIB_HEADER_T hdr;
+    std::vector<LIB_DISC_INFO_T> written;
+    std::string tmpname;
+    bool ok;
+    FILE *fp;
+
+    {
+        cMutexLock MutexLock(&mMutex);
+        if (mPending.empty() || mFileName.empty()) {
+            return true;
+        }
+        tmpname = mFileName + ".tmp";
+        for (uint32_t i = 0; (mHeader != NULL) && (i < mHeader->mDiscs); i++) {
+            LIB_DISC_INFO_T info;
+            GetDiscInfo(i, info);
+            if (FindPending(info.mKey) == NULL) {
+                all.push_back(info);
+            }
+        }
+        written = mPending;
+    }
+    all.insert(all.end(), written.begin(), written.end());
+    std::sort(all.begin(), all.end(), CompareInfo);
+
+    for (uint32_t i = 0; i < all.size(); i++) {
+        const LIB_DISC_INFO_T &info = all[i];
+        LIB_DISC_T d;
+        memset(&d, 0, sizeof(d));
+        d.mCddbId = info.mKey.mCddbId;
+        d.mLeadOut = info.mKey.mLeadOut;
+        d.mNumTracks = info.mStartLsn.size();
+        d.mFirstTrack = tracks.size();
+        d.mTitle = strings.Add(info.mTitle);
+        d.mPerformer = strings.Add(info.mPerformer);
+        d.mGenre = strings.Add(info.mGenre);
+        d.mSource = info.mSource;
+        d.mPlayCount = info.mPlayCount;
+        d.mLastTrack = info.mLastTrack;
+        d.mLastPos = info.mLastPos;
+        d.mResume = info.mResume;
+        if (info.mResume == LIB_RESUME_RANDOM) {
+            std::string order;
+            for (size_t t = 0; t < info.mResumeOrder.size(); t++) {
+                order.push_back((char)(info.mResumeOrder[t] + 1));
+            }
+            d.mResumeOrder = strings.Add(order);
+        }
+        d.mLastPlayed = info.mLastPlayed;
+        discs.push_back(d);
+
+        // Track -1 is the disc itself
+        for (int t = -1; t < (int)d.mNumTracks; t++) {
+            std::string title = (t < 0) ? info.mTitle : info.mTrackTitle[t];
+            std::string performer = (t < 0) ? info.mPerformer :
+                                              info.mTrackPerformer[t];
+            if (t >= 0) {
+                LIB_TRACK_T tr;
+                tr.mStartLsn = info.mStartLsn[t];
+                tr.mLength = info.mLength[t];
+                tr.mTitle = strings.Add(title);
+                tr.mPerformer = strings.Add(performer);
+                tracks.push_back(tr);
+            }
+            GetWords(title + " " + performer, words);
+            for (size_t w = 0; w < words.size(); w++) {
+                std::vector<LIB_POSTING_T> &list = index[words[w]];
+                LIB_POSTING_T p;
+                p.mDisc = i;
+                p.mTrack = (t < 0) ? LIB_NO_TRACK : t;
+                p.mReserved = 0;
+                if (list.empty() || (list.back().mDisc != p.mDisc) ||
+                    (list.back().mTrack != p.mTrack)) {
+                    list.push_back(p);
+                }
+            }
+        }
+    }
+    for (std::map<std::string, std::vector<LIB_POSTING_T> >::iterator it =
+         index.begin(); it != index.end(); ++it) {
+        LIB_TERM_T term;
+        term.mText = strings.Add(it->first);
+        term.mFirst = postings.size();
+        term.mCount = it->second.size();
+        terms.push_back(term);
+        postings.insert(postings.end(), it->second.begin(), it->second.end());
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.mMagic, LIB_MAGIC, sizeof(LIB_MAGIC));
+    hdr.mDiscs = discs.size();
+    hdr.mTracks = tracks.size();
+    hdr.mTerms = terms.size();
+    hdr.mPostings = postings.size();
+    hdr.mDiscPos = sizeof(hdr);
+    hdr.mTrackPos = hdr.mDiscPos + (uint64_t)hdr.mDiscs * sizeof(LIB_DISC_T);
+    hdr.mTermPos = hdr.mTrackPos + (uint64_t)hdr.mTracks * sizeof(LIB_TRACK_T);
+    hdr.mPostingPos = hdr.mTermPos + (uint64_t)hdr.mTerms * sizeof(LIB_TERM_T);
+    hdr.mStringPos = hdr.mPostingPos +
+                     (uint64_t)hdr.mPostings * sizeof(LIB_POSTING_T);
+    hdr.mFileSize = hdr.mStringPos + strings.GetData().size();
+
+    fp = fopen(tmpname.c_str(), "w");
+    ok = (fp != NULL);
+    if (ok) {
+        ok = (fwrite(&hdr, sizeof(hdr), 1, fp) == 1);
+        ok = ok && (discs.empty() ||
+                    (fwrite(&discs[0], sizeof(LIB_DISC_T), discs.size(), fp)
+                     == discs.size()));
+        ok = ok && (tracks.empty() ||
+                    (fwrite(&tracks[0], sizeof(LIB_TRACK_T), tracks.size(), fp)
+                     == tracks.size()));
+        ok = ok && (terms.empty() ||
+                    (fwrite(&terms[0], sizeof(LIB_TERM_T), terms.size(), fp)
+                     == terms.size()));
+        ok = ok && (postings.empty() ||
+                    (fwrite(&postings[0], sizeof(LIB_POSTING_T),
+                            postings.size(), fp) == postings.size()));
+        ok = ok && (fwrite(strings.GetData().data(), 1,
+                           strings.GetData().size(), fp) ==
+                    strings.GetData().size());
+        if (fclose(fp) != 0) {
+            ok = false;
+        }
+    }
+    if (ok) {
+        cMutexLock MutexLock(&mMutex);
+        ok = (rename(tmpname.c_str(), mFileName.c_str()) == 0) &&
+             Swap(written);
+    }
+    if (!ok) {
+        esyslog("%s %d can not write library %s",
+                __FILE__, __LINE__, tmpname.c_str());
+        unlink(tmpname.c_str());
+        return false;
+    }
+    dsyslog("%s %d library written, %d discs, %d words",
+            __FILE__, __LINE__, hdr.mDiscs, hdr.mTerms);
+    return true;
+}
+
+// Must be called with locked mMutex. Maps the new file and takes over the
+// play state changed while it was written. Pending discs written without
+// further changes are removed.
+bool cLibrary::Swap(const std::vector<LIB_DISC_INFO_T> &written)
+{
+    uint8_t *oldmap = mMap;
+    size_t oldlen = mMapLen;
+    const LIB_DISC_T *olddiscs = mDiscs;
+    int oldnum = (mHeader != NULL) ? (int)mHeader->mDiscs : 0;
+
+    mMap = NULL;
+    if (!Map()) {
+        // Keep working with the old mapping and the pending discs
+        if (oldmap != NULL) {
+            SetMap(oldmap, oldlen);
+        }
+        return false;
+    }
+    for (uint32_t i = 0; i < mHeader->mDiscs; i++) {
+        LIB_DISC_T &d = mDiscs[i];
+        LIB_KEY_T key;
+        LIB_DISC_INFO_T *p;
+        int idx;
+
+        key.mCddbId = d.mCddbId;
+        key.mLeadOut = d.mLeadOut;
+        key.mNumTracks = d.mNumTracks;
+        if ((p = FindPending(key)) != NULL) {
+            d.mPlayCount = p->mPlayCount;
+            d.mLastTrack = p->mLastTrack;
+            d.mLastPos = p->mLastPos;
+            d.mLastPlayed = p->mLastPlayed;
+        }
+        else if ((idx = FindDisc(olddiscs, oldnum, key)) >= 0) {
+            d.mPlayCount = olddiscs[idx].mPlayCount;
+            d.mLastTrack = olddiscs[idx].mLastTrack;
+            d.mLastPos = olddiscs[idx].mLastPos;
+            d.mResume = olddiscs[idx].mResume;
+            d.mLastPlayed = olddiscs[idx].mLastPlayed;
+        }
+    }
+    for (size_t i = 0; i < written.size(); i++) {
+        for (size_t j = 0; j < mPending.size(); j++) {
+            if (KeyEqual(mPending[j].mKey, written[i].mKey) &&
+                SameText(mPending[j], written[i]) &&
+                (mPending[j].mResume == written[i].mResume) &&
+                (mPending[j].mResumeOrder == written[i].mResumeOrder)) {
+                mPending.erase(mPending.begin() + j);
+                break;
+            }
+        }
+    }
+    if (oldmap != NULL) {
+        munmap(oldmap, oldlen);
+    }
+    return true;
+}
+
+void cLibrary::Action(void)
+{
+    while (Running()) {
+        mWait.Wait(LIB_WRITE_DELAY_MS);
+        Write();
+    }
+}
@@ -0,0 +1,192 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the library of all discs played so far. It keeps
+ * TOC, CD-Text or CDDB information, play count and last position of each
+ * disc in a memory mapped file with an inverted index over the words of
+ * all titles and performers.
+ *
+ * New or changed discs are collected in memory and written by a
+ * background thread which rebuilds the whole file. Play count and
+ * position are changed in place in the mapped file.
+ *
+ * File layout:
+ *   LIB_HEADER_T
+ *   LIB_DISC_T[mDiscs]         sorted by LIB_KEY_T
+ *   LIB_TRACK_T[mTracks]       tracks of all discs
+ *   LIB_TERM_T[mTerms]         sorted by the word
+ *   LIB_POSTING_T[mPostings]   discs and tracks of each word
+ *   char[]                     strings, 0 terminated
+ */
+
+#ifndef __LIBRARY_H__
+#define __LIBRARY_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <vdr/thread.h>
+
+#define LIB_MAGIC           "CDPLIB2"
+#define LIB_NO_TRACK        0xffff
+#define LIB_WRITE_DELAY_MS  2000    // Collect changes before rebuilding
+#define LIB_MAX_HITS        100
+
+// Play mode of the resume point
+#define LIB_RESUME_NONE     0       // Played to the end
+#define LIB_RESUME_SORTED   1
+#define LIB_RESUME_RANDOM   2       // Order in mResumeOrder
+
+// Origin of the text, bits of mSource
+#define LIB_SOURCE_CDTEXT   0x01
+#define LIB_SOURCE_CDDB     0x02
+#define LIB_SOURCE_FINGERPRINT 0x04
+#define LIB_SOURCE_COMPLETE (LIB_SOURCE_CDTEXT | LIB_SOURCE_CDDB)
+
+typedef struct _lib_key {
+    uint32_t mCddbId;
+    uint32_t mLeadOut;      // lba of the lead out
+    uint16_t mNumTracks;    // Number of audio tracks
+} LIB_KEY_T;
+
+typedef struct _lib_header {
+    char mMagic[8];
+    uint32_t mDiscs;
+    uint32_t mTracks;
+    uint32_t mTerms;
+    uint32_t mPostings;
+    uint64_t mDiscPos;
+    uint64_t mTrackPos;
+    uint64_t mTermPos;
+    uint64_t mPostingPos;
+    uint64_t mStringPos;
+    uint64_t mFileSize;
+} LIB_HEADER_T;
+
+typedef struct _lib_disc {
+    uint32_t mCddbId;
+    uint32_t mLeadOut;
+    uint16_t mNumTracks;
+    uint16_t mSource;       // LIB_SOURCE_*, 0 in older files
+    uint32_t mFirstTrack;   // Index of the first LIB_TRACK_T
+    uint32_t mTitle;        // String offsets
+    uint32_t mPerformer;
+    uint32_t mGenre;
+    uint32_t mResumeOrder;  // Random playlist, tracks as bytes 1..99
+    // Changed in place
+    uint32_t mPlayCount;
+    uint32_t mLastTrack;    // Track (CD order) of the last position
+    uint32_t mLastPos;      // Blocks into mLastTrack
+    uint32_t mResume;       // LIB_RESUME_*
+    uint64_t mLastPlayed;   // time_t
+} LIB_DISC_T;
+
+typedef struct _lib_track {
+    uint32_t mStartLsn;
+    uint32_t mLength;       // Blocks
+    uint32_t mTitle;
+    uint32_t mPerformer;
+} LIB_TRACK_T;
+
+typedef struct _lib_term {
+    uint32_t mText;         // Lower case word
+    uint32_t mFirst;        // First posting
+    uint32_t mCount;
+} LIB_TERM_T;
+
+typedef struct _lib_posting {
+    uint32_t mDisc;
+    uint16_t mTrack;        // LIB_NO_TRACK for the disc title/performer
+    uint16_t mReserved;
+} LIB_POSTING_T;
+
+// All information about a disc
+typedef struct _lib_disc_info {
+    LIB_KEY_T mKey;
+    std::string mTitle;
+    std::string mPerformer;
+    std::string mGenre;
+    uint16_t mSource;       // Merged with the known sources
+    std::vector<uint32_t> mStartLsn;
+    std::vector<uint32_t> mLength;
+    std::vector<std::string> mTrackTitle;
+    std::vector<std::string> mTrackPerformer;
+    uint32_t mPlayCount;
+    uint32_t mLastTrack;
+    uint32_t mLastPos;
+    uint32_t mResume;
+    std::vector<uint8_t> mResumeOrder;  // Tracks in CD order, 0 based
+    uint64_t mLastPlayed;
+} LIB_DISC_INFO_T;
+
+typedef struct _lib_hit {
+    LIB_KEY_T mKey;
+    std::string mPerformer;
+    std::string mTitle;
+    int mTrack;             // First matching track, -1 if none
+    std::string mTrackTitle;
+} LIB_HIT_T;
+
+class cLibrary: public cThread {
+private:
+    cMutex mMutex;          // Protects mapping and pending discs
+    cCondWait mWait;
+    std::string mFileName;
+    uint8_t *mMap;
+    size_t mMapLen;
+    const LIB_HEADER_T *mHeader;
+    LIB_DISC_T *mDiscs;
+    const LIB_TRACK_T *mTracks;
+    const LIB_TERM_T *mTerms;
+    const LIB_POSTING_T *mPostings;
+    const char *mStrings;
+    std::vector<LIB_DISC_INFO_T> mPending;  // Not yet in the file
+
+    bool Map(void);
+    void SetMap(uint8_t *map, size_t len);
+    void Unmap(void);
+    const char *GetString(uint32_t offset) const;
+    int FindDisc(const LIB_KEY_T &key) const;
+    static int FindDisc(const LIB_DISC_T *discs, int num,
+                        const LIB_KEY_T &key);
+    LIB_DISC_INFO_T *FindPending(const LIB_KEY_T &key);
+    void GetDiscInfo(int idx, LIB_DISC_INFO_T &info) const;
+    bool Write(void);
+    bool Swap(const std::vector<LIB_DISC_INFO_T> &written);
+protected:
+    virtual void Action(void);
+public:
+    cLibrary(void);
+    virtual ~cLibrary();
+    // Map the library file, a missing file is no error
+    bool Open(const std::string &filename);
+    bool Lookup(const LIB_KEY_T &key, LIB_DISC_INFO_T &info);
+    // Add or change a disc. Empty fields keep the known text, play count
+    // and resume point are never changed.
+    void Update(const LIB_DISC_INFO_T &info);
+    // The disc is played once more
+    void Played(const LIB_KEY_T &key);
+    // Position offset blocks into track (CD order)
+    void SetPosition(const LIB_KEY_T &key, int track, int offset);
+    // Play mode for the resume point, order is only kept for random play
+    void SetResume(const LIB_KEY_T &key, int mode,
+                   const std::vector<uint8_t> &order);
+    // Find discs containing all words (or word prefixes) of query in a
+    // title or performer of the disc or its tracks.
+    int Search(const std::string &query, std::vector<LIB_HIT_T> &hits,
+               int maxhits = LIB_MAX_HITS);
+    int GetNumDiscs(void);
+
+    static bool KeyLess(const LIB_KEY_T &a, const LIB_KEY_T &b);
+    static bool KeyEqual(const LIB_KEY_T &a, const LIB_KEY_T &b);
+    // Split text into lower case words
+    static void GetWords(const std::string &text,
+                         std::vector<std::string> &words);
+};
+
+#endif
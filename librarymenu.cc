@@ -0,0 +1,109 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the OSD menu to search the disc library
+ *
+ */
+
+#include <vdr/menu.h>
+#include <vdr/menuitems.h>
+#include "librarymenu.h"
+#include "cdplayer.h"
+
+cMenuLibrary::cMenuLibrary(void)
+    : cOsdMenu(tr("CD library"))
+{
+    mQuery[0] = '\0';
+    Search();
+}
+
+// Show the search field followed by the discs found
+void cMenuLibrary::Search(void)
+{
+    char buf[256];
+
+    Clear();
+    Add(new cMenuEditStrItem(tr("Search"), mQuery, sizeof(mQuery)));
+    cPluginCdplayer::GetLibrary().Search(mQuery, mHits);
+    for (size_t i = 0; i < mHits.size(); i++) {
+        const LIB_HIT_T &hit = mHits[i];
+        if (hit.mTrack >= 0) {
+            snprintf(buf, sizeof(buf), "%s - %s (%d. %s)",
+                     hit.mPerformer.c_str(), hit.mTitle.c_str(),
+                     hit.mTrack + 1, hit.mTrackTitle.c_str());
+        }
+        else {
+            snprintf(buf, sizeof(buf), "%s - %s", hit.mPerformer.c_str(),
+                     hit.mTitle.c_str());
+        }
+        Add(new cOsdItem(buf), i == 0);
+    }
+    snprintf(buf, sizeof(buf), "%s (%d/%d)", tr("CD library"),
+             (int)mHits.size(), cPluginCdplayer::GetLibrary().GetNumDiscs());
+    SetTitle(buf);
+}
+
+// Show all information about a disc
+eOSState cMenuLibrary::ShowDisc(int hit)
+{
+    LIB_DISC_INFO_T info;
+    std::string text;
+    char buf[256];
+
+    if ((hit < 0) || (hit >= (int)mHits.size()) ||
+        !cPluginCdplayer::GetLibrary().Lookup(mHits[hit].mKey, info)) {
+        return osContinue;
+    }
+    text = info.mPerformer + "\n";
+    if (!info.mGenre.empty()) {
+        text += info.mGenre + "\n";
+    }
+    snprintf(buf, sizeof(buf), "%s: %08x\n%s: %u\n", tr("Disk ID"),
+             info.mKey.mCddbId, tr("Played"), info.mPlayCount);
+    text += buf;
+    if (info.mLastPlayed != 0) {
+        text += tr("Last played");
+        text += ": ";
+        text += *DayDateTime(info.mLastPlayed);
+        text += "\n";
+    }
+    text += "\n";
+    for (size_t i = 0; i < info.mLength.size(); i++) {
+        int secs = info.mLength[i] / CDIO_CD_FRAMES_PER_SEC;
+        snprintf(buf, sizeof(buf), "%2d  %2d:%02d  %s", (int)i + 1,
+                 secs / 60, secs % 60, info.mTrackTitle[i].c_str());
+        text += buf;
+        if (!info.mTrackPerformer[i].empty() &&
+            (info.mTrackPerformer[i] != info.mPerformer)) {
+            text += " (" + info.mTrackPerformer[i] + ")";
+        }
+        text += "\n";
+    }
+    return AddSubMenu(new cMenuText(info.mTitle.empty() ? tr("Unknown") :
+                                    info.mTitle.c_str(), text.c_str()));
+}
+
+eOSState cMenuLibrary::ProcessKey(eKeys Key)
+{
+    bool hadsubmenu = HasSubMenu();
+    eOSState state = cOsdMenu::ProcessKey(Key);
+
+    if (hadsubmenu || HasSubMenu()) {
+        return state;
+    }
+    // Ok in the search field starts the search, on a disc shows it
+    if ((Key == kOk) && (Current() == 0)) {
+        Search();
+        Display();
+        return osContinue;
+    }
+    if ((Key == kOk) && (state == osUnknown)) {
+        return ShowDisc(Current() - 1);
+    }
+    return state;
+}
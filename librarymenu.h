@@ -0,0 +1,34 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the OSD menu to search the disc library
+ *
+ */
+
+#ifndef __LIBRARYMENU_H__
+#define __LIBRARYMENU_H__
+
+#include <vdr/plugin.h>
+#include <vector>
+#include "library.h"
+
+#define LIB_QUERY_LEN 64
+
+class cMenuLibrary: public cOsdMenu {
+private:
+    char mQuery[LIB_QUERY_LEN];
+    std::vector<LIB_HIT_T> mHits;
+
+    void Search(void);
+    eOSState ShowDisc(int hit);
+public:
+    cMenuLibrary(void);
+    virtual eOSState ProcessKey(eKeys Key);
+};
+
+#endif
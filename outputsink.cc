@@ -0,0 +1,396 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the additional outputs of the played audio.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "outputsink.h"
+#include "cdplayer.h"
+#include "ripper.h"
+
+#define SINK_STALL_MS   5000    // A write blocking longer detaches the sink
+#define SINK_IDLE_MS    10
+
+static void PutLe32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+cWavSink::cWavSink(const std::string &filename)
+    : mFileName(filename), mFile(NULL), mDataSize(0)
+{
+}
+
+cWavSink::~cWavSink()
+{
+    Close();
+}
+
+void cWavSink::MakeHeader(uint8_t *hdr, uint32_t datasize)
+{
+    memcpy(hdr, "RIFF", 4);
+    PutLe32(hdr + 4, datasize + 36);
+    memcpy(hdr + 8, "WAVEfmt ", 8);
+    PutLe32(hdr + 16, 16);
+    PutLe32(hdr + 20, 1 | (2 << 16));           // PCM, 2 channels
+    PutLe32(hdr + 24, 44100);
+    PutLe32(hdr + 28, 44100 * 4);
+    PutLe32(hdr + 32, 4 | (16 << 16));          // Block align, bits
+    memcpy(hdr + 36, "data", 4);
+    PutLe32(hdr + 40, datasize);
+}
+
+bool cWavSink::WriteHeader(void)
+{
+    uint8_t hdr[44];
+
+    MakeHeader(hdr, mDataSize);
+    return (fseek(mFile, 0, SEEK_SET) == 0) &&
+           (fwrite(hdr, sizeof(hdr), 1, mFile) == 1);
+}
+
+bool cWavSink::Open(void)
+{
+    mFile = fopen(mFileName.c_str(), "wb");
+    if (mFile == NULL) {
+        esyslog("%s %d Can not create %s %d", __FILE__, __LINE__,
+                mFileName.c_str(), errno);
+        return false;
+    }
+    mDataSize = 0;
+    return WriteHeader();
+}
+
+bool cWavSink::Write(const uint8_t *data, int blocks)
+{
+    size_t len = (size_t)blocks * CDIO_CD_FRAMESIZE_RAW;
+
+    if (mDataSize + len > SINK_WAV_MAX_DATA) {
+        esyslog("%s %d %s is full", __FILE__, __LINE__, mFileName.c_str());
+        return false;
+    }
+    if (fwrite(data, len, 1, mFile) != 1) {
+        esyslog("%s %d Write to %s failed %d", __FILE__, __LINE__,
+                mFileName.c_str(), errno);
+        return false;
+    }
+    mDataSize += len;
+    return true;
+}
+
+// Fill in the sizes, the file is playable even if this fails
+void cWavSink::Close(void)
+{
+    if (mFile == NULL) {
+        return;
+    }
+    if (!WriteHeader()) {
+        esyslog("%s %d Can not update header of %s", __FILE__, __LINE__,
+                mFileName.c_str());
+    }
+    fclose(mFile);
+    mFile = NULL;
+    dsyslog("%s %d %s closed, %u bytes", __FILE__, __LINE__,
+            mFileName.c_str(), mDataSize);
+}
+
+#ifdef USE_FLAC
+cFlacSink::cFlacSink(const std::string &filename)
+    : mFileName(filename), mEncoder(NULL)
+{
+}
+
+cFlacSink::~cFlacSink()
+{
+    Close();
+}
+
+bool cFlacSink::Open(void)
+{
+    // The length is not known, it is filled in when the file is closed
+    mEncoder = cRipper::NewEncoder(mFileName, 0, NULL, 0);
+    return mEncoder != NULL;
+}
+
+bool cFlacSink::Write(const uint8_t *data, int blocks)
+{
+    for (int i = 0; i < blocks; i++) {
+        if (!cRipper::Encode(mEncoder, data)) {
+            esyslog("%s %d Encoding %s failed", __FILE__, __LINE__,
+                    mFileName.c_str());
+            return false;
+        }
+        data += CDIO_CD_FRAMESIZE_RAW;
+    }
+    return true;
+}
+
+void cFlacSink::Close(void)
+{
+    if (mEncoder == NULL) {
+        return;
+    }
+    if (!FLAC__stream_encoder_finish(mEncoder)) {
+        esyslog("%s %d Can not finish %s", __FILE__, __LINE__,
+                mFileName.c_str());
+    }
+    FLAC__stream_encoder_delete(mEncoder);
+    mEncoder = NULL;
+    dsyslog("%s %d %s closed", __FILE__, __LINE__, mFileName.c_str());
+}
+#endif
+
+cUdpSink::cUdpSink(const std::string &host, const std::string &port)
+    : mHost(host), mPort(port), mSocket(-1)
+{
+}
+
+cUdpSink::~cUdpSink()
+{
+    Close();
+}
+
+bool cUdpSink::Open(void)
+{
+    struct addrinfo hints;
+    struct addrinfo *res;
+    int err;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    err = getaddrinfo(mHost.c_str(), mPort.c_str(), &hints, &res);
+    if (err != 0) {
+        esyslog("%s %d Can not resolve %s: %s",
+                __FILE__, __LINE__, mHost.c_str(), gai_strerror(err));
+        return false;
+    }
+    mSocket = socket(res->ai_family, SOCK_DGRAM, 0);
+    if ((mSocket < 0) || (connect(mSocket, res->ai_addr, res->ai_addrlen) < 0)) {
+        esyslog("%s %d UDP stream to %s:%s failed %d", __FILE__, __LINE__,
+                mHost.c_str(), mPort.c_str(), errno);
+        freeaddrinfo(res);
+        Close();
+        return false;
+    }
+    freeaddrinfo(res);
+    return true;
+}
+
+bool cUdpSink::SendDatagram(const uint8_t *data, int len)
+{
+    if (send(mSocket, data, len, MSG_DONTWAIT) >= 0) {
+        return true;
+    }
+    // Full socket buffer or nobody listening
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK) &&
+        (errno != ENOBUFS) && (errno != ECONNREFUSED) && (errno != EINTR)) {
+        esyslog("%s %d UDP send to %s:%s failed %d", __FILE__, __LINE__,
+                mHost.c_str(), mPort.c_str(), errno);
+        return false;
+    }
+    return true;
+}
+
+bool cUdpSink::Write(const uint8_t *data, int blocks)
+{
+    const int len = CDIO_CD_FRAMESIZE_RAW / 2;
+
+    for (int i = 0; i < blocks * 2; i++) {
+        if (!SendDatagram(data + i * len, len)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void cUdpSink::Close(void)
+{
+    if (mSocket >= 0) {
+        close(mSocket);
+        mSocket = -1;
+    }
+}
+
+bool cNullSink::Open(void)
+{
+    mStart = cTimeMs::Now();
+    mBlocks = 0;
+    return true;
+}
+
+bool cNullSink::Write(const uint8_t *data, int blocks)
+{
+    mBlocks += blocks;
+    return true;
+}
+
+void cNullSink::Close(void)
+{
+    dsyslog("%s %d null sink: %u blocks in %u ms", __FILE__, __LINE__,
+            mBlocks, (unsigned int)(cTimeMs::Now() - mStart));
+}
+
+cSinkRunner::cSinkRunner(cOutputSink *sink)
+    : mSink(sink), mHandle(-1), mBlocks(0), mDrops(0)
+{
+    SetDescription("cdplayer sink");
+}
+
+cSinkRunner::~cSinkRunner()
+{
+    Cancel(3);
+    delete mSink;
+}
+
+// The blocks are copied out of the tap before they are written, so a
+// slow write never reads blocks the player is overwriting.
+void cSinkRunner::Action(void)
+{
+    cPcmTap &tap = cPluginCdplayer::GetPcmTap();
+    const int budget = mSink->GetBudget();
+    const uint8_t *data;
+    uint8_t *buf;
+    uint64_t start;
+    int blocks;
+    int index;
+    bool valid;
+
+    buf = (uint8_t *)malloc(TAP_BLOCKS / 2 * CDIO_CD_FRAMESIZE_RAW);
+    if (buf == NULL) {
+        esyslog("%s %d Out of memory", __FILE__, __LINE__);
+        return;
+    }
+    if (!mSink->Open()) {
+        free(buf);
+        return;
+    }
+    mHandle = tap.Subscribe();
+    if (mHandle < 0) {
+        mSink->Close();
+        free(buf);
+        return;
+    }
+    dsyslog("%s %d %s attached", __FILE__, __LINE__, mSink->GetName().c_str());
+    while (Running()) {
+        if (!tap.Peek(mHandle, data, blocks, index, budget) || (blocks == 0)) {
+            if (!mSink->Idle()) {
+                esyslog("%s %d %s failed, detached", __FILE__, __LINE__,
+                        mSink->GetName().c_str());
+                break;
+            }
+            cCondWait::SleepMs(SINK_IDLE_MS);
+            continue;
+        }
+        if (blocks > TAP_BLOCKS / 2) {
+            blocks = TAP_BLOCKS / 2;
+        }
+        memcpy(buf, data, blocks * CDIO_CD_FRAMESIZE_RAW);
+        tap.Consume(mHandle, blocks, valid);
+        mDrops = tap.GetDrops(mHandle);
+        if (!valid) {
+            continue;
+        }
+        start = cTimeMs::Now();
+        if (!mSink->Write(buf, blocks)) {
+            esyslog("%s %d %s failed, detached", __FILE__, __LINE__,
+                    mSink->GetName().c_str());
+            break;
+        }
+        mBlocks += blocks;
+        if (cTimeMs::Now() - start > SINK_STALL_MS) {
+            esyslog("%s %d %s stalled, detached", __FILE__, __LINE__,
+                    mSink->GetName().c_str());
+            break;
+        }
+    }
+    tap.Unsubscribe(mHandle);
+    mSink->Close();
+    free(buf);
+}
+
+cSinkList::~cSinkList()
+{
+    Clear();
+}
+
+// Delete the sinks whose thread ended
+void cSinkList::Reap(void)
+{
+    for (size_t i = 0; i < mRunners.size(); ) {
+        if (!mRunners[i]->Active()) {
+            delete mRunners[i];
+            mRunners.erase(mRunners.begin() + i);
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+void cSinkList::Add(cOutputSink *sink)
+{
+    cMutexLock MutexLock(&mMutex);
+    cSinkRunner *runner = new cSinkRunner(sink);
+
+    Reap();
+    mRunners.push_back(runner);
+    runner->Start();
+}
+
+bool cSinkList::Remove(size_t idx)
+{
+    cMutexLock MutexLock(&mMutex);
+
+    Reap();
+    if (idx >= mRunners.size()) {
+        return false;
+    }
+    delete mRunners[idx];
+    mRunners.erase(mRunners.begin() + idx);
+    return true;
+}
+
+void cSinkList::Clear(void)
+{
+    cMutexLock MutexLock(&mMutex);
+
+    for (size_t i = 0; i < mRunners.size(); i++) {
+        delete mRunners[i];
+    }
+    mRunners.clear();
+}
+
+std::string cSinkList::List(void)
+{
+    cMutexLock MutexLock(&mMutex);
+    std::string reply;
+    char buf[256];
+
+    Reap();
+    for (size_t i = 0; i < mRunners.size(); i++) {
+        snprintf(buf, sizeof(buf), "%d %s blocks %u drops %u", (int)i + 1,
+                 mRunners[i]->GetName().c_str(), mRunners[i]->GetBlocks(),
+                 mRunners[i]->GetDrops());
+        if (!reply.empty()) {
+            reply += "\n";
+        }
+        reply += buf;
+    }
+    return reply;
+}
@@ -0,0 +1,153 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements additional outputs of the played audio. The VDR
+ * device stays the primary output which paces playback. Each further
+ * sink is run by its own thread reading the PCM tap with its own cursor,
+ * so the disc is read and the audio converted only once. A sink lagging
+ * more than its latency budget drops the older blocks, a failing sink is
+ * detached. Neither stops playback.
+ */
+
+#ifndef __OUTPUTSINK_H__
+#define __OUTPUTSINK_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <vdr/thread.h>
+#include "pcmtap.h"
+#ifdef USE_FLAC
+#include <FLAC/stream_encoder.h>
+#endif
+
+#define SINK_WAV_BUDGET     (TAP_BLOCKS / 2)    // A file may be slow at times
+#define SINK_NET_BUDGET     15                  // 200 ms, stay close to live
+#define SINK_WAV_MAX_DATA   0xffffffd0U         // RIFF size limit
+
+class cOutputSink {
+public:
+    virtual ~cOutputSink() {}
+    virtual bool Open(void) = 0;
+    // Write complete blocks, false detaches the sink
+    virtual bool Write(const uint8_t *data, int blocks) = 0;
+    virtual void Close(void) = 0;
+    virtual std::string GetName(void) = 0;
+    // Blocks the sink may lag behind the player
+    virtual int GetBudget(void) { return TAP_BLOCKS / 2; }
+    // Called when there is no data (pause, stop), false detaches the sink
+    virtual bool Idle(void) { return true; }
+};
+
+// Writes a WAV file
+class cWavSink: public cOutputSink {
+private:
+    std::string mFileName;
+    FILE *mFile;
+    uint32_t mDataSize;
+
+    bool WriteHeader(void);
+public:
+    // 44 bytes RIFF header for CD audio with datasize bytes
+    static void MakeHeader(uint8_t *hdr, uint32_t datasize);
+    cWavSink(const std::string &filename);
+    virtual ~cWavSink();
+    virtual bool Open(void);
+    virtual bool Write(const uint8_t *data, int blocks);
+    virtual void Close(void);
+    virtual std::string GetName(void) { return "wav " + mFileName; }
+    virtual int GetBudget(void) { return SINK_WAV_BUDGET; }
+};
+
+#ifdef USE_FLAC
+// Writes a FLAC file with the encoder settings of the ripper
+class cFlacSink: public cOutputSink {
+private:
+    std::string mFileName;
+    FLAC__StreamEncoder *mEncoder;
+public:
+    cFlacSink(const std::string &filename);
+    virtual ~cFlacSink();
+    virtual bool Open(void);
+    virtual bool Write(const uint8_t *data, int blocks);
+    virtual void Close(void);
+    virtual std::string GetName(void) { return "flac " + mFileName; }
+    virtual int GetBudget(void) { return SINK_WAV_BUDGET; }
+};
+#endif
+
+// Sends the raw PCM data (16 bit little endian stereo) as UDP datagrams of
+// half a block. Datagrams the network does not take at once are dropped.
+class cUdpSink: public cOutputSink {
+protected:
+    std::string mHost;
+    std::string mPort;
+    int mSocket;
+
+    // A datagram the network does not take at once is lost, false only
+    // on real errors
+    bool SendDatagram(const uint8_t *data, int len);
+public:
+    cUdpSink(const std::string &host, const std::string &port);
+    virtual ~cUdpSink();
+    virtual bool Open(void);
+    virtual bool Write(const uint8_t *data, int blocks);
+    virtual void Close(void);
+    virtual std::string GetName(void) { return "udp " + mHost + ":" + mPort; }
+    virtual int GetBudget(void) { return SINK_NET_BUDGET; }
+};
+
+// Discards the data, for measuring the cost of the fan-out
+class cNullSink: public cOutputSink {
+private:
+    uint64_t mStart;
+    unsigned int mBlocks;
+public:
+    cNullSink(void) : mStart(0), mBlocks(0) {}
+    virtual bool Open(void);
+    virtual bool Write(const uint8_t *data, int blocks);
+    virtual void Close(void);
+    virtual std::string GetName(void) { return "null"; }
+};
+
+// Thread feeding one sink from the tap
+class cSinkRunner: public cThread {
+private:
+    cOutputSink *mSink;
+    int mHandle;
+    unsigned int mBlocks;       // Blocks written
+    unsigned int mDrops;        // Blocks lost, updated after each write
+protected:
+    virtual void Action(void);
+public:
+    cSinkRunner(cOutputSink *sink);
+    virtual ~cSinkRunner();
+    std::string GetName(void) { return mSink->GetName(); }
+    unsigned int GetBlocks(void) { return mBlocks; }
+    unsigned int GetDrops(void) { return mDrops; }
+};
+
+class cSinkList {
+private:
+    cMutex mMutex;
+    std::vector<cSinkRunner *> mRunners;
+
+    void Reap(void);
+public:
+    cSinkList(void) {}
+    ~cSinkList();
+    // Takes ownership of the sink and starts feeding it
+    void Add(cOutputSink *sink);
+    bool Remove(size_t idx);
+    void Clear(void);
+    // One line per sink: number, name, blocks written and dropped
+    std::string List(void);
+};
+
+#endif
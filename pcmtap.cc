@@ -0,0 +1,225 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the PCM tap.
+ *
+ * Block n is stored in slot n % TAP_BLOCKS. Before a slot is written
+ * mWriting is incremented, after it mHead. A subscriber reading blocks
+ * from its cursor on checks mWriting afterwards: if the writer started
+ * on the slot of the cursor meanwhile, the data may be torn.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "pcmtap.h"
+#include "cdplayer.h"
+
+cPcmTap::cPcmTap(void) : mHead(0), mWriting(0), mNumSubs(0)
+{
+    mData = (uint8_t *)malloc(TAP_BLOCKS * CDIO_CD_FRAMESIZE_RAW);
+    if (mData == NULL) {
+        esyslog ("%s %d Out of memory", __FILE__, __LINE__);
+        exit(-1);
+    }
+    memset(mIndex, 0, sizeof(mIndex));
+    memset(mSubs, 0, sizeof(mSubs));
+}
+
+cPcmTap::~cPcmTap()
+{
+    free(mData);
+}
+
+void cPcmTap::DoPut(const uint8_t *data, int frame)
+{
+    unsigned int seq = mHead;
+    int slot = seq & (TAP_BLOCKS - 1);
+
+    __atomic_store_n(&mWriting, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(mData + slot * CDIO_CD_FRAMESIZE_RAW, data, CDIO_CD_FRAMESIZE_RAW);
+    mIndex[slot] = (frame * 1000) / CDIO_CD_FRAMES_PER_SEC;
+    __atomic_store_n(&mHead, seq + 1, __ATOMIC_RELEASE);
+}
+
+cPcmTap::TAP_SUBSCRIBER_T *cPcmTap::GetSubscriber(int handle)
+{
+    if ((handle < 0) || (handle >= TAP_MAX_SUBSCRIBERS) ||
+        !mSubs[handle].mUsed) {
+        return NULL;
+    }
+    return &mSubs[handle];
+}
+
+int cPcmTap::Subscribe(void)
+{
+    cMutexLock MutexLock(&mMutex);
+
+    for (int i = 0; i < TAP_MAX_SUBSCRIBERS; i++) {
+        if (!mSubs[i].mUsed) {
+            mSubs[i].mCursor = __atomic_load_n(&mHead, __ATOMIC_ACQUIRE);
+            mSubs[i].mPeeked = 0;
+            mSubs[i].mDrops = 0;
+            mSubs[i].mUsed = true;
+            __atomic_add_fetch(&mNumSubs, 1, __ATOMIC_RELEASE);
+            dsyslog("%s %d PCM tap subscriber %d", __FILE__, __LINE__, i);
+            return i;
+        }
+    }
+    esyslog("%s %d Too many PCM tap subscribers", __FILE__, __LINE__);
+    return -1;
+}
+
+void cPcmTap::Unsubscribe(int handle)
+{
+    cMutexLock MutexLock(&mMutex);
+    TAP_SUBSCRIBER_T *sub = GetSubscriber(handle);
+
+    if (sub != NULL) {
+        sub->mUsed = false;
+        __atomic_sub_fetch(&mNumSubs, 1, __ATOMIC_RELEASE);
+    }
+}
+
+bool cPcmTap::Peek(int handle, const uint8_t *&data, int &blocks, int &index,
+                   int maxlag)
+{
+    TAP_SUBSCRIBER_T *sub = GetSubscriber(handle);
+    unsigned int head = __atomic_load_n(&mHead, __ATOMIC_ACQUIRE);
+    unsigned int avail;
+    int slot;
+
+    data = NULL;
+    blocks = 0;
+    index = 0;
+    if (sub == NULL) {
+        return false;
+    }
+    avail = head - sub->mCursor;
+    // Fallen behind, at most in the middle of the ring to get some time
+    // before the writer reaches the cursor again.
+    if ((maxlag <= 0) || (maxlag > TAP_BLOCKS / 2)) {
+        maxlag = TAP_BLOCKS / 2;
+    }
+    if (avail > (unsigned int)maxlag) {
+        sub->mDrops += avail - maxlag;
+        sub->mCursor = head - maxlag;
+        avail = maxlag;
+    }
+    slot = sub->mCursor & (TAP_BLOCKS - 1);
+    blocks = avail;
+    if (slot + blocks > TAP_BLOCKS) {
+        blocks = TAP_BLOCKS - slot;
+    }
+    sub->mPeeked = blocks;
+    if (blocks > 0) {
+        data = mData + slot * CDIO_CD_FRAMESIZE_RAW;
+        index = mIndex[slot];
+    }
+    return true;
+}
+
+bool cPcmTap::Consume(int handle, int blocks, bool &valid)
+{
+    TAP_SUBSCRIBER_T *sub = GetSubscriber(handle);
+    unsigned int writing;
+
+    valid = false;
+    if (sub == NULL) {
+        return false;
+    }
+    if ((blocks < 0) || (blocks > sub->mPeeked)) {
+        blocks = sub->mPeeked;
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    writing = __atomic_load_n(&mWriting, __ATOMIC_RELAXED);
+    valid = (writing - sub->mCursor <= TAP_BLOCKS);
+    if (!valid) {
+        sub->mDrops += blocks;
+    }
+    sub->mCursor += blocks;
+    sub->mPeeked = 0;
+    return true;
+}
+
+unsigned int cPcmTap::GetDrops(int handle)
+{
+    TAP_SUBSCRIBER_T *sub = GetSubscriber(handle);
+
+    return (sub != NULL) ? sub->mDrops : 0;
+}
+
+bool cPcmTap::Service(CdPlayer_PcmTap_1_0 &tap)
+{
+    bool ok = false;
+
+    switch (tap.command) {
+    case CDPLAYER_TAP_SUBSCRIBE:
+        tap.handle = Subscribe();
+        ok = (tap.handle >= 0);
+        break;
+    case CDPLAYER_TAP_PEEK:
+        ok = Peek(tap.handle, tap.data, tap.blocks, tap.index);
+        break;
+    case CDPLAYER_TAP_CONSUME:
+        ok = Consume(tap.handle, tap.blocks, tap.valid);
+        break;
+    case CDPLAYER_TAP_UNSUBSCRIBE:
+        tap.drops = GetDrops(tap.handle);
+        Unsubscribe(tap.handle);
+        return true;
+    default:
+        break;
+    }
+    tap.drops = GetDrops(tap.handle);
+    return ok;
+}
+
+cSpanFeeder::cSpanFeeder(void)
+{
+    SetDescription("cdplayer span");
+}
+
+cSpanFeeder::~cSpanFeeder()
+{
+    Cancel(3);
+}
+
+void cSpanFeeder::Action(void)
+{
+    cPcmTap &tap = cPluginCdplayer::GetPcmTap();
+    Span_SetPcmData_1_0 setpcmdata;
+    const uint8_t *data;
+    int handle = tap.Subscribe();
+    int blocks;
+    int index;
+    bool valid;
+
+    if (handle < 0) {
+        return;
+    }
+    // tell span the tap's size for it's internal bookkeeping of the data
+    // to be visualized
+    setpcmdata.bufferSize = TAP_BLOCKS * CDIO_CD_FRAMESIZE_RAW;
+    setpcmdata.bigEndian = false;
+    while (Running()) {
+        if (!tap.Peek(handle, data, blocks, index) || (blocks == 0)) {
+            cCondWait::SleepMs(20);
+            continue;
+        }
+        for (int i = 0; i < blocks; i++) {
+            setpcmdata.length = CDIO_CD_FRAMESIZE_RAW;
+            setpcmdata.index = index + (i * 1000) / CDIO_CD_FRAMES_PER_SEC;
+            setpcmdata.data = data + i * CDIO_CD_FRAMESIZE_RAW;
+            cPluginManager::CallFirstService(SPAN_SET_PCM_DATA_ID,
+                                             &setpcmdata);
+        }
+        tap.Consume(handle, blocks, valid);
+    }
+    tap.Unsubscribe(handle);
+}
@@ -0,0 +1,82 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the PCM tap: the player writes each played
+ * block into a ring buffer, which is read by any number of subscribers
+ * (other plugins via the service interface) with their own read
+ * position. The player never waits, a subscriber which falls behind
+ * loses the overwritten blocks.
+ */
+
+#ifndef __PCMTAP_H__
+#define __PCMTAP_H__
+
+#include <stdint.h>
+#include <cdio/cdio.h>
+#ifdef VERSION
+#undef VERSION
+#endif
+#include <vdr/thread.h>
+#include "service.h"
+
+#define TAP_BLOCKS          512     // Must be a power of 2, about 7 seconds
+#define TAP_MAX_SUBSCRIBERS 8
+
+class cPcmTap {
+private:
+    typedef struct _tap_subscriber {
+        bool mUsed;
+        unsigned int mCursor;   // Next block to read
+        int mPeeked;            // Blocks handed out by the last Peek
+        unsigned int mDrops;
+    } TAP_SUBSCRIBER_T;
+
+    uint8_t *mData;
+    int mIndex[TAP_BLOCKS];     // Timestamp (ms) of each block
+    unsigned int mHead;         // Blocks written
+    unsigned int mWriting;      // Blocks of which writing has started
+    cMutex mMutex;              // Serializes subscribe and unsubscribe
+    TAP_SUBSCRIBER_T mSubs[TAP_MAX_SUBSCRIBERS];
+    int mNumSubs;
+
+    void DoPut(const uint8_t *data, int frame);
+    TAP_SUBSCRIBER_T *GetSubscriber(int handle);
+public:
+    cPcmTap(void);
+    ~cPcmTap();
+    // Called by the player for each block when it is played
+    void Put(const uint8_t *data, int frame) {
+        if (__atomic_load_n(&mNumSubs, __ATOMIC_ACQUIRE) > 0) {
+            DoPut(data, frame);
+        }
+    }
+    // Returns the handle, -1 if there are too many subscribers
+    int Subscribe(void);
+    void Unsubscribe(int handle);
+    // Contiguous blocks not yet read, they stay in place until Consume. A
+    // subscriber lagging more than maxlag blocks drops the older ones.
+    bool Peek(int handle, const uint8_t *&data, int &blocks, int &index,
+              int maxlag = TAP_BLOCKS / 2);
+    // Advance by blocks, valid is false if they were overwritten meanwhile
+    bool Consume(int handle, int blocks, bool &valid);
+    unsigned int GetDrops(int handle);
+    // Handle a CDPLAYER_PCM_TAP_ID service call
+    bool Service(CdPlayer_PcmTap_1_0 &tap);
+};
+
+// Feeds the span plugin from the tap, so the player does not call it
+// for each block.
+class cSpanFeeder: public cThread {
+protected:
+    virtual void Action(void);
+public:
+    cSpanFeeder(void);
+    virtual ~cSpanFeeder();
+};
+
+#endif
@@ -0,0 +1,330 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the play order of the tracks of a disc and the
+ * user defined play queue.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <vdr/tools.h>
+#include "playlist.h"
+#include "cdplayer.h"
+
+void cRandom::Seed(uint64_t seed)
+{
+    // splitmix64, so similar seeds give different sequences
+    uint64_t z = seed + 0x9e3779b97f4a7c15ULL;
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    mState = (z != 0) ? z : 1;
+}
+
+uint64_t cRandom::Next(void)
+{
+    mState ^= mState >> 12;
+    mState ^= mState << 25;
+    mState ^= mState >> 27;
+    return mState * 0x2545f4914f6cdd1dULL;
+}
+
+// Multiply instead of modulo, values in the biased part are rejected
+uint32_t cRandom::Below(uint32_t n)
+{
+    uint64_t m = (Next() >> 32) * n;
+    uint32_t low = (uint32_t)m;
+
+    if (low < n) {
+        uint32_t threshold = (0 - n) % n;
+        while (low < threshold) {
+            m = (Next() >> 32) * n;
+            low = (uint32_t)m;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
+
+cPlaylist::cPlaylist(cCdInfo &cdinfo)
+    : mCdInfo(cdinfo), mState(PL_SORTED << PL_MODE_SHIFT)
+{
+    memset(mOrder, 0, sizeof(mOrder));
+    mRandom.Seed(((uint64_t)time(NULL) << 20) ^ cTimeMs::Now());
+}
+
+// The unused array was filled by the caller. Writers are serialized by
+// the reader thread.
+void cPlaylist::Publish(int length, PL_MODE_T mode)
+{
+    unsigned int state = __atomic_load_n(&mState, __ATOMIC_RELAXED);
+    unsigned int gen = (state >> PL_GEN_SHIFT) + 1;
+    unsigned int buf = ((state >> PL_BUF_SHIFT) & 1) ^ 1;
+
+    state = (gen << PL_GEN_SHIFT) | ((unsigned int)mode << PL_MODE_SHIFT) |
+            (buf << PL_BUF_SHIFT) | length;
+    __atomic_store_n(&mState, state, __ATOMIC_RELEASE);
+}
+
+void cPlaylist::Sort(void)
+{
+    std::vector<uint8_t> order;
+
+    for (TRACK_IDX_T i = 0; i < mCdInfo.GetNumTracks(); i++) {
+        order.push_back(i);
+    }
+    SetOrder(order, PL_SORTED);
+}
+
+void cPlaylist::Shuffle(void)
+{
+    std::vector<uint8_t> order;
+    int n = mCdInfo.GetNumTracks();
+
+    for (int i = 0; i < n; i++) {
+        order.push_back(i);
+    }
+    for (int i = n - 1; i > 0; i--) {
+        int j = mRandom.Below(i + 1);
+        uint8_t t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    SetOrder(order, PL_RANDOM);
+}
+
+bool cPlaylist::SetOrder(const std::vector<uint8_t> &order, PL_MODE_T mode)
+{
+    int n = order.size();
+    track_t *next;
+
+    if (n > PL_MAX_TRACKS) {
+        return false;
+    }
+    for (int i = 0; i < n; i++) {
+        if (order[i] >= mCdInfo.GetNumTracks()) {
+            return false;
+        }
+    }
+    // Readers of an older state see the change and read again
+    next = mOrder[((GetState() >> PL_BUF_SHIFT) & 1) ^ 1];
+    for (int i = 0; i < n; i++) {
+        next[i] = order[i];
+    }
+    Publish(n, mode);
+    return true;
+}
+
+void cPlaylist::GetOrder(std::vector<uint8_t> &order) const
+{
+    unsigned int state;
+
+    do {
+        state = GetState();
+        const track_t *o = Order(state);
+        order.assign(o, o + Length(state));
+    } while (!Unchanged(state));
+}
+
+TRACK_IDX_T cPlaylist::GetDiscTrack(TRACK_IDX_T track) const
+{
+    unsigned int state;
+    TRACK_IDX_T disctrack;
+
+    if ((track < 0) || (track >= PL_MAX_TRACKS)) {
+        return 0;
+    }
+    do {
+        state = GetState();
+        disctrack = Order(state)[track];
+    } while (!Unchanged(state));
+    return disctrack;
+}
+
+int cPlaylist::GetLookahead(TRACK_IDX_T track, lsn_t lsn, int blocks,
+                            PL_RANGE_T *ranges, int maxranges) const
+{
+    unsigned int state = GetState();
+    const track_t *order = Order(state);
+    int len = Length(state);
+    int n = 0;
+
+    // Only called by the reader thread, which is the only writer
+    while ((track >= 0) && (track < len) && (n < maxranges) && (blocks > 0)) {
+        TRACK_IDX_T disctrack = order[track];
+        lsn_t start = mCdInfo.GetStartLsn(disctrack);
+        lsn_t end = mCdInfo.GetEndLsn(disctrack);
+        PL_RANGE_T &r = ranges[n];
+
+        if ((lsn < start) || (lsn > end)) {
+            lsn = start;
+        }
+        r.mTrack = track;
+        r.mStart = lsn;
+        r.mEnd = end;
+        if (end - lsn + 1 > blocks) {
+            r.mEnd = lsn + blocks - 1;
+        }
+        blocks -= r.mEnd - r.mStart + 1;
+        n++;
+        track++;
+        lsn = CDIO_INVALID_LSN;
+    }
+    return n;
+}
+
+cPlayQueue::cPlayQueue(void) : mVersion(0)
+{
+    memset(&mDisc, 0, sizeof(mDisc));
+}
+
+void cPlayQueue::SetDisc(const LIB_KEY_T *key)
+{
+    cMutexLock MutexLock(&mMutex);
+    if (key == NULL) {
+        memset(&mDisc, 0, sizeof(mDisc));
+    }
+    else {
+        mDisc = *key;
+    }
+}
+
+bool cPlayQueue::Add(int track)
+{
+    cMutexLock MutexLock(&mMutex);
+    PL_QUEUE_ENTRY_T entry;
+
+    if ((track < 0) || (track >= mDisc.mNumTracks)) {
+        return false;
+    }
+    entry.mKey = mDisc;
+    entry.mTrack = track;
+    mEntries.push_back(entry);
+    Changed();
+    return true;
+}
+
+void cPlayQueue::Clear(void)
+{
+    cMutexLock MutexLock(&mMutex);
+    mEntries.clear();
+    Changed();
+}
+
+void cPlayQueue::Get(std::vector<PL_QUEUE_ENTRY_T> &entries)
+{
+    cMutexLock MutexLock(&mMutex);
+    entries = mEntries;
+}
+
+bool cPlayQueue::GetTracks(const LIB_KEY_T &key, std::vector<uint8_t> &tracks)
+{
+    cMutexLock MutexLock(&mMutex);
+
+    tracks.clear();
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        if (cLibrary::KeyEqual(mEntries[i].mKey, key)) {
+            tracks.push_back(mEntries[i].mTrack);
+        }
+    }
+    return !tracks.empty();
+}
+
+bool cPlayQueue::CheckName(const std::string &name)
+{
+    return !name.empty() && (name[0] != '.') &&
+           (name.find('/') == std::string::npos);
+}
+
+// One line per track: cddb id, lead out, number of tracks, track (1 based)
+bool cPlayQueue::Save(const std::string &name)
+{
+    cMutexLock MutexLock(&mMutex);
+    std::string path = cPluginCdplayer::GetConfigDir() + PL_QUEUE_DIR + name;
+    bool ok;
+    FILE *fp;
+
+    if (!CheckName(name)) {
+        return false;
+    }
+    if (!MakeDirs(path.c_str(), false)) {
+        esyslog("%s %d can not create directory for %s",
+                __FILE__, __LINE__, path.c_str());
+        return false;
+    }
+    fp = fopen(path.c_str(), "w");
+    if (fp == NULL) {
+        esyslog("%s %d can not write %s", __FILE__, __LINE__, path.c_str());
+        return false;
+    }
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        const PL_QUEUE_ENTRY_T &e = mEntries[i];
+        fprintf(fp, "%08x %u %u %d\n", e.mKey.mCddbId, e.mKey.mLeadOut,
+                e.mKey.mNumTracks, e.mTrack + 1);
+    }
+    ok = (ferror(fp) == 0);
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+    return ok;
+}
+
+bool cPlayQueue::Load(const std::string &name)
+{
+    cMutexLock MutexLock(&mMutex);
+    std::string path = cPluginCdplayer::GetConfigDir() + PL_QUEUE_DIR + name;
+    std::vector<PL_QUEUE_ENTRY_T> entries;
+    char line[128];
+    FILE *fp;
+
+    if (!CheckName(name)) {
+        return false;
+    }
+    fp = fopen(path.c_str(), "r");
+    if (fp == NULL) {
+        return false;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        PL_QUEUE_ENTRY_T e;
+        unsigned int id, leadout, numtracks;
+        int track;
+        if ((sscanf(line, "%x %u %u %d", &id, &leadout, &numtracks,
+                    &track) != 4) ||
+            (track < 1) || (track > (int)numtracks)) {
+            continue;
+        }
+        e.mKey.mCddbId = id;
+        e.mKey.mLeadOut = leadout;
+        e.mKey.mNumTracks = numtracks;
+        e.mTrack = track - 1;
+        entries.push_back(e);
+    }
+    fclose(fp);
+    mEntries.swap(entries);
+    Changed();
+    return true;
+}
+
+void cPlayQueue::GetNames(std::vector<std::string> &names)
+{
+    std::string dir = cPluginCdplayer::GetConfigDir() + PL_QUEUE_DIR;
+    cReadDir d(dir.c_str());
+    struct dirent *e;
+
+    names.clear();
+    if (!d.Ok()) {
+        return;
+    }
+    while ((e = d.Next()) != NULL) {
+        if (CheckName(e->d_name)) {
+            names.push_back(e->d_name);
+        }
+    }
+}
@@ -0,0 +1,139 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the play order of the tracks of a disc and the
+ * user defined play queue, which may contain tracks of several discs.
+ *
+ * The play order is kept in two fixed arrays. A new order is written to
+ * the unused one and published with a single word holding the array, the
+ * length, the mode and a generation, so the player and the OSD read it
+ * without locking. A reader which found the word changed after reading
+ * an array reads again.
+ */
+
+#ifndef __PLAYLIST_H__
+#define __PLAYLIST_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <vdr/thread.h>
+#include "cdinfo.h"
+#include "library.h"
+
+#define PL_MAX_TRACKS   CDIO_CD_MAX_TRACKS
+// Published state: length, array, mode and generation
+#define PL_LEN_MASK     0xff
+#define PL_BUF_SHIFT    8
+#define PL_MODE_SHIFT   9
+#define PL_MODE_MASK    0x3
+#define PL_GEN_SHIFT    11
+#define PL_QUEUE_DIR    "queues/"
+
+typedef enum _pl_mode {
+    PL_SORTED,
+    PL_RANDOM,
+    PL_QUEUE        // Tracks of the play queue
+} PL_MODE_T;
+
+// Blocks which will be played, start and end are inclusive
+typedef struct _pl_range {
+    TRACK_IDX_T mTrack;     // Index in the play order
+    lsn_t mStart;
+    lsn_t mEnd;
+} PL_RANGE_T;
+
+// Small seedable random generator (xorshift64*), so a shuffled order
+// can be repeated
+class cRandom {
+private:
+    uint64_t mState;
+public:
+    cRandom(uint64_t seed = 0) { Seed(seed); }
+    void Seed(uint64_t seed);
+    uint64_t Next(void);
+    // Equally distributed in 0..n-1
+    uint32_t Below(uint32_t n);
+};
+
+class cPlaylist {
+private:
+    cCdInfo &mCdInfo;
+    cRandom mRandom;
+    track_t mOrder[2][PL_MAX_TRACKS];   // Disc tracks in play order
+    unsigned int mState;
+
+    unsigned int GetState(void) const {
+        return __atomic_load_n(&mState, __ATOMIC_ACQUIRE);
+    }
+    // True if the state did not change while an array was read
+    bool Unchanged(unsigned int state) const {
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        return __atomic_load_n(&mState, __ATOMIC_RELAXED) == state;
+    }
+    static int Length(unsigned int state) { return state & PL_LEN_MASK; }
+    const track_t *Order(unsigned int state) const {
+        return mOrder[(state >> PL_BUF_SHIFT) & 1];
+    }
+    void Publish(int length, PL_MODE_T mode);
+public:
+    cPlaylist(cCdInfo &cdinfo);
+    void SetSeed(uint64_t seed) { mRandom.Seed(seed); }
+    void Clear(void) { Publish(0, GetMode()); }
+    void Sort(void);
+    // Fisher-Yates shuffle of all tracks of the disc
+    void Shuffle(void);
+    // Play the given disc tracks, returns false if a track is invalid
+    bool SetOrder(const std::vector<uint8_t> &order, PL_MODE_T mode);
+    void GetOrder(std::vector<uint8_t> &order) const;
+    PL_MODE_T GetMode(void) const {
+        return (PL_MODE_T)((GetState() >> PL_MODE_SHIFT) & PL_MODE_MASK);
+    }
+    int GetLength(void) const { return Length(GetState()); }
+    TRACK_IDX_T GetDiscTrack(TRACK_IDX_T track) const;
+    // Fill up to maxranges ranges played after lsn of track, covering at
+    // most blocks blocks. Returns the number of ranges.
+    int GetLookahead(TRACK_IDX_T track, lsn_t lsn, int blocks,
+                     PL_RANGE_T *ranges, int maxranges) const;
+};
+
+typedef struct _pl_queue_entry {
+    LIB_KEY_T mKey;
+    int mTrack;             // Disc track, 0 based
+} PL_QUEUE_ENTRY_T;
+
+// Tracks queued by the user. Tracks of other discs are kept until their
+// disc is inserted. Queues may be saved under a name.
+class cPlayQueue {
+private:
+    cMutex mMutex;
+    std::vector<PL_QUEUE_ENTRY_T> mEntries;
+    LIB_KEY_T mDisc;        // Disc in the drive
+    unsigned int mVersion;  // Changed with each change of the queue
+
+    void Changed(void) { __atomic_add_fetch(&mVersion, 1, __ATOMIC_RELEASE); }
+    static bool CheckName(const std::string &name);
+public:
+    cPlayQueue(void);
+    // Set the disc in the drive, NULL if none
+    void SetDisc(const LIB_KEY_T *key);
+    // Add a track of the disc in the drive
+    bool Add(int track);
+    void Clear(void);
+    void Get(std::vector<PL_QUEUE_ENTRY_T> &entries);
+    // Tracks queued for a disc, false if none
+    bool GetTracks(const LIB_KEY_T &key, std::vector<uint8_t> &tracks);
+    unsigned int GetVersion(void) const {
+        return __atomic_load_n(&mVersion, __ATOMIC_ACQUIRE);
+    }
+    bool Save(const std::string &name);
+    bool Load(const std::string &name);
+    static void GetNames(std::vector<std::string> &names);
+};
+
+#endif
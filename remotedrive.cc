@@ -0,0 +1,858 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the drive server and its client.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vdr/config.h>
+#include <vdr/tools.h>
+#include "remotedrive.h"
+
+#define RD_MAX_REPLY    (1024 * 1024)   // Replies without sectors
+
+// Requests are small and must not wait for more data
+static void SetupSocket(int fd)
+{
+    struct timeval tv;
+    int on = 1;
+
+    tv.tv_sec = RD_TIMEOUT_MS / 1000;
+    tv.tv_usec = 0;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+static bool SendAll(int fd, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    ssize_t n;
+
+    while (len > 0) {
+        n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool RecvAll(int fd, void *data, size_t len)
+{
+    uint8_t *p = (uint8_t *)data;
+    ssize_t n;
+
+    while (len > 0) {
+        n = recv(fd, p, len, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (n == 0) {
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static void PutBe32(std::string &s, uint32_t v)
+{
+    v = htonl(v);
+    s.append((const char *)&v, sizeof(v));
+}
+
+static void SetBe32(std::string &s, size_t pos, uint32_t v)
+{
+    v = htonl(v);
+    s.replace(pos, sizeof(v), (const char *)&v, sizeof(v));
+}
+
+static bool GetBe32(const std::string &s, size_t &pos, uint32_t &v)
+{
+    if (pos + sizeof(v) > s.size()) {
+        return false;
+    }
+    memcpy(&v, s.data() + pos, sizeof(v));
+    v = ntohl(v);
+    pos += sizeof(v);
+    return true;
+}
+
+static bool ParseCdText(const std::string &s, CD_TEXT_T &cdtext)
+{
+    size_t pos = 0;
+    uint32_t field, len;
+
+    while (pos < s.size()) {
+        if (!GetBe32(s, pos, field) || !GetBe32(s, pos, len) ||
+            (field >= MAX_CDTEXT_FIELDS) || (len > s.size() - pos)) {
+            return false;
+        }
+        cdtext[field].assign(s, pos, len);
+        pos += len;
+    }
+    return true;
+}
+
+static bool ParseToc(const std::string &s, SRC_TOC_T &toc)
+{
+    size_t pos = 0;
+    uint32_t leadout, num, v[5];
+
+    if (!GetBe32(s, pos, leadout) || !GetBe32(s, pos, num) ||
+        (num > CDIO_CD_MAX_TRACKS)) {
+        return false;
+    }
+    toc.mLeadOut = (lba_t)leadout;
+    toc.mTracks.clear();
+    for (uint32_t i = 0; i < num; i++) {
+        SRC_TRACK_T t;
+        for (int j = 0; j < 5; j++) {
+            if (!GetBe32(s, pos, v[j])) {
+                return false;
+            }
+        }
+        t.mTrackNo = (track_t)v[0];
+        t.mStartLsn = (lsn_t)v[1];
+        t.mEndLsn = (lsn_t)v[2];
+        t.mLba = (lba_t)v[3];
+        t.mAudio = (v[4] != 0);
+        toc.mTracks.push_back(t);
+    }
+    return true;
+}
+
+static bool IsSilent(const uint8_t *data)
+{
+    return (data[0] == 0) &&
+           (memcmp(data, data + 1, CDIO_CD_FRAMESIZE_RAW - 1) == 0);
+}
+
+cRemoteSource::cRemoteSource(const std::string &server)
+    : mSocket(-1), mTag(0), mUseCount(0), mInFlight(0)
+{
+    size_t pos = server.rfind(':');
+
+    if (pos == std::string::npos) {
+        mHost = server;
+        mPort = RD_DEFAULT_PORT;
+    }
+    else {
+        mHost = server.substr(0, pos);
+        mPort = server.substr(pos + 1);
+    }
+    for (int i = 0; i < RD_SLOTS; i++) {
+        mSlots[i].mCount = 0;
+        mSlots[i].mPending = false;
+        mSlots[i].mData = NULL;
+    }
+}
+
+cRemoteSource::~cRemoteSource()
+{
+    Disconnect();
+    for (int i = 0; i < RD_SLOTS; i++) {
+        free(mSlots[i].mData);
+    }
+}
+
+bool cRemoteSource::Connect(void)
+{
+    struct addrinfo hints;
+    struct addrinfo *res;
+    struct addrinfo *ai;
+    int err;
+
+    for (int i = 0; i < RD_SLOTS; i++) {
+        if (mSlots[i].mData == NULL) {
+            mSlots[i].mData = (uint8_t *)malloc(RD_READ_BLOCKS *
+                                                CDIO_CD_FRAMESIZE_RAW);
+            if (mSlots[i].mData == NULL) {
+                esyslog("%s %d Out of memory", __FILE__, __LINE__);
+                return false;
+            }
+        }
+    }
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;         // The server is IPv4 only
+    hints.ai_socktype = SOCK_STREAM;
+    err = getaddrinfo(mHost.c_str(), mPort.c_str(), &hints, &res);
+    if (err != 0) {
+        esyslog("%s %d Can not resolve %s: %s",
+                __FILE__, __LINE__, mHost.c_str(), gai_strerror(err));
+        return false;
+    }
+    for (ai = res; ai != NULL; ai = ai->ai_next) {
+        mSocket = socket(ai->ai_family, SOCK_STREAM, 0);
+        if (mSocket < 0) {
+            continue;
+        }
+        SetupSocket(mSocket);
+        if (connect(mSocket, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        close(mSocket);
+        mSocket = -1;
+    }
+    freeaddrinfo(res);
+    if (mSocket < 0) {
+        esyslog("%s %d Drive server %s:%s not reachable %d", __FILE__,
+                __LINE__, mHost.c_str(), mPort.c_str(), errno);
+        return false;
+    }
+    dsyslog("%s %d Connected to drive server %s:%s", __FILE__, __LINE__,
+            mHost.c_str(), mPort.c_str());
+    return true;
+}
+
+void cRemoteSource::Disconnect(void)
+{
+    if (mSocket >= 0) {
+        close(mSocket);
+        mSocket = -1;
+    }
+    mPending.clear();
+    mInFlight = 0;
+    for (int i = 0; i < RD_SLOTS; i++) {
+        mSlots[i].mCount = 0;
+        mSlots[i].mPending = false;
+    }
+}
+
+bool cRemoteSource::Send(uint32_t cmd, uint32_t arg1, uint32_t arg2, int slot)
+{
+    RD_PENDING_T p;
+    uint32_t req[4];
+
+    if (mSocket < 0) {
+        return false;
+    }
+    p.mTag = ++mTag;
+    p.mSlot = slot;
+    req[0] = htonl(cmd);
+    req[1] = htonl(p.mTag);
+    req[2] = htonl(arg1);
+    req[3] = htonl(arg2);
+    if (!SendAll(mSocket, req, sizeof(req))) {
+        esyslog("%s %d Send to drive server failed %d", __FILE__, __LINE__,
+                errno);
+        Disconnect();
+        return false;
+    }
+    mPending.push_back(p);
+    if (slot >= 0) {
+        mInFlight++;
+    }
+    return true;
+}
+
+// Sectors of a reply to a read, decoded into the slot
+bool cRemoteSource::ReceiveRuns(RD_SLOT_T &s, uint32_t len)
+{
+    uint32_t word, n;
+    uint8_t *p;
+
+    s.mValid = 0;
+    while (len >= sizeof(word)) {
+        if (!RecvAll(mSocket, &word, sizeof(word))) {
+            return false;
+        }
+        len -= sizeof(word);
+        word = ntohl(word);
+        n = word & ~RD_SILENCE;
+        if (n > (uint32_t)(s.mCount - s.mValid)) {
+            return false;
+        }
+        p = s.mData + s.mValid * CDIO_CD_FRAMESIZE_RAW;
+        if (word & RD_SILENCE) {
+            memset(p, 0, n * CDIO_CD_FRAMESIZE_RAW);
+        }
+        else {
+            if (len < n * CDIO_CD_FRAMESIZE_RAW) {
+                return false;
+            }
+            if (!RecvAll(mSocket, p, n * CDIO_CD_FRAMESIZE_RAW)) {
+                return false;
+            }
+            len -= n * CDIO_CD_FRAMESIZE_RAW;
+        }
+        s.mValid += n;
+    }
+    return len == 0;
+}
+
+// Receive the reply to the oldest request. The data is stored if the
+// request has no slot and data is given.
+bool cRemoteSource::Receive(std::string *data, uint32_t *status)
+{
+    RD_PENDING_T p;
+    uint32_t hdr[3];
+    uint32_t len;
+    bool ok;
+
+    if ((mSocket < 0) || mPending.empty()) {
+        return false;
+    }
+    p = mPending.front();
+    mPending.pop_front();
+    if (!RecvAll(mSocket, hdr, sizeof(hdr))) {
+        esyslog("%s %d Receive from drive server failed %d", __FILE__,
+                __LINE__, errno);
+        Disconnect();
+        return false;
+    }
+    len = ntohl(hdr[2]);
+    if (ntohl(hdr[0]) != p.mTag) {
+        esyslog("%s %d Drive server protocol error", __FILE__, __LINE__);
+        Disconnect();
+        return false;
+    }
+    if (p.mSlot >= 0) {
+        RD_SLOT_T &s = mSlots[p.mSlot];
+        mInFlight--;
+        s.mPending = false;
+        ok = ReceiveRuns(s, len);
+        if (ok && (ntohl(hdr[1]) != 0)) {
+            dsyslog("%s %d Remote read error at %d", __FILE__, __LINE__,
+                    s.mLsn + s.mValid);
+        }
+    }
+    else {
+        std::string buf(len, '\0');
+        ok = (len <= RD_MAX_REPLY) && ((len == 0) ||
+                                       RecvAll(mSocket, &buf[0], len));
+        if (data != NULL) {
+            data->swap(buf);
+        }
+    }
+    if (!ok) {
+        esyslog("%s %d Invalid reply of drive server", __FILE__, __LINE__);
+        Disconnect();
+        return false;
+    }
+    if (status != NULL) {
+        *status = ntohl(hdr[1]);
+    }
+    return true;
+}
+
+// Send a request and wait for its reply
+bool cRemoteSource::Call(uint32_t cmd, uint32_t arg1, uint32_t arg2,
+                         uint32_t &status, std::string &data)
+{
+    if (!Send(cmd, arg1, arg2, -1)) {
+        return false;
+    }
+    while (mPending.size() > 1) {
+        if (!Receive(NULL, NULL)) {
+            return false;
+        }
+    }
+    return Receive(&data, &status);
+}
+
+SRC_ERROR_T cRemoteSource::Open(SRC_TOC_T &toc)
+{
+    std::string data;
+    uint32_t status;
+    size_t i;
+
+    Disconnect();
+    toc.mTracks.clear();
+    if (!Connect()) {
+        return SRC_ERR_CONNECT;
+    }
+    if (!Call(RD_CMD_OPEN, RD_VERSION, 0, status, data)) {
+        return SRC_ERR_CONNECT;
+    }
+    if (status != SRC_OK) {
+        Disconnect();
+        return (SRC_ERROR_T)status;
+    }
+    if (!Call(RD_CMD_TOC, 0, 0, status, data) || (status != 0) ||
+        !ParseToc(data, toc)) {
+        esyslog("%s %d No TOC from drive server", __FILE__, __LINE__);
+        Disconnect();
+        return SRC_ERR_TOC;
+    }
+    // The CD-Text requests of all tracks are sent at once
+    Send(RD_CMD_CDTEXT, 0, 0, -1);
+    for (i = 0; i < toc.mTracks.size(); i++) {
+        if (toc.mTracks[i].mAudio) {
+            Send(RD_CMD_CDTEXT, toc.mTracks[i].mTrackNo, 0, -1);
+        }
+    }
+    if (!Receive(&data, &status) || !ParseCdText(data, toc.mCdText)) {
+        Disconnect();
+        return SRC_ERR_TOC;
+    }
+    for (i = 0; i < toc.mTracks.size(); i++) {
+        if (toc.mTracks[i].mAudio &&
+            (!Receive(&data, &status) ||
+             !ParseCdText(data, toc.mTracks[i].mCdText))) {
+            Disconnect();
+            return SRC_ERR_TOC;
+        }
+    }
+    mToc = toc;
+    return SRC_OK;
+}
+
+void cRemoteSource::SetSpeed(int speed)
+{
+    Send(RD_CMD_SPEED, speed, 0, -1);
+}
+
+// Sectors already received were read without paranoia
+void cRemoteSource::SetParanoia(bool on)
+{
+    Send(RD_CMD_PARANOIA, on ? 1 : 0, 0, -1);
+    for (int i = 0; i < RD_SLOTS; i++) {
+        if (!mSlots[i].mPending) {
+            mSlots[i].mCount = 0;
+        }
+    }
+}
+
+int cRemoteSource::FindSlot(lsn_t lsn)
+{
+    for (int i = 0; i < RD_SLOTS; i++) {
+        RD_SLOT_T &s = mSlots[i];
+        if ((s.mCount > 0) && (lsn >= s.mLsn) && (lsn < s.mLsn + s.mCount)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// A free slot or the least recently used one with its reply received
+int cRemoteSource::GetFreeSlot(void)
+{
+    int idx = -1;
+
+    for (int i = 0; i < RD_SLOTS; i++) {
+        RD_SLOT_T &s = mSlots[i];
+        if (s.mCount == 0) {
+            return i;
+        }
+        if (!s.mPending && ((idx < 0) || (s.mUsed < mSlots[idx].mUsed))) {
+            idx = i;
+        }
+    }
+    return idx;
+}
+
+// Reads ahead stay within the audio track, CDIO_INVALID_LSN if lsn is
+// not within an audio track
+lsn_t cRemoteSource::GetTrackEnd(lsn_t lsn)
+{
+    for (size_t i = 0; i < mToc.mTracks.size(); i++) {
+        SRC_TRACK_T &t = mToc.mTracks[i];
+        if (t.mAudio && (lsn >= t.mStartLsn) && (lsn <= t.mEndLsn)) {
+            return t.mEndLsn;
+        }
+    }
+    return CDIO_INVALID_LSN;
+}
+
+// Send a read starting at lsn, returns the slot or -1
+int cRemoteSource::Request(lsn_t lsn)
+{
+    lsn_t end = GetTrackEnd(lsn);
+    int count = (end == CDIO_INVALID_LSN) ? 1 : end - lsn + 1;
+    int idx = GetFreeSlot();
+
+    if (idx < 0) {
+        return -1;
+    }
+    if (count > RD_READ_BLOCKS) {
+        count = RD_READ_BLOCKS;
+    }
+    RD_SLOT_T &s = mSlots[idx];
+    s.mLsn = lsn;
+    s.mCount = count;
+    s.mValid = 0;
+    s.mPending = true;
+    s.mUsed = ++mUseCount;
+    if (!Send(RD_CMD_READ, lsn, count, idx)) {
+        return -1;
+    }
+    return idx;
+}
+
+// Keep RD_MAX_INFLIGHT reads in flight after lsn
+void cRemoteSource::Prefetch(lsn_t lsn)
+{
+    lsn_t end = GetTrackEnd(lsn);
+    lsn_t next = lsn;
+    int idx;
+
+    if (end == CDIO_INVALID_LSN) {
+        return;
+    }
+    while ((next <= end) && (mInFlight < RD_MAX_INFLIGHT)) {
+        idx = FindSlot(next);
+        if (idx < 0) {
+            if (Request(next) < 0) {
+                return;
+            }
+            continue;
+        }
+        RD_SLOT_T &s = mSlots[idx];
+        // Stop at a read error, it is retried when it is played
+        if (!s.mPending && (s.mValid < s.mCount)) {
+            return;
+        }
+        next = s.mLsn + s.mCount;
+    }
+}
+
+bool cRemoteSource::Read(lsn_t lsn, uint8_t *buf, uint8_t *&bufptr)
+{
+    int idx;
+
+    if (mSocket < 0) {
+        return false;
+    }
+    idx = FindSlot(lsn);
+    if (idx < 0) {
+        idx = Request(lsn);
+        if (idx < 0) {
+            return false;
+        }
+    }
+    RD_SLOT_T &s = mSlots[idx];
+    while (s.mPending) {
+        if (!Receive(NULL, NULL)) {
+            return false;
+        }
+    }
+    if (lsn >= s.mLsn + s.mValid) {
+        // Read error, the next try asks the server again
+        s.mCount = 0;
+        return false;
+    }
+    s.mUsed = ++mUseCount;
+    bufptr = s.mData + (lsn - s.mLsn) * CDIO_CD_FRAMESIZE_RAW;
+    Prefetch(lsn + 1);
+    return true;
+}
+
+cDriveConnection::cDriveConnection(int fd, const std::string &device)
+    : mSocket(fd), mSource(device), mSectors(0), mSilent(0)
+{
+    mToc.mLeadOut = 0;
+    SetDescription("cdplayer drive connection");
+}
+
+cDriveConnection::~cDriveConnection()
+{
+    Cancel(3);
+    close(mSocket);
+}
+
+void cDriveConnection::Begin(void)
+{
+    mReply.assign(3 * sizeof(uint32_t), '\0');
+}
+
+bool cDriveConnection::Finish(uint32_t tag, uint32_t status)
+{
+    SetBe32(mReply, 0, tag);
+    SetBe32(mReply, 4, status);
+    SetBe32(mReply, 8, mReply.size() - 3 * sizeof(uint32_t));
+    return SendAll(mSocket, mReply.data(), mReply.size());
+}
+
+bool cDriveConnection::Toc(uint32_t tag)
+{
+    Begin();
+    if (!mSource.IsOpen()) {
+        return Finish(tag, 1);
+    }
+    PutBe32(mReply, mToc.mLeadOut);
+    PutBe32(mReply, mToc.mTracks.size());
+    for (size_t i = 0; i < mToc.mTracks.size(); i++) {
+        SRC_TRACK_T &t = mToc.mTracks[i];
+        PutBe32(mReply, t.mTrackNo);
+        PutBe32(mReply, t.mStartLsn);
+        PutBe32(mReply, t.mEndLsn);
+        PutBe32(mReply, t.mLba);
+        PutBe32(mReply, t.mAudio ? 1 : 0);
+    }
+    return Finish(tag, 0);
+}
+
+bool cDriveConnection::CdText(uint32_t tag, int track)
+{
+    const CD_TEXT_T *cdtext = NULL;
+
+    Begin();
+    if (track == 0) {
+        cdtext = &mToc.mCdText;
+    }
+    for (size_t i = 0; i < mToc.mTracks.size(); i++) {
+        if (mToc.mTracks[i].mTrackNo == track) {
+            cdtext = &mToc.mTracks[i].mCdText;
+        }
+    }
+    if (cdtext == NULL) {
+        return Finish(tag, 1);
+    }
+    for (int i = 0; i < MAX_CDTEXT_FIELDS; i++) {
+        const std::string &txt = (*cdtext)[i];
+        if (!txt.empty()) {
+            PutBe32(mReply, i);
+            PutBe32(mReply, txt.size());
+            mReply += txt;
+        }
+    }
+    return Finish(tag, 0);
+}
+
+// Silent sectors are collected to runs sent without data
+bool cDriveConnection::Read(uint32_t tag, lsn_t lsn, int count)
+{
+    uint8_t buf[CDIO_CD_FRAMESIZE_RAW];
+    uint8_t *bufptr;
+    uint32_t status = 0;
+    uint32_t run = 0;
+    size_t runpos = 0;
+    bool silent;
+    bool runsilent = false;
+
+    Begin();
+    if ((count <= 0) || (count > RD_MAX_READ_BLOCKS)) {
+        return Finish(tag, 1);
+    }
+    for (int i = 0; i < count; i++) {
+        if (!mSource.Read(lsn + i, buf, bufptr)) {
+            esyslog("%s %d Read error at %d", __FILE__, __LINE__, lsn + i);
+            status = 1;
+            break;
+        }
+        silent = IsSilent(bufptr);
+        if ((run == 0) || (silent != runsilent)) {
+            if (run != 0) {
+                SetBe32(mReply, runpos, run | (runsilent ? RD_SILENCE : 0));
+            }
+            runpos = mReply.size();
+            PutBe32(mReply, 0);
+            run = 0;
+            runsilent = silent;
+        }
+        if (silent) {
+            mSilent++;
+        }
+        else {
+            mReply.append((const char *)bufptr, CDIO_CD_FRAMESIZE_RAW);
+        }
+        mSectors++;
+        run++;
+    }
+    if (run != 0) {
+        SetBe32(mReply, runpos, run | (runsilent ? RD_SILENCE : 0));
+    }
+    return Finish(tag, status);
+}
+
+void cDriveConnection::Action(void)
+{
+    struct pollfd pfd;
+    uint32_t req[4];
+    uint32_t cmd, tag, arg1, arg2;
+    bool ok = true;
+
+    dsyslog("%s %d Drive client %d connected", __FILE__, __LINE__, mSocket);
+    pfd.fd = mSocket;
+    pfd.events = POLLIN;
+    while (ok && Running()) {
+        if (poll(&pfd, 1, 500) <= 0) {
+            continue;
+        }
+        // Closed by the client
+        if (!RecvAll(mSocket, req, sizeof(req))) {
+            break;
+        }
+        cmd = ntohl(req[0]);
+        tag = ntohl(req[1]);
+        arg1 = ntohl(req[2]);
+        arg2 = ntohl(req[3]);
+        switch (cmd) {
+        case RD_CMD_OPEN:
+            Begin();
+            if (arg1 != RD_VERSION) {
+                esyslog("%s %d Drive client with protocol %u", __FILE__,
+                        __LINE__, arg1);
+                ok = Finish(tag, SRC_ERR_CONNECT);
+                break;
+            }
+            ok = Finish(tag, mSource.Open(mToc));
+            break;
+        case RD_CMD_TOC:
+            ok = Toc(tag);
+            break;
+        case RD_CMD_CDTEXT:
+            ok = CdText(tag, arg1);
+            break;
+        case RD_CMD_READ:
+            ok = Read(tag, (lsn_t)arg1, arg2);
+            break;
+        case RD_CMD_SPEED:
+            mSource.SetSpeed(arg1);
+            Begin();
+            ok = Finish(tag, 0);
+            break;
+        case RD_CMD_PARANOIA:
+            mSource.SetParanoia(arg1 != 0);
+            Begin();
+            ok = Finish(tag, 0);
+            break;
+        default:
+            esyslog("%s %d Unknown drive request %u", __FILE__, __LINE__, cmd);
+            ok = false;
+            break;
+        }
+    }
+    mSource.Close();
+    dsyslog("%s %d Drive client %d closed, %u sectors, %u silent", __FILE__,
+            __LINE__, mSocket, mSectors, mSilent);
+}
+
+cDriveServer::cDriveServer(const std::string &port, const std::string &device)
+    : mPort(port), mDevice(device), mListen(-1)
+{
+    SetDescription("cdplayer drive server");
+}
+
+cDriveServer::~cDriveServer()
+{
+    Cancel(3);
+    for (size_t i = 0; i < mConnections.size(); i++) {
+        delete mConnections[i];
+    }
+}
+
+// Delete the connections whose thread ended
+void cDriveServer::Reap(void)
+{
+    for (size_t i = 0; i < mConnections.size(); ) {
+        if (!mConnections[i]->Active()) {
+            delete mConnections[i];
+            mConnections.erase(mConnections.begin() + i);
+        }
+        else {
+            i++;
+        }
+    }
+}
+
+// mPort is [address:]port, without address on all interfaces. Only hosts
+// allowed in VDR's svdrphosts.conf are served.
+void cDriveServer::Action(void)
+{
+    struct addrinfo hints;
+    struct addrinfo *res;
+    struct sockaddr_in peer;
+    socklen_t peerlen;
+    struct pollfd pfd;
+    cDriveConnection *conn;
+    std::string host;
+    std::string port = mPort;
+    size_t pos = mPort.rfind(':');
+    int on = 1;
+    int err;
+    int fd;
+
+    if (pos != std::string::npos) {
+        host = mPort.substr(0, pos);
+        port = mPort.substr(pos + 1);
+    }
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    err = getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(),
+                      &hints, &res);
+    if (err != 0) {
+        esyslog("%s %d Invalid address %s: %s", __FILE__, __LINE__,
+                mPort.c_str(), gai_strerror(err));
+        return;
+    }
+    mListen = socket(res->ai_family, SOCK_STREAM, 0);
+    if (mListen >= 0) {
+        setsockopt(mListen, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        fcntl(mListen, F_SETFD, FD_CLOEXEC);
+    }
+    if ((mListen < 0) || (bind(mListen, res->ai_addr, res->ai_addrlen) < 0) ||
+        (listen(mListen, 4) < 0)) {
+        esyslog("%s %d Drive server on %s failed %d", __FILE__,
+                __LINE__, mPort.c_str(), errno);
+        freeaddrinfo(res);
+        if (mListen >= 0) {
+            close(mListen);
+            mListen = -1;
+        }
+        return;
+    }
+    freeaddrinfo(res);
+    isyslog("Drive server for %s on %s", mDevice.c_str(), mPort.c_str());
+    pfd.fd = mListen;
+    pfd.events = POLLIN;
+    while (Running()) {
+        if (poll(&pfd, 1, 500) <= 0) {
+            continue;
+        }
+        peerlen = sizeof(peer);
+        fd = accept(mListen, (struct sockaddr *)&peer, &peerlen);
+        if (fd < 0) {
+            continue;
+        }
+        if (!SVDRPhosts.Acceptable(peer.sin_addr.s_addr)) {
+            esyslog("%s %d Drive client %s not in svdrphosts.conf", __FILE__,
+                    __LINE__, inet_ntoa(peer.sin_addr));
+            close(fd);
+            continue;
+        }
+        Reap();
+        if (mConnections.size() >= RD_MAX_CONNECTIONS) {
+            esyslog("%s %d Too many drive clients", __FILE__, __LINE__);
+            close(fd);
+            continue;
+        }
+        SetupSocket(fd);
+        conn = new cDriveConnection(fd, mDevice);
+        mConnections.push_back(conn);
+        conn->Start();
+    }
+    close(mListen);
+    mListen = -1;
+}
@@ -0,0 +1,150 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements reading the drive of another host. The drive
+ * server serves the TOC, the CD-Text and ranges of audio sectors of its
+ * local drive over TCP, the remote source is the client used by the
+ * player instead of the local drive.
+ *
+ * Every request is answered in the order received, so the client sends
+ * further requests without waiting for the replies. It keeps several
+ * ranged reads ahead of the played position in flight, the replies are
+ * collected in a small cache of slots. Runs of digitally silent sectors
+ * are sent as a count only.
+ *
+ * The server only accepts the hosts allowed in VDR's svdrphosts.conf, as
+ * they may control VDR anyway, and is IPv4 only like this file.
+ *
+ * All values are sent big endian. A request is four 32 bit words:
+ * command, tag, argument 1, argument 2. A reply starts with three words:
+ * tag, status, length of the following data.
+ */
+
+#ifndef __REMOTEDRIVE_H__
+#define __REMOTEDRIVE_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <vdr/thread.h>
+#include "sectorsource.h"
+
+#define RD_VERSION          1
+#define RD_DEFAULT_PORT     "7910"
+#define RD_READ_BLOCKS      (CDIO_CD_FRAMES_PER_SEC / 3)    // Per request
+#define RD_MAX_READ_BLOCKS  CDIO_CD_FRAMES_PER_SEC  // Accepted by the server
+#define RD_MAX_INFLIGHT     4       // Reads sent ahead of the played sector
+#define RD_SLOTS            (2 * RD_MAX_INFLIGHT + 2)
+#define RD_TIMEOUT_MS       20000   // Paranoia may take long on bad discs
+#define RD_MAX_CONNECTIONS  4
+#define RD_SILENCE          0x80000000  // Run of silent sectors
+
+typedef enum _rd_cmd {
+    RD_CMD_OPEN = 1,        // arg1 protocol version, status SRC_ERROR_T
+    RD_CMD_TOC,             // Reply: leadout, tracks, per track number,
+                            // start, end, lba, audio
+    RD_CMD_CDTEXT,          // arg1 track (0 disc), reply: per field
+                            // field, length, text
+    RD_CMD_READ,            // arg1 lsn, arg2 count, reply: runs
+    RD_CMD_SPEED,           // arg1 speed
+    RD_CMD_PARANOIA         // arg1 on
+} RD_CMD_T;
+
+// The sectors read are sent as runs: a word with the number of sectors,
+// RD_SILENCE set for a run of silence, else followed by the sectors. A
+// failed read has status 1 and holds the sectors read before the error.
+
+class cRemoteSource: public cSectorSource {
+private:
+    typedef struct _rd_slot {
+        lsn_t mLsn;             // First sector
+        int mCount;             // Sectors requested, 0 if free
+        int mValid;             // Sectors received
+        bool mPending;
+        uint64_t mUsed;         // For replacement
+        uint8_t *mData;
+    } RD_SLOT_T;
+    typedef struct _rd_pending {
+        uint32_t mTag;
+        int mSlot;              // -1 for requests without sectors
+    } RD_PENDING_T;
+
+    std::string mHost;
+    std::string mPort;
+    int mSocket;
+    uint32_t mTag;
+    uint64_t mUseCount;
+    int mInFlight;              // Pending reads
+    std::deque<RD_PENDING_T> mPending;
+    RD_SLOT_T mSlots[RD_SLOTS];
+    SRC_TOC_T mToc;
+
+    bool Connect(void);
+    void Disconnect(void);
+    bool Send(uint32_t cmd, uint32_t arg1, uint32_t arg2, int slot);
+    bool Receive(std::string *data, uint32_t *status);
+    bool Call(uint32_t cmd, uint32_t arg1, uint32_t arg2, uint32_t &status,
+              std::string &data);
+    bool ReceiveRuns(RD_SLOT_T &s, uint32_t len);
+    int FindSlot(lsn_t lsn);
+    int GetFreeSlot(void);
+    lsn_t GetTrackEnd(lsn_t lsn);
+    int Request(lsn_t lsn);
+    void Prefetch(lsn_t lsn);
+public:
+    cRemoteSource(const std::string &server);
+    virtual ~cRemoteSource();
+    virtual SRC_ERROR_T Open(SRC_TOC_T &toc);
+    virtual void Close(void) { Disconnect(); }
+    virtual bool IsOpen(void) { return mSocket >= 0; }
+    virtual void SetSpeed(int speed);
+    virtual void SetParanoia(bool on);
+    virtual bool Read(lsn_t lsn, uint8_t *buf, uint8_t *&bufptr);
+    virtual std::string GetName(void) { return mHost + ":" + mPort; }
+};
+
+// Serves one client with its own access to the drive
+class cDriveConnection: public cThread {
+private:
+    int mSocket;
+    cLocalSource mSource;
+    SRC_TOC_T mToc;
+    std::string mReply;         // Reply being built
+    unsigned int mSectors;      // Sectors sent
+    unsigned int mSilent;       // Sent as silence runs
+
+    void Begin(void);
+    bool Finish(uint32_t tag, uint32_t status);
+    bool Read(uint32_t tag, lsn_t lsn, int count);
+    bool CdText(uint32_t tag, int track);
+    bool Toc(uint32_t tag);
+protected:
+    virtual void Action(void);
+public:
+    cDriveConnection(int fd, const std::string &device);
+    virtual ~cDriveConnection();
+};
+
+class cDriveServer: public cThread {
+private:
+    std::string mPort;
+    std::string mDevice;
+    int mListen;
+    std::vector<cDriveConnection *> mConnections;
+
+    void Reap(void);
+protected:
+    virtual void Action(void);
+public:
+    // port is [address:]port, the address limits the interface
+    cDriveServer(const std::string &port, const std::string &device);
+    virtual ~cDriveServer();
+};
+
+#endif
@@ -0,0 +1,159 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the drift resampler and its controller.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "resampler.h"
+
+cResampler::cResampler(void)
+{
+    Reset();
+}
+
+void cResampler::Reset(void)
+{
+    memset(mLeft, 0, sizeof(mLeft));
+    memset(mRight, 0, sizeof(mRight));
+    mPos = 1.0;
+    mStep = 1.0;
+}
+
+// Catmull-Rom interpolation between left[i] and left[i + 1] at
+// frac + i * eps. The loop has no branches and reads the samples in
+// order, so it is vectorized.
+void cResampler::Interpolate(const float *left, const float *right,
+                             int16_t *out, int frames, float frac, float eps)
+{
+    for (int i = 0; i < frames; i++) {
+        float f = frac + i * eps;
+        float l0 = left[i - 1], l1 = left[i], l2 = left[i + 1], l3 = left[i + 2];
+        float r0 = right[i - 1], r1 = right[i], r2 = right[i + 1],
+              r3 = right[i + 2];
+        float l = ((((l3 - l0) * 0.5f + (l1 - l2) * 1.5f) * f +
+                    (l0 - l1 * 2.5f + l2 * 2.0f - l3 * 0.5f)) * f +
+                   (l2 - l0) * 0.5f) * f + l1;
+        float r = ((((r3 - r0) * 0.5f + (r1 - r2) * 1.5f) * f +
+                    (r0 - r1 * 2.5f + r2 * 2.0f - r3 * 0.5f)) * f +
+                   (r2 - r0) * 0.5f) * f + r1;
+        // Rounded, the offset keeps the value positive for the truncation
+        int sl = (int)(l + 32768.5f) - 32768;
+        int sr = (int)(r + 32768.5f) - 32768;
+
+        sl = (sl < -32768) ? -32768 : ((sl > 32767) ? 32767 : sl);
+        sr = (sr < -32768) ? -32768 : ((sr > 32767) ? 32767 : sr);
+        out[2 * i] = sl;
+        out[2 * i + 1] = sr;
+    }
+}
+
+// The input block is stored behind the last frames of the previous one.
+// Output frames are interpolated at mPos, mPos + mStep, ... as long as
+// the two frames behind the position are in the block. Each run keeps
+// the same integer offset into the input; as the ratio differs from 1 by
+// at most 0.1 %, a block has one or two runs.
+int cResampler::Process(const uint8_t *in, int16_t *out)
+{
+    float *left = mLeft + RESAMPLE_HISTORY;
+    float *right = mRight + RESAMPLE_HISTORY;
+    const double end = RESAMPLE_FRAMES + 1;
+    const double eps = mStep - 1.0;
+    int count = 0;
+
+    for (int i = 0; i < RESAMPLE_FRAMES; i++) {
+        left[i] = (int16_t)(in[4 * i] | (in[4 * i + 1] << 8));
+        right[i] = (int16_t)(in[4 * i + 2] | (in[4 * i + 3] << 8));
+    }
+    for (int i = RESAMPLE_FRAMES; i < RESAMPLE_FRAMES + RESAMPLE_GUARD; i++) {
+        left[i] = left[RESAMPLE_FRAMES - 1];
+        right[i] = right[RESAMPLE_FRAMES - 1];
+    }
+    while ((mPos < end) && (count < RESAMPLE_MAX_OUT)) {
+        int base = (int)floor(mPos);
+        double frac = mPos - base;
+        // Frames up to the end of the block
+        int len = (int)ceil((end - mPos) / mStep);
+
+        // Frames until the offset into the input changes
+        if (eps > 0.0) {
+            int run = (int)ceil((1.0 - frac) / eps);
+            if (run < len) {
+                len = run;
+            }
+        }
+        else if (eps < 0.0) {
+            int run = (int)floor(frac / -eps) + 1;
+            if (run < len) {
+                len = run;
+            }
+        }
+        if (len < 1) {
+            len = 1;
+        }
+        if (len > RESAMPLE_MAX_OUT - count) {
+            len = RESAMPLE_MAX_OUT - count;
+        }
+        Interpolate(mLeft + base, mRight + base, out + 2 * count, len,
+                    frac, eps);
+        count += len;
+        mPos += len * mStep;
+    }
+    mPos -= RESAMPLE_FRAMES;
+    memmove(mLeft, mLeft + RESAMPLE_FRAMES, RESAMPLE_HISTORY * sizeof(float));
+    memmove(mRight, mRight + RESAMPLE_FRAMES, RESAMPLE_HISTORY * sizeof(float));
+    return count;
+}
+
+cDriftControl::cDriftControl(void)
+    : mTarget(0)
+{
+    Reset();
+}
+
+void cDriftControl::Reset(void)
+{
+    mAverage = 0;
+    mIntegral = 0;
+    mPpm = 0;
+    mValid = false;
+}
+
+double cDriftControl::Update(long depth)
+{
+    double error;
+
+    if (mTarget <= 0) {
+        return 1.0;
+    }
+    if (!mValid) {
+        mAverage = depth;
+        mValid = true;
+    }
+    else {
+        mAverage += (depth - mAverage) / DRIFT_AVG_BLOCKS;
+    }
+    // A queue above the target needs fewer output frames, a ratio above 1
+    error = (mAverage - mTarget) / mTarget;
+    mIntegral += error * DRIFT_KP / DRIFT_TI_BLOCKS;
+    if (mIntegral > DRIFT_MAX_PPM) {
+        mIntegral = DRIFT_MAX_PPM;
+    }
+    else if (mIntegral < -DRIFT_MAX_PPM) {
+        mIntegral = -DRIFT_MAX_PPM;
+    }
+    mPpm = error * DRIFT_KP + mIntegral;
+    if (mPpm > DRIFT_MAX_PPM) {
+        mPpm = DRIFT_MAX_PPM;
+    }
+    else if (mPpm < -DRIFT_MAX_PPM) {
+        mPpm = -DRIFT_MAX_PPM;
+    }
+    return 1.0 + mPpm * 1e-6;
+}
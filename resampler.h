@@ -0,0 +1,78 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * These classes compensate the clock drift between the player and an
+ * output with its own clock. cDriftControl is a PI controller which
+ * holds the averaged queue depth of the output at a target by changing
+ * the ratio by at most 0.1 %. The integral part is the learned clock
+ * difference, it is kept when the output restarts after an underrun.
+ *
+ * cResampler converts one block (sector) at a time with this ratio by
+ * cubic interpolation. Within a block the interpolated frames are split
+ * into at most a few runs with a fixed offset into the input, each run is
+ * a plain loop over contiguous samples the compiler vectorizes, so the
+ * cost per block does not depend on the ratio. At ratio 1 the output is
+ * the input delayed by two frames, bit for bit.
+ */
+
+#ifndef __RESAMPLER_H__
+#define __RESAMPLER_H__
+
+#include <stdint.h>
+#include <cdio/cdio.h>
+
+#define RESAMPLE_FRAMES     (CDIO_CD_FRAMESIZE_RAW / 4)  // Input per block
+#define RESAMPLE_MAX_OUT    (RESAMPLE_FRAMES + 2)
+#define RESAMPLE_HISTORY    3       // Frames kept of the previous block
+#define RESAMPLE_GUARD      2       // Behind the block for rounding errors
+#define RESAMPLE_LEN        (RESAMPLE_HISTORY + RESAMPLE_FRAMES + RESAMPLE_GUARD)
+
+#define DRIFT_MAX_PPM       1000.0  // 0.1 %
+#define DRIFT_KP            2000.0  // ppm per relative queue error
+#define DRIFT_TI_BLOCKS     (30 * CDIO_CD_FRAMES_PER_SEC)   // Integral time
+#define DRIFT_AVG_BLOCKS    CDIO_CD_FRAMES_PER_SEC  // Averaging of the depth
+
+class cResampler {
+private:
+    float mLeft[RESAMPLE_LEN];
+    float mRight[RESAMPLE_LEN];
+    double mPos;                // Input position of the next output frame
+    double mStep;               // Input frames per output frame
+
+    static void Interpolate(const float *left, const float *right,
+                            int16_t *out, int frames, float frac, float eps);
+public:
+    cResampler(void);
+    void Reset(void);
+    // Input frames per output frame, 1.001 shrinks the output by 0.1 %
+    void SetRatio(double ratio) { mStep = ratio; }
+    // Convert one block of CD audio (little endian), out takes up to
+    // RESAMPLE_MAX_OUT interleaved frames. Returns the frames written.
+    int Process(const uint8_t *in, int16_t *out);
+};
+
+class cDriftControl {
+private:
+    double mTarget;             // Queue depth to hold (frames)
+    double mAverage;
+    double mIntegral;           // ppm
+    double mPpm;
+    bool mValid;                // mAverage holds a measurement
+public:
+    cDriftControl(void);
+    void Reset(void);
+    void SetTarget(long frames) { mTarget = frames; }
+    // The queue was emptied, start averaging anew but keep the drift
+    void Restart(void) { mValid = false; }
+    // Queue depth after a block was written, returns the ratio for
+    // cResampler
+    double Update(long depth);
+    double GetPpm(void) { return mPpm; }
+};
+
+#endif
@@ -0,0 +1,555 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the ripping to FLAC while playing.
+ *
+ * Lock order: cRipper::mMutex before cRipWorker::mMutex. A worker calls
+ * back into the ripper only without holding its own mutex.
+ */
+
+#ifdef USE_FLAC
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <FLAC/metadata.h>
+#include <vdr/tools.h>
+#include "ripper.h"
+
+#define RIP_SAMPLES_PER_BLOCK   (CDIO_CD_FRAMESIZE_RAW / 4)
+
+cRipWorker::cRipWorker(cRipper &ripper) :
+    mRipper(ripper), mHead(0), mCount(0), mTrack(-1), mBlocks(0),
+    mEncoder(NULL), mPadding(NULL)
+{
+    SetDescription("cdplayer rip");
+    mQueue = (uint8_t *)malloc(RIP_QUEUE_BLOCKS * CDIO_CD_FRAMESIZE_RAW);
+    if (mQueue == NULL) {
+        esyslog("%s %d Out of memory", __FILE__, __LINE__);
+        exit(-1);
+    }
+}
+
+cRipWorker::~cRipWorker()
+{
+    Cancel(5);
+    free(mQueue);
+}
+
+bool cRipWorker::IsIdle(void)
+{
+    cMutexLock MutexLock(&mMutex);
+    return (mTrack < 0);
+}
+
+void cRipWorker::Assign(int track, int blocks)
+{
+    cMutexLock MutexLock(&mMutex);
+    mTrack = track;
+    mBlocks = blocks;
+    mHead = 0;
+    mCount = 0;
+}
+
+bool cRipWorker::Put(const uint8_t *data)
+{
+    cMutexLock MutexLock(&mMutex);
+    int slot;
+
+    if ((mTrack < 0) || (mCount >= RIP_QUEUE_BLOCKS)) {
+        return false;
+    }
+    slot = (mHead + mCount) % RIP_QUEUE_BLOCKS;
+    memcpy(mQueue + slot * CDIO_CD_FRAMESIZE_RAW, data, CDIO_CD_FRAMESIZE_RAW);
+    mCount++;
+    mCond.Broadcast();
+    return true;
+}
+
+int cRipWorker::GetFree(void)
+{
+    cMutexLock MutexLock(&mMutex);
+    return RIP_QUEUE_BLOCKS - mCount;
+}
+
+bool cRipWorker::Begin(void)
+{
+    FLAC__StreamMetadata *meta[1];
+
+    mFileName = mRipper.GetFileName(mTrack, true);
+    mPadding = FLAC__metadata_object_new(FLAC__METADATA_TYPE_PADDING);
+    if (mPadding == NULL) {
+        esyslog("%s %d Out of memory", __FILE__, __LINE__);
+        return false;
+    }
+    mPadding->length = RIP_PADDING;
+    meta[0] = mPadding;
+    mEncoder = cRipper::NewEncoder(mFileName,
+                        (FLAC__uint64)mBlocks * RIP_SAMPLES_PER_BLOCK, meta, 1);
+    if (mEncoder == NULL) {
+        return false;
+    }
+    dsyslog("%s %d Ripping track %d to %s", __FILE__, __LINE__, mTrack + 1,
+            mFileName.c_str());
+    return true;
+}
+
+bool cRipWorker::Encode(const uint8_t *data)
+{
+    return cRipper::Encode(mEncoder, data);
+}
+
+// Close the file of the track, an incomplete file is removed
+void cRipWorker::End(bool ok)
+{
+    int track = mTrack;
+
+    if (mEncoder != NULL) {
+        if (ok && !FLAC__stream_encoder_finish(mEncoder)) {
+            esyslog("%s %d Encoding %s failed", __FILE__, __LINE__,
+                    mFileName.c_str());
+            ok = false;
+        }
+        FLAC__stream_encoder_delete(mEncoder);
+        mEncoder = NULL;
+    }
+    if (mPadding != NULL) {
+        FLAC__metadata_object_delete(mPadding);
+        mPadding = NULL;
+    }
+    if (ok) {
+        std::string name = mRipper.GetFileName(track, false);
+        mRipper.WriteTags(track, mFileName);
+        if (rename(mFileName.c_str(), name.c_str()) < 0) {
+            esyslog("%s %d Can not rename %s", __FILE__, __LINE__,
+                    mFileName.c_str());
+            ok = false;
+        }
+        else {
+            isyslog("Track %d ripped to %s", track + 1, name.c_str());
+        }
+    }
+    if (!ok && !mFileName.empty()) {
+        unlink(mFileName.c_str());
+    }
+    mFileName.clear();
+    mMutex.Lock();
+    mTrack = -1;
+    mCount = 0;
+    mMutex.Unlock();
+    mRipper.Finished(track, ok);
+}
+
+// The reader only writes free slots, so a queued sector is encoded
+// without holding the mutex.
+void cRipWorker::Action(void)
+{
+    const uint8_t *data;
+    int done = 0;
+
+    while (Running()) {
+        mMutex.Lock();
+        if ((mTrack < 0) || (mCount == 0)) {
+            mCond.TimedWait(mMutex, 100);
+            mMutex.Unlock();
+            continue;
+        }
+        data = mQueue + mHead * CDIO_CD_FRAMESIZE_RAW;
+        mMutex.Unlock();
+        if (mEncoder == NULL) {
+            done = 0;
+            if (!Begin()) {
+                End(false);
+                continue;
+            }
+        }
+        if (!Encode(data)) {
+            esyslog("%s %d Encoding %s failed", __FILE__, __LINE__,
+                    mFileName.c_str());
+            End(false);
+            continue;
+        }
+        mMutex.Lock();
+        mHead = (mHead + 1) % RIP_QUEUE_BLOCKS;
+        mCount--;
+        mMutex.Unlock();
+        if (++done == mBlocks) {
+            End(true);
+        }
+    }
+    if (mEncoder != NULL) {
+        End(false);
+    }
+}
+
+cRipper::cRipper(cCdInfo &cdinfo) :
+    mCdInfo(cdinfo), mNumTracks(0), mLastTrack(0)
+{
+}
+
+cRipper::~cRipper()
+{
+    Reset();
+}
+
+void cRipper::Setup(const std::vector<lsn_t> &start,
+                    const std::vector<lsn_t> &end, const std::string &dir)
+{
+    RIP_TRACK_T t;
+    int pending = 0;
+    int workers;
+
+    Reset();
+    cMutexLock MutexLock(&mMutex);
+    mDir = dir;
+    mNumTracks = start.size();
+    mLastTrack = 0;
+    for (size_t i = 0; i < start.size(); i++) {
+        t.mStartLsn = start[i];
+        t.mEndLsn = end[i];
+        t.mNext = start[i];
+        t.mState = RIP_PENDING;
+        t.mWorker = -1;
+        mTracks.push_back(t);
+    }
+    // Tracks are ripped only once
+    cReadDir d(mDir.c_str());
+    if (d.Ok()) {
+        struct dirent *e;
+        while ((e = d.Next()) != NULL) {
+            size_t len = strlen(e->d_name);
+            int track = atoi(e->d_name) - 1;
+            if ((len > 5) && (strcmp(e->d_name + len - 5, ".flac") == 0) &&
+                (track >= 0) && (track < (int)mTracks.size())) {
+                mTracks[track].mState = RIP_DONE;
+            }
+        }
+    }
+    for (size_t i = 0; i < mTracks.size(); i++) {
+        if (mTracks[i].mState == RIP_PENDING) {
+            pending++;
+        }
+    }
+    if (pending == 0) {
+        dsyslog("%s %d Disc already ripped to %s", __FILE__, __LINE__,
+                mDir.c_str());
+        return;
+    }
+    if (!MakeDirs(mDir.c_str(), true)) {
+        esyslog("%s %d can not create directory %s", __FILE__, __LINE__,
+                mDir.c_str());
+        return;
+    }
+    // One track per core
+    workers = sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers > RIP_MAX_WORKERS) {
+        workers = RIP_MAX_WORKERS;
+    }
+    if (workers > pending) {
+        workers = pending;
+    }
+    if (workers < 1) {
+        workers = 1;
+    }
+    for (int i = 0; i < workers; i++) {
+        mWorkers.push_back(new cRipWorker(*this));
+        mWorkers.back()->Start();
+    }
+    dsyslog("%s %d Ripping %d tracks to %s with %d workers",
+            __FILE__, __LINE__, pending, mDir.c_str(), workers);
+}
+
+void cRipper::Reset(void)
+{
+    std::vector<cRipWorker *> workers;
+
+    mMutex.Lock();
+    workers.swap(mWorkers);
+    mTracks.clear();
+    mMutex.Unlock();
+    // The workers call Finished while stopping, which ignores them now
+    for (size_t i = 0; i < workers.size(); i++) {
+        delete workers[i];
+    }
+}
+
+int cRipper::FindTrack(lsn_t lsn)
+{
+    int n = mTracks.size();
+
+    if ((mLastTrack < n) && (lsn >= mTracks[mLastTrack].mStartLsn) &&
+        (lsn <= mTracks[mLastTrack].mEndLsn)) {
+        return mLastTrack;
+    }
+    for (int i = 0; i < n; i++) {
+        if ((lsn >= mTracks[i].mStartLsn) && (lsn <= mTracks[i].mEndLsn)) {
+            mLastTrack = i;
+            return i;
+        }
+    }
+    return -1;
+}
+
+int cRipper::GetFreeWorker(void)
+{
+    for (size_t i = 0; i < mWorkers.size(); i++) {
+        if (mWorkers[i]->IsIdle()) {
+            bool assigned = false;
+            // Idle, but the track it finished may not be marked yet
+            for (size_t t = 0; t < mTracks.size(); t++) {
+                if ((mTracks[t].mState == RIP_ACTIVE) &&
+                    (mTracks[t].mWorker == (int)i)) {
+                    assigned = true;
+                }
+            }
+            if (!assigned) {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+void cRipper::Feed(lsn_t lsn, const uint8_t *data)
+{
+    cMutexLock MutexLock(&mMutex);
+    RIP_TRACK_T *t;
+    int track;
+    int w;
+
+    if (mWorkers.empty()) {
+        return;
+    }
+    track = FindTrack(lsn);
+    if (track < 0) {
+        return;
+    }
+    t = &mTracks[track];
+    if ((t->mState == RIP_PENDING) && (lsn == t->mStartLsn)) {
+        w = GetFreeWorker();
+        if (w < 0) {
+            return;
+        }
+        mWorkers[w]->Assign(track, t->mEndLsn - t->mStartLsn + 1);
+        t->mWorker = w;
+        t->mState = RIP_ACTIVE;
+    }
+    // Sectors are encoded in order, others are read again later
+    if ((t->mState != RIP_ACTIVE) || (lsn != t->mNext)) {
+        return;
+    }
+    if (mWorkers[t->mWorker]->Put(data)) {
+        t->mNext++;
+    }
+}
+
+bool cRipper::GetNextRead(lsn_t &lsn, int &count)
+{
+    cMutexLock MutexLock(&mMutex);
+    int avail;
+
+    // Continue the tracks being ripped first
+    for (size_t i = 0; i < mTracks.size(); i++) {
+        RIP_TRACK_T &t = mTracks[i];
+        if ((t.mState != RIP_ACTIVE) || (t.mNext > t.mEndLsn)) {
+            continue;
+        }
+        avail = mWorkers[t.mWorker]->GetFree();
+        if (avail > 0) {
+            lsn = t.mNext;
+            count = t.mEndLsn - t.mNext + 1;
+            count = (count < avail) ? count : avail;
+            count = (count < RIP_AHEAD_BLOCKS) ? count : RIP_AHEAD_BLOCKS;
+            return true;
+        }
+    }
+    if (GetFreeWorker() < 0) {
+        return false;
+    }
+    for (size_t i = 0; i < mTracks.size(); i++) {
+        RIP_TRACK_T &t = mTracks[i];
+        if (t.mState == RIP_PENDING) {
+            lsn = t.mStartLsn;
+            count = t.mEndLsn - t.mStartLsn + 1;
+            count = (count < RIP_AHEAD_BLOCKS) ? count : RIP_AHEAD_BLOCKS;
+            return true;
+        }
+    }
+    return false;
+}
+
+void cRipper::GetProgress(int &done, int &total)
+{
+    cMutexLock MutexLock(&mMutex);
+
+    done = 0;
+    total = mTracks.size();
+    for (size_t i = 0; i < mTracks.size(); i++) {
+        if (mTracks[i].mState == RIP_DONE) {
+            done++;
+        }
+    }
+}
+
+// "01 - Title.flac", the title is taken when the track is complete. The
+// file is written as "01.flac.part" until then.
+std::string cRipper::GetFileName(int track, bool part)
+{
+    std::string title;
+    char buf[16];
+
+    snprintf(buf, sizeof(buf), "%02d", track + 1);
+    if (part) {
+        return mDir + buf + ".flac.part";
+    }
+    cCdTextRef ref;
+    mCdInfo.GetCdText(ref);
+    title = ref->GetTrack(track, CDTEXT_TITLE);
+    for (size_t i = 0; i < title.size(); i++) {
+        if (title[i] == '/') {
+            title[i] = '_';
+        }
+    }
+    if (title.empty()) {
+        return mDir + buf + ".flac";
+    }
+    return mDir + buf + " - " + title + ".flac";
+}
+
+static void AddComment(FLAC__StreamMetadata *vc, const char *name,
+                       const char *value)
+{
+    FLAC__StreamMetadata_VorbisComment_Entry entry;
+
+    if ((value == NULL) || (*value == '\0')) {
+        return;
+    }
+    if (FLAC__metadata_object_vorbiscomment_entry_from_name_value_pair(
+            &entry, name, value)) {
+        FLAC__metadata_object_vorbiscomment_append_comment(vc, entry, false);
+    }
+}
+
+// The tags go into the padding reserved at the start, so the file is not
+// rewritten.
+void cRipper::WriteTags(int track, const std::string &filename)
+{
+    FLAC__Metadata_Chain *chain = FLAC__metadata_chain_new();
+    FLAC__Metadata_Iterator *it = FLAC__metadata_iterator_new();
+    FLAC__StreamMetadata *vc;
+    cCdTextRef ref;
+    const char *performer;
+    char buf[16];
+
+    if ((chain == NULL) || (it == NULL) ||
+        !FLAC__metadata_chain_read(chain, filename.c_str())) {
+        esyslog("%s %d Can not read %s", __FILE__, __LINE__, filename.c_str());
+        goto out;
+    }
+    vc = FLAC__metadata_object_new(FLAC__METADATA_TYPE_VORBIS_COMMENT);
+    if (vc == NULL) {
+        goto out;
+    }
+    mCdInfo.GetCdText(ref);
+    performer = ref->GetTrack(track, CDTEXT_PERFORMER);
+    if (*performer == '\0') {
+        performer = ref->GetDisc(CDTEXT_PERFORMER);
+    }
+    AddComment(vc, "ARTIST", performer);
+    AddComment(vc, "ALBUMARTIST", ref->GetDisc(CDTEXT_PERFORMER));
+    AddComment(vc, "ALBUM", ref->GetDisc(CDTEXT_TITLE));
+    AddComment(vc, "TITLE", ref->GetTrack(track, CDTEXT_TITLE));
+    AddComment(vc, "GENRE", ref->GetDisc(CDTEXT_GENRE));
+    AddComment(vc, "COMPOSER", ref->GetTrack(track, CDTEXT_COMPOSER));
+    AddComment(vc, "ISRC", ref->GetTrack(track, CDTEXT_ISRC));
+    snprintf(buf, sizeof(buf), "%d", track + 1);
+    AddComment(vc, "TRACKNUMBER", buf);
+    snprintf(buf, sizeof(buf), "%d", mNumTracks);
+    AddComment(vc, "TRACKTOTAL", buf);
+    snprintf(buf, sizeof(buf), "%08x", mCdInfo.GetCddbDiscId());
+    AddComment(vc, "CDDB", buf);
+    // After the stream info, which is always the first block
+    FLAC__metadata_iterator_init(it, chain);
+    if (!FLAC__metadata_iterator_insert_block_after(it, vc)) {
+        FLAC__metadata_object_delete(vc);
+        goto out;
+    }
+    FLAC__metadata_chain_sort_padding(chain);
+    if (!FLAC__metadata_chain_write(chain, true, false)) {
+        esyslog("%s %d Can not write tags to %s", __FILE__, __LINE__,
+                filename.c_str());
+    }
+out:
+    if (it != NULL) {
+        FLAC__metadata_iterator_delete(it);
+    }
+    if (chain != NULL) {
+        FLAC__metadata_chain_delete(chain);
+    }
+}
+
+void cRipper::Finished(int track, bool ok)
+{
+    cMutexLock MutexLock(&mMutex);
+
+    if ((track < 0) || (track >= (int)mTracks.size())) {
+        return;
+    }
+    // A failed track is not tried again, the cause (disc full) is likely
+    // to stay
+    mTracks[track].mState = ok ? RIP_DONE : RIP_FAILED;
+    mTracks[track].mWorker = -1;
+}
+
+FLAC__StreamEncoder *cRipper::NewEncoder(const std::string &filename,
+                                         FLAC__uint64 samples,
+                                         FLAC__StreamMetadata **meta,
+                                         unsigned int nummeta)
+{
+    FLAC__StreamEncoderInitStatus status;
+    FLAC__StreamEncoder *encoder = FLAC__stream_encoder_new();
+
+    if (encoder == NULL) {
+        esyslog("%s %d Out of memory", __FILE__, __LINE__);
+        return NULL;
+    }
+    FLAC__stream_encoder_set_channels(encoder, 2);
+    FLAC__stream_encoder_set_bits_per_sample(encoder, 16);
+    FLAC__stream_encoder_set_sample_rate(encoder, 44100);
+    FLAC__stream_encoder_set_compression_level(encoder, RIP_FLAC_LEVEL);
+    if (samples > 0) {
+        FLAC__stream_encoder_set_total_samples_estimate(encoder, samples);
+    }
+    if (nummeta > 0) {
+        FLAC__stream_encoder_set_metadata(encoder, meta, nummeta);
+    }
+    status = FLAC__stream_encoder_init_file(encoder, filename.c_str(),
+                                            NULL, NULL);
+    if (status != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
+        esyslog("%s %d Can not create %s (%d)", __FILE__, __LINE__,
+                filename.c_str(), status);
+        FLAC__stream_encoder_delete(encoder);
+        return NULL;
+    }
+    return encoder;
+}
+
+bool cRipper::Encode(FLAC__StreamEncoder *encoder, const uint8_t *data)
+{
+    FLAC__int32 samples[RIP_SAMPLES_PER_BLOCK * 2];
+
+    for (int i = 0; i < RIP_SAMPLES_PER_BLOCK * 2; i++) {
+        samples[i] = (int16_t)(data[2 * i] | (data[2 * i + 1] << 8));
+    }
+    return FLAC__stream_encoder_process_interleaved(encoder, samples,
+                                                    RIP_SAMPLES_PER_BLOCK);
+}
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class rips the disc to one FLAC file per track while playing. The
+ * reader thread hands over the sectors read for playback and the sectors
+ * it reads ahead for the ripper while the ring buffer is well filled.
+ * Each track is encoded by a worker thread, up to one per core, which
+ * gets the sectors of its track in order through a queue. The tags are
+ * written from the CD-Text or CDDB information when a track is complete.
+ */
+
+#ifndef __RIPPER_H__
+#define __RIPPER_H__
+
+#ifdef USE_FLAC
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <vdr/thread.h>
+#include <FLAC/stream_encoder.h>
+#include "cdinfo.h"
+
+#define RIP_QUEUE_BLOCKS    (4 * CDIO_CD_FRAMES_PER_SEC)    // Per worker
+#define RIP_MAX_WORKERS     8
+#define RIP_AHEAD_BLOCKS    CDIO_CD_FRAMES_PER_SEC  // Read at once for ripping
+// While ripping, the read-ahead of playback grows into the history of the
+// ring buffer. Reading ahead for the ripper starts at RIP_MIN_FILL blocks
+// and playback reads continue at RIP_REFILL, so the drive changes between
+// both positions only every few seconds.
+#define RIP_READAHEAD_BLOCKS (10 * CDIO_CD_FRAMES_PER_SEC)
+#define RIP_MIN_FILL        (8 * CDIO_CD_FRAMES_PER_SEC)
+#define RIP_REFILL          (3 * CDIO_CD_FRAMES_PER_SEC)
+#define RIP_FLAC_LEVEL      5
+#define RIP_PADDING         4096    // Room for the tags written at the end
+
+typedef enum _rip_state {
+    RIP_PENDING,    // Not started, waits for its first sector
+    RIP_ACTIVE,     // Encoded by a worker
+    RIP_DONE,
+    RIP_FAILED
+} RIP_STATE_T;
+
+typedef struct _rip_track {
+    lsn_t mStartLsn;
+    lsn_t mEndLsn;          // Last sector of the track
+    lsn_t mNext;            // Next sector accepted
+    RIP_STATE_T mState;
+    int mWorker;
+} RIP_TRACK_T;
+
+class cRipper;
+
+// Encodes one track at a time
+class cRipWorker: public cThread {
+private:
+    cRipper &mRipper;
+    cMutex mMutex;          // Protects queue and assignment
+    cCondVar mCond;
+    uint8_t *mQueue;
+    int mHead;              // Oldest sector in the queue
+    int mCount;
+    int mTrack;             // Track in CD order, -1 when idle
+    int mBlocks;            // Sectors of the track
+    FLAC__StreamEncoder *mEncoder;
+    FLAC__StreamMetadata *mPadding;
+    std::string mFileName;
+
+    bool Begin(void);
+    bool Encode(const uint8_t *data);
+    void End(bool ok);
+protected:
+    virtual void Action(void);
+public:
+    cRipWorker(cRipper &ripper);
+    virtual ~cRipWorker();
+    bool IsIdle(void);
+    // Called by the ripper with its mutex held
+    void Assign(int track, int blocks);
+    bool Put(const uint8_t *data);
+    int GetFree(void);
+};
+
+class cRipper {
+private:
+    friend class cRipWorker;
+    cCdInfo &mCdInfo;
+    cMutex mMutex;          // Protects the tracks
+    std::vector<RIP_TRACK_T> mTracks;
+    std::vector<cRipWorker *> mWorkers;
+    std::string mDir;       // Directory of the disc
+    int mNumTracks;
+    int mLastTrack;         // Track of the last sector fed
+
+    int FindTrack(lsn_t lsn);
+    int GetFreeWorker(void);
+    std::string GetFileName(int track, bool part);
+    void WriteTags(int track, const std::string &filename);
+    void Finished(int track, bool ok);
+public:
+    cRipper(cCdInfo &cdinfo);
+    ~cRipper();
+    // Start with a new disc, tracks already ripped to dir are skipped.
+    // start and end (inclusive) are the lsn of the audio tracks.
+    void Setup(const std::vector<lsn_t> &start, const std::vector<lsn_t> &end,
+               const std::string &dir);
+    // Stop the workers, incomplete files are removed
+    void Reset(void);
+    bool IsActive(void) { return !mWorkers.empty(); }
+    // Called by the reader thread for each sector, never blocks
+    void Feed(lsn_t lsn, const uint8_t *data);
+    // Sectors to read ahead for the ripper, false if there is nothing
+    // which can be taken now
+    bool GetNextRead(lsn_t &lsn, int &count);
+    // Number of tracks ripped and of all tracks
+    void GetProgress(int &done, int &total);
+    // Encoder for CD audio writing filename, samples is the expected
+    // length or 0 if unknown. NULL on errors.
+    static FLAC__StreamEncoder *NewEncoder(const std::string &filename,
+                                           FLAC__uint64 samples,
+                                           FLAC__StreamMetadata **meta,
+                                           unsigned int nummeta);
+    // Encode one sector of CD audio
+    static bool Encode(FLAC__StreamEncoder *encoder, const uint8_t *data);
+};
+
+#endif
+#endif
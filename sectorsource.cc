@@ -0,0 +1,251 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the access to the local drive via libcdio.
+ */
+
+#include <stdlib.h>
+#include <vdr/tools.h>
+#include "sectorsource.h"
+
+cLocalSource::cLocalSource(const std::string &device)
+    : mDevice(device), mUseParanoia(false), mReadLsn(CDIO_INVALID_LSN)
+{
+#ifdef USE_PARANOIA
+    pParanoiaDrive = NULL;
+    pParanoiaCd = NULL;
+#endif
+#if LIBCDIO_VERSION_NUM > 83
+    pCdioCdtext = NULL;
+#endif
+    pCdio = NULL;
+}
+
+cLocalSource::~cLocalSource()
+{
+    Close();
+}
+
+#if LIBCDIO_VERSION_NUM > 83
+// Get all available CD-Text for a track
+void cLocalSource::GetCDText (const track_t track_no, CD_TEXT_T &cd_text)
+{
+    int i;
+    const char *txt;
+
+    for (i = 0; i < MAX_CDTEXT_FIELDS; i++) {
+        txt = cdtext_get_const (pCdioCdtext, (cdtext_field_t)i, track_no);
+        if (txt != NULL) {
+            cd_text[i] = txt;
+            dsyslog ("CD-Text %d: %s", i, cd_text[i].c_str());
+        }
+    }
+}
+#else
+// Get all available CD-Text for a track
+void cLocalSource::GetCDText (const track_t track_no, CD_TEXT_T &cd_text)
+{
+    int i;
+    const cdtext_t *cdtext = cdio_get_cdtext(pCdio, track_no);
+
+    if (cdtext == NULL) {
+        dsyslog ("No CD-Text found");
+        return;
+    }
+    for (i = 0; i < MAX_CDTEXT_FIELDS; i++) {
+        if (cdtext->field[i] != NULL) {
+            cd_text[i] = cdtext->field[i];
+            dsyslog ("CD-Text %d: %s", i, cdtext->field[i]);
+        }
+    }
+}
+#endif
+
+void cLocalSource::Close(void)
+{
+#ifdef USE_PARANOIA
+    pParanoiaDrive = NULL;
+    if (pParanoiaCd != NULL) {
+        cdio_paranoia_free(pParanoiaCd);
+        pParanoiaCd = NULL;
+    }
+#endif
+    if (pCdio != NULL) {
+        cdio_destroy(pCdio);
+        pCdio = NULL;
+    }
+    mUseParanoia = false;
+    mReadLsn = CDIO_INVALID_LSN;
+}
+
+#ifdef USE_PARANOIA
+bool cLocalSource::ParanoiaLogMsg (void)
+{
+    bool iserr = false;
+    if (pParanoiaDrive != NULL) {
+        char *err = cdio_cddap_errors(pParanoiaDrive);
+        char *mes = cdio_cddap_messages(pParanoiaDrive);
+        if (mes != NULL) {
+            dsyslog (mes);
+            free(mes);
+        }
+        if (err != NULL) {
+            esyslog (err);
+            free(err);
+            iserr = true;
+        }
+    }
+    return iserr;
+}
+#endif
+
+void cLocalSource::SetSpeed (int speed)
+{
+    if (pCdio != NULL) {
+        if (cdio_set_speed (pCdio, speed) != 0) {
+            esyslog("%s %d mmc_set_drive_speed failed", __FILE__, __LINE__);
+        }
+        else {
+            dsyslog ("Change cd speed to %dx",speed);
+        }
+     }
+}
+
+void cLocalSource::SetParanoia(bool on)
+{
+#ifdef USE_PARANOIA
+    mUseParanoia = on;
+#else
+    mUseParanoia = false;
+#endif
+    mReadLsn = CDIO_INVALID_LSN;
+}
+
+// Open access to the audio cd and retrieve the TOC and all available
+// CD-Text information
+SRC_ERROR_T cLocalSource::Open(SRC_TOC_T &toc)
+{
+    track_t firsttrack;
+    track_t numtracks;
+    char *str;
+
+    Close();
+    toc.mTracks.clear();
+#if LIBCDIO_VERSION_NUM > 83
+    pCdio = cdio_open(mDevice.c_str(), DRIVER_UNKNOWN);
+#else
+    pCdio = cdio_open(mDevice.c_str(), DRIVER_DEVICE);
+#endif
+    if (pCdio == NULL) {
+        esyslog("%s %d Can not open %s", __FILE__, __LINE__, mDevice.c_str());
+        return SRC_ERR_OPEN;
+    }
+#if LIBCDIO_VERSION_NUM > 83
+    pCdioCdtext = cdio_get_cdtext(pCdio);
+    if (pCdioCdtext == NULL) {
+        dsyslog ("No CD-Text available");
+    }
+#endif
+#ifdef USE_PARANOIA
+    pParanoiaDrive=cdio_cddap_identify_cdio(pCdio, 1, NULL);
+    if (pParanoiaDrive == NULL) {
+        esyslog ("Drive Init failed");
+        Close();
+        return SRC_ERR_INIT;
+    }
+    cdio_cddap_open (pParanoiaDrive);
+
+    pParanoiaCd = cdio_paranoia_init(pParanoiaDrive);
+    if (pParanoiaCd == NULL) {
+        esyslog ("Paranoia Init failed");
+        Close();
+        return SRC_ERR_INIT;
+    }
+     /* Set reading mode for full paranoia, but allow skipping sectors. */
+    cdio_paranoia_modeset(pParanoiaCd,
+                             PARANOIA_MODE_FULL^PARANOIA_MODE_NEVERSKIP);
+#endif
+    dsyslog("The driver selected is %s", cdio_get_driver_name(pCdio));
+    str = cdio_get_default_device(pCdio);
+    dsyslog("The default device for this driver is %s", str);
+    free(str);
+
+    firsttrack = cdio_get_first_track_num(pCdio);
+    if (firsttrack == CDIO_INVALID_TRACK) {
+        esyslog("%s %d Problem on read first track %s",
+                __FILE__, __LINE__, mDevice.c_str());
+        return SRC_ERR_NODISC;
+    }
+    numtracks = cdio_get_num_tracks(pCdio);
+    if (numtracks == CDIO_INVALID_TRACK) {
+        esyslog("%s %d Problem on read no of tracks %s",
+                __FILE__, __LINE__, mDevice.c_str());
+        return SRC_ERR_TOC;
+    }
+    dsyslog("CD-ROM Track List (%d - %d)\n", firsttrack, numtracks);
+
+    GetCDText (0, toc.mCdText);
+    for (int i = 0; i < numtracks; i++) {
+        SRC_TRACK_T t;
+        t.mTrackNo = (track_t)i + firsttrack;
+        t.mStartLsn = cdio_get_track_lsn(pCdio, t.mTrackNo);
+        t.mEndLsn = cdio_get_track_last_lsn(pCdio, t.mTrackNo);
+        t.mLba = cdio_get_track_lba(pCdio, t.mTrackNo);
+        if (t.mEndLsn == CDIO_INVALID_LSN) {
+            esyslog("%s %d Problem on read last lsn %s",
+                     __FILE__, __LINE__, mDevice.c_str());
+            return SRC_ERR_LSN;
+        }
+        if (t.mLba == CDIO_INVALID_LBA) {
+            esyslog("%s %d Problem on read lba %s",
+                    __FILE__, __LINE__, mDevice.c_str());
+            return SRC_ERR_LBA;
+        }
+        t.mAudio = (cdio_get_track_format(pCdio, t.mTrackNo) ==
+                    TRACK_FORMAT_AUDIO) && (t.mStartLsn != CDIO_INVALID_LSN);
+        if (t.mAudio) {
+            dsyslog ("get_track_info for track %d S %d E %d L %d",
+                     t.mTrackNo, t.mStartLsn, t.mEndLsn, t.mLba);
+            GetCDText (t.mTrackNo, t.mCdText);
+        }
+        toc.mTracks.push_back(t);
+    }
+    toc.mLeadOut = cdio_get_track_lba(pCdio, CDIO_CDROM_LEADOUT_TRACK);
+    return SRC_OK;
+}
+
+// Read one sector, bufptr is set to buf or to the paranoia buffer
+bool cLocalSource::Read(lsn_t lsn, uint8_t *buf, uint8_t *&bufptr)
+{
+    if (pCdio == NULL) {
+        return false;
+    }
+#ifdef USE_PARANOIA
+    if (mUseParanoia) {
+        // Blocks continuing the last read need no seek, so paranoia
+        // reads on without verifying the overlap again.
+        if (lsn != mReadLsn) {
+            cdio_paranoia_seek(pParanoiaCd, lsn, SEEK_SET);
+        }
+        bufptr = (uint8_t *)cdio_paranoia_read(pParanoiaCd, NULL);
+        if (ParanoiaLogMsg()) {
+            mReadLsn = CDIO_INVALID_LSN;
+            return false;
+        }
+        mReadLsn = lsn + 1;
+        return true;
+    }
+#endif
+    bufptr = buf;
+    if (cdio_read_audio_sectors(pCdio, bufptr, lsn, 1) != DRIVER_OP_SUCCESS) {
+        mReadLsn = CDIO_INVALID_LSN;
+        return false;
+    }
+    mReadLsn = lsn + 1;
+    return true;
+}
@@ -0,0 +1,112 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the source of the sectors read by the player:
+ * the TOC, the CD-Text and the audio sectors of the disc. The local
+ * source reads the drive with libcdio and paranoia, the remote source
+ * (remotedrive.h) gets them from the drive of another host.
+ */
+
+#ifndef __SECTORSOURCE_H__
+#define __SECTORSOURCE_H__
+
+#define DO_NOT_WANT_PARANOIA_COMPATIBILITY 1
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <cdio/version.h>
+
+#if USE_PARANOIA
+#if LIBCDIO_VERSION_NUM < 90
+#include <cdio/cdda.h>
+#include <cdio/paranoia.h>
+#else
+#include <cdio/paranoia/cdda.h>
+#include <cdio/paranoia/paranoia.h>
+#endif
+#endif
+
+#include <cdio/cdio.h>
+#include <cdio/track.h>
+#include <cdio/cd_types.h>
+#include "cdtextstore.h"
+
+typedef enum _src_error {
+    SRC_OK,
+    SRC_ERR_OPEN,       // Device can not be opened
+    SRC_ERR_NODISC,     // No disc in drive
+    SRC_ERR_TOC,        // Number of tracks not readable
+    SRC_ERR_LSN,        // Last sector of a track not readable
+    SRC_ERR_LBA,        // Start of a track not readable
+    SRC_ERR_INIT,       // Paranoia init failed
+    SRC_ERR_CONNECT     // Drive server not reachable
+} SRC_ERROR_T;
+
+typedef struct _src_track {
+    track_t mTrackNo;
+    lsn_t mStartLsn;
+    lsn_t mEndLsn;          // Last sector of the track
+    lba_t mLba;
+    bool mAudio;
+    CD_TEXT_T mCdText;
+} SRC_TRACK_T;
+
+typedef struct _src_toc {
+    CD_TEXT_T mCdText;      // Disc
+    std::vector<SRC_TRACK_T> mTracks;
+    lba_t mLeadOut;
+} SRC_TOC_T;
+
+class cSectorSource {
+public:
+    virtual ~cSectorSource() {}
+    // Open the disc and read its TOC and CD-Text
+    virtual SRC_ERROR_T Open(SRC_TOC_T &toc) = 0;
+    virtual void Close(void) = 0;
+    virtual bool IsOpen(void) = 0;
+    virtual void SetSpeed(int speed) = 0;
+    // Read sectors through paranoia from now on
+    virtual void SetParanoia(bool on) = 0;
+    // Read one sector, bufptr is set to buf or to an internal buffer
+    // valid until the next call
+    virtual bool Read(lsn_t lsn, uint8_t *buf, uint8_t *&bufptr) = 0;
+    virtual std::string GetName(void) = 0;
+};
+
+class cLocalSource: public cSectorSource {
+private:
+#ifdef USE_PARANOIA
+    cdrom_drive_t   *pParanoiaDrive;
+    cdrom_paranoia_t *pParanoiaCd;
+#endif
+#if LIBCDIO_VERSION_NUM > 83
+    const cdtext_t *pCdioCdtext;
+#endif
+    CdIo_t          *pCdio;
+    std::string mDevice;
+    bool mUseParanoia;
+    lsn_t mReadLsn;         // Next block read without seek
+
+    void GetCDText(const track_t track_no, CD_TEXT_T &cd_text);
+#ifdef USE_PARANOIA
+    bool ParanoiaLogMsg(void);
+#endif
+public:
+    cLocalSource(const std::string &device);
+    virtual ~cLocalSource();
+    virtual SRC_ERROR_T Open(SRC_TOC_T &toc);
+    virtual void Close(void);
+    virtual bool IsOpen(void) { return pCdio != NULL; }
+    virtual void SetSpeed(int speed);
+    virtual void SetParanoia(bool on);
+    virtual bool Read(lsn_t lsn, uint8_t *buf, uint8_t *&bufptr);
+    virtual std::string GetName(void) { return mDevice; }
+};
+
+#endif
@@ -43,4 +43,59 @@ struct Span_SetPlayindex_1_0 {
     int index;                  // the timestamp (ms) of the frame(s) being currently played
 };
 
+// Services provided by the cdplayer plugin
+
+#define CDPLAYER_GET_STATE_ID   "CdPlayer-GetState-v1.0"
+
+// Current playback state, filled in by the cdplayer plugin
+struct CdPlayer_GetState_1_0 {
+    int track;                  // current track (1..numTracks), 0 if none
+    int numTracks;              // number of audio tracks
+    int position;               // played seconds of current track
+    int length;                 // length of current track in seconds
+    bool playing;               // true if playing, false if paused/stopped
+    int speed;                  // 0 = normal speed
+    int bufferFill;             // fill level of the read buffer in percent
+    bool cddbInfo;              // track information from CDDB available
+    bool random;                // shuffle mode
+};
+
+#define CDPLAYER_GET_SPECTRUM_ID    "CdPlayer-GetSpectrum-v1.0"
+#define CDPLAYER_SPECTRUM_MAX_BANDS 64
+
+// Band levels of the played audio. The analysis runs while the service
+// is called at least every 5 seconds. The bands are logarithmically
+// spaced from 40 Hz to 16 kHz.
+struct CdPlayer_GetSpectrum_1_0 {
+    int bands;                  // in: bands wanted (1..64), out: bands filled
+    unsigned int version;       // incremented with each analysis, 0 if none
+    int index;                  // timestamp (ms) of the analysed frame(s)
+    int heights[CDPLAYER_SPECTRUM_MAX_BANDS]; // 0..1000, 60 dB range
+    int peaks[CDPLAYER_SPECTRUM_MAX_BANDS];   // slowly falling maximum
+};
+
+#define CDPLAYER_PCM_TAP_ID         "CdPlayer-PcmTap-v1.0"
+
+#define CDPLAYER_TAP_SUBSCRIBE      0   // Get a handle, reading starts now
+#define CDPLAYER_TAP_PEEK           1   // Get the blocks not yet read
+#define CDPLAYER_TAP_CONSUME        2   // Blocks of the last peek were read
+#define CDPLAYER_TAP_UNSUBSCRIBE    3
+
+// Access to the played PCM data (44.1 kHz, 16 bit stereo, little endian,
+// blocks of 2352 bytes). The data is read directly from a ring buffer
+// shared by all subscribers. The player never waits for a subscriber:
+// blocks not read in time are overwritten and counted as dropped. Each
+// handle must only be used by one thread.
+struct CdPlayer_PcmTap_1_0 {
+    int command;                // CDPLAYER_TAP_...
+    int handle;                 // out for SUBSCRIBE, in for the others
+    const unsigned char *data;  // out PEEK: first block, NULL if none
+    int blocks;                 // out PEEK: contiguous blocks at data,
+                                // in CONSUME: blocks read
+    int index;                  // out PEEK: timestamp (ms) of the first block
+    unsigned int drops;         // out: blocks dropped for this handle so far
+    bool valid;                 // out CONSUME: data was not overwritten
+                                // while it was read
+};
+
 #endif
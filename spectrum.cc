@@ -0,0 +1,180 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the spectrum analysis of the played audio.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <cdio/cdio.h>
+#ifdef VERSION
+#undef VERSION
+#endif
+#include <vdr/tools.h>
+#include "spectrum.h"
+
+#define SPEC_LOW_HZ     40.0
+#define SPEC_HIGH_HZ    16000.0
+#define SPEC_RATE_HZ    44100.0
+#define SPEC_RANGE_DB   60.0f
+// Fall of the bars and peaks per analysis, a full bar falls in 1 second
+#define SPEC_FALL       (SPEC_MAX_LEVEL * SPEC_RATE_MS / 1000)
+#define SPEC_PEAK_HOLD  (500 / SPEC_RATE_MS)
+
+cSpectrum::cSpectrum(void) :
+    mPcmPos(0), mIndex(0), mFed(0), mLevelIndex(0), mVersion(0),
+    mWanted(false), mLastRequest(0),
+    mFft(SPEC_FFT_SIZE), mFrame(SPEC_FFT_SIZE), mPower(SPEC_FFT_SIZE / 2 + 1)
+{
+    int prev = 0;
+
+    SetDescription("cdplayer spectrum");
+    memset(mPcm, 0, sizeof(mPcm));
+    memset(mHeights, 0, sizeof(mHeights));
+    memset(mPeaks, 0, sizeof(mPeaks));
+    memset(mPeakHold, 0, sizeof(mPeakHold));
+    // Logarithmic bands, each at least one bin wide
+    for (int b = 0; b <= SPEC_BANDS; b++) {
+        double f = SPEC_LOW_HZ * pow(SPEC_HIGH_HZ / SPEC_LOW_HZ,
+                                     (double)b / SPEC_BANDS);
+        int bin = (int)(f * SPEC_FFT_SIZE / SPEC_RATE_HZ + 0.5);
+        if ((b > 0) && (bin <= prev)) {
+            bin = prev + 1;
+        }
+        if (bin > SPEC_FFT_SIZE / 2) {
+            bin = SPEC_FFT_SIZE / 2;
+        }
+        mBandBin[b] = bin;
+        prev = bin;
+    }
+}
+
+cSpectrum::~cSpectrum()
+{
+    Cancel(3);
+}
+
+void cSpectrum::DoFeed(const uint8_t *data, int frame)
+{
+    cMutexLock MutexLock(&mPcmMutex);
+
+    for (int i = 0; i < CDIO_CD_FRAMESIZE_RAW / 4; i++) {
+        int16_t l = data[4 * i] | (data[4 * i + 1] << 8);
+        int16_t r = data[4 * i + 2] | (data[4 * i + 3] << 8);
+        mPcm[mPcmPos] = (l + r) * (0.5f / 32768.0f);
+        mPcmPos = (mPcmPos + 1) & (SPEC_FFT_SIZE - 1);
+    }
+    mIndex = (frame * 1000) / CDIO_CD_FRAMES_PER_SEC;
+    mFed++;
+}
+
+// Calculate the band levels of mFrame. Without new samples (pause) the
+// bars fall down.
+void cSpectrum::Analyze(bool fresh, int index)
+{
+    // Power of a full scale sine with Hann window
+    const float ref = (SPEC_FFT_SIZE / 4.0f) * (SPEC_FFT_SIZE / 4.0f);
+    int levels[SPEC_BANDS];
+
+    memset(levels, 0, sizeof(levels));
+    if (fresh) {
+        mFft.Power(&mFrame[0], &mPower[0]);
+        for (int b = 0; b < SPEC_BANDS; b++) {
+            float sum = 0;
+            for (int bin = mBandBin[b]; bin < mBandBin[b + 1]; bin++) {
+                sum += mPower[bin];
+            }
+            float db = 10.0f * log10f(sum / ref + 1e-12f);
+            int h = (int)((db + SPEC_RANGE_DB) * SPEC_MAX_LEVEL / SPEC_RANGE_DB);
+            levels[b] = (h < 0) ? 0 : (h > SPEC_MAX_LEVEL) ? SPEC_MAX_LEVEL : h;
+        }
+    }
+    cMutexLock MutexLock(&mLevelMutex);
+    for (int b = 0; b < SPEC_BANDS; b++) {
+        int h = mHeights[b] - SPEC_FALL;
+        mHeights[b] = (levels[b] > h) ? levels[b] : (h > 0) ? h : 0;
+        if (mHeights[b] >= mPeaks[b]) {
+            mPeaks[b] = mHeights[b];
+            mPeakHold[b] = SPEC_PEAK_HOLD;
+        }
+        else if (mPeakHold[b] > 0) {
+            mPeakHold[b]--;
+        }
+        else {
+            int p = mPeaks[b] - SPEC_FALL / 2;
+            mPeaks[b] = (p > mHeights[b]) ? p : mHeights[b];
+        }
+    }
+    mLevelIndex = index;
+    if (++mVersion == 0) {
+        mVersion = 1;
+    }
+}
+
+void cSpectrum::Action(void)
+{
+    unsigned int fed = 0;
+
+    dsyslog("%s %d spectrum analysis started", __FILE__, __LINE__);
+    while (Running()) {
+        cCondWait::SleepMs(SPEC_RATE_MS);
+        if (cTimeMs::Now() - __atomic_load_n(&mLastRequest, __ATOMIC_RELAXED)
+                > SPEC_IDLE_MS) {
+            mWanted = false;
+            break;
+        }
+        mPcmMutex.Lock();
+        bool fresh = (mFed != fed);
+        int index = mIndex;
+        fed = mFed;
+        if (fresh) {
+            // Oldest sample first
+            for (int i = 0; i < SPEC_FFT_SIZE; i++) {
+                mFrame[i] = mPcm[(mPcmPos + i) & (SPEC_FFT_SIZE - 1)];
+            }
+        }
+        mPcmMutex.Unlock();
+        Analyze(fresh, index);
+    }
+    dsyslog("%s %d spectrum analysis stopped", __FILE__, __LINE__);
+}
+
+void cSpectrum::Get(CdPlayer_GetSpectrum_1_0 &spectrum)
+{
+    cMutexLock MutexLock(&mLevelMutex);
+    int bands = spectrum.bands;
+
+    __atomic_store_n(&mLastRequest, cTimeMs::Now(), __ATOMIC_RELAXED);
+    if (!Active()) {
+        mWanted = true;
+        Start();
+    }
+    if ((bands <= 0) || (bands > SPEC_BANDS)) {
+        bands = SPEC_BANDS;
+    }
+    // Merge neighbouring bands if fewer are wanted
+    for (int i = 0; i < bands; i++) {
+        int from = i * SPEC_BANDS / bands;
+        int to = (i + 1) * SPEC_BANDS / bands;
+        int h = 0;
+        int p = 0;
+        for (int b = from; b < to; b++) {
+            if (mHeights[b] > h) {
+                h = mHeights[b];
+            }
+            if (mPeaks[b] > p) {
+                p = mPeaks[b];
+            }
+        }
+        spectrum.heights[i] = h;
+        spectrum.peaks[i] = p;
+    }
+    spectrum.bands = bands;
+    spectrum.version = mVersion;
+    spectrum.index = mLevelIndex;
+}
@@ -0,0 +1,70 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the spectrum analysis of the played audio. The
+ * player hands over each block when it is played, a separate thread
+ * calculates the band levels at display rate. It only runs while a
+ * visualizer asks for the levels.
+ */
+
+#ifndef __SPECTRUM_H__
+#define __SPECTRUM_H__
+
+#include <stdint.h>
+#include <vector>
+#include <vdr/thread.h>
+#include "fft.h"
+#include "service.h"
+
+#define SPEC_FFT_SIZE   4096
+#define SPEC_BANDS      CDPLAYER_SPECTRUM_MAX_BANDS
+#define SPEC_RATE_MS    40      // Analysis interval
+#define SPEC_IDLE_MS    5000    // Stop without requests for this time
+#define SPEC_MAX_LEVEL  1000
+
+class cSpectrum: public cThread {
+private:
+    cMutex mPcmMutex;
+    float mPcm[SPEC_FFT_SIZE];  // Last played samples, mono
+    int mPcmPos;                // Next sample to write
+    int mIndex;                 // Playback time (ms) of the last block
+    unsigned int mFed;          // Incremented for each block
+
+    cMutex mLevelMutex;
+    int mHeights[SPEC_BANDS];
+    int mPeaks[SPEC_BANDS];
+    int mPeakHold[SPEC_BANDS];  // Analyses until the peak falls
+    int mLevelIndex;
+    unsigned int mVersion;
+
+    volatile bool mWanted;      // Someone asked for the levels
+    uint64_t mLastRequest;
+
+    cFft mFft;
+    std::vector<float> mFrame;
+    std::vector<float> mPower;
+    int mBandBin[SPEC_BANDS + 1];   // First FFT bin of each band
+
+    void Analyze(bool fresh, int index);
+protected:
+    virtual void Action(void);
+public:
+    cSpectrum(void);
+    virtual ~cSpectrum();
+    // Called by the player for each block when it is played
+    void Feed(const uint8_t *data, int frame) {
+        if (mWanted) {
+            DoFeed(data, frame);
+        }
+    }
+    void DoFeed(const uint8_t *data, int frame);
+    // Fill the service data, starts the analysis if not running
+    void Get(CdPlayer_GetSpectrum_1_0 &spectrum);
+};
+
+#endif
@@ -0,0 +1,412 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the live network streams of the played audio.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vdr/config.h>
+#include <vdr/tools.h>
+#include "streamsink.h"
+
+#define HTTP_RING_BYTES ((uint64_t)HTTP_RING_BLOCKS * CDIO_CD_FRAMESIZE_RAW)
+
+static void SetNonBlocking(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+cHttpSink::cHttpSink(const std::string &port)
+    : mPort(port), mListen(-1), mRing(NULL), mWritePos(0), mNumClients(0)
+{
+}
+
+cHttpSink::~cHttpSink()
+{
+    Close();
+}
+
+std::string cHttpSink::GetName(void)
+{
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), " clients %d",
+             __atomic_load_n(&mNumClients, __ATOMIC_RELAXED));
+    if (mPort.find(':') != std::string::npos) {
+        return "http " + mPort + buf;
+    }
+    return "http :" + mPort + buf;
+}
+
+// mPort is [address:]port, without address on all interfaces
+bool cHttpSink::Open(void)
+{
+    struct addrinfo hints;
+    struct addrinfo *res;
+    std::string host;
+    std::string port = mPort;
+    size_t pos = mPort.rfind(':');
+    int on = 1;
+    int err;
+
+    mRing = (uint8_t *)malloc(HTTP_RING_BYTES);
+    if (mRing == NULL) {
+        esyslog("%s %d Out of memory", __FILE__, __LINE__);
+        return false;
+    }
+    mWritePos = 0;
+    if (pos != std::string::npos) {
+        host = mPort.substr(0, pos);
+        port = mPort.substr(pos + 1);
+    }
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    err = getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(),
+                      &hints, &res);
+    if (err != 0) {
+        esyslog("%s %d Invalid address %s: %s", __FILE__, __LINE__,
+                mPort.c_str(), gai_strerror(err));
+        return false;
+    }
+    mListen = socket(res->ai_family, SOCK_STREAM, 0);
+    if (mListen >= 0) {
+        setsockopt(mListen, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+    if ((mListen < 0) || (bind(mListen, res->ai_addr, res->ai_addrlen) < 0) ||
+        (listen(mListen, 16) < 0)) {
+        esyslog("%s %d HTTP stream on %s failed %d", __FILE__, __LINE__,
+                mPort.c_str(), errno);
+        freeaddrinfo(res);
+        Close();
+        return false;
+    }
+    freeaddrinfo(res);
+    SetNonBlocking(mListen);
+    isyslog("HTTP stream on %s", mPort.c_str());
+    return true;
+}
+
+void cHttpSink::Close(void)
+{
+    while (!mClients.empty()) {
+        Drop(mClients.size() - 1);
+    }
+    if (mListen >= 0) {
+        close(mListen);
+        mListen = -1;
+    }
+    free(mRing);
+    mRing = NULL;
+}
+
+void cHttpSink::Drop(size_t idx)
+{
+    HTTP_CLIENT_T &c = mClients[idx];
+
+    dsyslog("%s %d HTTP client %d closed, %u bytes skipped", __FILE__,
+            __LINE__, c.mFd, c.mSkipped);
+    close(c.mFd);
+    mClients.erase(mClients.begin() + idx);
+    __atomic_store_n(&mNumClients, (int)mClients.size(), __ATOMIC_RELAXED);
+}
+
+// Only hosts allowed in VDR's svdrphosts.conf are served
+void cHttpSink::Accept(void)
+{
+    HTTP_CLIENT_T c;
+    struct sockaddr_in peer;
+    socklen_t peerlen = sizeof(peer);
+    int fd;
+
+    while ((fd = accept(mListen, (struct sockaddr *)&peer, &peerlen)) >= 0) {
+        peerlen = sizeof(peer);
+        if (!SVDRPhosts.Acceptable(peer.sin_addr.s_addr)) {
+            esyslog("%s %d HTTP client %s not in svdrphosts.conf", __FILE__,
+                    __LINE__, inet_ntoa(peer.sin_addr));
+            close(fd);
+            continue;
+        }
+        if (mClients.size() >= HTTP_MAX_CLIENTS) {
+            static const char busy[] = "HTTP/1.0 503 Service Unavailable\r\n\r\n";
+            send(fd, busy, sizeof(busy) - 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+            close(fd);
+            continue;
+        }
+        SetNonBlocking(fd);
+        c.mFd = fd;
+        c.mRaw = false;
+        c.mRequest.clear();
+        c.mHeader.clear();
+        c.mHeaderSent = 0;
+        c.mPos = 0;
+        c.mSince = cTimeMs::Now();
+        c.mSkipped = 0;
+        mClients.push_back(c);
+        __atomic_store_n(&mNumClients, (int)mClients.size(), __ATOMIC_RELAXED);
+    }
+}
+
+// Collect the request until the empty line, then prepare the response.
+// Returns false if the client is to be dropped.
+bool cHttpSink::ReadRequest(HTTP_CLIENT_T &c)
+{
+    char buf[512];
+    char path[256];
+    ssize_t len;
+    uint8_t wav[44];
+
+    len = recv(c.mFd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (len == 0) {
+        return false;
+    }
+    if (len < 0) {
+        return (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR);
+    }
+    c.mRequest.append(buf, len);
+    if ((c.mRequest.find("\r\n\r\n") == std::string::npos) &&
+        (c.mRequest.find("\n\n") == std::string::npos)) {
+        return c.mRequest.size() < HTTP_MAX_REQUEST;
+    }
+    if (sscanf(c.mRequest.c_str(), "GET %255s", path) != 1) {
+        c.mHeader = "HTTP/1.0 400 Bad Request\r\n\r\n";
+    }
+    else if ((strcmp(path, "/") == 0) || (strcmp(path, "/stream.wav") == 0)) {
+        c.mHeader = "HTTP/1.0 200 OK\r\n"
+                    "Content-Type: audio/wav\r\n"
+                    "Cache-Control: no-cache\r\n"
+                    "Connection: close\r\n\r\n";
+        // Unknown length of a live stream
+        cWavSink::MakeHeader(wav, 0xffffffff - 36);
+        c.mHeader.append((const char *)wav, sizeof(wav));
+    }
+    else if (strcmp(path, "/stream.raw") == 0) {
+        c.mRaw = true;
+        c.mHeader = "HTTP/1.0 200 OK\r\n"
+                    "Content-Type: application/octet-stream\r\n"
+                    "Cache-Control: no-cache\r\n"
+                    "Connection: close\r\n\r\n";
+    }
+    else {
+        c.mHeader = "HTTP/1.0 404 Not Found\r\n\r\n";
+    }
+    c.mRequest.clear();
+    // Start with the last second, so the player can fill its buffer
+    c.mPos = mWritePos;
+    if (c.mPos > HTTP_START_BLOCKS * CDIO_CD_FRAMESIZE_RAW) {
+        c.mPos -= HTTP_START_BLOCKS * CDIO_CD_FRAMESIZE_RAW;
+    }
+    else {
+        c.mPos = 0;
+    }
+    return true;
+}
+
+// Send as much as the socket takes. Returns false if the client is to be
+// dropped.
+bool cHttpSink::Send(HTTP_CLIENT_T &c)
+{
+    struct iovec iov[2];
+    struct msghdr msg;
+    uint64_t avail;
+    uint64_t oldest;
+    size_t off;
+    ssize_t len;
+
+    if (c.mHeaderSent < c.mHeader.size()) {
+        len = send(c.mFd, c.mHeader.data() + c.mHeaderSent,
+                   c.mHeader.size() - c.mHeaderSent,
+                   MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (len < 0) {
+            return (errno == EAGAIN) || (errno == EWOULDBLOCK) ||
+                   (errno == EINTR);
+        }
+        c.mHeaderSent += len;
+        if (c.mHeaderSent < c.mHeader.size()) {
+            return true;
+        }
+        // Error responses end here
+        if (c.mHeader.compare(0, 12, "HTTP/1.0 200") != 0) {
+            return false;
+        }
+    }
+    // Too slow, skip to the start position of a new client. The distance
+    // is kept a multiple of 4, so the client stays on sample frames.
+    oldest = (mWritePos > HTTP_RING_BYTES) ? mWritePos - HTTP_RING_BYTES : 0;
+    if (c.mPos < oldest) {
+        uint64_t pos = mWritePos - HTTP_START_BLOCKS * CDIO_CD_FRAMESIZE_RAW;
+        pos += (c.mPos - pos) & 3;
+        c.mSkipped += pos - c.mPos;
+        c.mPos = pos;
+    }
+    avail = mWritePos - c.mPos;
+    if (avail == 0) {
+        return true;
+    }
+    off = c.mPos % HTTP_RING_BYTES;
+    iov[0].iov_base = mRing + off;
+    iov[0].iov_len = avail;
+    iov[1].iov_base = mRing;
+    iov[1].iov_len = 0;
+    if (off + avail > HTTP_RING_BYTES) {
+        iov[0].iov_len = HTTP_RING_BYTES - off;
+        iov[1].iov_len = avail - iov[0].iov_len;
+    }
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = (iov[1].iov_len > 0) ? 2 : 1;
+    len = sendmsg(c.mFd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (len < 0) {
+        return (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR);
+    }
+    c.mPos += len;
+    return true;
+}
+
+// Handle all sockets which are ready, never waits
+bool cHttpSink::Serve(void)
+{
+    struct pollfd fds[HTTP_MAX_CLIENTS + 1];
+    size_t n = mClients.size();
+    uint64_t now = cTimeMs::Now();
+
+    fds[0].fd = mListen;
+    fds[0].events = POLLIN;
+    for (size_t i = 0; i < n; i++) {
+        HTTP_CLIENT_T &c = mClients[i];
+        fds[i + 1].fd = c.mFd;
+        if (c.mHeader.empty()) {
+            fds[i + 1].events = POLLIN;
+        }
+        else if ((c.mHeaderSent < c.mHeader.size()) || (c.mPos < mWritePos)) {
+            fds[i + 1].events = POLLOUT;
+        }
+        else {
+            fds[i + 1].events = 0;
+        }
+        fds[i + 1].revents = 0;
+    }
+    fds[0].revents = 0;
+    if (poll(fds, n + 1, 0) < 0) {
+        return (errno == EINTR);
+    }
+    // Backwards, so dropping does not move the clients still to check
+    for (size_t i = n; i > 0; i--) {
+        HTTP_CLIENT_T &c = mClients[i - 1];
+        short ev = fds[i].revents;
+        bool keep = true;
+
+        if (ev & (POLLERR | POLLNVAL)) {
+            keep = false;
+        }
+        else if (c.mHeader.empty()) {
+            if (ev & (POLLIN | POLLHUP)) {
+                keep = ReadRequest(c);
+            }
+            else if (now - c.mSince > HTTP_REQUEST_MS) {
+                keep = false;
+            }
+        }
+        else if (ev & POLLOUT) {
+            keep = Send(c);
+        }
+        else if (ev & POLLHUP) {
+            keep = false;
+        }
+        if (!keep) {
+            Drop(i - 1);
+        }
+    }
+    if (fds[0].revents & POLLIN) {
+        Accept();
+    }
+    return true;
+}
+
+bool cHttpSink::Write(const uint8_t *data, int blocks)
+{
+    size_t len = (size_t)blocks * CDIO_CD_FRAMESIZE_RAW;
+    size_t off;
+    size_t first;
+
+    if (len > HTTP_RING_BYTES) {
+        data += len - HTTP_RING_BYTES;
+        mWritePos += len - HTTP_RING_BYTES;
+        len = HTTP_RING_BYTES;
+    }
+    off = mWritePos % HTTP_RING_BYTES;
+    first = (off + len > HTTP_RING_BYTES) ? HTTP_RING_BYTES - off : len;
+    memcpy(mRing + off, data, first);
+    memcpy(mRing, data + first, len - first);
+    mWritePos += len;
+    return Serve();
+}
+
+cRtpSink::cRtpSink(const std::string &host, const std::string &port)
+    : cUdpSink(host, port), mSeq(0), mTimestamp(0), mSsrc(0), mFirst(true)
+{
+}
+
+bool cRtpSink::Open(void)
+{
+    if (!cUdpSink::Open()) {
+        return false;
+    }
+    mSsrc = (uint32_t)cTimeMs::Now() ^ ((uint32_t)getpid() << 16);
+    mSeq = mSsrc & 0xffff;
+    mTimestamp = 0;
+    mFirst = true;
+    return true;
+}
+
+// RTP header (RFC 3550) and the samples in network byte order
+bool cRtpSink::Write(const uint8_t *data, int blocks)
+{
+    uint8_t pkt[12 + RTP_FRAMES * 4];
+    const int packets = blocks * CDIO_CD_FRAMESIZE_RAW / (RTP_FRAMES * 4);
+
+    for (int p = 0; p < packets; p++) {
+        const uint8_t *src = data + p * RTP_FRAMES * 4;
+        pkt[0] = 0x80;
+        pkt[1] = RTP_PAYLOAD_L16 | (mFirst ? 0x80 : 0);
+        pkt[2] = mSeq >> 8;
+        pkt[3] = mSeq & 0xff;
+        pkt[4] = mTimestamp >> 24;
+        pkt[5] = (mTimestamp >> 16) & 0xff;
+        pkt[6] = (mTimestamp >> 8) & 0xff;
+        pkt[7] = mTimestamp & 0xff;
+        pkt[8] = mSsrc >> 24;
+        pkt[9] = (mSsrc >> 16) & 0xff;
+        pkt[10] = (mSsrc >> 8) & 0xff;
+        pkt[11] = mSsrc & 0xff;
+        for (int i = 0; i < RTP_FRAMES * 4; i += 2) {
+            pkt[12 + i] = src[i + 1];
+            pkt[13 + i] = src[i];
+        }
+        if (!SendDatagram(pkt, sizeof(pkt))) {
+            return false;
+        }
+        mFirst = false;
+        mSeq++;
+        mTimestamp += RTP_FRAMES;
+    }
+    return true;
+}
@@ -0,0 +1,89 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the live network streams of the played audio:
+ * an HTTP server for any number of listeners and an RTP L16 sender.
+ *
+ * The HTTP sink keeps the last seconds of audio in one ring shared by
+ * all clients. Each client has its own position in the ring and gets its
+ * data with one sendmsg from the ring without further copies. A client
+ * which does not take the data fast enough falls behind and skips ahead
+ * when its position is about to be overwritten; the other clients and
+ * the player never wait for it.
+ *
+ * Like the drive server, the HTTP sink only serves the hosts allowed in
+ * VDR's svdrphosts.conf and listens on IPv4 only.
+ */
+
+#ifndef __STREAMSINK_H__
+#define __STREAMSINK_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "outputsink.h"
+
+#define HTTP_RING_BLOCKS    (4 * CDIO_CD_FRAMES_PER_SEC)
+#define HTTP_START_BLOCKS   CDIO_CD_FRAMES_PER_SEC  // Sent at once to new clients
+#define HTTP_MAX_CLIENTS    64
+#define HTTP_MAX_REQUEST    2048
+#define HTTP_REQUEST_MS     5000    // Time for a client to send its request
+#define RTP_PAYLOAD_L16     10      // L16, 2 channels, 44.1 kHz (RFC 3551)
+#define RTP_FRAMES          (CDIO_CD_FRAMESIZE_RAW / 8)  // Per packet
+
+class cHttpSink: public cOutputSink {
+private:
+    typedef struct _http_client {
+        int mFd;
+        bool mRaw;              // Without WAV header
+        std::string mRequest;
+        std::string mHeader;    // Response header still to send
+        size_t mHeaderSent;
+        uint64_t mPos;          // Next byte of the stream to send
+        uint64_t mSince;        // Connect time
+        unsigned int mSkipped;  // Bytes lost because it was too slow
+    } HTTP_CLIENT_T;
+
+    std::string mPort;
+    int mListen;
+    uint8_t *mRing;
+    uint64_t mWritePos;         // Bytes written to the ring
+    std::vector<HTTP_CLIENT_T> mClients;
+    int mNumClients;            // Read by other threads
+
+    void Accept(void);
+    bool ReadRequest(HTTP_CLIENT_T &c);
+    bool Send(HTTP_CLIENT_T &c);
+    void Drop(size_t idx);
+    bool Serve(void);
+public:
+    // port is [address:]port, the address limits the interface
+    cHttpSink(const std::string &port);
+    virtual ~cHttpSink();
+    virtual bool Open(void);
+    virtual bool Write(const uint8_t *data, int blocks);
+    virtual void Close(void);
+    virtual bool Idle(void) { return Serve(); }
+    virtual std::string GetName(void);
+};
+
+// Sends RTP packets of L16 audio (big endian) to a host or multicast group
+class cRtpSink: public cUdpSink {
+private:
+    uint16_t mSeq;
+    uint32_t mTimestamp;
+    uint32_t mSsrc;
+    bool mFirst;
+public:
+    cRtpSink(const std::string &host, const std::string &port);
+    virtual bool Open(void);
+    virtual bool Write(const uint8_t *data, int blocks);
+    virtual std::string GetName(void) { return "rtp " + mHost + ":" + mPort; }
+};
+
+#endif
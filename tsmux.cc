@@ -0,0 +1,181 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the transport stream multiplexer.
+ */
+
+#include <string.h>
+#include "tsmux.h"
+
+#define TSMUX_PROGRAM       1
+#define TSMUX_AF_LEN        18      // Flags, PCR and stuffing
+#define TSMUX_PES_LEN       (3 + 5 + LPCM_HEADER_LEN + CDIO_CD_FRAMESIZE_RAW)
+#define TSMUX_PCR_POS       6
+#define TSMUX_PTS_POS       (4 + 1 + TSMUX_AF_LEN + 9)
+#define TSMUX_STREAM_PRIVATE 0x06
+#define TSMUX_AC3_DESCRIPTOR 0x6a
+
+// The first packet carries TSMUX_FIRST_HEADER bytes of headers, the
+// others only the TS header, all of them are completely filled.
+typedef char TSMUX_LAYOUT_CHECK[
+    (TSMUX_FIRST_HEADER == 4 + 1 + TSMUX_AF_LEN + 9 + 5 + LPCM_HEADER_LEN &&
+     (TS_SIZE - TSMUX_FIRST_HEADER) +
+     (TSMUX_SECTOR_PACKETS - 1) * (TS_SIZE - 4) == CDIO_CD_FRAMESIZE_RAW)
+    ? 1 : -1];
+
+cTsMux::cTsMux(void)
+{
+    static const uint8_t pat[] = {
+        0x00,                       // table id
+        0xb0, 0x0d,                 // section length
+        0x00, 0x01,                 // transport stream id
+        0xc1, 0x00, 0x00,           // version, section numbers
+        0x00, TSMUX_PROGRAM,
+        0xe0 | (TSMUX_PMT_PID >> 8), TSMUX_PMT_PID & 0xff
+    };
+    static const uint8_t pmt[] = {
+        0x02,                       // table id
+        0xb0, 0x15,                 // section length
+        0x00, TSMUX_PROGRAM,
+        0xc1, 0x00, 0x00,           // version, section numbers
+        0xe0 | (TSMUX_AUDIO_PID >> 8), TSMUX_AUDIO_PID & 0xff,  // PCR pid
+        0xf0, 0x00,                 // program info length
+        TSMUX_STREAM_PRIVATE,
+        0xe0 | (TSMUX_AUDIO_PID >> 8), TSMUX_AUDIO_PID & 0xff,
+        0xf0, 0x03,                 // ES info length
+        TSMUX_AC3_DESCRIPTOR, 0x01, 0x00
+    };
+    uint8_t *p = mFirst;
+
+    MakeSection(mPat, 0, pat, sizeof(pat));
+    MakeSection(mPmt, TSMUX_PMT_PID, pmt, sizeof(pmt));
+    // TS header with payload unit start and adaptation field
+    *p++ = 0x47;
+    *p++ = 0x40 | (TSMUX_AUDIO_PID >> 8);
+    *p++ = TSMUX_AUDIO_PID & 0xff;
+    *p++ = 0x30;
+    *p++ = TSMUX_AF_LEN;
+    *p++ = 0x50;                    // Random access, PCR
+    memset(p, 0, 6);
+    p += 6;
+    memset(p, 0xff, TSMUX_AF_LEN - 7);
+    p += TSMUX_AF_LEN - 7;
+    // PES header with PTS
+    *p++ = 0x00;
+    *p++ = 0x00;
+    *p++ = 0x01;
+    *p++ = STREAM_ID_PRIVATE1;
+    *p++ = TSMUX_PES_LEN >> 8;
+    *p++ = TSMUX_PES_LEN & 0xff;
+    *p++ = PES_EXT1 | PES_DATA_ALIGNMENT_INDICATOR | PES_ORIGINAL;
+    *p++ = 0x80;                    // PTS only
+    *p++ = 5;
+    memset(p, 0, 5);
+    p += 5;
+    // LPCM header as written by cPesAudioConverter
+    *p++ = SUBSTREAM_LPCM;
+    *p++ = 0xff;
+    *p++ = 0;
+    *p++ = 4;
+    *p++ = 0;
+    *p++ = PCM_FREQ_44100 | PCM_CHAN2;
+    *p++ = PES_DYNAMIC_RANGE_OFF;
+    Reset();
+}
+
+// CRC of the PSI sections (polynomial 0x04c11db7, not reflected)
+uint32_t cTsMux::Crc32(const uint8_t *data, int len)
+{
+    uint32_t crc = 0xffffffff;
+
+    for (int i = 0; i < len; i++) {
+        crc ^= (uint32_t)data[i] << 24;
+        for (int j = 0; j < 8; j++) {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+void cTsMux::MakeSection(uint8_t *pkt, int pid, const uint8_t *section,
+                         int len)
+{
+    uint32_t crc = Crc32(section, len);
+    uint8_t *p = pkt;
+
+    memset(pkt, 0xff, TS_SIZE);
+    *p++ = 0x47;
+    *p++ = 0x40 | (pid >> 8);
+    *p++ = pid & 0xff;
+    *p++ = 0x10;
+    *p++ = 0;                       // Pointer field
+    memcpy(p, section, len);
+    p += len;
+    *p++ = crc >> 24;
+    *p++ = (crc >> 16) & 0xff;
+    *p++ = (crc >> 8) & 0xff;
+    *p++ = crc & 0xff;
+}
+
+int cTsMux::PutPatPmt(uint8_t *out)
+{
+    memcpy(out, mPat, TS_SIZE);
+    out[3] = 0x10 | mPatCc;
+    mPatCc = (mPatCc + 1) & 0x0f;
+    memcpy(out + TS_SIZE, mPmt, TS_SIZE);
+    out[TS_SIZE + 3] = 0x10 | mPmtCc;
+    mPmtCc = (mPmtCc + 1) & 0x0f;
+    return TSMUX_PATPMT_SIZE;
+}
+
+// Copy the samples in big endian order as LPCM requires
+static inline void SwapCopy(uint8_t *to, const uint8_t *from, int len)
+{
+    for (int i = 0; i < len; i += 2) {
+        to[i] = from[i + 1];
+        to[i + 1] = from[i];
+    }
+}
+
+int cTsMux::PutSector(uint8_t *out, const uint8_t *data, int64_t pts)
+{
+    uint64_t pcr = pts - TSMUX_PCR_DELAY;
+    uint8_t *p = out;
+    uint8_t *q;
+
+    memcpy(p, mFirst, TSMUX_FIRST_HEADER);
+    p[3] = 0x30 | mCc;
+    mCc = (mCc + 1) & 0x0f;
+    q = p + TSMUX_PCR_POS;
+    q[0] = pcr >> 25;
+    q[1] = pcr >> 17;
+    q[2] = pcr >> 9;
+    q[3] = pcr >> 1;
+    q[4] = ((pcr & 1) << 7) | 0x7e;
+    q[5] = 0;
+    q = p + TSMUX_PTS_POS;
+    q[0] = 0x21 | ((pts >> 29) & 0x0e);
+    q[1] = pts >> 22;
+    q[2] = ((pts >> 14) & 0xfe) | 1;
+    q[3] = pts >> 7;
+    q[4] = ((pts << 1) & 0xfe) | 1;
+    SwapCopy(p + TSMUX_FIRST_HEADER, data, TS_SIZE - TSMUX_FIRST_HEADER);
+    data += TS_SIZE - TSMUX_FIRST_HEADER;
+    p += TS_SIZE;
+    for (int i = 1; i < TSMUX_SECTOR_PACKETS; i++) {
+        p[0] = 0x47;
+        p[1] = TSMUX_AUDIO_PID >> 8;
+        p[2] = TSMUX_AUDIO_PID & 0xff;
+        p[3] = 0x10 | mCc;
+        mCc = (mCc + 1) & 0x0f;
+        SwapCopy(p + 4, data, TS_SIZE - 4);
+        data += TS_SIZE - 4;
+        p += TS_SIZE;
+    }
+    return TSMUX_SECTOR_SIZE;
+}
@@ -0,0 +1,72 @@
+/*
+ * Plugin for VDR to act as CD-Player
+ *
+ * Copyright (C) 2010-2012 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements a transport stream multiplexer for the audio of
+ * the disc. Each sector becomes one LPCM PES packet (Private Stream 1,
+ * like the packets of cPesAudioConverter) with its PTS, carried in a
+ * fixed number of TS packets. The first of them holds the PCR and the
+ * stuffing, so the headers of all packets are the same for each sector
+ * and are copied from a template; only continuity counter, PCR and PTS
+ * are filled in.
+ *
+ * The audio is announced in the PMT as private PES with an AC3
+ * descriptor, which makes VDR hand it to the output device as audio
+ * track like the PES of the player. The device recognizes the LPCM by
+ * its substream id.
+ */
+
+#ifndef __TSMUX_H__
+#define __TSMUX_H__
+
+#include <stdint.h>
+#include <cdio/cdio.h>
+#include "pes_audio_converter.h"
+
+#ifndef TS_SIZE
+#define TS_SIZE 188
+#endif
+
+#define TSMUX_PMT_PID       0x0084
+#define TSMUX_AUDIO_PID     0x0101
+#define TSMUX_SECTOR_PACKETS 13
+#define TSMUX_SECTOR_SIZE   (TSMUX_SECTOR_PACKETS * TS_SIZE)
+#define TSMUX_PATPMT_SIZE   (2 * TS_SIZE)
+#define TSMUX_PTS_PER_SECTOR (90000 / CDIO_CD_FRAMES_PER_SEC)
+#define TSMUX_PTS_START     90000   // PTS of the first sector
+#define TSMUX_PCR_DELAY     9000    // PCR runs 100 ms ahead of the PTS
+
+// TS header, adaptation field with PCR, PES and LPCM header
+#define TSMUX_FIRST_HEADER  (TS_SIZE - 144)
+
+class cTsMux {
+private:
+    uint8_t mPat[TS_SIZE];
+    uint8_t mPmt[TS_SIZE];
+    uint8_t mFirst[TSMUX_FIRST_HEADER];     // Template of the first packet
+    uint8_t mPatCc;
+    uint8_t mPmtCc;
+    uint8_t mCc;
+
+    static uint32_t Crc32(const uint8_t *data, int len);
+    static void MakeSection(uint8_t *pkt, int pid, const uint8_t *section,
+                            int len);
+public:
+    cTsMux(void);
+    // Start a new stream, the continuity counters start at 0
+    void Reset(void) { mPatCc = mPmtCc = mCc = 0; }
+    // Sample rate announced in the LPCM header, for faster playback
+    void SetFreq(PCM_FREQ_T freq) {
+        mFirst[TSMUX_FIRST_HEADER - 2] = freq | PCM_CHAN2;
+    }
+    // PAT and PMT, TSMUX_PATPMT_SIZE bytes
+    int PutPatPmt(uint8_t *out);
+    // One sector with the given PTS, TSMUX_SECTOR_SIZE bytes
+    int PutSector(uint8_t *out, const uint8_t *data, int64_t pts);
+};
+
+#endif